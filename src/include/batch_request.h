@@ -175,6 +175,13 @@ struct rq_runjob {
 	unsigned long rq_resch;
 };
 
+/* RunJobList */
+struct rq_runjoblist {
+	int rq_count;
+	char **rq_jobslist;
+	char **rq_destins;	/* destination of each job in rq_jobslist */
+};
+
 /* SignalJob */
 struct rq_signal {
 	char rq_jid[PBS_MAXSVRJOBID + 1];
@@ -324,6 +331,7 @@ struct batch_request {
 		char rq_rerun[PBS_MAXSVRJOBID + 1];
 		struct rq_rescq rq_rescq;
 		struct rq_runjob rq_run;
+		struct rq_runjoblist rq_runjoblist;
 		struct rq_selstat rq_select;
 		int rq_shutdown;
 		struct rq_signal rq_signal;
@@ -349,6 +357,7 @@ extern void reply_badattr(int, int, svrattrl *, struct batch_request *);
 extern void reply_badattr_msg(int, int, svrattrl *, struct batch_request *, int);
 extern int reply_text(struct batch_request *, int, char *);
 extern int reply_send(struct batch_request *);
+extern int add_runjoblist_status(struct batch_request *, char *, int);
 extern int reply_send_status_part(struct batch_request *);
 extern int reply_jobid(struct batch_request *, char *, int);
 extern int reply_jobid_msg(struct batch_request *, char *, int, int);
@@ -377,6 +386,7 @@ extern void req_register(struct batch_request *);
 extern void req_releasejob(struct batch_request *);
 extern void req_rescq(struct batch_request *);
 extern void req_runjob(struct batch_request *);
+extern void req_runjoblist(struct batch_request *);
 extern void req_selectjobs(struct batch_request *);
 extern void req_stat_que(struct batch_request *);
 extern void req_stat_svr(struct batch_request *);
@@ -418,6 +428,7 @@ extern int decode_DIS_ReqHdr(int, struct batch_request *, int *, int *);
 extern int decode_DIS_Rescl(int, struct batch_request *);
 extern int decode_DIS_Rescq(int, struct batch_request *);
 extern int decode_DIS_Run(int, struct batch_request *);
+extern int decode_DIS_RunJobList(int, struct batch_request *);
 extern int decode_DIS_ShutDown(int, struct batch_request *);
 extern int decode_DIS_SignalJob(int, struct batch_request *);
 extern int decode_DIS_Status(int, struct batch_request *);
@@ -199,7 +199,7 @@ typedef struct rq_preempt brp_preempt_jobs;
 #define BATCH_REPLY_CHOICE_Locate	8	/* locate, see brp_locate */
 #define BATCH_REPLY_CHOICE_RescQuery	9	/* Resource Query */
 #define BATCH_REPLY_CHOICE_PreemptJobs	10	/* Preempt Job */
-#define BATCH_REPLY_CHOICE_Delete		11  /* Delete Job status */
+#define BATCH_REPLY_CHOICE_Delete		11  /* Delete/Run Job List status */
 
 /*
  * the following is the basic Batch Reply structure
@@ -310,6 +310,7 @@ struct batch_reply
 #define PBS_BATCH_ModifyVnode    	99
 #define PBS_BATCH_DeleteJobList  	100
 #define PBS_BATCH_ServerReady    	101
+#define PBS_BATCH_RunJobList    	102
 
 #define PBS_BATCH_FileOpt_Default	0
 #define PBS_BATCH_FileOpt_OFlg		1
@@ -386,6 +387,7 @@ int encode_DIS_ReqExtend(int, char *);
 int encode_DIS_ReqHdr(int, int, char *);
 int encode_DIS_Rescq(int, char **, int);
 int encode_DIS_Run(int, char *, char *, unsigned long);
+int encode_DIS_RunJobList(int, char **, char **, int);
 int encode_DIS_ShutDown(int, int);
 int encode_DIS_SignalJob(int, char *, char *);
 int encode_DIS_Status(int, char *, struct attrl *);
@@ -400,6 +402,7 @@ int tcp_pre_process(conn_t *);
 char *PBSD_modify_resv(int, char *, struct attropl *, char *);
 int PBSD_cred(int, char *, char *, int, char *, long, int, char **);
 int PBSD_server_ready(int);
+int PBSD_runjoblist(int, char **, char **, int, char *, struct batch_deljob_status **);
 int tcp_send_auth_req(int, unsigned int, char *, char *, char *);
 svr_conn_t **get_conn_svr_instances(int);
 int pbs_register_sched(const char *sched_id, int primary_conn_id, int secondary_conn_id);
@@ -142,6 +142,12 @@ int get_num_occurrences(char *rrule, time_t dtstart, char *tz);
  */
 time_t get_occurrence(char *, time_t, char *, int);
 
+/* Get the sorted start times of all the occurrences of a recurrence rule */
+int get_occurrence_times(char *, time_t, char *, time_t **);
+
+/* Get the index of the first occurrence starting at or after a given time */
+int get_occurrence_index(char *, time_t, char *, time_t);
+
 /*
  * Check if a recurrence rule is valid and consistent.
  * The recurrence rule is verified against a start date and checks
@@ -102,6 +102,17 @@ extern int has_hardlimits(void *);
  */
 extern int has_softlimits(void *);
 
+/**	@fn unsigned long lim_hash_hardlimits(void *p)
+ *	@brief	hash the hard limits, independent of the order they are stored in
+ *
+ *	@param p	the limit storage to hash
+ *
+ *	@return		hash of the hard limits, 0 if none are set
+ *
+ *	@par MT-safe:	No
+ */
+extern unsigned long lim_hash_hardlimits(void *);
+
 /**	@fn int is_reslimattr(const struct attrl *a)
  *	@brief	is the given attribute a new-style resource limit attribute?
  *
@@ -43,6 +43,7 @@
  * @file	dec_RunJob.c
  * @brief
  * decode_DIS_RunJob() - decode a Run Job batch request
+ * decode_DIS_RunJobList() - decode a Run Job List batch request
  *
  *	The batch_request structure must already exist (be allocated by the
  *	caller.   It is assumed that the header fields (protocol type,
@@ -56,6 +57,7 @@
 
 #include <pbs_config.h>   /* the master config generated by configure */
 
+#include <stdlib.h>
 #include <sys/types.h>
 #include "libpbs.h"
 #include "list_link.h"
@@ -105,3 +107,59 @@ decode_DIS_Run(int sock, struct batch_request *preq)
 	preq->rq_ind.rq_run.rq_resch = disrul(sock, &rc);
 	return rc;
 }
+
+/**
+ * @brief-
+ *	decode a Run Job List batch request
+ *
+ * @par	Data items are:\n
+ *		unsigned int    count\n
+ *		string          job id\n
+ *		string          destination\n
+ *		(job id and destination are repeated count times)
+ *
+ * @param[in] sock - socket descriptor
+ * @param[out] preq - pointer to batch_request structure
+ *
+ * @return      int
+ * @retval      DIS_SUCCESS(0)  success
+ * @retval      error code      error
+ *
+ */
+
+int
+decode_DIS_RunJobList(int sock, struct batch_request *preq)
+{
+	int rc;
+	int count;
+	int i;
+	char **jobs;
+	char **destins;
+
+	preq->rq_ind.rq_runjoblist.rq_count = 0;
+	preq->rq_ind.rq_runjoblist.rq_jobslist = NULL;
+	preq->rq_ind.rq_runjoblist.rq_destins = NULL;
+
+	count = disrui(sock, &rc);
+	if (rc) return rc;
+
+	jobs = calloc(count + 1, sizeof(char *));
+	destins = calloc(count + 1, sizeof(char *));
+	if (jobs == NULL || destins == NULL) {
+		free(jobs);
+		free(destins);
+		return DIS_NOMALLOC;
+	}
+	/* hand the lists over now so free_br() frees what was decoded on error */
+	preq->rq_ind.rq_runjoblist.rq_jobslist = jobs;
+	preq->rq_ind.rq_runjoblist.rq_destins = destins;
+
+	for (i = 0; i < count; i++) {
+		jobs[i] = disrst(sock, &rc);
+		if (rc) return rc;
+		destins[i] = disrst(sock, &rc);
+		if (rc) return rc;
+		preq->rq_ind.rq_runjoblist.rq_count++;
+	}
+	return rc;
+}
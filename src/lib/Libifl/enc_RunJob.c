@@ -43,6 +43,7 @@
  * @file	enc_RunJob.c
  * @brief
  * encode_DIS_RunJob() - encode a Run Job Batch Request
+ * encode_DIS_RunJobList() - encode a Run Job List Batch Request
  *
  * @par Data items are:
  * 			string		job id
@@ -89,3 +90,37 @@ encode_DIS_Run(int sock, char *id, char *where, unsigned long arg)
 
 	return 0;
 }
+
+/**
+ * @brief
+ *	-encode a Run Job List request: the jobs to run and where
+ *	 to run each of them
+ *
+ * @param[in] sock - socket descriptor
+ * @param[in] jobids - ids of the jobs to run
+ * @param[in] locations - where to run each job
+ * @param[in] count - number of jobs
+ *
+ * @return      int
+ * @retval      DIS_SUCCESS(0)  success
+ * @retval      error code      error
+ *
+ */
+
+int
+encode_DIS_RunJobList(int sock, char **jobids, char **locations, int count)
+{
+	int   rc;
+	int   i;
+
+	if ((rc = diswui(sock, count)) != 0)
+		return rc;
+
+	for (i = 0; i < count; i++) {
+		if ((rc = diswst(sock, jobids[i])) != 0 ||
+			(rc = diswst(sock, locations[i])) != 0)
+			return rc;
+	}
+
+	return 0;
+}
@@ -237,3 +237,83 @@ __pbs_runjob(int c, char *jobid, char *location, char *extend)
 {
 	return __runjob_helper(c, jobid, location, extend, PBS_BATCH_RunJob);
 }
+
+/**
+ * @brief
+ *	-send a run job list batch request: run many jobs, each on its own
+ *	 location, with one request and one reply.  The server handles each
+ *	 job like pbs_asyrunjob_ack() and replies once all of them were handled.
+ *
+ * @param[in] c - connection handle to a server instance (not a cluster fd)
+ * @param[in] jobids - ids of the jobs to run
+ * @param[in] locations - string of vnodes/resources to allocate to each job
+ * @param[in] count - number of jobs
+ * @param[in] extend - extend string for encoding req
+ * @param[out] failed - the jobs the server did not run and why.
+ *			Free with pbs_delstatfree()
+ *
+ * @return      int
+ * @retval      0       success, see failed for the jobs which did not run
+ * @retval      !0      error, the request was not handled
+ *
+ */
+int
+PBSD_runjoblist(int c, char **jobids, char **locations, int count, char *extend,
+	struct batch_deljob_status **failed)
+{
+	int rc = 0;
+	struct batch_reply *reply = NULL;
+
+	if (failed == NULL || jobids == NULL || locations == NULL || count <= 0)
+		return (pbs_errno = PBSE_IVALREQ);
+	*failed = NULL;
+
+	/* initialize the thread context data, if not already initialized */
+	if (pbs_client_thread_init_thread_context() != 0)
+		return pbs_errno;
+
+	/* lock pthread mutex here for this connection */
+	/* blocking call, waits for mutex release */
+	if (pbs_client_thread_lock_connection(c) != 0)
+		return pbs_errno;
+
+	DIS_tcp_funcs();
+
+	if ((rc = encode_DIS_ReqHdr(c, PBS_BATCH_RunJobList, pbs_current_user)) ||
+		(rc = encode_DIS_RunJobList(c, jobids, locations, count)) ||
+		(rc = encode_DIS_ReqExtend(c, extend))) {
+		if (set_conn_errtxt(c, dis_emsg[rc]) != 0)
+			pbs_errno = PBSE_SYSTEM;
+		else
+			pbs_errno = PBSE_PROTOCOL;
+
+		pbs_client_thread_unlock_connection(c);
+		return pbs_errno;
+	}
+
+	if (dis_flush(c)) {
+		pbs_errno = PBSE_PROTOCOL;
+		pbs_client_thread_unlock_connection(c);
+		return pbs_errno;
+	}
+
+	reply = PBSD_rdrpy(c);
+	rc = get_conn_errno(c);
+	if (reply == NULL && rc == PBSE_NONE)
+		rc = pbs_errno = PBSE_PROTOCOL;
+	else if (reply != NULL && rc == PBSE_NONE) {
+		if (reply->brp_choice == BATCH_REPLY_CHOICE_Delete) {
+			*failed = reply->brp_un.brp_deletejoblist.brp_delstatc;
+			reply->brp_un.brp_deletejoblist.brp_delstatc = NULL;
+		} else if (reply->brp_choice != BATCH_REPLY_CHOICE_NULL &&
+			reply->brp_choice != BATCH_REPLY_CHOICE_Text)
+			rc = pbs_errno = PBSE_PROTOCOL;
+	}
+	PBSD_FreeReply(reply);
+
+	/* unlock the thread lock and update the thread context data */
+	if (pbs_client_thread_unlock_connection(c) != 0)
+		return pbs_errno;
+
+	return rc;
+}
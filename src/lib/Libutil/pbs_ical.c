@@ -62,7 +62,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 #include <time.h>
+#include <pthread.h>
 #include <libutil.h>
 
 #include "pbs_error.h"
@@ -71,13 +73,220 @@
 #endif
 
 #define DATE_LIMIT (3*(60*60*24*365)) /* Limit to 3 years from now */
+#define DATE_LIMIT_STEP (60*60*24)	/* the limit moves a day at a time */
+
+#ifdef LIBICAL
+#define OCCR_CACHE_SIZE 32		/* number of expanded recurrence rules kept */
+#define OCCR_CACHE_MAX_OCCR (1 << 20)	/* only this many occurrences of a rule are kept */
+
+/* A recurrence rule expanded into its occurrences.  Both the scheduler and
+ * the server walk the occurrences of a reservation one index at a time, and
+ * without this every step would expand the rule again from dtstart.
+ */
+typedef struct occr_cache_entry {
+	char *rrule;
+	char *tz;
+	time_t dtstart;
+	time_t limit;		/* occurrences were expanded up to this local time */
+	int complete;		/* the rule has no occurrences past the limit */
+	int truncated;		/* more occurrences start before the limit than are kept */
+	int count;		/* the number of occurrences kept */
+	int total;		/* the number of occurrences which start before the limit */
+	time_t *occr;		/* the occurrence start times in UTC */
+	time_t *local;		/* the same times in the rule's timezone */
+	unsigned long last_used;
+} occr_cache_entry;
+
+static occr_cache_entry occr_cache[OCCR_CACHE_SIZE];
+static unsigned long occr_cache_clock = 0;
+static pthread_mutex_t occr_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+#ifdef LIBICAL
+/**
+ * @brief
+ * 	Return the time before which the occurrences of a rule are counted.
+ * 	It is DATE_LIMIT from now, rounded up to a whole DATE_LIMIT_STEP so
+ * 	an expanded rule stays good for the rest of the step.
+ *
+ * @return	time_t
+ */
+static time_t
+occr_date_limit(void)
+{
+	time_t limit = time(NULL) + DATE_LIMIT;
+
+	return limit - limit % DATE_LIMIT_STEP + DATE_LIMIT_STEP;
+}
+
+/**
+ * @brief
+ * 	Empty a slot of the occurrence cache
+ *
+ * @param[in] ent - the cache slot
+ *
+ */
+static void
+free_occr_cache_entry(occr_cache_entry *ent)
+{
+	free(ent->rrule);
+	free(ent->tz);
+	free(ent->occr);
+	free(ent->local);
+	memset(ent, 0, sizeof(occr_cache_entry));
+}
+
+/**
+ * @brief
+ * 	Expand a recurrence rule into a slot of the occurrence cache.
+ *
+ * @param[in] ent - the cache slot to fill.  It is emptied first.
+ * @param[in] rrule - The recurrence rule as defined by the user
+ * @param[in] dtstart - The start time of the first occurrence
+ * @param[in] tz - The timezone associated to the recurrence rule
+ * @param[in] limit - expand the occurrences which start before this time
+ * @param[in] max_occr - keep at most this many occurrences, the rest are
+ * 			 only counted
+ *
+ * @return	int
+ * @retval	1	: the rule was expanded
+ * @retval	0	: the rule could not be expanded
+ *
+ * @par MT-safe: No, call with occr_cache_lock held for a slot of the cache
+ */
+static int
+expand_occurrences(occr_cache_entry *ent, char *rrule, time_t dtstart, char *tz, time_t limit, int max_occr)
+{
+	struct icalrecurrencetype rt;
+	struct icaltimetype start;
+	icaltimezone *localzone;
+	struct icaltimetype next;
+	struct icaltimetype utc;
+	struct icalrecur_iterator_impl *itr;
+	int size = 0;
+	time_t *tmp;
+
+	free_occr_cache_entry(ent);
+
+	icalerror_clear_errno();
+
+	icalerror_set_error_state(ICAL_PARSE_ERROR, ICAL_ERROR_NONFATAL);
+#ifdef LIBICAL_API2
+	icalerror_set_errors_are_fatal(0);
+#else
+	icalerror_errors_are_fatal = 0;
+#endif
+	localzone = icaltimezone_get_builtin_timezone(tz);
+
+	if (localzone == NULL)
+		return 0;
+
+	if ((ent->rrule = strdup(rrule)) == NULL || (ent->tz = strdup(tz)) == NULL) {
+		free_occr_cache_entry(ent);
+		return 0;
+	}
+	ent->dtstart = dtstart;
+	ent->limit = limit;
+
+	rt = icalrecurrencetype_from_string(rrule);
+
+	start = icaltime_from_timet_with_zone(dtstart, 0, NULL);
+	icaltimezone_convert_time(&start, icaltimezone_get_utc_timezone(), localzone);
+
+	itr = (struct icalrecur_iterator_impl*) icalrecur_iterator_new(rt, start);
+
+	for (next = icalrecur_iterator_next(itr); !icaltime_is_null_time(next) &&
+		(icaltime_as_timet(next) < limit); next = icalrecur_iterator_next(itr)) {
+		ent->total++;
+		if (ent->truncated)
+			continue;
+		if (ent->count == size) {
+			if (size >= max_occr) {
+				/* keep counting, the later occurrences are walked to */
+				ent->truncated = 1;
+				continue;
+			}
+			size = size == 0 ? 64 : size * 2;
+			if (size > max_occr)
+				size = max_occr;
+			if ((tmp = realloc(ent->occr, size * sizeof(time_t))) == NULL)
+				break;
+			ent->occr = tmp;
+			if ((tmp = realloc(ent->local, size * sizeof(time_t))) == NULL)
+				break;
+			ent->local = tmp;
+		}
+		utc = next;
+		icaltimezone_convert_time(&utc, localzone, icaltimezone_get_utc_timezone());
+		ent->occr[ent->count] = icaltime_as_timet(utc);
+		ent->local[ent->count] = icaltime_as_timet(next);
+		ent->count++;
+	}
+	if (icaltime_is_null_time(next))
+		ent->complete = 1;
+	else if (icaltime_as_timet(next) < limit) {
+		/* ran out of memory before the limit */
+		icalrecur_iterator_free(itr);
+		free_occr_cache_entry(ent);
+		return 0;
+	}
+	icalrecur_iterator_free(itr);
+
+	return 1;
+}
+
+/**
+ * @brief
+ * 	Find the expanded occurrences of a recurrence rule, expanding the rule
+ * 	if it is not in the cache or was expanded short of a time limit.
+ *
+ * @param[in] rrule - The recurrence rule as defined by the user
+ * @param[in] dtstart - The start time of the first occurrence
+ * @param[in] tz - The timezone associated to the recurrence rule
+ * @param[in] limit - the occurrences which start before this time are needed
+ *
+ * @return	occr_cache_entry *
+ * @retval	the cached occurrences
+ * @retval	NULL	: the rule could not be expanded
+ *
+ * @par MT-safe: No, call with occr_cache_lock held
+ */
+static occr_cache_entry *
+find_occurrences(char *rrule, time_t dtstart, char *tz, time_t limit)
+{
+	occr_cache_entry *ent = NULL;
+	occr_cache_entry *lru = &occr_cache[0];
+	int i;
+
+	for (i = 0; i < OCCR_CACHE_SIZE; i++) {
+		if (occr_cache[i].rrule != NULL && occr_cache[i].dtstart == dtstart &&
+			strcmp(occr_cache[i].rrule, rrule) == 0 && strcmp(occr_cache[i].tz, tz) == 0) {
+			ent = &occr_cache[i];
+			break;
+		}
+		if (occr_cache[i].last_used < lru->last_used)
+			lru = &occr_cache[i];
+	}
+
+	if (ent == NULL || (!ent->complete && ent->limit < limit)) {
+		if (ent == NULL)
+			ent = lru;
+		if (!expand_occurrences(ent, rrule, dtstart, tz, limit, OCCR_CACHE_MAX_OCCR))
+			return NULL;
+	}
+	ent->last_used = ++occr_cache_clock;
+
+	return ent;
+}
+
+#endif
 
 /**
  * @brief
  * 	Returns the number of occurrences defined by a recurrence rule.
  *
  * @par	The total number of occurrences is currently limited to a hardcoded
- * 	3 years limit from the current date.
+ * 	3 years limit from the current date, rounded up to a whole day.
  *
  * @par	NOTE: Determine whether 3 years limit is the right way to go about setting
  * 	a limit on the total number of occurrences.
@@ -101,8 +310,8 @@ get_num_occurrences(char *rrule, time_t dtstart, char *tz)
 	icaltimezone *localzone;
 	struct icaltimetype next;
 	struct icalrecur_iterator_impl *itr;
-	time_t now;
 	time_t date_limit;
+	occr_cache_entry *ent;
 	int num_resv = 0;
 
 	/* if any of the argument is NULL, we are dealing with
@@ -123,8 +332,16 @@ get_num_occurrences(char *rrule, time_t dtstart, char *tz)
 	if (localzone == NULL)
 		return 0;
 
-	now = time(NULL);
-	date_limit = now + DATE_LIMIT;
+	date_limit = occr_date_limit();
+
+	pthread_mutex_lock(&occr_cache_lock);
+	ent = find_occurrences(rrule, dtstart, tz, date_limit);
+	if (ent != NULL) {
+		num_resv = ent->total;
+		pthread_mutex_unlock(&occr_cache_lock);
+		return num_resv;
+	}
+	pthread_mutex_unlock(&occr_cache_lock);
 
 	rt = icalrecurrencetype_from_string(rrule);
 
@@ -160,9 +377,8 @@ get_num_occurrences(char *rrule, time_t dtstart, char *tz)
  * 	index, and start time. This function assumes that the
  * 	time dtsart passed in is the one to start the occurrence from.
  *
- * @par	NOTE: This function should be made reentrant such that
- * 	it can be looped over without having to loop over every occurrence
- * 	over and over again.
+ * @par	The occurrences are expanded once per rule and cached, so looping
+ * 	over idx does not walk the rule from dtstart every time.
  *
  * @param[in] rrule - The recurrence rule as defined by the user
  * @param[in] dtstart - The start time from which to start
@@ -183,6 +399,7 @@ get_occurrence(char *rrule, time_t dtstart, char *tz, int idx)
 	icaltimezone *localzone;
 	struct icaltimetype next;
 	struct icalrecur_iterator_impl *itr;
+	occr_cache_entry *ent;
 	int i;
 	time_t next_occr = dtstart;
 
@@ -205,6 +422,21 @@ get_occurrence(char *rrule, time_t dtstart, char *tz, int idx)
 	if (localzone == NULL)
 		return -1;
 
+	if (idx <= 0)
+		return dtstart;
+
+	/* The occurrences up to the date limit are looked up in the cache.
+	 * Past the last one, the rule has either ended or is walked below.
+	 */
+	pthread_mutex_lock(&occr_cache_lock);
+	ent = find_occurrences(rrule, dtstart, tz, occr_date_limit());
+	if (ent != NULL && (idx <= ent->count || (ent->complete && !ent->truncated))) {
+		next_occr = idx <= ent->count ? ent->occr[idx - 1] : -1;
+		pthread_mutex_unlock(&occr_cache_lock);
+		return next_occr;
+	}
+	pthread_mutex_unlock(&occr_cache_lock);
+
 	rt = icalrecurrencetype_from_string(rrule);
 
 	start = icaltime_from_timet_with_zone(dtstart, 0, NULL);
@@ -229,6 +461,154 @@ get_occurrence(char *rrule, time_t dtstart, char *tz, int idx)
 #endif
 }
 
+/**
+ * @brief
+ * 	Get the start times of all the occurrences of a recurrence rule,
+ * 	as counted by get_num_occurrences().  The rule is expanded once,
+ * 	so this is the cheap way to walk every occurrence of a reservation.
+ * 	A rule with more occurrences than the cache keeps is expanded again
+ * 	for each call.
+ *
+ * @param[in] rrule - The recurrence rule as defined by the user
+ * @param[in] dtstart - The start time of the first occurrence
+ * @param[in] tz - The timezone associated to the recurrence rule
+ * @param[out] occrs - the sorted occurrence start times.  The caller frees it.
+ *
+ * @return	int
+ * @retval	the number of occurrences in occrs
+ * @retval	-1	: error, occrs is not set
+ *
+ */
+int
+get_occurrence_times(char *rrule, time_t dtstart, char *tz, time_t **occrs)
+{
+	time_t *arr;
+	int count;
+	int i;
+
+	if (occrs == NULL)
+		return -1;
+
+	if (rrule == NULL) {
+		if ((arr = malloc(sizeof(time_t))) == NULL)
+			return -1;
+		arr[0] = dtstart;
+		*occrs = arr;
+		return 1;
+	}
+
+#ifdef LIBICAL
+	if (tz != NULL) {
+		occr_cache_entry *ent;
+		occr_cache_entry all;
+		time_t date_limit = occr_date_limit();
+
+		pthread_mutex_lock(&occr_cache_lock);
+		ent = find_occurrences(rrule, dtstart, tz, date_limit);
+		if (ent != NULL && !ent->truncated) {
+			count = ent->count;
+			if ((arr = malloc((count + 1) * sizeof(time_t))) == NULL) {
+				pthread_mutex_unlock(&occr_cache_lock);
+				return -1;
+			}
+			memcpy(arr, ent->occr, count * sizeof(time_t));
+			pthread_mutex_unlock(&occr_cache_lock);
+			*occrs = arr;
+			return count;
+		}
+		pthread_mutex_unlock(&occr_cache_lock);
+
+		/* more occurrences than the cache keeps, expand them for the caller */
+		memset(&all, 0, sizeof(all));
+		if (ent != NULL && expand_occurrences(&all, rrule, dtstart, tz, date_limit, INT_MAX)) {
+			count = all.count;
+			arr = all.occr;
+			all.occr = NULL;
+			free_occr_cache_entry(&all);
+			if (arr == NULL && (arr = malloc(sizeof(time_t))) == NULL)
+				return -1;
+			*occrs = arr;
+			return count;
+		}
+	}
+#endif
+
+	/* the rule could not be kept in the cache, walk it one occurrence at a time */
+	count = get_num_occurrences(rrule, dtstart, tz);
+	if ((arr = malloc((count + 1) * sizeof(time_t))) == NULL)
+		return -1;
+	for (i = 0; i < count; i++)
+		arr[i] = get_occurrence(rrule, dtstart, tz, i + 1);
+	*occrs = arr;
+
+	return count;
+}
+
+/**
+ * @brief
+ * 	Find the first occurrence of a recurrence rule which starts at or
+ * 	after a given time.  Used with get_occurrence() to walk the
+ * 	occurrences in a window of time without starting from dtstart.
+ *
+ * @param[in] rrule - The recurrence rule as defined by the user
+ * @param[in] dtstart - The start time of the first occurrence
+ * @param[in] tz - The timezone associated to the recurrence rule
+ * @param[in] when - the start of the window
+ *
+ * @return	int
+ * @retval	the index of the occurrence as passed to get_occurrence()
+ * @retval	0	: no occurrence starts at or after when
+ *
+ */
+int
+get_occurrence_index(char *rrule, time_t dtstart, char *tz, time_t when)
+{
+#ifdef LIBICAL
+	time_t next;
+	int i;
+#endif
+
+	if (rrule == NULL)
+		return dtstart >= when ? 1 : 0;
+
+#ifdef LIBICAL
+	if (tz != NULL) {
+		occr_cache_entry *ent;
+
+		pthread_mutex_lock(&occr_cache_lock);
+		ent = find_occurrences(rrule, dtstart, tz, occr_date_limit());
+		if (ent != NULL && ent->count > 0 && ent->occr[ent->count - 1] >= when) {
+			int lo = 0;
+			int hi = ent->count - 1;
+
+			while (lo < hi) {
+				int mid = lo + (hi - lo) / 2;
+				if (ent->occr[mid] < when)
+					lo = mid + 1;
+				else
+					hi = mid;
+			}
+			pthread_mutex_unlock(&occr_cache_lock);
+			return lo + 1;
+		}
+		if (ent != NULL && ent->complete && !ent->truncated) {
+			pthread_mutex_unlock(&occr_cache_lock);
+			return 0;
+		}
+		pthread_mutex_unlock(&occr_cache_lock);
+	}
+
+	for (i = 1; (next = get_occurrence(rrule, dtstart, tz, i)) != -1; i++) {
+		if (next >= when)
+			return i;
+	}
+
+	return 0;
+#else
+	return dtstart >= when ? 1 : 0;
+#endif
+}
+
 /**
  * @brief
  * 	Check if a recurrence rule is valid and consistent.
@@ -579,10 +959,18 @@ set_ical_zoneinfo(char *path)
 {
 #ifdef LIBICAL
 	static int called = 0;
+	int i;
+
 	if (path != NULL) {
 		if(called)
 			free_zone_directory();
 
+		/* the expanded occurrences depend on the zone definitions */
+		pthread_mutex_lock(&occr_cache_lock);
+		for (i = 0; i < OCCR_CACHE_SIZE; i++)
+			free_occr_cache_entry(&occr_cache[i]);
+		pthread_mutex_unlock(&occr_cache_lock);
+
 		set_zone_directory(path);
 		called = 1;
 	}
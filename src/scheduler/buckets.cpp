@@ -58,6 +58,10 @@
 #include <log.h>
 #include "pbs_internal.h"
 
+#include <string>
+#include <unordered_map>
+#include <vector>
+
 /* bucket_bitpool constructor */
 bucket_bitpool *
 new_bucket_bitpool()
@@ -399,6 +403,11 @@ create_node_buckets(status *policy, node_info **nodes, queue_info **queues, unsi
 	node_bucket **buckets = NULL;
 	node_bucket **tmp;
 	int node_ct;
+	/* node signature to the buckets created for nodes with that signature.
+	 * Nodes with the same signature almost always share a bucket, so this
+	 * saves searching the whole bucket array for each node.
+	 */
+	std::unordered_map<std::string, std::vector<int>> sig_bkts;
 
 	if (policy == NULL || nodes == NULL)
 		return NULL;
@@ -424,7 +433,27 @@ create_node_buckets(status *policy, node_info **nodes, queue_info **queues, unsi
 		if (queues != NULL && !nodes[i]->queue_name.empty())
 			qinfo = find_queue_info(queues, nodes[i]->queue_name);
 
-		bkt_ind = find_node_bucket_ind(buckets, nodes[i]->res, qinfo, nodes[i]->priority);
+		std::string sig;
+		char *res_sig = create_resource_signature(nodes[i]->res, policy->resdef_to_check_no_hostvnode, ADD_ALL_BOOL);
+		if (res_sig != NULL) {
+			sig = res_sig;
+			free(res_sig);
+		}
+		sig += ":" + std::to_string(nodes[i]->priority) + ":" + (qinfo != NULL ? qinfo->name : "");
+
+		auto &cands = sig_bkts[sig];
+		bkt_ind = -1;
+		for (auto c : cands) {
+			if (buckets[c]->queue == qinfo && buckets[c]->priority == nodes[i]->priority &&
+			    compare_resource_avail_list(buckets[c]->res_spec, nodes[i]->res)) {
+				bkt_ind = c;
+				break;
+			}
+		}
+		if (bkt_ind == -1) {
+			bkt_ind = find_node_bucket_ind(buckets, nodes[i]->res, qinfo, nodes[i]->priority);
+			cands.push_back(bkt_ind == -1 ? j : bkt_ind);
+		}
 		if (flags & UPDATE_BUCKET_IND) {
 			if (bkt_ind == -1)
 				nodes[i]->bucket_ind = j;
@@ -628,7 +657,8 @@ bucket_match(chunk_map **cmap, resource_resv *resresv, schd_error *err)
 	int i;
 	int j;
 	int k;
-	static pbs_bitmap *zeromap = NULL;
+	static thread_local pbs_bitmap *zeromap = NULL;
+	static thread_local pbs_bitmap *takemap = NULL;
 	server_info *sinfo;
 
 	if (cmap == NULL || resresv == NULL || resresv->select == NULL)
@@ -639,6 +669,11 @@ bucket_match(chunk_map **cmap, resource_resv *resresv, schd_error *err)
 		if (zeromap == NULL)
 			return 0;
 	}
+	if (takemap == NULL) {
+		takemap = pbs_bitmap_alloc(NULL, 1);
+		if (takemap == NULL)
+			return 0;
+	}
 
 	sinfo = resresv->server;
 
@@ -653,10 +688,25 @@ bucket_match(chunk_map **cmap, resource_resv *resresv, schd_error *err)
 
 	for (i = 0; cmap[i] != NULL; i++) {
 		int num_chunks_needed = cmap[i]->chk->num_chunks;
+		int chunks_avail = 0;
 
 		if (cmap[i]->bkt_cnts == NULL)
 			break;
 
+		/* Quick check: even if every free and busy later node is usable,
+		 * are there enough of them?  Provisioning checks set the error,
+		 * so leave those jobs to the node by node search.
+		 */
+		if (resresv->aoename == NULL) {
+			for (j = 0; cmap[i]->bkt_cnts[j] != NULL; j++) {
+				node_bucket *bkt = cmap[i]->bkt_cnts[j]->bkt;
+				chunks_avail += (bkt->free_pool->working_ct + bkt->busy_later_pool->working_ct) *
+					cmap[i]->bkt_cnts[j]->chunk_count;
+			}
+			if (chunks_avail < num_chunks_needed)
+				return 0;
+		}
+
 		for (j = 0; cmap[i]->bkt_cnts[j] != NULL && num_chunks_needed > 0; j++) {
 			node_bucket *bkt = cmap[i]->bkt_cnts[j]->bkt;
 			int chunks_added = 0;
@@ -684,23 +734,43 @@ bucket_match(chunk_map **cmap, resource_resv *resresv, schd_error *err)
 
 			}
 
-			for (k = pbs_bitmap_first_on_bit(bkt->free_pool->working);
-			     num_chunks_needed > chunks_added && k >= 0;
-			     k = pbs_bitmap_next_on_bit(bkt->free_pool->working, k)) {
-				clear_schd_error(err);
-				if (resresv->aoename != NULL) {
+			/* Without provisioning every free node will do: take as many as
+			 * are needed from the front of the pool a word at a time
+			 */
+			if (resresv->aoename == NULL) {
+				int chunk_count = cmap[i]->bkt_cnts[j]->chunk_count;
+
+				if (num_chunks_needed > chunks_added) {
+					unsigned long nodes_needed = (num_chunks_needed - chunks_added + chunk_count - 1) / chunk_count;
+					unsigned long taken;
+
+					taken = pbs_bitmap_first_n_on_bits(takemap, bkt->free_pool->working, nodes_needed);
+					if (taken > 0) {
+						pbs_bitmap_andnot(bkt->free_pool->working, takemap);
+						bkt->free_pool->working_ct -= taken;
+						pbs_bitmap_or(bkt->busy_pool->working, takemap);
+						bkt->busy_pool->working_ct += taken;
+						pbs_bitmap_or(cmap[i]->node_bits, takemap);
+						chunks_added += taken * chunk_count;
+					}
+				}
+			} else {
+				for (k = pbs_bitmap_first_on_bit(bkt->free_pool->working);
+				     num_chunks_needed > chunks_added && k >= 0;
+				     k = pbs_bitmap_next_on_bit(bkt->free_pool->working, k)) {
+					clear_schd_error(err);
 					if (sinfo->unordered_nodes[k]->current_aoe == NULL ||
 					   strcmp(sinfo->unordered_nodes[k]->current_aoe, resresv->aoename) != 0)
 						if (is_provisionable(sinfo->unordered_nodes[k], resresv, err) == NOT_PROVISIONABLE) {
 							continue;
 						}
+					pbs_bitmap_bit_off(bkt->free_pool->working, k);
+					bkt->free_pool->working_ct--;
+					pbs_bitmap_bit_on(bkt->busy_pool->working, k);
+					bkt->busy_pool->working_ct++;
+					pbs_bitmap_bit_on(cmap[i]->node_bits, k);
+					chunks_added += cmap[i]->bkt_cnts[j]->chunk_count;
 				}
-				pbs_bitmap_bit_off(bkt->free_pool->working, k);
-				bkt->free_pool->working_ct--;
-				pbs_bitmap_bit_on(bkt->busy_pool->working, k);
-				bkt->busy_pool->working_ct++;
-				pbs_bitmap_bit_on(cmap[i]->node_bits, k);
-				chunks_added += cmap[i]->bkt_cnts[j]->chunk_count;
 			}
 
 			if (chunks_added > 0)
@@ -949,7 +1019,7 @@ find_correct_buckets(status *policy, node_bucket **buckets, resource_resv *resre
 	int i, j;
 	int can_run = 1;
 	chunk_map **cb_map;
-	static struct schd_error *failerr = NULL;
+	static thread_local struct schd_error *failerr = NULL;
 
 	if (policy == NULL || buckets == NULL || resresv == NULL || resresv->select == NULL || resresv->select->chunks == NULL || err == NULL)
 		return NULL;
@@ -1095,7 +1165,7 @@ check_node_buckets(status *policy, server_info *sinfo, queue_info *qinfo, resour
 	if (nodepart != NULL) {
 		int i;
 		int can_run = 0;
-		static schd_error *failerr = NULL;
+		static thread_local schd_error *failerr = NULL;
 		if (failerr == NULL) {
 			failerr = new_schd_error();
 			if (failerr == NULL)
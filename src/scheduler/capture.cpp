@@ -0,0 +1,728 @@
+/*
+ * Copyright (C) 1994-2021 Altair Engineering, Inc.
+ * For more information, contact Altair at www.altair.com.
+ *
+ * This file is part of both the OpenPBS software ("OpenPBS")
+ * and the PBS Professional ("PBS Pro") software.
+ *
+ * Open Source License Information:
+ *
+ * OpenPBS is free software. You can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Commercial License Information:
+ *
+ * PBS Pro is commercially licensed software that shares a common core with
+ * the OpenPBS software.  For a copy of the commercial license terms and
+ * conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+ * Altair Legal Department.
+ *
+ * Altair's dual-license business model allows companies, individuals, and
+ * organizations to create proprietary derivative works of OpenPBS and
+ * distribute them - whether embedded or bundled with other software -
+ * under a commercial license agreement.
+ *
+ * Use of Altair's trademarks, including but not limited to "PBS™",
+ * "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+ * subject to Altair's trademark licensing policies.
+ */
+
+
+/**
+ * @file    capture.cpp
+ *
+ * @brief
+ * 		capture.cpp - capture the status replies of a scheduling cycle
+ * 		and answer status calls from such a capture.
+ *
+ * A capture directory holds copies of the sched_priv files and the
+ * universe file.  The universe file is line based.  The first line is
+ * the header:
+ *	#pbs_sched_capture <version> <capture time> <scheduler name>
+ * and every object is an O line followed by an A line per attribute:
+ *	O <kind> <name>
+ *	A <attribute> <resource> <value>
+ * Fields are separated by tabs.  Backslashes, tabs and newlines in a
+ * field are escaped as \\, \t and \n.
+ *
+ * Functions included are:
+ * 	capture_arm()
+ * 	capture_start()
+ * 	capture_record()
+ * 	capture_end()
+ * 	capture_copy_priv()
+ * 	replay_load()
+ * 	replay_active()
+ * 	replay_time()
+ * 	replay_sched_name()
+ * 	replay_stat()
+ * 	replay_select()
+ * 	replay_decision()
+ * 	replay_decision_count()
+ */
+#include <pbs_config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <string>
+#include <vector>
+#include <pbs_ifl.h>
+#include <pbs_error.h>
+#include <libpbs.h>
+#include <log.h>
+#include "config.h"
+#include "constant.h"
+#include "fifo.h"
+#include "globals.h"
+#include "job_status_cache.h"
+#include "resource.h"
+#include "capture.h"
+
+#define CAPTURE_MAGIC "#pbs_sched_capture"
+#define CAPTURE_VERSION 1
+
+struct cap_attr
+{
+	std::string name;
+	std::string resource;
+	std::string value;
+};
+
+struct cap_obj
+{
+	std::string name;
+	std::vector<cap_attr> attrs;
+};
+
+static const char *cap_kind_names[CAP_NUM_KINDS] = {
+	"server",
+	"sched",
+	"resource",
+	"queue",
+	"node",
+	"resv",
+	"job"
+};
+
+/* the sched_priv files a cycle depends on */
+static const char *cap_priv_files[] = {
+	CONFIG_FILE,
+	RESGROUP_FILE,
+	USAGE_FILE,
+	USAGE_JOURNAL,
+	HOLIDAYS_FILE,
+	DEDTIME_FILE,
+	NULL
+};
+
+/* capture state */
+static std::string capture_dir;		/* where to capture the next cycle, empty if not armed */
+static FILE *capture_fp = NULL;		/* universe file of the cycle being captured */
+static int capture_sd;			/* connection the cycle is captured from */
+static bool capture_recorded[CAP_NUM_KINDS];
+
+/* replay state */
+static bool replaying = false;
+static time_t rp_time;
+static std::string rp_sched;
+static std::vector<cap_obj> rp_objs[CAP_NUM_KINDS];
+static unsigned long rp_decisions = 0;
+
+/**
+ * @brief	write one field of a record, escaping it
+ *
+ * @param[in]	fp	-	file to write to
+ * @param[in]	str	-	the field, NULL is written as an empty field
+ *
+ * @return	void
+ */
+static void
+write_field(FILE *fp, const char *str)
+{
+	if (str == NULL)
+		return;
+
+	for (; *str != '\0'; str++) {
+		switch (*str) {
+			case '\\':
+				fputs("\\\\", fp);
+				break;
+			case '\t':
+				fputs("\\t", fp);
+				break;
+			case '\n':
+				fputs("\\n", fp);
+				break;
+			default:
+				putc(*str, fp);
+		}
+	}
+}
+
+/**
+ * @brief	split a record into its unescaped fields
+ *
+ * @param[in]	line	-	the record without its newline
+ * @param[out]	fields	-	the fields of the record
+ *
+ * @return	void
+ */
+static void
+split_fields(const char *line, std::vector<std::string>& fields)
+{
+	std::string cur;
+
+	fields.clear();
+	for (; *line != '\0'; line++) {
+		if (*line == '\t') {
+			fields.push_back(cur);
+			cur.clear();
+		} else if (*line == '\\' && line[1] != '\0') {
+			line++;
+			if (*line == 't')
+				cur += '\t';
+			else if (*line == 'n')
+				cur += '\n';
+			else
+				cur += *line;
+		} else
+			cur += *line;
+	}
+	fields.push_back(cur);
+}
+
+/**
+ * @brief	capture the next cycle into a directory
+ *
+ * @param[in]	dir	-	directory to capture into, empty to disarm
+ *
+ * @return	void
+ */
+void
+capture_arm(const std::string& dir)
+{
+	/* a replayed sched_config names the directory it was captured to */
+	if (replaying)
+		return;
+
+	capture_dir = dir;
+}
+
+/**
+ * @brief	start capturing the cycle if a capture is armed.  The sched
+ *		object and the resource definitions are only queried when they
+ *		change, so they are queried here to get them into the capture.
+ *		The job status cache is invalidated so every job is queried.
+ *
+ * @param[in]	pbs_sd	-	connection to the server
+ *
+ * @return	void
+ */
+void
+capture_start(int pbs_sd)
+{
+	std::string file;
+
+	if (capture_dir.empty() || capture_fp != NULL)
+		return;
+
+	if (mkdir(capture_dir.c_str(), 0750) == -1 && errno != EEXIST) {
+		log_errf(errno, __func__, "Can't create capture directory %s", capture_dir.c_str());
+		capture_dir.clear();
+		return;
+	}
+	if (capture_copy_priv(".", capture_dir.c_str()) != 0) {
+		capture_dir.clear();
+		return;
+	}
+
+	file = capture_dir + "/" CAPTURE_FILE ".new";
+	if ((capture_fp = fopen(file.c_str(), "w")) == NULL) {
+		log_errf(errno, __func__, "Can't open %s", file.c_str());
+		capture_dir.clear();
+		return;
+	}
+	fprintf(capture_fp, "%s\t%d\t%ld\t", CAPTURE_MAGIC, CAPTURE_VERSION, static_cast<long>(time(NULL)));
+	write_field(capture_fp, sc_name);
+	putc('\n', capture_fp);
+
+	for (int i = 0; i < CAP_NUM_KINDS; i++)
+		capture_recorded[i] = false;
+	capture_sd = pbs_sd;
+
+	pbs_statfree(send_statsched(pbs_sd, NULL, NULL));
+	pbs_statfree(send_statrsc(pbs_sd, NULL, NULL, const_cast<char *>("p")));
+	jstat_cache.invalidate("cycle capture");
+}
+
+/**
+ * @brief	record a status reply of the cycle being captured.  Only the
+ *		first reply of each kind is kept, except for jobs which are
+ *		queried a queue at a time.
+ *
+ * @param[in]	pbs_sd	-	connection the reply came from
+ * @param[in]	kind	-	kind of objects in the reply
+ * @param[in]	bs	-	the reply
+ * @param[in]	criteria	-	selection criteria of a selstat, or NULL
+ *
+ * @return	void
+ */
+void
+capture_record(int pbs_sd, enum cap_kind kind, struct batch_status *bs, struct attropl *criteria)
+{
+	const char *queue = NULL;
+
+	/* replies from remote peer servers are not part of our universe */
+	if (capture_fp == NULL || pbs_sd != capture_sd)
+		return;
+
+	if (kind == CAP_JOB) {
+		/* only whole queues, the job status cache's deltas would repeat jobs */
+		if (criteria == NULL || criteria->next != NULL || criteria->op != EQ ||
+		    strcmp(criteria->name, ATTR_q) != 0)
+			return;
+		queue = criteria->value;
+	} else if (capture_recorded[kind])
+		return;
+	capture_recorded[kind] = true;
+
+	for (; bs != NULL; bs = bs->next) {
+		bool has_queue = false;
+
+		fprintf(capture_fp, "O\t%s\t", cap_kind_names[kind]);
+		write_field(capture_fp, bs->name);
+		putc('\n', capture_fp);
+		for (struct attrl *attr = bs->attribs; attr != NULL; attr = attr->next) {
+			if (queue != NULL && strcmp(attr->name, ATTR_queue) == 0)
+				has_queue = true;
+			fputs("A\t", capture_fp);
+			write_field(capture_fp, attr->name);
+			putc('\t', capture_fp);
+			write_field(capture_fp, attr->resource);
+			putc('\t', capture_fp);
+			write_field(capture_fp, attr->value);
+			putc('\n', capture_fp);
+		}
+		/* the replay selects jobs by queue, make sure they have one */
+		if (queue != NULL && !has_queue) {
+			fprintf(capture_fp, "A\t%s\t\t", ATTR_queue);
+			write_field(capture_fp, queue);
+			putc('\n', capture_fp);
+		}
+	}
+}
+
+/**
+ * @brief	finish the capture of the cycle and disarm the capture
+ *
+ * @return	void
+ */
+void
+capture_end(void)
+{
+	std::string file;
+	int err;
+
+	if (capture_fp == NULL)
+		return;
+
+	file = capture_dir + "/" CAPTURE_FILE;
+	err = ferror(capture_fp);
+	if (fclose(capture_fp) != 0)
+		err = 1;
+	capture_fp = NULL;
+
+	if (err || rename((file + ".new").c_str(), file.c_str()) == -1)
+		log_errf(errno, __func__, "Can't write capture %s", file.c_str());
+	else
+		log_eventf(PBSEVENT_SCHED, PBS_EVENTCLASS_SCHED, LOG_INFO, "capture",
+			"Scheduling cycle captured in %s", capture_dir.c_str());
+
+	capture_dir.clear();
+}
+
+/**
+ * @brief	copy the sched_priv files a cycle depends on between
+ *		directories.  Files which don't exist are skipped, except
+ *		that a missing usage journal removes the one in the target.
+ *
+ * @param[in]	from	-	directory to copy from
+ * @param[in]	to	-	directory to copy to
+ *
+ * @return	int
+ * @retval	0	success
+ * @retval	-1	error
+ */
+int
+capture_copy_priv(const char *from, const char *to)
+{
+	char buf[8192];
+
+	for (int i = 0; cap_priv_files[i] != NULL; i++) {
+		std::string src = std::string(from) + "/" + cap_priv_files[i];
+		std::string dst = std::string(to) + "/" + cap_priv_files[i];
+		ssize_t n;
+		int in;
+		int out;
+		int err = 0;
+
+		if ((in = open(src.c_str(), O_RDONLY)) == -1) {
+			if (errno == ENOENT) {
+				/* a journal left in the target would be replayed
+				 * on the usage file we copied
+				 */
+				if (!strcmp(cap_priv_files[i], USAGE_JOURNAL))
+					unlink(dst.c_str());
+				continue;
+			}
+			log_errf(errno, __func__, "Can't open %s", src.c_str());
+			return -1;
+		}
+		if ((out = open(dst.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644)) == -1) {
+			log_errf(errno, __func__, "Can't open %s", dst.c_str());
+			close(in);
+			return -1;
+		}
+		while ((n = read(in, buf, sizeof(buf))) > 0) {
+			if (write(out, buf, n) != n) {
+				err = 1;
+				break;
+			}
+		}
+		if (n == -1)
+			err = 1;
+		close(in);
+		if (close(out) == -1)
+			err = 1;
+		if (err) {
+			log_errf(errno, __func__, "Can't copy %s to %s", src.c_str(), dst.c_str());
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * @brief	load a capture and answer status calls from it from now on.
+ *		Errors are written to stderr, this is only used by
+ *		pbs_sched_replay.
+ *
+ * @param[in]	dir	-	capture directory
+ *
+ * @return	int
+ * @retval	0	success
+ * @retval	-1	error
+ */
+int
+replay_load(const char *dir)
+{
+	std::string file = std::string(dir) + "/" CAPTURE_FILE;
+	std::vector<std::string> fields;
+	cap_obj *cur = NULL;
+	char *line = NULL;
+	size_t linesz = 0;
+	ssize_t len;
+	int lineno = 0;
+	FILE *fp;
+
+	if ((fp = fopen(file.c_str(), "r")) == NULL) {
+		fprintf(stderr, "%s: %s\n", file.c_str(), strerror(errno));
+		return -1;
+	}
+
+	while ((len = getline(&line, &linesz, fp)) != -1) {
+		lineno++;
+		if (len > 0 && line[len - 1] == '\n')
+			line[len - 1] = '\0';
+		split_fields(line, fields);
+
+		if (lineno == 1) {
+			if (fields.size() != 4 || fields[0] != CAPTURE_MAGIC) {
+				fprintf(stderr, "%s: not a scheduler capture\n", file.c_str());
+				break;
+			}
+			if (atoi(fields[1].c_str()) != CAPTURE_VERSION) {
+				fprintf(stderr, "%s: unsupported capture version %s\n", file.c_str(), fields[1].c_str());
+				break;
+			}
+			rp_time = strtol(fields[2].c_str(), NULL, 10);
+			rp_sched = fields[3];
+		} else if (fields.size() == 3 && fields[0] == "O") {
+			int kind;
+
+			for (kind = 0; kind < CAP_NUM_KINDS; kind++)
+				if (fields[1] == cap_kind_names[kind])
+					break;
+			if (kind == CAP_NUM_KINDS) {
+				fprintf(stderr, "%s:%d: unknown object kind %s\n", file.c_str(), lineno, fields[1].c_str());
+				break;
+			}
+			rp_objs[kind].push_back(cap_obj{fields[2], {}});
+			cur = &rp_objs[kind].back();
+		} else if (fields.size() == 4 && fields[0] == "A" && cur != NULL)
+			cur->attrs.push_back(cap_attr{fields[1], fields[2], fields[3]});
+		else {
+			fprintf(stderr, "%s:%d: bad record\n", file.c_str(), lineno);
+			break;
+		}
+	}
+	free(line);
+
+	if (!feof(fp) || lineno == 0) {
+		if (lineno == 0)
+			fprintf(stderr, "%s: empty capture\n", file.c_str());
+		fclose(fp);
+		for (int i = 0; i < CAP_NUM_KINDS; i++)
+			rp_objs[i].clear();
+		return -1;
+	}
+	fclose(fp);
+
+	replaying = true;
+	return 0;
+}
+
+/**
+ * @brief	are status calls answered from a loaded capture?
+ */
+bool
+replay_active(void)
+{
+	return replaying;
+}
+
+/**
+ * @brief	when the loaded capture was taken
+ */
+time_t
+replay_time(void)
+{
+	return rp_time;
+}
+
+/**
+ * @brief	name of the scheduler the loaded capture was taken of
+ */
+const char *
+replay_sched_name(void)
+{
+	return rp_sched.c_str();
+}
+
+/**
+ * @brief	does an object match one selection criterion?  Like the
+ *		server, a job_state criterion matches any of the states it lists.
+ *
+ * @param[in]	attr	-	the object's attribute named by the criterion
+ * @param[in]	crit	-	the criterion
+ *
+ * @return	bool
+ */
+static bool
+match_criterion(const cap_attr& attr, const struct attropl *crit)
+{
+	long val;
+	long cval;
+
+	switch (crit->op) {
+		case EQ:
+			if (attr.name == ATTR_state)
+				return !attr.value.empty() && strchr(crit->value, attr.value[0]) != NULL;
+			return attr.value == crit->value;
+		case NE:
+			return attr.value != crit->value;
+		case GE:
+		case GT:
+		case LE:
+		case LT:
+			val = strtol(attr.value.c_str(), NULL, 10);
+			cval = strtol(crit->value, NULL, 10);
+			if (crit->op == GE)
+				return val >= cval;
+			if (crit->op == GT)
+				return val > cval;
+			if (crit->op == LE)
+				return val <= cval;
+			return val < cval;
+		default:
+			return false;
+	}
+}
+
+/**
+ * @brief	does an object match all the selection criteria?
+ *
+ * @param[in]	obj	-	the object
+ * @param[in]	criteria	-	the criteria, NULL matches everything
+ *
+ * @return	bool
+ */
+static bool
+match_criteria(const cap_obj& obj, const struct attropl *criteria)
+{
+	for (auto crit = criteria; crit != NULL; crit = crit->next) {
+		/* the destination criterion selects on the job's queue */
+		const char *name = strcmp(crit->name, ATTR_q) == 0 ? ATTR_queue : crit->name;
+		const cap_attr *found = NULL;
+
+		for (const auto& attr : obj.attrs) {
+			if (attr.name == name && (crit->resource == NULL || attr.resource == crit->resource)) {
+				found = &attr;
+				break;
+			}
+		}
+		if (found == NULL || !match_criterion(*found, crit))
+			return false;
+	}
+
+	return true;
+}
+
+/**
+ * @brief	return the status of the capture's objects of a kind, as
+ *		the server would have
+ *
+ * @param[in]	kind	-	kind of the objects
+ * @param[in]	criteria	-	selection criteria, or NULL for all
+ *
+ * @return	struct batch_status *
+ * @retval	the matching objects, free with pbs_statfree()
+ * @retval	NULL if nothing matched or on error (pbs_errno is set)
+ */
+struct batch_status *
+replay_stat(enum cap_kind kind, struct attropl *criteria)
+{
+	struct batch_status *head = NULL;
+	struct batch_status **tail = &head;
+
+	pbs_errno = PBSE_NONE;
+	for (const auto& obj : rp_objs[kind]) {
+		struct batch_status *bs;
+		struct attrl **atail;
+
+		if (!match_criteria(obj, criteria))
+			continue;
+
+		if ((bs = static_cast<struct batch_status *>(calloc(1, sizeof(struct batch_status)))) == NULL)
+			goto err;
+		*tail = bs;
+		tail = &bs->next;
+		if ((bs->name = strdup(obj.name.c_str())) == NULL)
+			goto err;
+
+		atail = &bs->attribs;
+		for (const auto& attr : obj.attrs) {
+			struct attrl *a;
+
+			if ((a = static_cast<struct attrl *>(calloc(1, sizeof(struct attrl)))) == NULL)
+				goto err;
+			*atail = a;
+			atail = &a->next;
+			a->name = strdup(attr.name.c_str());
+			a->value = strdup(attr.value.c_str());
+			if (!attr.resource.empty())
+				a->resource = strdup(attr.resource.c_str());
+			if (a->name == NULL || a->value == NULL || (!attr.resource.empty() && a->resource == NULL))
+				goto err;
+		}
+	}
+
+	return head;
+
+err:
+	log_err(errno, __func__, MEM_ERR_MSG);
+	pbs_statfree(head);
+	pbs_errno = PBSE_SYSTEM;
+	return NULL;
+}
+
+/**
+ * @brief	return the names of the capture's jobs which match the
+ *		criteria.  Like pbs_selectjob(), the array and the names are
+ *		one allocation.
+ *
+ * @param[in]	criteria	-	selection criteria
+ *
+ * @return	char **
+ * @retval	the job names, free with free()
+ * @retval	NULL if nothing matched or on error (pbs_errno is set)
+ */
+char **
+replay_select(struct attropl *criteria)
+{
+	std::vector<const std::string *> names;
+	size_t size = 0;
+	char **ret;
+	char *p;
+
+	pbs_errno = PBSE_NONE;
+	for (const auto& obj : rp_objs[CAP_JOB]) {
+		if (match_criteria(obj, criteria)) {
+			names.push_back(&obj.name);
+			size += obj.name.size() + 1;
+		}
+	}
+	if (names.empty())
+		return NULL;
+
+	size += (names.size() + 1) * sizeof(char *);
+	if ((ret = static_cast<char **>(malloc(size))) == NULL) {
+		log_err(errno, __func__, MEM_ERR_MSG);
+		pbs_errno = PBSE_SYSTEM;
+		return NULL;
+	}
+
+	p = reinterpret_cast<char *>(ret + names.size() + 1);
+	for (size_t i = 0; i < names.size(); i++) {
+		ret[i] = p;
+		strcpy(p, names[i]->c_str());
+		p += names[i]->size() + 1;
+	}
+	ret[names.size()] = NULL;
+
+	return ret;
+}
+
+/**
+ * @brief	report a request the scheduler would have sent to the server
+ *
+ * @param[in]	what	-	the request, e.g. "run"
+ * @param[in]	id	-	the job or reservation it is for
+ * @param[in]	detail	-	what goes with the request, or NULL
+ *
+ * @return	void
+ */
+void
+replay_decision(const char *what, const std::string& id, const char *detail)
+{
+	if (detail != NULL)
+		printf("\t%s %s %s\n", what, id.c_str(), detail);
+	else
+		printf("\t%s %s\n", what, id.c_str());
+	rp_decisions++;
+}
+
+/**
+ * @brief	number of decisions reported so far
+ */
+unsigned long
+replay_decision_count(void)
+{
+	return rp_decisions;
+}
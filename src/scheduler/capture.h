@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 1994-2021 Altair Engineering, Inc.
+ * For more information, contact Altair at www.altair.com.
+ *
+ * This file is part of both the OpenPBS software ("OpenPBS")
+ * and the PBS Professional ("PBS Pro") software.
+ *
+ * Open Source License Information:
+ *
+ * OpenPBS is free software. You can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Commercial License Information:
+ *
+ * PBS Pro is commercially licensed software that shares a common core with
+ * the OpenPBS software.  For a copy of the commercial license terms and
+ * conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+ * Altair Legal Department.
+ *
+ * Altair's dual-license business model allows companies, individuals, and
+ * organizations to create proprietary derivative works of OpenPBS and
+ * distribute them - whether embedded or bundled with other software -
+ * under a commercial license agreement.
+ *
+ * Use of Altair's trademarks, including but not limited to "PBS™",
+ * "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+ * subject to Altair's trademark licensing policies.
+ */
+
+#ifndef	_CAPTURE_H
+#define	_CAPTURE_H
+
+#include <string>
+#include <time.h>
+#include <pbs_ifl.h>
+
+/*
+ * Scheduling cycle captures.  With the cycle_capture sched_config
+ * option set, pbs_sched records every status reply of the first cycle after
+ * it reads its config into a directory, along with copies of its sched_priv
+ * files.  pbs_sched_replay loads such a directory and answers the status
+ * calls of the IFL wrappers from it, so scheduling cycles can be run and
+ * timed without a server.  While replaying, requests which would change the
+ * server are reported as successful without being sent.  Run, preempt,
+ * signal and confirm requests are printed as the decisions of the cycle.
+ */
+
+/* name of the status file in a capture directory */
+#define CAPTURE_FILE "universe"
+
+enum cap_kind {
+	CAP_SERVER,
+	CAP_SCHED,
+	CAP_RESOURCE,
+	CAP_QUEUE,
+	CAP_NODE,
+	CAP_RESV,
+	CAP_JOB,
+	CAP_NUM_KINDS
+};
+
+/* capture the next cycle into dir, or stop capturing if dir is empty */
+void capture_arm(const std::string& dir);
+
+/* start capturing this cycle if armed */
+void capture_start(int pbs_sd);
+
+/* record a status reply if capturing.  criteria is the selection of a selstat */
+void capture_record(int pbs_sd, enum cap_kind kind, struct batch_status *bs, struct attropl *criteria);
+
+/* finish the capture of this cycle */
+void capture_end(void);
+
+/* copy the sched_priv files of a capture from one directory to another */
+int capture_copy_priv(const char *from, const char *to);
+
+/* load a capture and start answering status calls from it */
+int replay_load(const char *dir);
+
+/* are status calls answered from a loaded capture? */
+bool replay_active(void);
+
+/* when the loaded capture was taken */
+time_t replay_time(void);
+
+/* name of the scheduler the loaded capture was taken of */
+const char *replay_sched_name(void);
+
+/* return the status of the objects of a kind which match criteria */
+struct batch_status *replay_stat(enum cap_kind kind, struct attropl *criteria);
+
+/* return the names of the jobs which match criteria, in pbs_selectjob() form */
+char **replay_select(struct attropl *criteria);
+
+/* report a request the scheduler would have sent to the server */
+void replay_decision(const char *what, const std::string& id, const char *detail);
+
+/* number of decisions reported so far */
+unsigned long replay_decision_count(void);
+
+#endif	/* _CAPTURE_H */
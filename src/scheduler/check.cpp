@@ -51,6 +51,7 @@
  *	shrink_job_algorithm()
  *	is_ok_to_run_STF()
  *	is_ok_to_run()
+ *	is_ok_to_run_quick()
  *	check_avail_resources()
  *	dynamic_avail()
  *	find_counts_elm()
@@ -101,6 +102,7 @@
 #include "resource.h"
 #include "buckets.h"
 #include "pbs_bitmap.h"
+#include "cycle_profile.h"
 
 
 /**
@@ -698,6 +700,7 @@ nspec **
 is_ok_to_run(status *policy, server_info *sinfo,
 	queue_info *qinfo, resource_resv *resresv, unsigned int flags, schd_error *perr)
 {
+	prof_phase prof(__func__);
 	enum sched_error_code rc = SE_NONE;			/* Return Code */
 	schd_resource	*res = NULL;		/* resource list to check */
 	int		endtime = 0;		/* end time of job if started now */
@@ -1062,26 +1065,112 @@ is_ok_to_run(status *policy, server_info *sinfo,
 }
 
 /**
- * @brief find the resources associated with the resource_req's def
- * @param[in] reslist - schd_resource list to search in
+ * @brief
+ *		is_ok_to_run_quick - run the leading checks of is_ok_to_run() which
+ *		only read the universe: the runnable state of the job, the allpart
+ *		meta data, and the hard limits.  Most jobs which can't run fail one
+ *		of these, so main_sched_loop() runs them ahead of time for the next
+ *		few jobs in parallel.
+ *
+ * @param[in]	policy	-	policy info
+ * @param[in]	sinfo	-	server info
+ * @param[in]	qinfo	-	queue info
+ * @param[in]	resresv	-	job to check
+ * @param[in]	flags	-	flags as passed to is_ok_to_run() (not RETURN_ALL_ERR)
+ * @param[out]	err	-	set as is_ok_to_run() would set it on failure
+ *
+ * @par NOTE:
+ *		the pset meta data must be up to date before this is called
+ *
+ * @par MT-Safe: Yes, as long as the universe is not being modified
+ *
+ * @return	enum sched_error_code
+ * @retval	SE_NONE	: passed, is_ok_to_run() still needs to be called
+ * @retval	error code of the first check which failed
+ */
+enum sched_error_code
+is_ok_to_run_quick(status *policy, server_info *sinfo,
+	queue_info *qinfo, resource_resv *resresv, unsigned int flags, schd_error *err)
+{
+	enum sched_error_code rc;
+	node_partition *allpart = NULL;
+
+	if (policy == NULL || sinfo == NULL || qinfo == NULL ||
+	    resresv == NULL || !resresv->is_job || err == NULL)
+		return SCHD_ERROR;
+
+	if (!in_runnable_state(resresv)) {
+		set_schd_error_codes(err, NOT_RUN, NOT_QUEUED);
+		return NOT_QUEUED;
+	}
+
+	/* same choice of allpart as is_ok_to_run() */
+	if (flags & NO_ALLPART)
+		allpart = NULL;
+	else if (resresv->job->resv != NULL)
+		allpart = NULL;
+	else if (qinfo->has_nodes)
+		allpart = qinfo->allpart;
+	else
+		allpart = sinfo->allpart;
+
+	if (allpart != NULL) {
+		if (resresv_can_fit_nodepart(policy, allpart, resresv, flags, err) == 0) {
+			schd_error *toterr;
+
+			toterr = new_schd_error();
+			if (toterr == NULL)
+				return SCHD_ERROR;
+			if (resresv_can_fit_nodepart(policy, allpart, resresv, flags|COMPARE_TOTAL, toterr) == 0) {
+				move_schd_error(err, toterr);
+				err->status_code = NEVER_RUN;
+			}
+			free_schd_error(toterr);
+			return err->error_code;
+		}
+	}
+
+	if (sinfo->qrun_job == NULL) {
+#ifdef NAS_HWY149 /* localmod 033 */
+		if (resresv->job->priority != NAS_HWY149)
+#endif /* localmod 033 */
+#ifdef NAS_HWY101 /* localmod 032 */
+		if (resresv->job->priority != NAS_HWY101)
+#endif /* localmod 032 */
+		{
+			if ((rc = static_cast<sched_error_code>(check_limits(sinfo, qinfo, resresv, err, flags | CHECK_LIMIT))))
+				return rc;
+
+			if (resresv->job->is_array && (resresv->job->max_run_subjobs != UNSPECIFIED) &&
+			   (resresv->job->running_subjobs >= resresv->job->max_run_subjobs)) {
+				set_schd_error_codes(err, NOT_RUN, MAX_RUN_SUBJOBS);
+				return MAX_RUN_SUBJOBS;
+			}
+		}
+	}
+
+	return SE_NONE;
+}
+
+/**
+ * @brief substitute the resource to check a request against when the
+ *	  resource is not set
+ * @param[in] res - resource found for the request or NULL
  * @param[in] resreq - requested resource
  * @param[in] flags to modify behavior (@see check_avail_resources())
  * @return schd_resource
- * @retval found resource
+ * @retval res if set
  * @retval fres/zres/ustr if not found
  * @retval if indirect, point to the real resource
  * @retval NULL if resource is to be ignored
  */
-schd_resource *
-find_check_resource(schd_resource *reslist, resource_req *resreq, unsigned int flags)
+static schd_resource *
+check_resource_or_default(schd_resource *res, resource_req *resreq, unsigned int flags)
 {
-	schd_resource *res;
 	schd_resource *fres = false_res();
 	schd_resource *zres = zero_res();
 	schd_resource *ustr = unset_str_res();
 
-	res = find_resource(reslist, resreq->def);
-
 	if (res == NULL || res->orig_str_avail == NULL) {
 		/* if resources_assigned.res is unset and resources is in
 		 * resource_unset_infinite, ignore the check and assume a match
@@ -1113,6 +1202,23 @@ find_check_resource(schd_resource *reslist, resource_req *resreq, unsigned int f
 	return res;
 }
 
+/**
+ * @brief find the resources associated with the resource_req's def
+ * @param[in] reslist - schd_resource list to search in
+ * @param[in] resreq - requested resource
+ * @param[in] flags to modify behavior (@see check_avail_resources())
+ * @return schd_resource
+ * @retval found resource
+ * @retval fres/zres/ustr if not found
+ * @retval if indirect, point to the real resource
+ * @retval NULL if resource is to be ignored
+ */
+schd_resource *
+find_check_resource(schd_resource *reslist, resource_req *resreq, unsigned int flags)
+{
+	return check_resource_or_default(find_resource(reslist, resreq->def), resreq, flags);
+}
+
 /**
  * @brief do resource matching between a resource_req and a schd_resource
  * @param[in] res - schd_resource to match
@@ -1202,6 +1308,74 @@ match_resource(schd_resource *res, resource_req *resreq, unsigned int flags, enu
 	return num_chunk;
 }
 
+/**
+ * @brief
+ *		match each resource in reqlist against the resource lookup() finds
+ *		for it.  Shared by the check_avail_resources() overloads.
+ *
+ * @param[in]	lookup	-	finds the resource to check a resource_req against
+ * @param[in]	reqlist	-	the list of resources requested
+ * @param[in]	flags	-	@see check_avail_resources()
+ * @param[in]	checklist	-	set of resources to check, NULL to check all
+ * @param[in]	fail_code	-	error code if resource request is rejected
+ * @param[out]	perr	-	@see check_avail_resources()
+ *
+ * @return	int
+ * @retval	number of chunks which can be allocated
+ */
+template <typename Lookup>
+static long long
+match_resource_list(Lookup lookup, resource_req *reqlist, unsigned int flags,
+	const std::unordered_set<resdef *> *checklist,
+	enum sched_error_code fail_code, schd_error *perr)
+{
+	long long num_chunk = SCHD_INFINITY;
+
+	int any_fail = 0;
+	schd_error *prev_err = NULL;
+	schd_error *err;
+
+	err = perr;
+
+	for (resource_req *resreq = reqlist; resreq != NULL; resreq = resreq->next) {
+		if (checklist != NULL && !((flags & CHECK_ALL_BOOLS) && resreq->type.is_boolean) &&
+			checklist->find(resreq->def) == checklist->end())
+			continue;
+
+		schd_resource *res = lookup(resreq);
+		if (res == NULL)
+			continue;
+
+		num_chunk = match_resource(res, resreq, flags, fail_code, err);
+
+		if (num_chunk == 0) {
+			any_fail = 1;
+			if (flags & RETURN_ALL_ERR) {
+				if (err != NULL) {
+					err->next = new_schd_error();
+					if (err->next == NULL)
+						return 0;
+					prev_err = err;
+					err = err->next;
+				}
+			} else
+				break;
+		}
+	}
+
+	if (any_fail)
+		num_chunk = 0;
+
+	if (prev_err != NULL && (flags & RETURN_ALL_ERR)) {
+		if (prev_err != NULL) {
+			free_schd_error(err);
+			prev_err->next = NULL;
+		}
+	}
+
+	return num_chunk;
+}
+
 /**
  *
  * @brief
@@ -1236,12 +1410,6 @@ check_avail_resources(schd_resource *reslist, resource_req *reqlist,
 	unsigned int flags, std::unordered_set<resdef *>& checklist,
 	enum sched_error_code fail_code, schd_error *perr)
 {
-	long long num_chunk = SCHD_INFINITY;
-
-	int any_fail = 0;
-	schd_error *prev_err = NULL;
-	schd_error *err;
-
 	if (reslist == NULL || reqlist == NULL) {
 		if (perr != NULL)
 			set_schd_error_codes(perr, NOT_RUN, SCHD_ERROR);
@@ -1249,45 +1417,9 @@ check_avail_resources(schd_resource *reslist, resource_req *reqlist,
 		return -1;
 	}
 
-	err = perr;
-
-	for (resource_req *resreq = reqlist; resreq != NULL; resreq = resreq->next) {
-		if (((flags & CHECK_ALL_BOOLS) && resreq->type.is_boolean) ||
-			(checklist.find(resreq->def) != checklist.end())) {
-
-			schd_resource *res = find_check_resource(reslist, resreq, flags);
-			if (res == NULL)
-				continue;
-
-			num_chunk = match_resource(res, resreq, flags, fail_code, err);
-
-			if (num_chunk == 0) {
-				any_fail = 1;
-				if (flags & RETURN_ALL_ERR) {
-					if (err != NULL) {
-						err->next = new_schd_error();
-						if (err->next == NULL)
-							return 0;
-						prev_err = err;
-						err = err->next;
-					}
-				} else
-					break;
-			}
-		}
-	}
-
-	if (any_fail)
-		num_chunk = 0;
-
-	if (prev_err != NULL && (flags & RETURN_ALL_ERR)) {
-		if (prev_err != NULL) {
-			free_schd_error(err);
-			prev_err->next = NULL;
-		}
-	}
-
-	return num_chunk;
+	return match_resource_list([reslist, flags](resource_req *resreq) {
+		return find_check_resource(reslist, resreq, flags);
+	}, reqlist, flags, &checklist, fail_code, perr);
 }
 
 /** @brief overloaded version of check_avail_resources() which matches all resources.  
@@ -1297,12 +1429,6 @@ long long
 check_avail_resources(schd_resource *reslist, resource_req *reqlist,
 		      unsigned int flags, enum sched_error_code fail_code, schd_error *perr)
 {
-	long long num_chunk = SCHD_INFINITY;
-
-	int any_fail = 0;
-	schd_error *prev_err = NULL;
-	schd_error *err;
-
 	if (reslist == NULL || reqlist == NULL) {
 		if (perr != NULL)
 			set_schd_error_codes(perr, NOT_RUN, SCHD_ERROR);
@@ -1310,41 +1436,51 @@ check_avail_resources(schd_resource *reslist, resource_req *reqlist,
 		return -1;
 	}
 
-	err = perr;
-
-	for (resource_req *resreq = reqlist; resreq != NULL; resreq = resreq->next) {
-		schd_resource *res = find_check_resource(reslist, resreq, flags);
-		if (res == NULL)
-			continue;
+	return match_resource_list([reslist, flags](resource_req *resreq) {
+		return find_check_resource(reslist, resreq, flags);
+	}, reqlist, flags, NULL, fail_code, perr);
+}
 
-		num_chunk = match_resource(res, resreq, flags, fail_code, err);
+/** @brief overloaded version of check_avail_resources() which checks the
+ *	   resources of a node.  Consumables are found through the node's
+ *	   ordinal index rather than by walking its resource list.
+ * @see other function for argument description
+*/
+long long
+check_avail_resources(node_info *ninfo, resource_req *reqlist,
+	unsigned int flags, std::unordered_set<resdef *>& checklist,
+	enum sched_error_code fail_code, schd_error *perr)
+{
+	if (ninfo == NULL || ninfo->res == NULL || reqlist == NULL) {
+		if (perr != NULL)
+			set_schd_error_codes(perr, NOT_RUN, SCHD_ERROR);
 
-		if (num_chunk == 0) {
-			any_fail = 1;
-			if (flags & RETURN_ALL_ERR) {
-				if (err != NULL) {
-					err->next = new_schd_error();
-					if (err->next == NULL)
-						return 0;
-					prev_err = err;
-					err = err->next;
-				}
-			} else
-				break;
-		}
+		return -1;
 	}
 
-	if (any_fail)
-		num_chunk = 0;
+	return match_resource_list([ninfo, flags](resource_req *resreq) {
+		return check_resource_or_default(find_node_resource(ninfo, resreq->def), resreq, flags);
+	}, reqlist, flags, &checklist, fail_code, perr);
+}
 
-	if (prev_err != NULL && (flags & RETURN_ALL_ERR)) {
-		if (prev_err != NULL) {
-			free_schd_error(err);
-			prev_err->next = NULL;
-		}
+/** @brief overloaded version of check_avail_resources() which matches all
+ *	   resources of a node.
+ * @see other function for argument description
+*/
+long long
+check_avail_resources(node_info *ninfo, resource_req *reqlist,
+		      unsigned int flags, enum sched_error_code fail_code, schd_error *perr)
+{
+	if (ninfo == NULL || ninfo->res == NULL || reqlist == NULL) {
+		if (perr != NULL)
+			set_schd_error_codes(perr, NOT_RUN, SCHD_ERROR);
+
+		return -1;
 	}
 
-	return num_chunk;
+	return match_resource_list([ninfo, flags](resource_req *resreq) {
+		return check_resource_or_default(find_node_resource(ninfo, resreq->def), resreq, flags);
+	}, reqlist, flags, NULL, fail_code, perr);
 }
 
 /**
@@ -1527,6 +1663,7 @@ dedtime_conflict(resource_resv *resresv)
  */
 nspec **
 check_nodes(status *policy, server_info *sinfo, queue_info *qinfo, resource_resv *resresv, unsigned int flags, schd_error *err) {
+	prof_phase prof(__func__);
 	nspec **ns_arr;
 
 	if (sinfo->pset_metadata_stale)
@@ -1867,12 +2004,12 @@ check_prime_boundary(status *policy, resource_resv  *resresv, struct schd_error
  *
  * @return	schd_resource * (set to False)
  *
- * @par MT-safe: No
+ * @par MT-safe: Yes (one resource per thread)
  */
 schd_resource *
 false_res()
 {
-	static schd_resource *res = NULL;
+	static thread_local schd_resource *res = NULL;
 
 	if (res == NULL) {
 		res = new_resource();
@@ -1900,12 +2037,12 @@ false_res()
  * @return	schd_resource *
  * @retval	NULL	: fail
  *
- * @par MT-safe: No
+ * @par MT-safe: Yes (one resource per thread)
  */
 schd_resource *
 unset_str_res()
 {
-	static schd_resource *res = NULL;
+	static thread_local schd_resource *res = NULL;
 
 	if (res == NULL) {
 		res = new_resource();
@@ -1940,11 +2077,13 @@ unset_str_res()
  *
  * @return	schd_resource *
  * @retval	NULL	: fail
+ *
+ * @par MT-safe: Yes (one resource per thread)
  */
 schd_resource *
 zero_res()
 {
-	static schd_resource *res = NULL;
+	static thread_local schd_resource *res = NULL;
 
 	if (res == NULL) {
 		res = new_resource();
@@ -1971,12 +2110,12 @@ zero_res()
  * @param[out] **spec output select specification
  * @param[out] **pl  output placement specification
  *
- * @par MT-Safe: No
+ * @par MT-Safe: Yes, *pl may point at a per-thread copy
  * @return void
  */
 void get_resresv_spec(resource_resv *resresv, selspec **spec, place **pl)
 {
-	static place place_spec;
+	static thread_local place place_spec;
 	if (resresv->is_job && resresv->job != NULL) {
 		if (resresv->execselect != NULL) {
 			*spec = resresv->execselect;
@@ -59,6 +59,14 @@ nspec **
 is_ok_to_run(status *policy, server_info *sinfo,
 	queue_info *qinfo, resource_resv *resresv, unsigned int flags, schd_error *perr);
 
+/*
+ *	is_ok_to_run_quick - run the checks of is_ok_to_run() which only read
+ *			     the universe
+ */
+enum sched_error_code
+is_ok_to_run_quick(status *policy, server_info *sinfo,
+	queue_info *qinfo, resource_resv *resresv, unsigned int flags, schd_error *err);
+
 /**
  *
  *	is_ok_to_run_STF - check to see if the STF job is OK to run.
@@ -115,6 +123,13 @@ check_avail_resources(schd_resource *reslist, resource_req *reqlist,
 long long
 check_avail_resources(schd_resource *reslist, resource_req *reqlist,
 		      unsigned int flags, enum sched_error_code fail_code, schd_error *perr);
+long long
+check_avail_resources(node_info *ninfo, resource_req *reqlist,
+	unsigned int flags, std::unordered_set<resdef *>& res_to_check,
+	enum sched_error_code fail_code, schd_error *err);
+long long
+check_avail_resources(node_info *ninfo, resource_req *reqlist,
+		      unsigned int flags, enum sched_error_code fail_code, schd_error *perr);
 
 /*
  *	dynamic_avail - find out how much of a resource is available on a
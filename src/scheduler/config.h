@@ -55,15 +55,19 @@
 #define CONFIG_FILE "sched_config"
 #define USAGE_FILE "usage"
 #define USAGE_TOUCH USAGE_FILE ".touch"
+#define USAGE_JOURNAL USAGE_FILE ".journal"
 #define HOLIDAYS_FILE "holidays"
 #define RESGROUP_FILE "resource_group"
 #define DEDTIME_FILE "dedicated_time"
 
 /* usage file "magic number" - needs to be 8 chars */
 #define USAGE_MAGIC "PBS_MAG!"
-#define USAGE_VERSION 2
+#define USAGE_VERSION 3
 #define USAGE_NAME_MAX 50
 
+/* usage journal "magic number" - needs to be 8 chars */
+#define USAGE_JOURNAL_MAGIC "PBS_JNL!"
+
 #define UNKNOWN_GROUP_NAME "unknown"
 
 /* preempt priority values */
@@ -160,6 +164,9 @@
 /* undocumented */
 #define PARSE_MAX_JOB_CHECK "max_job_check"
 #define PARSE_PREEMPT_ATTEMPTS "preempt_attempts"
+#define PARSE_RUNJOB_BATCH_SIZE "runjob_batch_size"
+#define PARSE_CYCLE_PROFILE "cycle_profile"
+#define PARSE_CYCLE_CAPTURE "cycle_capture"
 #define PARSE_UPDATE_COMMENTS "update_comments"
 #define PARSE_RESV_CONFIRM_IGNORE "resv_confirm_ignore"
 #define PARSE_ALLOW_AOE_CALENDAR "allow_aoe_calendar"
@@ -171,12 +171,10 @@ enum resval_cmpflag
 enum thread_task_type
 {
 	TS_IS_ND_ELIGIBLE,
-	TS_DUP_ND_INFO,
 	TS_QUERY_ND_INFO,
-	TS_FREE_ND_INFO,
 	TS_DUP_RESRESV,
 	TS_QUERY_JOB_INFO,
-	TS_FREE_RESRESV
+	TS_PARALLEL_FOR
 };
 
 /* return codes for is_ok_to_run_* functions
@@ -338,11 +336,15 @@ enum { SIMULATE_SD = -1 };
 
 enum fairshare_flags
 {
-	FS_TRIM = 1
+	FS_TRIM = 1,
+	FS_UPDATE = 2	/* the caller owns the usage file: replay its journal and update it in place */
 };
 
 #define FAIRSHARE_MIN_USAGE 1
 
+/* counts lists at least this long are indexed by entity name */
+#define COUNTS_INDEX_MIN 8
+
 /* flags used for copy constructors - bit field */
 enum dup_flags
 {
@@ -0,0 +1,284 @@
+/*
+ * Copyright (C) 1994-2021 Altair Engineering, Inc.
+ * For more information, contact Altair at www.altair.com.
+ *
+ * This file is part of both the OpenPBS software ("OpenPBS")
+ * and the PBS Professional ("PBS Pro") software.
+ *
+ * Open Source License Information:
+ *
+ * OpenPBS is free software. You can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Commercial License Information:
+ *
+ * PBS Pro is commercially licensed software that shares a common core with
+ * the OpenPBS software.  For a copy of the commercial license terms and
+ * conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+ * Altair Legal Department.
+ *
+ * Altair's dual-license business model allows companies, individuals, and
+ * organizations to create proprietary derivative works of OpenPBS and
+ * distribute them - whether embedded or bundled with other software -
+ * under a commercial license agreement.
+ *
+ * Use of Altair's trademarks, including but not limited to "PBS™",
+ * "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+ * subject to Altair's trademark licensing policies.
+ */
+
+
+/**
+ * @file    cycle_profile.cpp
+ *
+ * @brief
+ * 		cycle_profile.cpp - times the phases of a scheduling cycle and
+ * 		reports them as JSON at the end of the cycle.
+ *
+ * Functions included are:
+ * 	prof_phase::prof_phase()
+ * 	prof_phase::~prof_phase()
+ * 	prof_cycle_start()
+ * 	prof_cycle_end()
+ * 	prof_count()
+ */
+#include <pbs_config.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <log.h>
+#include "data_types.h"
+#include "globals.h"
+#include "cycle_profile.h"
+
+/* a phase in the tree of phases of a cycle */
+struct prof_node
+{
+	const char *name;
+	int parent;
+	long calls;
+	double secs;
+	double started;		/* when the phase was last entered */
+	std::vector<int> children;
+};
+
+static std::atomic<bool> prof_on(false);
+static pthread_t prof_thread;
+static unsigned long prof_gen = 0;
+static std::vector<prof_node> prof_nodes;	/* prof_nodes[0] is the cycle itself */
+static int prof_cur = 0;
+static time_t prof_start_wall;
+static std::atomic<long> prof_counters[PROF_NUM_COUNTERS];
+
+static const char *prof_counter_names[PROF_NUM_COUNTERS] = {
+	"jobs_considered",
+	"jobs_run",
+	"nodes_probed",
+	"preempt_attempts",
+	"dup_server_info"
+};
+
+/**
+ * @brief	seconds on the monotonic clock
+ */
+static double
+prof_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief
+ *		start timing a phase as a child of the innermost open phase
+ *
+ * @param[in]	name	-	name of the phase
+ */
+prof_phase::prof_phase(const char *name)
+{
+	int parent;
+	int child = -1;
+
+	idx = -1;
+	gen = 0;
+	if (!prof_on.load(std::memory_order_relaxed) || !pthread_equal(pthread_self(), prof_thread))
+		return;
+
+	parent = prof_cur;
+
+	for (auto c : prof_nodes[parent].children) {
+		if (prof_nodes[c].name == name || strcmp(prof_nodes[c].name, name) == 0) {
+			child = c;
+			break;
+		}
+	}
+	if (child == -1) {
+		child = prof_nodes.size();
+		prof_nodes.push_back(prof_node{name, parent, 0, 0.0, 0.0, {}});
+		prof_nodes[parent].children.push_back(child);
+	}
+
+	idx = child;
+	gen = prof_gen;
+	prof_cur = child;
+	prof_nodes[child].started = prof_now();
+}
+
+/**
+ * @brief
+ *		stop timing a phase.  Does nothing if the cycle it was started in
+ *		has already been written out.
+ */
+prof_phase::~prof_phase()
+{
+	if (idx == -1 || gen != prof_gen)
+		return;
+
+	prof_node& pn = prof_nodes[idx];
+	pn.calls++;
+	pn.secs += prof_now() - pn.started;
+	prof_cur = pn.parent;
+}
+
+/**
+ * @brief
+ *		start profiling a cycle if the cycle_profile option is set.  Must
+ *		be called from the thread which runs the cycle.
+ *
+ * @return void
+ */
+void
+prof_cycle_start(void)
+{
+	prof_gen++;
+	prof_nodes.clear();
+	prof_cur = 0;
+	for (auto& c : prof_counters)
+		c.store(0, std::memory_order_relaxed);
+
+	if (conf.cycle_profile.empty()) {
+		prof_on = false;
+		return;
+	}
+
+	prof_thread = pthread_self();
+	time(&prof_start_wall);
+	prof_nodes.push_back(prof_node{"scheduling_cycle", -1, 1, 0.0, prof_now(), {}});
+	prof_on = true;
+}
+
+/**
+ * @brief	add n to a cycle counter
+ *
+ * @param[in]	c	-	counter
+ * @param[in]	n	-	amount to add
+ *
+ * @par MT-Safe:	yes
+ */
+void
+prof_count(enum prof_counter c, long n)
+{
+	if (prof_on.load(std::memory_order_relaxed))
+		prof_counters[c].fetch_add(n, std::memory_order_relaxed);
+}
+
+/**
+ * @brief	append the JSON of a phase and its children to a string
+ *
+ * @param[in]	idx	-	node of the phase
+ * @param[out]	out	-	string to append to
+ */
+static void
+prof_phase_json(int idx, std::string& out)
+{
+	const prof_node& pn = prof_nodes[idx];
+	char buf[128];
+
+	snprintf(buf, sizeof(buf), "{\"calls\":%ld,\"seconds\":%.6f", pn.calls, pn.secs);
+	out += buf;
+	if (!pn.children.empty()) {
+		out += ",\"phases\":{";
+		for (size_t i = 0; i < pn.children.size(); i++) {
+			if (i > 0)
+				out += ',';
+			out += '"';
+			out += prof_nodes[pn.children[i]].name;
+			out += "\":";
+			prof_phase_json(pn.children[i], out);
+		}
+		out += '}';
+	}
+	out += '}';
+}
+
+/**
+ * @brief
+ *		close any phases still open, and write the profile of the cycle
+ *		to the sched log or append it to the cycle_profile file
+ *
+ * @return void
+ */
+void
+prof_cycle_end(void)
+{
+	std::string json;
+	char buf[128];
+	double now;
+
+	if (!prof_on)
+		return;
+	prof_on = false;
+
+	now = prof_now();
+	for (int i = prof_cur; i > 0; i = prof_nodes[i].parent) {
+		prof_nodes[i].calls++;
+		prof_nodes[i].secs += now - prof_nodes[i].started;
+	}
+	prof_nodes[0].secs = now - prof_nodes[0].started;
+
+	snprintf(buf, sizeof(buf), "{\"start\":%ld,\"cycle\":", static_cast<long>(prof_start_wall));
+	json = buf;
+	prof_phase_json(0, json);
+	json += ",\"counters\":{";
+	for (int i = 0; i < PROF_NUM_COUNTERS; i++) {
+		snprintf(buf, sizeof(buf), "%s\"%s\":%ld", i > 0 ? "," : "",
+			prof_counter_names[i], prof_counters[i].load());
+		json += buf;
+	}
+	json += "}}";
+
+	/* phases which are still open stop being timed */
+	prof_gen++;
+	prof_cur = 0;
+
+	if (conf.cycle_profile == "log") {
+		log_event(PBSEVENT_DEBUG, PBS_EVENTCLASS_SCHED, LOG_DEBUG, "cycle_profile", json.c_str());
+		return;
+	}
+
+	FILE *fp = fopen(conf.cycle_profile.c_str(), "a");
+	if (fp == NULL) {
+		log_errf(errno, __func__, "Unable to open %s", conf.cycle_profile.c_str());
+		return;
+	}
+	fprintf(fp, "%s\n", json.c_str());
+	fclose(fp);
+}
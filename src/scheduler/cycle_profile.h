@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 1994-2021 Altair Engineering, Inc.
+ * For more information, contact Altair at www.altair.com.
+ *
+ * This file is part of both the OpenPBS software ("OpenPBS")
+ * and the PBS Professional ("PBS Pro") software.
+ *
+ * Open Source License Information:
+ *
+ * OpenPBS is free software. You can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Commercial License Information:
+ *
+ * PBS Pro is commercially licensed software that shares a common core with
+ * the OpenPBS software.  For a copy of the commercial license terms and
+ * conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+ * Altair Legal Department.
+ *
+ * Altair's dual-license business model allows companies, individuals, and
+ * organizations to create proprietary derivative works of OpenPBS and
+ * distribute them - whether embedded or bundled with other software -
+ * under a commercial license agreement.
+ *
+ * Use of Altair's trademarks, including but not limited to "PBS™",
+ * "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+ * subject to Altair's trademark licensing policies.
+ */
+
+#ifndef	_CYCLE_PROFILE_H
+#define	_CYCLE_PROFILE_H
+
+/*
+ * Per-cycle phase profiler.  A prof_phase object times the scope it lives
+ * in.  Phases nest: a phase started while another is open on the main
+ * thread is recorded as its child.  Phases on worker threads are not timed.
+ * At the end of the cycle the tree of phases and the cycle counters are
+ * written as one line of JSON to the sched log or to a file, as set by
+ * the cycle_profile sched_config option.
+ */
+
+enum prof_counter {
+	PROF_JOBS_CONSIDERED,
+	PROF_JOBS_RUN,
+	PROF_NODES_PROBED,
+	PROF_PREEMPT_ATTEMPTS,
+	PROF_DUP_SERVER_INFO,
+	PROF_NUM_COUNTERS
+};
+
+class prof_phase
+{
+	public:
+	/* name must outlive the cycle, e.g. __func__ or a string literal */
+	explicit prof_phase(const char *name);
+	~prof_phase();
+
+	private:
+	int idx;		/* node of this phase, -1 if not timed */
+	unsigned long gen;	/* cycle the phase was started in */
+};
+
+/* start profiling a cycle if cycle_profile is set */
+void prof_cycle_start(void);
+
+/* close any open phases and write out the profile of the cycle */
+void prof_cycle_end(void);
+
+/* add n to a cycle counter */
+void prof_count(enum prof_counter c, long n = 1);
+
+#endif	/* _CYCLE_PROFILE_H */
@@ -52,6 +52,7 @@
 #ifndef	_DATA_TYPES_H
 #define	_DATA_TYPES_H
 
+#include <functional>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
@@ -93,11 +94,13 @@ struct status;
 class fairshare_head;
 struct node_scratch;
 struct te_list;
+struct calendar_index;
 struct node_bucket;
 struct bucket_bitpool;
 struct chunk_map;
 struct node_bucket_count;
 struct preempt_job_st;
+struct preempt_cand_index;
 struct config;
 struct sort_info;
 class resource_resv;
@@ -138,6 +141,7 @@ typedef struct th_data_free_ninfo th_data_free_ninfo;
 typedef struct th_data_dup_resresv th_data_dup_resresv;
 typedef struct th_data_query_jinfo th_data_query_jinfo;
 typedef struct th_data_free_resresv th_data_free_resresv;
+typedef struct th_data_parallel_for th_data_parallel_for;
 
 
 #ifdef NAS
@@ -245,6 +249,15 @@ struct th_data_free_resresv
 	int eidx;
 };
 
+struct th_data_parallel_for
+{
+	const std::function<int(int, int)> *func;	/* called on [sidx, eidx] */
+	const char *name;			/* stage name for the timing counters */
+	int sidx;
+	int eidx;
+	int ret;				/* return value of func */
+};
+
 struct schd_error
 {
 	enum sched_error_code error_code;	/* scheduler error code (see constant.h) */
@@ -403,6 +416,8 @@ struct server_info
 	bool has_nonCPU_licenses:1;	/* server has non-CPU (e.g. socket-based) licenses */
 	bool use_hard_duration:1;	/* use hard duration when creating the calendar */
 	bool pset_metadata_stale:1;	/* The placement set meta data is stale and needs to be regenerated before the next use */
+	bool pset_stale_all:1;		/* pset_stale_nodes is incomplete, regenerate all of the placement set meta data */
+	bool is_snapshot:1;		/* simulation snapshot which only holds the jobs a simulation can touch */
 	char *name;			/* name of server */
 	struct schd_resource *res;	/* list of resources */
 	void *liminfo;			/* limit storage information */
@@ -461,6 +476,9 @@ struct server_info
 	 */
 	np_cache **npc_arr;
 
+	/* resources held by the preemptable running jobs, see preempt_index.h */
+	preempt_cand_index *pcands;
+
 	resource_resv *qrun_job;	/* used if running a job via qrun request */
 	/* policy structure for the server.  This is an easy storage location for
 	 * the policy struct.  The policy struct will be passed around separately
@@ -471,6 +489,13 @@ struct server_info
 	node_bucket **buckets;		/* node bucket array */
 	node_info **unordered_nodes;
 	std::unordered_map<std::string, node_partition *> svr_to_psets;
+	std::vector<int> pset_stale_nodes;	/* node_ind of nodes whose placement sets are stale */
+	/* resresv_ind to resresv map of a snapshot.  The all_resresv array of a
+	 * snapshot is not indexed by resresv_ind since it only holds the cloned
+	 * resresvs.  While the snapshot is being duplicated, it holds the indices
+	 * of the queued jobs to clone.
+	 */
+	std::unordered_map<int, resource_resv *> snapshot_ind;
 #ifdef NAS
 	/* localmod 034 */
 	share_head *share_head;	/* root of share info */
@@ -699,6 +724,8 @@ struct node_info
 	int max_group_run;		/* max number of jobs running by a UNIX group */
 
 	schd_resource *res;		/* list of resources max/current usage */
+	/* consumable resources in res indexed by resdef ordinal (@see index_node_resources()) */
+	std::vector<schd_resource *> res_ind;
 
 	int rank;			/* unique numeric identifier for node */
 
@@ -775,9 +802,9 @@ class resource_resv
 	bool will_use_multinode:1;	/* res resv will use multiple nodes */
 
 	const std::string name;		/* name of res resv */
-	char *user;			/* username of the owner of the res resv */
-	char *group;			/* exec group of owner of res resv */
-	char *project;			/* exec project of owner of res resv */
+	const char *user;		/* username of the owner of the res resv (interned) */
+	const char *group;		/* exec group of owner of res resv (interned) */
+	const char *project;		/* exec project of owner of res resv (interned) */
 	char *nodepart_name;		/* name of node partition to run res resv in */
 
 	long sch_priority;		/* scheduler priority of res resv */
@@ -875,7 +902,8 @@ class resdef
 	const std::string name;	/* name of resource */
 	resource_type type;	/* resource type */
 	unsigned int flags;	/* resource flags (see pbs_ifl.h) */
-	resdef(char *rname, unsigned int rflags, resource_type rtype) : name(rname), type(rtype), flags(rflags) {}
+	int ordinal;		/* index among the consumable resources, -1 if not consumable */
+	resdef(char *rname, unsigned int rflags, resource_type rtype) : name(rname), type(rtype), flags(rflags), ordinal(-1) {}
 };
 
 class prev_job_info
@@ -891,12 +919,20 @@ class prev_job_info
 	~prev_job_info();
 };
 
+/* name index of a long counts list, kept on the head of the list */
+struct counts_index
+{
+	std::unordered_map<std::string, counts *> by_name;	/* entity name to counts */
+	counts *tail;			/* last element of the list */
+};
+
 struct counts
 {
-	char *name;			/* name of entitiy */
+	const char *name;		/* name of entitiy (interned) */
 	int running;			/* count of running jobs in object */
 	int soft_limit_preempt_bit;	/* Place to store preempt bit if entity is over limits */
 	resource_count *rescts;		/* resources used */
+	counts_index *index;		/* only set on the head of a long list */
 	counts *next;
 };
 
@@ -923,6 +959,13 @@ class fairshare_head
 	~fairshare_head();
 };
 
+/* index of a whole fairshare tree, kept on the root node */
+struct fairshare_index
+{
+	std::unordered_map<std::string, group_info *> by_name;	/* entity name to node */
+	std::vector<group_info *> nodes;	/* every node, parents before their children */
+};
+
 class group_info
 {
 	public:
@@ -940,6 +983,7 @@ class group_info
 	 */
 	usage_t usage;				/* calculated usage info */
 	usage_t temp_usage;			/* usage plus any temporary usage */
+	unsigned long usage_gen;		/* bumped whenever temp_usage grows during a cycle */
 	float usage_factor;			/* usage calculation taking parent's usage into account: number between 0 and 1 */
 
 	std::vector<group_info *> gpath;	/* path from the root of the tree */
@@ -947,8 +991,10 @@ class group_info
 	group_info *parent;			/* parent node */
 	group_info *sibling;			/* sibling node */
 	group_info *child;			/* child node */
+	fairshare_index *findex;		/* only set on the root of the tree */
 	group_info(const std::string& gname);
 	group_info(group_info&);
+	~group_info();
 };
 
 /**
@@ -961,9 +1007,9 @@ struct resresv_set
 {
 	bool can_not_run:1;		/* set can not run */
 	schd_error *err;		/* reason why set can not run*/
-	char *user;			/* user of set, can be NULL */
-	char *group;			/* group of set, can be NULL */
-	char *project;			/* project of set, can be NULL */
+	const char *user;		/* user of set, can be NULL (interned) */
+	const char *group;		/* group of set, can be NULL (interned) */
+	const char *project;		/* project of set, can be NULL (interned) */
 	selspec *select_spec;		/* select spec of set */
 	place *place_spec;		/* place spec of set */
 	resource_req *req;		/* ATTR_L (qsub -l) resources of set.  Only contains resources on the resources line */
@@ -1027,6 +1073,25 @@ struct group_node_usage_v2
 	usage_t usage;
 };
 
+/* Usage file version 3 has the same records as version 2.  The file is
+ * memory mapped and records are rewritten in place, so a record with an
+ * empty name is unused.  Changes are first written to a journal, which is
+ * this header followed by the changed records and a checksum.
+ */
+struct usage_journal_header
+{
+	char tag[9];		/* journal "magic number" */
+	int count;		/* number of entries which follow */
+	int nslots;		/* number of records in the usage file once replayed */
+	time_t last_decay;	/* last decay time of the fairshare tree */
+};
+
+struct usage_journal_entry
+{
+	int slot;				/* record of the usage file to replace */
+	struct group_node_usage_v2 rec;		/* the new record */
+};
+
 struct usage_info
 {
 	char *name;			/* name of the user */
@@ -1158,6 +1223,9 @@ struct config
 	int unknown_shares;			/* unknown group shares */
 	int max_preempt_attempts;		/* max num of preempt attempts per cyc*/
 	int max_jobs_to_check;			/* max number of jobs to check in cyc*/
+	int runjob_batch_size;			/* max num of jobs sent in one run job list */
+	std::string cycle_profile;		/* where the cycle profile goes: "log", a file, or "" for none */
+	std::string cycle_capture;		/* directory to capture the next cycle into, "" for none */
 	std::string ded_prefix;			/* prefix to dedicated queues */
 	std::string pt_prefix;			/* prefix to primetime queues */
 	std::string npt_prefix;			/* prefix to non primetime queues */
@@ -1202,6 +1270,8 @@ struct event_list
 	timed_event *next_event;	/* the next event to be performed */
 	timed_event *first_run_event;	/* The first run event in the calendar */
 	time_t *current_time;		/* [reference] current time in the calendar */
+	unsigned long next_seq;		/* insertion sequence number of the next event added */
+	calendar_index *index;		/* search indexes over the events, see simulate.cpp */
 };
 
 struct timed_event
@@ -1213,6 +1283,7 @@ struct timed_event
 	event_ptr_t *event_ptr;
 	event_func_t event_func;
 	void *event_func_arg;		/* optional argument to function - not freed */
+	unsigned long seq;		/* insertion order, orders events at the same time */
 	timed_event *next;
 	timed_event *prev;
 };
@@ -0,0 +1,609 @@
+/*
+ * Copyright (C) 1994-2021 Altair Engineering, Inc.
+ * For more information, contact Altair at www.altair.com.
+ *
+ * This file is part of both the OpenPBS software ("OpenPBS")
+ * and the PBS Professional ("PBS Pro") software.
+ *
+ * Open Source License Information:
+ *
+ * OpenPBS is free software. You can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Commercial License Information:
+ *
+ * PBS Pro is commercially licensed software that shares a common core with
+ * the OpenPBS software.  For a copy of the commercial license terms and
+ * conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+ * Altair Legal Department.
+ *
+ * Altair's dual-license business model allows companies, individuals, and
+ * organizations to create proprietary derivative works of OpenPBS and
+ * distribute them - whether embedded or bundled with other software -
+ * under a commercial license agreement.
+ *
+ * Use of Altair's trademarks, including but not limited to "PBS™",
+ * "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+ * subject to Altair's trademark licensing policies.
+ */
+
+
+
+/**
+ * @file    equiv_class_cache.cpp
+ *
+ * @brief
+ * 		equiv_class_cache.cpp - remembers across scheduling cycles which
+ * 		equivalence classes could not run and why, so their jobs are not
+ * 		evaluated again until something they depend on changes.
+ *
+ * Functions included are:
+ * 	equiv_class_cache::apply()
+ * 	equiv_class_cache::remember()
+ * 	equiv_class_cache::invalidate()
+ * 	equiv_class_cache::failure_kind()
+ * 	equiv_class_cache::clear_cycle()
+ */
+#include <pbs_config.h>
+
+#include <string.h>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <log.h>
+#include "equiv_class_cache.h"
+#include "data_types.h"
+#include "server_info.h"
+#include "resource.h"
+#include "misc.h"
+#include "limits_if.h"
+#include "constant.h"
+
+
+equiv_class_cache ec_cache;
+
+/**
+ * @brief	mix a value into a running hash
+ *
+ * @param[in,out]	seed	-	running hash
+ * @param[in]	v	-	value to mix in
+ *
+ * @return	void
+ */
+static inline void
+hash_combine(size_t& seed, size_t v)
+{
+	seed ^= v + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+}
+
+/**
+ * @brief	hash a string which may be NULL
+ *
+ * @param[in]	str	-	string to hash
+ *
+ * @return	size_t
+ */
+static size_t
+hash_str(const char *str)
+{
+	if (str == NULL)
+		return 0;
+	return std::hash<std::string>()(str);
+}
+
+/**
+ * @brief	fingerprint a resource list: what is available and what is assigned
+ *
+ * @param[in]	res	-	resource list
+ *
+ * @return	size_t
+ */
+static size_t
+resource_list_print(schd_resource *res)
+{
+	size_t h = 0;
+
+	for (; res != NULL; res = res->next) {
+		hash_combine(h, hash_str(res->name));
+		hash_combine(h, hash_str(res->orig_str_avail));
+		hash_combine(h, std::hash<double>()(res->avail));
+		hash_combine(h, std::hash<double>()(res->assigned));
+	}
+	return h;
+}
+
+/**
+ * @brief	fingerprint one counts entry: running jobs and resources used
+ *
+ * @param[in]	cts	-	counts entry
+ *
+ * @return	size_t
+ */
+static size_t
+counts_print(counts *cts)
+{
+	size_t h = hash_str(cts->name);
+
+	hash_combine(h, cts->running);
+	for (resource_count *rc = cts->rescts; rc != NULL; rc = rc->next) {
+		hash_combine(h, hash_str(rc->name));
+		hash_combine(h, std::hash<double>()(rc->amount));
+	}
+	return h;
+}
+
+/**
+ * @brief	fingerprint a whole counts list
+ *
+ * @param[in]	cts	-	counts list
+ *
+ * @return	size_t
+ */
+static size_t
+counts_list_print(counts *cts)
+{
+	size_t h = 0;
+
+	for (; cts != NULL; cts = cts->next)
+		hash_combine(h, counts_print(cts));
+	return h;
+}
+
+/**
+ * @brief	fingerprint the counts of one entity
+ *
+ * @param[in]	cts	-	counts list to search
+ * @param[in]	name	-	name of the entity, NULL if the class has none
+ *
+ * @return	size_t
+ */
+static size_t
+entity_counts_print(counts *cts, const char *name)
+{
+	counts *c;
+	size_t h;
+
+	if (name == NULL)
+		return 0;
+
+	h = hash_str(name);
+	if ((c = find_counts(cts, name)) != NULL)
+		hash_combine(h, counts_print(c));
+	return h;
+}
+
+/**
+ * @brief	fingerprint everything about a node a job's placement looks at
+ *
+ * @param[in]	ninfo	-	the node
+ *
+ * @return	size_t
+ */
+static size_t
+node_print(node_info *ninfo)
+{
+	size_t h = std::hash<std::string>()(ninfo->name);
+	unsigned long state = 0;
+	int b = 0;
+
+	for (bool bit : {ninfo->is_down, ninfo->is_free, ninfo->is_offline,
+			ninfo->is_unknown, ninfo->is_exclusive, ninfo->is_job_exclusive,
+			ninfo->is_resv_exclusive, ninfo->is_sharing, ninfo->is_busy,
+			ninfo->is_job_busy, ninfo->is_stale, ninfo->is_maintenance,
+			ninfo->is_provisioning, ninfo->is_sleeping, ninfo->lic_lock,
+			ninfo->no_multinode_jobs, ninfo->resv_enable, ninfo->provision_enable})
+		state |= static_cast<unsigned long>(bit) << b++;
+
+	hash_combine(h, state);
+	hash_combine(h, ninfo->num_jobs);
+	hash_combine(h, ninfo->num_run_resv);
+	hash_combine(h, ninfo->num_susp_jobs);
+	hash_combine(h, std::hash<std::string>()(ninfo->queue_name));
+	hash_combine(h, hash_str(ninfo->current_aoe));
+	hash_combine(h, hash_str(ninfo->current_eoe));
+	hash_combine(h, hash_str(ninfo->partition));
+	if (ninfo->jobs != NULL)
+		for (int i = 0; ninfo->jobs[i] != NULL; i++)
+			hash_combine(h, hash_str(ninfo->jobs[i]));
+	if (ninfo->resvs != NULL)
+		for (int i = 0; ninfo->resvs[i] != NULL; i++)
+			hash_combine(h, hash_str(ninfo->resvs[i]));
+	hash_combine(h, resource_list_print(ninfo->res));
+
+	return h;
+}
+
+/**
+ * @brief	fingerprint a node array
+ *
+ * @param[in]	nodes	-	NULL terminated node array
+ *
+ * @return	size_t
+ */
+static size_t
+nodes_print(node_info **nodes)
+{
+	size_t h = 0;
+
+	if (nodes == NULL)
+		return 0;
+
+	for (int i = 0; nodes[i] != NULL; i++)
+		hash_combine(h, node_print(nodes[i]));
+	return h;
+}
+
+/**
+ * @brief	fingerprint what every class depends on: prime and dedicated
+ *		time, node grouping and the reservations on the server
+ *
+ * @param[in]	policy	-	policy info
+ * @param[in]	sinfo	-	server info
+ *
+ * @return	size_t
+ */
+static size_t
+global_print(status *policy, server_info *sinfo)
+{
+	size_t h = 0;
+
+	hash_combine(h, policy->is_prime);
+	hash_combine(h, policy->is_ded_time);
+	hash_combine(h, sinfo->node_group_enable);
+	hash_combine(h, sinfo->num_nodes);
+	if (sinfo->node_group_key != NULL)
+		for (int i = 0; sinfo->node_group_key[i] != NULL; i++)
+			hash_combine(h, hash_str(sinfo->node_group_key[i]));
+	if (sinfo->resvs != NULL)
+		for (int i = 0; sinfo->resvs[i] != NULL; i++) {
+			resource_resv *resv = sinfo->resvs[i];
+
+			hash_combine(h, std::hash<std::string>()(resv->name));
+			hash_combine(h, resv->start);
+			hash_combine(h, resv->end);
+			if (resv->resv != NULL) {
+				hash_combine(h, resv->resv->resv_state);
+				hash_combine(h, resv->resv->resv_substate);
+			}
+		}
+	return h;
+}
+
+/**
+ * @brief	build the key an equivalence class is remembered by across cycles
+ *
+ * @param[in]	ec	-	the equivalence class
+ *
+ * @return	std::string
+ */
+static std::string
+ec_signature(resresv_set *ec)
+{
+	std::string key;
+
+	key += "q=";
+	if (ec->qinfo != NULL)
+		key += ec->qinfo->name;
+	key += "|u=";
+	if (ec->user != NULL)
+		key += ec->user;
+	key += "|g=";
+	if (ec->group != NULL)
+		key += ec->group;
+	key += "|p=";
+	if (ec->project != NULL)
+		key += ec->project;
+
+	key += "|sel=";
+	if (ec->select_spec != NULL && ec->select_spec->chunks != NULL)
+		for (int i = 0; ec->select_spec->chunks[i] != NULL; i++) {
+			chunk *chk = ec->select_spec->chunks[i];
+
+			key += std::to_string(chk->num_chunks) + ':';
+			if (chk->str_chunk != NULL)
+				key += chk->str_chunk;
+			key += '+';
+		}
+
+	key += "|pl=";
+	if (ec->place_spec != NULL) {
+		place *pl = ec->place_spec;
+
+		key += std::to_string(pl->free | pl->pack << 1 | pl->scatter << 2 |
+			pl->vscatter << 3 | pl->excl << 4 | pl->exclhost << 5 | pl->share << 6);
+		if (pl->group != NULL)
+			key += std::string(":") + pl->group;
+	}
+
+	key += "|req=";
+	for (resource_req *req = ec->req; req != NULL; req = req->next) {
+		key += req->name;
+		key += '=';
+		if (req->res_str != NULL)
+			key += req->res_str;
+		key += ',';
+	}
+
+	return key;
+}
+
+/**
+ * @brief	what kind of failure is an error, and can it be remembered
+ *
+ * @param[in]	err	-	why the class could not run
+ *
+ * @return	ecc_kind
+ * @retval	ECC_RESOURCE	: failed on the nodes or server/queue resources
+ * @retval	ECC_LIMIT	: failed on a server or queue limit
+ * @retval	ECC_NONE	: the failure depends on something else (time,
+ *				  the calendar, the job itself) and is not kept
+ */
+equiv_class_cache::ecc_kind
+equiv_class_cache::failure_kind(schd_error *err)
+{
+	if (err == NULL || err->next != NULL)
+		return ECC_NONE;
+
+	switch (err->error_code) {
+		case NOT_ENOUGH_NODES_AVAIL:
+		case NO_NODE_RESOURCES:
+		case INSUFFICIENT_RESOURCE:
+		case INSUFFICIENT_QUEUE_RESOURCE:
+		case INSUFFICIENT_SERVER_RESOURCE:
+		case SET_TOO_SMALL:
+		case CANT_SPAN_PSET:
+		case NO_FREE_NODES:
+		case NO_TOTAL_NODES:
+			return ECC_RESOURCE;
+
+		case QUEUE_JOB_LIMIT_REACHED:
+		case SERVER_JOB_LIMIT_REACHED:
+		case SERVER_USER_LIMIT_REACHED:
+		case QUEUE_USER_LIMIT_REACHED:
+		case SERVER_GROUP_LIMIT_REACHED:
+		case QUEUE_GROUP_LIMIT_REACHED:
+		case QUEUE_USER_RES_LIMIT_REACHED:
+		case SERVER_USER_RES_LIMIT_REACHED:
+		case QUEUE_GROUP_RES_LIMIT_REACHED:
+		case SERVER_GROUP_RES_LIMIT_REACHED:
+		case QUEUE_BYGROUP_JOB_LIMIT_REACHED:
+		case QUEUE_BYUSER_JOB_LIMIT_REACHED:
+		case SERVER_BYGROUP_JOB_LIMIT_REACHED:
+		case SERVER_BYUSER_JOB_LIMIT_REACHED:
+		case SERVER_BYGROUP_RES_LIMIT_REACHED:
+		case SERVER_BYUSER_RES_LIMIT_REACHED:
+		case QUEUE_BYGROUP_RES_LIMIT_REACHED:
+		case QUEUE_BYUSER_RES_LIMIT_REACHED:
+		case QUEUE_RESOURCE_LIMIT_REACHED:
+		case SERVER_RESOURCE_LIMIT_REACHED:
+		case SERVER_PROJECT_LIMIT_REACHED:
+		case SERVER_PROJECT_RES_LIMIT_REACHED:
+		case SERVER_BYPROJECT_RES_LIMIT_REACHED:
+		case SERVER_BYPROJECT_JOB_LIMIT_REACHED:
+		case QUEUE_PROJECT_LIMIT_REACHED:
+		case QUEUE_PROJECT_RES_LIMIT_REACHED:
+		case QUEUE_BYPROJECT_RES_LIMIT_REACHED:
+		case QUEUE_BYPROJECT_JOB_LIMIT_REACHED:
+			return ECC_LIMIT;
+
+		default:
+			return ECC_NONE;
+	}
+}
+
+/**
+ * @brief	forget this cycle's class keys and fingerprints
+ *
+ * @return	void
+ */
+void
+equiv_class_cache::clear_cycle()
+{
+	keys.clear();
+	res_prints.clear();
+	lim_prints.clear();
+}
+
+/**
+ * @brief	fingerprint the equivalence classes of this cycle and mark every
+ *		class whose remembered failure still holds can_not_run.  Entries
+ *		which no longer hold, or whose class is gone, are dropped.
+ *
+ * @param[in]	policy	-	policy info
+ * @param[in,out]	sinfo	-	server universe at the start of the cycle
+ *
+ * @return	int
+ * @retval	number of classes marked can_not_run
+ */
+int
+equiv_class_cache::apply(status *policy, server_info *sinfo)
+{
+	std::unordered_map<std::string, size_t> qnode_prints;
+	std::unordered_set<std::string> seen;
+	size_t gprint;
+	size_t snode_print;
+	size_t sres_print;
+	size_t slim_print;
+	int nclasses;
+	int hits = 0;
+
+	clear_cycle();
+
+	if (policy == NULL || sinfo == NULL || sinfo->equiv_classes == NULL)
+		return 0;
+
+	/* a qrun cycle does not see the whole universe, leave the cache be */
+	if (sinfo->qrun_job != NULL)
+		return 0;
+
+	gprint = global_print(policy, sinfo);
+	snode_print = nodes_print(sinfo->nodes);
+	sres_print = resource_list_print(sinfo->res);
+	slim_print = lim_hash_hardlimits(sinfo->liminfo);
+	hash_combine(slim_print, counts_list_print(sinfo->alljobcounts));
+
+	nclasses = count_array(sinfo->equiv_classes);
+	keys.resize(nclasses);
+	res_prints.resize(nclasses);
+	lim_prints.resize(nclasses);
+
+	for (int i = 0; i < nclasses; i++) {
+		resresv_set *ec = sinfo->equiv_classes[i];
+		queue_info *qinfo = ec->qinfo;
+		size_t rp = gprint;
+		size_t lp = gprint;
+
+		/* jobs in reservations run on the reservation's nodes */
+		if (qinfo != NULL && qinfo->resv != NULL)
+			continue;
+
+		if (qinfo != NULL && qinfo->has_nodes) {
+			auto qp = qnode_prints.find(qinfo->name);
+			if (qp == qnode_prints.end())
+				qp = qnode_prints.emplace(qinfo->name, nodes_print(qinfo->nodes)).first;
+			hash_combine(rp, qp->second);
+		} else
+			hash_combine(rp, snode_print);
+		hash_combine(rp, sres_print);
+
+		hash_combine(lp, slim_print);
+		hash_combine(lp, entity_counts_print(sinfo->user_counts, ec->user));
+		hash_combine(lp, entity_counts_print(sinfo->group_counts, ec->group));
+		hash_combine(lp, entity_counts_print(sinfo->project_counts, ec->project));
+
+		if (qinfo != NULL) {
+			hash_combine(rp, resource_list_print(qinfo->qres));
+
+			hash_combine(lp, lim_hash_hardlimits(qinfo->liminfo));
+			hash_combine(lp, counts_list_print(qinfo->alljobcounts));
+			hash_combine(lp, entity_counts_print(qinfo->user_counts, ec->user));
+			hash_combine(lp, entity_counts_print(qinfo->group_counts, ec->group));
+			hash_combine(lp, entity_counts_print(qinfo->project_counts, ec->project));
+		}
+
+		keys[i] = ec_signature(ec);
+		res_prints[i] = rp;
+		lim_prints[i] = lp;
+		seen.insert(keys[i]);
+
+		auto e = entries.find(keys[i]);
+		if (e == entries.end() || ec->can_not_run)
+			continue;
+
+		size_t print = e->second.kind == ECC_LIMIT ? lp : rp;
+		resdef *rdef = NULL;
+
+		if (!e->second.rdef_name.empty())
+			rdef = find_resdef(e->second.rdef_name);
+
+		if (print != e->second.print || (!e->second.rdef_name.empty() && rdef == NULL)) {
+			free_schd_error(e->second.err);
+			entries.erase(e);
+			continue;
+		}
+
+		free_schd_error(ec->err);
+		ec->err = dup_schd_error(e->second.err);
+		if (ec->err == NULL)
+			continue;
+		ec->err->rdef = rdef;
+		ec->can_not_run = 1;
+		hits++;
+	}
+
+	for (auto e = entries.begin(); e != entries.end();) {
+		if (seen.find(e->first) == seen.end()) {
+			free_schd_error(e->second.err);
+			e = entries.erase(e);
+		} else
+			++e;
+	}
+
+	if (hits > 0)
+		log_eventf(PBSEVENT_DEBUG2, PBS_EVENTCLASS_SCHED, LOG_DEBUG, __func__,
+			"%d of %d equivalence classes still can not run since an earlier cycle",
+			hits, nclasses);
+
+	return hits;
+}
+
+/**
+ * @brief	remember why an equivalence class could not run.  Only call this
+ *		when nothing has changed in the universe since apply(), so the
+ *		fingerprints taken there describe what the failure saw.
+ *
+ * @param[in]	ec	-	the equivalence class
+ * @param[in]	ec_index	-	index of ec in the server's equiv_classes
+ * @param[in]	err	-	why the class could not run
+ *
+ * @return	void
+ */
+void
+equiv_class_cache::remember(resresv_set *ec, int ec_index, schd_error *err)
+{
+	ecc_entry entry;
+
+	if (ec == NULL || ec_index < 0 || ec_index >= static_cast<int>(keys.size()))
+		return;
+	if (keys[ec_index].empty())
+		return;
+
+	entry.kind = failure_kind(err);
+	if (entry.kind == ECC_NONE)
+		return;
+
+	entry.print = entry.kind == ECC_LIMIT ? lim_prints[ec_index] : res_prints[ec_index];
+	entry.err = dup_schd_error(err);
+	if (entry.err == NULL)
+		return;
+	if (err->rdef != NULL)
+		entry.rdef_name = err->rdef->name;
+	entry.err->rdef = NULL;
+
+	auto e = entries.find(keys[ec_index]);
+	if (e != entries.end()) {
+		free_schd_error(e->second.err);
+		e->second = entry;
+	} else
+		entries.emplace(keys[ec_index], entry);
+}
+
+/**
+ * @brief	throw away every remembered failure
+ *
+ * @param[in]	reason	-	why the cache is invalidated (for logging)
+ *
+ * @return	void
+ */
+void
+equiv_class_cache::invalidate(const char *reason)
+{
+	clear_cycle();
+
+	if (entries.empty())
+		return;
+
+	for (auto& e : entries)
+		free_schd_error(e.second.err);
+	entries.clear();
+
+	log_eventf(PBSEVENT_DEBUG2, PBS_EVENTCLASS_SCHED, LOG_DEBUG, __func__,
+		"Equivalence class cache invalidated: %s", reason);
+}
+
+equiv_class_cache::~equiv_class_cache()
+{
+	for (auto& e : entries)
+		free_schd_error(e.second.err);
+}
@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 1994-2021 Altair Engineering, Inc.
+ * For more information, contact Altair at www.altair.com.
+ *
+ * This file is part of both the OpenPBS software ("OpenPBS")
+ * and the PBS Professional ("PBS Pro") software.
+ *
+ * Open Source License Information:
+ *
+ * OpenPBS is free software. You can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Commercial License Information:
+ *
+ * PBS Pro is commercially licensed software that shares a common core with
+ * the OpenPBS software.  For a copy of the commercial license terms and
+ * conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+ * Altair Legal Department.
+ *
+ * Altair's dual-license business model allows companies, individuals, and
+ * organizations to create proprietary derivative works of OpenPBS and
+ * distribute them - whether embedded or bundled with other software -
+ * under a commercial license agreement.
+ *
+ * Use of Altair's trademarks, including but not limited to "PBS™",
+ * "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+ * subject to Altair's trademark licensing policies.
+ */
+
+
+#ifndef	_EQUIV_CLASS_CACHE_H
+#define	_EQUIV_CLASS_CACHE_H
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "data_types.h"
+
+/*
+ * The equivalence class cache remembers, between scheduling cycles, why an
+ * equivalence class (resresv_set) could not run.  Only failures that depend
+ * on nothing but the node/resource state or the limit counts are kept, and
+ * only when the class was turned down before anything changed in the cycle.
+ *
+ * Each entry carries a fingerprint of what its failure depended on: the
+ * nodes, server and queue resources of the class's node partition for a
+ * resource failure, or the limits and running counts of the class's
+ * entities for a limit failure.  At the start of the next cycle an entry
+ * whose fingerprint still matches marks its class can_not_run, so none of
+ * the class's jobs are evaluated again.  Any mismatch drops the entry.
+ */
+class equiv_class_cache
+{
+	public:
+	/* fingerprint this cycle's classes and mark the ones still known not to run */
+	int apply(status *policy, server_info *sinfo);
+
+	/* remember why a class could not run before the universe changed */
+	void remember(resresv_set *ec, int ec_index, schd_error *err);
+
+	/* throw everything away */
+	void invalidate(const char *reason);
+
+	~equiv_class_cache();
+
+	private:
+	enum ecc_kind {
+		ECC_NONE,
+		ECC_RESOURCE,	/* failed on the nodes or the server/queue resources */
+		ECC_LIMIT	/* failed on a server or queue limit */
+	};
+
+	struct ecc_entry
+	{
+		ecc_kind kind;
+		size_t print;		/* fingerprint of what the failure depended on */
+		schd_error *err;	/* why the class could not run, rdef cleared */
+		std::string rdef_name;	/* name of err's resource, if any */
+	};
+
+	std::unordered_map<std::string, ecc_entry> entries;
+
+	/* this cycle's classes, by equivalence class index */
+	std::vector<std::string> keys;
+	std::vector<size_t> res_prints;
+	std::vector<size_t> lim_prints;
+
+	static ecc_kind failure_kind(schd_error *err);
+	void clear_cycle();
+};
+
+extern equiv_class_cache ec_cache;
+
+#endif	/* _EQUIV_CLASS_CACHE_H */
@@ -64,6 +64,7 @@
  * 	read_usage()
  * 	read_usage_v1()
  * 	read_usage_v2()
+ * 	read_usage_v3()
  * 	over_fs_usage()
  * 	dup_fairshare_tree()
  * 	free_fairshare_tree()
@@ -76,6 +77,16 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 #include <log.h>
 
@@ -112,11 +123,23 @@ void
 add_child(group_info *ginfo, group_info *parent)
 {
 	if (parent != NULL) {
+		group_info *root;
+
 		ginfo->sibling = parent->child;
 		parent->child = ginfo;
 		ginfo->parent = parent;
 		ginfo->resgroup = parent->cresgroup;
 		ginfo->gpath = create_group_path(ginfo);
+
+		/* register the node in the tree's index, which lives on the root */
+		root = ginfo->gpath[0];
+		if (root->findex == NULL) {
+			root->findex = new fairshare_index();
+			root->findex->by_name.emplace(root->name, root);
+			root->findex->nodes.push_back(root);
+		}
+		root->findex->by_name.emplace(ginfo->name, ginfo);
+		root->findex->nodes.push_back(ginfo);
 	}
 }
 
@@ -142,8 +165,9 @@ add_unknown(group_info *ginfo, group_info *root)
 
 /**
  * @brief
- *		find_group_info - recursive function to find a group_info in the
- *			  resgroup tree
+ *		find_group_info - find a group_info in the resgroup tree.
+ *			  The root of a whole tree is looked up in its index,
+ *			  any other sub-tree is searched recursively.
  *
  * @param[in]	name	-	name of the ginfo to find
  * @param[in]	root	-	the root of the current sub-tree
@@ -158,6 +182,13 @@ find_group_info(const std::string& name, group_info *root)
 	if (root == NULL || name == root->name)
 		return root;
 
+	if (root->findex != NULL) {
+		auto it = root->findex->by_name.find(name);
+		if (it == root->findex->by_name.end())
+			return NULL;
+		return it->second;
+	}
+
 	ginfo = find_group_info(name, root->sibling);
 	if (ginfo == NULL)
 		ginfo = find_group_info(name, root->child);
@@ -213,10 +244,22 @@ group_info::group_info(const std::string& gname) : name(gname)
 	group_percentage = 0.0;
 	usage = FAIRSHARE_MIN_USAGE;
 	temp_usage = FAIRSHARE_MIN_USAGE;
+	usage_gen = 0;
 	usage_factor = 0.0;
 	parent = NULL;
 	sibling = NULL;
-	child = NULL;}
+	child = NULL;
+	findex = NULL;
+}
+
+/**
+ * @brief
+ *		destructor for group_info
+ */
+group_info::~group_info()
+{
+	delete findex;
+}
 
 /**
  * @brief
@@ -460,8 +503,10 @@ update_usage_on_run(resource_resv *resresv)
 
 	u = formula_evaluate(conf.fairshare_res.c_str(), resresv, resresv->resreq);
 	if (resresv->job->ginfo !=NULL) {
-		for (auto& g : resresv->job->ginfo->gpath)
+		for (auto& g : resresv->job->ginfo->gpath) {
 			g->temp_usage += u;
+			g->usage_gen++;
+		}
 	}
 	else
 		log_event(PBSEVENT_JOB, PBS_EVENTCLASS_JOB, LOG_INFO, resresv->name,
@@ -484,6 +529,15 @@ decay_fairshare_tree(group_info *root)
 	if (root == NULL)
 		return;
 
+	if (root->findex != NULL) {
+		for (auto g : root->findex->nodes) {
+			g->usage *= conf.fairshare_decay_factor;
+			if (g->usage < FAIRSHARE_MIN_USAGE)
+				g->usage = FAIRSHARE_MIN_USAGE;
+		}
+		return;
+	}
+
 	decay_fairshare_tree(root->sibling);
 	decay_fairshare_tree(root->child);
 
@@ -542,41 +596,425 @@ compare_path(std::vector<group_info *>& gp1, std::vector<group_info *>& gp2)
 	return rc;
 }
 
+/* the version 3 usage file this process keeps mapped for in-place updates */
+struct usage_store
+{
+	int fd;				/* open usage file or -1 */
+	bool writable;			/* file was opened for writing */
+	char *map;			/* mapping of the whole file */
+	size_t maplen;			/* length of the mapping */
+	int nslots;			/* number of usage records in the file */
+	std::string filename;		/* name the file was opened by */
+	std::unordered_map<std::string, int> slots;	/* entity name to record */
+	std::set<int> free_slots;	/* unused records */
+	usage_store() : fd(-1), writable(false), map(NULL), maplen(0), nslots(0) {}
+};
+static usage_store ustore;
+
+/* the usage records of a version 3 file follow the header and last decay time */
+#define USAGE_RECORDS_OFFSET (sizeof(struct group_node_header) + sizeof(time_t))
+
 /**
  * @brief
- *		write_usage - write the usage information to the usage file
- *		      This function uses a recursive helper function
+ *		persist_usage - should an entity's usage be kept in the usage file
+ *
+ * @param[in]	ginfo	-	the entity
+ *
+ * @return	bool
+ */
+static bool
+persist_usage(group_info *ginfo)
+{
+	/* only write out leaves of the tree (fairshare entities)
+	 * usage defaults to 1 so don't bother writing those out either
+	 * It is possible that the unknown group is empty.  Don't want to write it out
+	 */
+#ifdef NAS /* localmod 043 */
+	return ginfo->child == NULL;
+#else
+	return ginfo->usage != 1 && ginfo->child == NULL && ginfo->name != UNKNOWN_GROUP_NAME;
+#endif /* localmod 043 */
+}
+
+/**
+ * @brief	return the usage record in a slot of the mapped usage file
+ */
+static struct group_node_usage_v2 *
+usage_record(int slot)
+{
+	return reinterpret_cast<struct group_node_usage_v2 *>(ustore.map + USAGE_RECORDS_OFFSET) + slot;
+}
+
+/**
+ * @brief	return the last decay time of the mapped usage file
+ */
+static time_t *
+usage_last_decay(void)
+{
+	return reinterpret_cast<time_t *>(ustore.map + sizeof(struct group_node_header));
+}
+
+/**
+ * @brief	unmap and close the usage file
+ *
+ * @return	void
+ */
+static void
+close_usage_store(void)
+{
+	if (ustore.map != NULL)
+		munmap(ustore.map, ustore.maplen);
+	if (ustore.fd >= 0)
+		close(ustore.fd);
+	ustore.fd = -1;
+	ustore.writable = false;
+	ustore.map = NULL;
+	ustore.maplen = 0;
+	ustore.nslots = 0;
+	ustore.filename.clear();
+	ustore.slots.clear();
+	ustore.free_slots.clear();
+}
+
+/**
+ * @brief
+ *		open_usage_store - map a version 3 usage file and index its records
+ *		by entity name.  The file is mapped read-only if it is not to be
+ *		written or can not be opened for writing.
+ *
+ * @param[in]	filename	-	the usage file
+ * @param[in]	writable	-	map the file for in-place updates
+ *
+ * @return	int
+ * @retval	1	: file is mapped
+ * @retval	0	: not a version 3 usage file or error
+ */
+static int
+open_usage_store(const char *filename, bool writable)
+{
+	struct stat sb;
+	struct group_node_header *head;
+	int prot = PROT_READ | PROT_WRITE;
+	void *map;
+
+	close_usage_store();
+
+	ustore.writable = writable;
+	if (!writable || (ustore.fd = open(filename, O_RDWR)) < 0) {
+		ustore.writable = false;
+		prot = PROT_READ;
+		if ((ustore.fd = open(filename, O_RDONLY)) < 0)
+			return 0;
+	}
+
+	if (fstat(ustore.fd, &sb) < 0 || sb.st_size < (off_t) USAGE_RECORDS_OFFSET ||
+		(sb.st_size - USAGE_RECORDS_OFFSET) % sizeof(struct group_node_usage_v2) != 0) {
+		close_usage_store();
+		return 0;
+	}
+
+	map = mmap(NULL, sb.st_size, prot, MAP_SHARED, ustore.fd, 0);
+	if (map == MAP_FAILED) {
+		log_err(errno, __func__, "Unable to map usage file");
+		close_usage_store();
+		return 0;
+	}
+	ustore.map = static_cast<char *>(map);
+	ustore.maplen = sb.st_size;
+
+	head = reinterpret_cast<struct group_node_header *>(ustore.map);
+	if (strncmp(head->tag, USAGE_MAGIC, sizeof(head->tag)) != 0 || head->version != USAGE_VERSION) {
+		close_usage_store();
+		return 0;
+	}
+
+	ustore.filename = filename;
+	ustore.nslots = (sb.st_size - USAGE_RECORDS_OFFSET) / sizeof(struct group_node_usage_v2);
+	for (int i = 0; i < ustore.nslots; i++) {
+		struct group_node_usage_v2 *rec = usage_record(i);
+
+		if (rec->name[0] != '\0')
+			ustore.slots[std::string(rec->name, strnlen(rec->name, sizeof(rec->name)))] = i;
+		else
+			ustore.free_slots.insert(i);
+	}
+
+	return 1;
+}
+
+/**
+ * @brief	check the mapped usage file is still the one named filename.
+ *		pbsfs replaces the file when it rewrites it.
+ *
+ * @param[in]	filename	-	the usage file
+ *
+ * @return	bool
+ */
+static bool
+usage_store_current(const char *filename)
+{
+	struct stat sb;
+	struct stat fsb;
+
+	if (ustore.fd < 0 || !ustore.writable || ustore.filename != filename)
+		return false;
+
+	if (stat(filename, &sb) < 0 || fstat(ustore.fd, &fsb) < 0)
+		return false;
+
+	return sb.st_dev == fsb.st_dev && sb.st_ino == fsb.st_ino;
+}
+
+/**
+ * @brief
+ *		apply_usage_changes - write changed usage records into the mapped
+ *		usage file, growing it if needed, and sync it to disk
+ *
+ * @param[in]	last_decay	-	last decay time of the tree
+ * @param[in]	nslots	-	number of records the file must hold
+ * @param[in]	changes	-	the records to write
+ *
+ * @return	int
+ * @retval	1	: success
+ * @retval	0	: failure
+ */
+static int
+apply_usage_changes(time_t last_decay, int nslots, std::vector<usage_journal_entry>& changes)
+{
+	if (nslots > ustore.nslots) {
+		size_t len = USAGE_RECORDS_OFFSET + nslots * sizeof(struct group_node_usage_v2);
+		void *map;
+
+		if (ftruncate(ustore.fd, len) < 0) {
+			log_err(errno, __func__, "Unable to grow usage file");
+			return 0;
+		}
+		map = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, ustore.fd, 0);
+		if (map == MAP_FAILED) {
+			log_err(errno, __func__, "Unable to map usage file");
+			return 0;
+		}
+		munmap(ustore.map, ustore.maplen);
+		ustore.map = static_cast<char *>(map);
+		ustore.maplen = len;
+		ustore.nslots = nslots;
+	}
+
+	for (auto& e : changes) {
+		struct group_node_usage_v2 *rec;
+
+		if (e.slot < 0 || e.slot >= ustore.nslots)
+			continue;
+		rec = usage_record(e.slot);
+		if (rec->name[0] != '\0') {
+			auto it = ustore.slots.find(std::string(rec->name, strnlen(rec->name, sizeof(rec->name))));
+			if (it != ustore.slots.end() && it->second == e.slot)
+				ustore.slots.erase(it);
+		}
+		e.rec.name[sizeof(e.rec.name) - 1] = '\0';
+		*rec = e.rec;
+		if (e.rec.name[0] != '\0') {
+			ustore.slots[e.rec.name] = e.slot;
+			ustore.free_slots.erase(e.slot);
+		} else
+			ustore.free_slots.insert(e.slot);
+	}
+	*usage_last_decay() = last_decay;
+
+	if (msync(ustore.map, ustore.maplen, MS_SYNC) < 0) {
+		log_err(errno, __func__, "Unable to sync usage file");
+		return 0;
+	}
+
+	return 1;
+}
+
+/**
+ * @brief	checksum used to detect a partially written usage journal
+ */
+static unsigned long
+usage_journal_sum(const void *buf, size_t len, unsigned long sum)
+{
+	const unsigned char *p = static_cast<const unsigned char *>(buf);
+
+	for (size_t i = 0; i < len; i++)
+		sum = (sum ^ p[i]) * 1099511628211UL;
+
+	return sum;
+}
+
+/**
+ * @brief
+ *		write_usage_journal - write the usage changes about to be applied
+ *		and flush them to disk.  If we die while the usage file is being
+ *		updated, read_usage() replays the journal.
+ *
+ * @param[in]	jname	-	name of the journal file
+ * @param[in]	last_decay	-	last decay time of the tree
+ * @param[in]	nslots	-	number of records the usage file must hold
+ * @param[in]	changes	-	the records to write
+ *
+ * @return	int
+ * @retval	1	: success
+ * @retval	0	: failure
+ */
+static int
+write_usage_journal(const std::string& jname, time_t last_decay, int nslots,
+	std::vector<usage_journal_entry>& changes)
+{
+	struct usage_journal_header jhead;
+	unsigned long sum;
+	FILE *fp;
+	int rc;
+
+	memset(&jhead, 0, sizeof(jhead));
+	pbs_strncpy(jhead.tag, USAGE_JOURNAL_MAGIC, sizeof(jhead.tag));
+	jhead.count = changes.size();
+	jhead.nslots = nslots;
+	jhead.last_decay = last_decay;
+
+	sum = usage_journal_sum(&jhead, sizeof(jhead), 14695981039346656037UL);
+	sum = usage_journal_sum(changes.data(), changes.size() * sizeof(usage_journal_entry), sum);
+
+	if ((fp = fopen(jname.c_str(), "wb")) == NULL) {
+		log_err(errno, __func__, "Unable to open usage journal");
+		return 0;
+	}
+	rc = fwrite(&jhead, sizeof(jhead), 1, fp) == 1 &&
+		fwrite(changes.data(), sizeof(usage_journal_entry), changes.size(), fp) == changes.size() &&
+		fwrite(&sum, sizeof(sum), 1, fp) == 1 &&
+		fflush(fp) == 0 && fsync(fileno(fp)) == 0;
+	if (fclose(fp) != 0)
+		rc = 0;
+
+	if (!rc) {
+		log_err(errno, __func__, "Unable to write usage journal");
+		unlink(jname.c_str());
+		return 0;
+	}
+
+	return 1;
+}
+
+/**
+ * @brief
+ *		read_usage_journal - read the usage journal of a usage file
+ *
+ * @param[in]	jname	-	name of the journal file
+ * @param[out]	jhead	-	the journal header
+ * @param[out]	changes	-	the journaled records
+ *
+ * @return	int
+ * @retval	1	: the journal was read
+ * @retval	0	: the journal was not completely written
+ * @retval	-1	: there is no journal
+ */
+static int
+read_usage_journal(const std::string& jname, struct usage_journal_header& jhead,
+	std::vector<usage_journal_entry>& changes)
+{
+	unsigned long sum;
+	unsigned long fsum;
+	int valid = 0;
+	FILE *fp;
+
+	if ((fp = fopen(jname.c_str(), "rb")) == NULL)
+		return -1;
+
+	if (fread(&jhead, sizeof(jhead), 1, fp) == 1 &&
+		strncmp(jhead.tag, USAGE_JOURNAL_MAGIC, sizeof(jhead.tag)) == 0 &&
+		jhead.count >= 0 && jhead.nslots >= 0) {
+		changes.resize(jhead.count);
+		if (fread(changes.data(), sizeof(usage_journal_entry), jhead.count, fp) == (size_t) jhead.count &&
+			fread(&fsum, sizeof(fsum), 1, fp) == 1) {
+			sum = usage_journal_sum(&jhead, sizeof(jhead), 14695981039346656037UL);
+			sum = usage_journal_sum(changes.data(), changes.size() * sizeof(usage_journal_entry), sum);
+			valid = sum == fsum;
+		}
+	}
+	fclose(fp);
+
+	return valid;
+}
+
+/**
+ * @brief
+ *		replay_usage_journal - apply a usage journal left behind by a
+ *		scheduler which died while updating the usage file.  A journal
+ *		which was not completely written is discarded; the usage file was
+ *		not touched yet.  Only the scheduler, which owns the usage file,
+ *		replays the journal.
+ *
+ * @param[in]	filename	-	the usage file
+ *
+ * @return	void
+ */
+static void
+replay_usage_journal(const char *filename)
+{
+	std::string jname = std::string(filename) + ".journal";
+	struct usage_journal_header jhead;
+	std::vector<usage_journal_entry> changes;
+	bool done = true;
+	int rc;
+
+	rc = read_usage_journal(jname, jhead, changes);
+	if (rc == -1)
+		return;
+
+	if (rc == 1) {
+		if (open_usage_store(filename, true) && ustore.writable &&
+			apply_usage_changes(jhead.last_decay, jhead.nslots, changes))
+			log_eventf(PBSEVENT_SCHED, PBS_EVENTCLASS_FILE, LOG_NOTICE, "fairshare usage",
+				"Replayed %d entries from the usage journal", jhead.count);
+		else
+			done = false;
+		close_usage_store();
+	} else
+		log_event(PBSEVENT_SCHED, PBS_EVENTCLASS_FILE, LOG_WARNING, "fairshare usage",
+			"Discarding incomplete usage journal");
+
+	if (done)
+		unlink(jname.c_str());
+}
+
+/**
+ * @brief
+ *		write_usage_file - write the whole usage file.  It is written to a
+ *		new file which replaces the old one so a crash never leaves a
+ *		partial usage file behind.  The new file is then mapped for
+ *		in-place updates by write_usage().
  *
  * @param[in]	filename	-	usage file
  * @param[in]	fhead	-	Pointer to fairshare_head structure.
  *
  * @return	success/failure
- *
  */
-int
-write_usage(const char *filename, fairshare_head *fhead)
+static int
+write_usage_file(const char *filename, fairshare_head *fhead)
 {
+	std::string tmpname = std::string(filename) + ".new";
+	std::string jname = std::string(filename) + ".journal";
 	FILE *fp;		/* file pointer to usage file */
 	struct group_node_header head;
+	int rc;
 
-	if (fhead == NULL)
-		return 0;
+	close_usage_store();
 
-	if (filename == NULL)
-		filename = USAGE_FILE;
-
-	if ((fp = fopen(filename, "wb")) == NULL) {
-		sprintf(log_buffer, "Error opening file %s", filename);
+	if ((fp = fopen(tmpname.c_str(), "wb")) == NULL) {
+		sprintf(log_buffer, "Error opening file %s", tmpname.c_str());
 		log_err(errno, "write_usage", log_buffer);
 		return 0;
 	}
 
-	/* version 2:
+	/* version 3:
 	 * header
 	 * last_decay
 	 * group_node_usage_v2
 	 * group_node_usage_v2
 	 * ...
+	 * Records are updated in place afterwards.  A record with an empty name
+	 * is unused.
 	 */
 
 	memset(&head, 0, sizeof(struct group_node_header));
@@ -587,7 +1025,119 @@ write_usage(const char *filename, fairshare_head *fhead)
 	fwrite(&fhead->last_decay, sizeof(time_t), 1, fp);
 
 	rec_write_usage(fhead->root, fp);
-	fclose(fp);
+
+	rc = fflush(fp) == 0 && fsync(fileno(fp)) == 0 && !ferror(fp);
+	if (fclose(fp) != 0)
+		rc = 0;
+	if (!rc) {
+		sprintf(log_buffer, "Error writing file %s", tmpname.c_str());
+		log_err(errno, "write_usage", log_buffer);
+		remove(tmpname.c_str());
+		return 0;
+	}
+
+	/* a journal left behind belongs to the file we are replacing */
+	unlink(jname.c_str());
+	if (rename(tmpname.c_str(), filename) < 0) {
+		sprintf(log_buffer, "Error renaming %s to %s", tmpname.c_str(), filename);
+		log_err(errno, "write_usage", log_buffer);
+		remove(tmpname.c_str());
+		return 0;
+	}
+
+	open_usage_store(filename, true);
+	return 1;
+}
+
+/**
+ * @brief
+ *		write_usage - write the usage information to the usage file
+ *
+ * @par
+ *		The usage file stays mapped between calls.  Only the records of the
+ *		entities whose usage changed are written, in place, after they were
+ *		journaled.  New entities reuse unused records or get records at the
+ *		end of the file.  The records of entities whose usage is no longer
+ *		kept are freed.  The
+ *		whole file is written when it is not mapped yet, e.g. the first
+ *		time, after converting an older usage file, or after pbsfs replaced it.
+ *
+ * @param[in]	filename	-	usage file
+ * @param[in]	fhead	-	Pointer to fairshare_head structure.
+ *
+ * @return	success/failure
+ *
+ */
+int
+write_usage(const char *filename, fairshare_head *fhead)
+{
+	std::vector<usage_journal_entry> changes;
+	std::unordered_set<std::string> live;
+	int nslots;
+
+	if (fhead == NULL)
+		return 0;
+
+	if (filename == NULL)
+		filename = USAGE_FILE;
+
+	if (fhead->root == NULL || fhead->root->findex == NULL || !usage_store_current(filename))
+		return write_usage_file(filename, fhead);
+
+	nslots = ustore.nslots;
+	auto free_slot = ustore.free_slots.begin();
+	for (auto g : fhead->root->findex->nodes) {
+		usage_journal_entry e;
+		int slot;
+
+		if (!persist_usage(g))
+			continue;
+
+		/* names are truncated to fit the record like rec_write_usage() does */
+		std::string name(g->name, 0, USAGE_NAME_MAX - 1);
+		auto it = ustore.slots.find(name);
+
+		live.insert(name);
+		if (it != ustore.slots.end()) {
+			if (usage_record(it->second)->usage == g->usage)
+				continue;
+			slot = it->second;
+		} else if (free_slot != ustore.free_slots.end())
+			slot = *free_slot++;
+		else
+			slot = nslots++;
+
+		memset(&e, 0, sizeof(e));
+		e.slot = slot;
+		snprintf(e.rec.name, sizeof(e.rec.name), "%s", name.c_str());
+		e.rec.usage = g->usage;
+		changes.push_back(e);
+	}
+
+	/* free the records of entities which are gone from the tree or whose
+	 * usage is no longer kept, as rewriting the whole file would
+	 */
+	for (const auto& sl : ustore.slots) {
+		usage_journal_entry e;
+
+		if (live.find(sl.first) != live.end())
+			continue;
+		memset(&e, 0, sizeof(e));
+		e.slot = sl.second;
+		changes.push_back(e);
+	}
+
+	if (changes.empty() && *usage_last_decay() == fhead->last_decay)
+		return 1;
+
+	std::string jname = std::string(filename) + ".journal";
+	if (!write_usage_journal(jname, fhead->last_decay, nslots, changes))
+		return 0;
+
+	if (!apply_usage_changes(fhead->last_decay, nslots, changes))
+		return 0;
+
+	unlink(jname.c_str());
 	return 1;
 }
 
@@ -610,15 +1160,7 @@ rec_write_usage(group_info *root, FILE *fp)
 	if (root == NULL)
 		return;
 
-	/* only write out leaves of the tree (fairshare entities)
-	 * usage defaults to 1 so don't bother writing those out either
-	 * It is possible that the unknown group is empty.  Don't want to write it out
-	 */
-#ifdef NAS /* localmod 043 */
-	if (root->child == NULL) {
-#else
-	if (root->usage != 1 && root->child == NULL && root->name != UNKNOWN_GROUP_NAME) {
-#endif /* localmod 043 */
+	if (persist_usage(root)) {
 		memset(&grp, 0, sizeof(struct group_node_usage_v2));
 		snprintf(grp.name, sizeof(grp.name), "%s", root->name.c_str());
 		grp.usage = root->usage;
@@ -630,13 +1172,53 @@ rec_write_usage(group_info *root, FILE *fp)
 	rec_write_usage(root->child, fp);
 }
 
+/**
+ * @brief
+ *		load_usage_entity - set the usage of an entity read from the usage
+ *		file and add it to the groups on its path
+ *
+ * @param[in]	name	-	name of the entity
+ * @param[in]	usage	-	its usage
+ * @param[in]	flags	-	FS_TRIM: don't add entities not in the resource_group file
+ * @param[in]	root	-	root of the fairshare tree
+ *
+ * @return	void
+ */
+static void
+load_usage_entity(const char *name, usage_t usage, int flags, group_info *root)
+{
+	group_info *ginfo;
+
+	/* if we're trimming the tree, don't add any new nodes which are not
+	 * already in the resource_group file
+	 */
+	if (flags & FS_TRIM)
+		ginfo = find_group_info(name, root);
+	else
+		ginfo = find_alloc_ginfo(name, root);
+
+	if (ginfo != NULL) {
+		ginfo->usage = usage;
+		ginfo->temp_usage = usage;
+		if (ginfo->child == NULL) {
+			/* add usage down the path from the root to our parent */
+			for (auto& g : ginfo->gpath) {
+				if (g == ginfo)
+					break;
+				g->usage += usage;
+				g->temp_usage += usage;
+			}
+		}
+	}
+}
+
 /**
  * @brief
  *		read_usage - read the usage information and load it into the
  *		     resgroup tree.
  *
  * @param[in]	filename	-	The file which stores the usage information.
- * @param[in]	flags	-	flags to check whether to trim or not.
+ * @param[in]	flags	-	FS_TRIM: trim the tree, FS_UPDATE: the caller owns the usage file
  * @param[in]	fhead	-	pointer to fairshare_head struct.
  *
  * @return void
@@ -655,6 +1237,10 @@ read_usage(const char *filename, int flags, fairshare_head *fhead)
 	if (filename == NULL)
 		filename = USAGE_FILE;
 
+	if (flags & FS_UPDATE)
+		replay_usage_journal(filename);
+	close_usage_store();
+
 	if ((fp = fopen(filename, "r")) == NULL) {
 		log_event(PBSEVENT_SCHED, PBS_EVENTCLASS_FILE, LOG_WARNING, "fairshare usage",
 			  "Creating usage database for fairshare");
@@ -667,7 +1253,7 @@ read_usage(const char *filename, int flags, fairshare_head *fhead)
 		if (!strcmp(head.tag, USAGE_MAGIC)) { /* this is a header */
 			int error = 0;
 
-			if (head.version == 2) {
+			if (head.version == 2 || head.version == USAGE_VERSION) {
 				if (fread(&last, sizeof(time_t), 1, fp) != 0) {
 					/* 946713600 = 1/1/2000 00:00 - before usage version 2 existed */
 					if (last == 0 || last > 946713600)
@@ -675,8 +1261,15 @@ read_usage(const char *filename, int flags, fairshare_head *fhead)
 					else
 						error = 1;
 				}
-				if (!error)
-					read_usage_v2(fp, flags, fhead->root);
+				if (!error) {
+					if (head.version == USAGE_VERSION)
+						read_usage_v3(filename, flags, fhead->root);
+					else {
+						read_usage_v2(fp, flags, fhead->root);
+						log_event(PBSEVENT_SCHED, PBS_EVENTCLASS_FILE, LOG_NOTICE, "fairshare usage",
+							"Usage file will be converted to version 3 when it is next written");
+					}
+				}
 			} else
 				error = 1;
 
@@ -709,28 +1302,13 @@ int
 read_usage_v1(FILE *fp, group_info *root)
 {
 	struct group_node_usage_v1 grp;
-	group_info *ginfo;
 
 	if (fp == NULL)
 		return 0;
 	memset(&grp, 0, sizeof(struct group_node_usage_v1));
 	while (fread(&grp, sizeof(struct group_node_usage_v1), 1, fp)) {
-		if (grp.usage >= 0 && is_valid_pbs_name(grp.name, USAGE_NAME_MAX)) {
-			ginfo = find_alloc_ginfo(grp.name, root);
-			if (ginfo != NULL) {
-				ginfo->usage = grp.usage;
-				ginfo->temp_usage = grp.usage;
-				if (ginfo->child == NULL) {
-					/* add usage down the path from the root to our parent */
-					for (auto& g : ginfo->gpath) {
-						if (g == ginfo)
-							break;
-						g->usage += grp.usage;
-						g->temp_usage += grp.usage;
-					}
-				}
-			}
-		}
+		if (grp.usage >= 0 && is_valid_pbs_name(grp.name, USAGE_NAME_MAX))
+			load_usage_entity(grp.name, grp.usage, NO_FLAGS, root);
 		else
 			log_event(PBSEVENT_SCHED, PBS_EVENTCLASS_FILE, LOG_WARNING,
 				  "fairshare usage", "Invalid entity");
@@ -755,36 +1333,78 @@ int
 read_usage_v2(FILE *fp, int flags, group_info *root)
 {
 	struct group_node_usage_v2 grp;
-	group_info *ginfo;
 
 	if (fp == NULL)
 		return 0;
 
 	memset(&grp, 0, sizeof(struct group_node_usage_v2));
 	while (fread(&grp, sizeof(struct group_node_usage_v2), 1, fp)) {
-		if (grp.usage >= 0 && is_valid_pbs_name(grp.name, USAGE_NAME_MAX)) {
-			/* if we're trimming the tree, don't add any new nodes which are not
-			 * already in the resource_group file
-			 */
-			if (flags & FS_TRIM)
-				ginfo = find_group_info(grp.name, root);
-			else
-				ginfo = find_alloc_ginfo(grp.name, root);
-
-			if (ginfo != NULL) {
-				ginfo->usage = grp.usage;
-				ginfo->temp_usage = grp.usage;
-				if (ginfo->child == NULL) {
-					/* add usage down the path from the root to our parent */
-					for (auto& g : ginfo->gpath) {
-						if (g == ginfo)
-							break;
-						g->usage += grp.usage;
-						g->temp_usage += grp.usage;
-					}
-				}
-			}
-		}
+		if (grp.usage >= 0 && is_valid_pbs_name(grp.name, USAGE_NAME_MAX))
+			load_usage_entity(grp.name, grp.usage, flags, root);
+		else
+			log_event(PBSEVENT_SCHED, PBS_EVENTCLASS_FILE, LOG_WARNING,
+				  "fairshare usage", "Invalid entity");
+	}
+
+	return 1;
+}
+
+/**
+ * @brief
+ * 		read version 3 usage file.  The file is mapped and stays mapped
+ *		so write_usage() can update it in place.  If the file is not ours to
+ *		update, a journal the scheduler has not replayed yet is read over it.
+ *
+ * @param[in]	filename	- the usage file
+ * @param[in]	flags	- FS_TRIM: don't add entities not in the resource_group file
+ *			  FS_UPDATE: map the file for in-place updates
+ * @param[in]	root	- root of the fairshare tree
+ *
+ *	@retval 1 success
+ *	@retval 0 failure
+ *
+ */
+int
+read_usage_v3(const char *filename, int flags, group_info *root)
+{
+	struct usage_journal_header jhead;
+	std::vector<usage_journal_entry> changes;
+	std::unordered_map<int, struct group_node_usage_v2> journaled;
+	int nslots;
+
+	if (!open_usage_store(filename, (flags & FS_UPDATE) != 0)) {
+		log_event(PBSEVENT_SCHED, PBS_EVENTCLASS_FILE, LOG_WARNING,
+			  "fairshare usage", "Invalid usage file");
+		return 0;
+	}
+
+	nslots = ustore.nslots;
+	if (!(flags & FS_UPDATE) && read_usage_journal(std::string(filename) + ".journal", jhead, changes) == 1) {
+		for (const auto& e : changes)
+			if (e.slot >= 0 && e.slot < jhead.nslots)
+				journaled[e.slot] = e.rec;
+		if (jhead.nslots > nslots)
+			nslots = jhead.nslots;
+	}
+
+	for (int i = 0; i < nslots; i++) {
+		struct group_node_usage_v2 grp;
+		auto it = journaled.find(i);
+
+		if (it != journaled.end())
+			grp = it->second;
+		else if (i < ustore.nslots)
+			grp = *usage_record(i);
+		else
+			continue;
+
+		/* unused record */
+		if (grp.name[0] == '\0')
+			continue;
+
+		grp.name[sizeof(grp.name) - 1] = '\0';
+		if (grp.usage >= 0 && is_valid_pbs_name(grp.name, USAGE_NAME_MAX))
+			load_usage_entity(grp.name, grp.usage, flags, root);
 		else
 			log_event(PBSEVENT_SCHED, PBS_EVENTCLASS_FILE, LOG_WARNING,
 				  "fairshare usage", "Invalid entity");
@@ -846,9 +1466,11 @@ group_info::group_info(group_info& root) : name(root.name)
 	usage = root.usage;
 	usage_factor = root.usage_factor;
 	temp_usage = root.temp_usage;
+	usage_gen = root.usage_gen;
 	sibling = NULL;
 	child = NULL;
 	parent = NULL;
+	findex = NULL;
 }
 
 /**
@@ -960,6 +1582,12 @@ reset_temp_usage(group_info *head)
 	if (head == NULL)
 		return;
 
+	if (head->findex != NULL) {
+		for (auto g : head->findex->nodes)
+			g->temp_usage = g->usage;
+		return;
+	}
+
 	head->temp_usage = head->usage;
 	reset_temp_usage(head->sibling);
 	reset_temp_usage(head->child);
@@ -1009,6 +1637,25 @@ calc_usage_factor(fairshare_head *tree)
 		return;
 
 	root = tree->root;
+	if (root == NULL)
+		return;
+
+	/* the index lists parents before their children, so one pass will do */
+	if (root->findex != NULL) {
+		for (auto g : root->findex->nodes) {
+			float usage;
+
+			if (g == root)
+				continue;
+			usage = g->usage / root->usage;
+			if (g->parent == root)
+				g->usage_factor = usage;
+			else
+				g->usage_factor = usage + ((g->parent->usage_factor - usage) * g->group_percentage);
+		}
+		return;
+	}
+
 	/* Root's children use their real usage as their arbitrary usage */
 	for (ginfo = root->child; ginfo != NULL; ginfo = ginfo->sibling) {
 		ginfo->usage_factor = ginfo->usage / root->usage;
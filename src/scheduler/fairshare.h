@@ -144,6 +144,11 @@ int read_usage_v1(FILE *fp, group_info *root);
  */
 int read_usage_v2(FILE *fp, int flags, group_info *root);
 
+/*
+ *      read_usage_v3 - read version 3 usage file
+ */
+int read_usage_v3(const char *filename, int flags, group_info *root);
+
 /*
  *      create_group_path - create a path from the root to the leaf of the tree
  */
@@ -65,6 +65,8 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <unordered_map>
+#include <vector>
 #include "fifo.h"
 #include "queue_info.h"
 #include "server_info.h"
@@ -94,6 +96,13 @@
 #include "pbs_version.h"
 #include "buckets.h"
 #include "multi_threading.h"
+#include "job_status_cache.h"
+#include "equiv_class_cache.h"
+#include "formula.h"
+#include "mem_pool.h"
+#include "cycle_profile.h"
+#include "capture.h"
+#include "preempt_index.h"
 #include "pbs_python.h"
 #include "libpbs.h"
 
@@ -124,6 +133,7 @@ schedinit(int nthreads)
 #endif
 
 	conf = parse_config(CONFIG_FILE);
+	capture_arm(conf.cycle_capture);
 
 	parse_holidays(HOLIDAYS_FILE);
 	time(&(cstat.current_time));
@@ -149,7 +159,7 @@ schedinit(int nthreads)
 	if (fstree != NULL) {
 		parse_group(RESGROUP_FILE, fstree->root);
 		calc_fair_share_perc(fstree->root->child, UNSPECIFIED);
-		read_usage(USAGE_FILE, 0, fstree);
+		read_usage(USAGE_FILE, FS_UPDATE, fstree);
 
 		if (fstree->last_decay == 0)
 			fstree->last_decay = cstat.current_time;
@@ -310,6 +320,7 @@ update_cycle_status(status& policy, time_t current_time)
 int
 init_scheduling_cycle(status *policy, int pbs_sd, server_info *sinfo)
 {
+	prof_phase prof(__func__);
 	group_info *user = NULL;	/* the user for the running jobs of the last cycle */
 	static schd_error *err;
 
@@ -326,7 +337,7 @@ init_scheduling_cycle(status *policy, int pbs_sd, server_info *sinfo)
 		if ((fp = fopen(USAGE_TOUCH, "r")) != NULL) {
 			fclose(fp);
 			reset_usage(fstree->root);
-			read_usage(USAGE_FILE, NO_FLAGS, fstree);
+			read_usage(USAGE_FILE, FS_UPDATE, fstree);
 			if (fstree->last_decay == 0)
 				fstree->last_decay = policy->current_time;
 			remove(USAGE_TOUCH);
@@ -412,6 +423,8 @@ init_scheduling_cycle(status *policy, int pbs_sd, server_info *sinfo)
 		}
 	}
 	if (sinfo->jobs != NULL) {
+		if (sinfo->job_sort_formula != NULL)
+			formula_evaluate_jobs(sinfo->job_sort_formula, sinfo->jobs);
 		for (int i = 0; sinfo->jobs[i] != NULL; i++) {
 			resource_resv *resresv = sinfo->jobs[i];
 			if (resresv->job != NULL) {
@@ -425,7 +438,6 @@ init_scheduling_cycle(status *policy, int pbs_sd, server_info *sinfo)
 				}
 				if (sinfo->job_sort_formula != NULL) {
 					double threshold = sc_attrs.job_sort_formula_threshold;
-					resresv->job->formula_value = formula_evaluate(sinfo->job_sort_formula, resresv, resresv->resreq);
 					log_eventf(PBSEVENT_DEBUG2, PBS_EVENTCLASS_JOB, LOG_DEBUG, resresv->name, "Formula Evaluation = %.*f",
 						   float_digits(resresv->job->formula_value, FLOAT_NUM_DIGITS), resresv->job->formula_value);
 
@@ -482,6 +494,10 @@ schedule(int sd, const sched_cmd *cmd)
 			 */
 			update_resource_defs(sd);
 
+			/* the server recovered its jobs, our cached view of them is stale */
+			jstat_cache.invalidate("server restarted");
+			ec_cache.invalidate("server restarted");
+
 			/* Get config from the qmgr sched object */
 			if (!set_validate_sched_attrs(sd))
 				return 0;
@@ -506,6 +522,8 @@ schedule(int sd, const sched_cmd *cmd)
 				return 0;
 
 			update_resource_defs(sd);
+			jstat_cache.invalidate("scheduler reconfigured");
+			ec_cache.invalidate("scheduler reconfigured");
 
 			/* Get config from the qmgr sched object */
 			if (!set_validate_sched_attrs(sd))
@@ -592,6 +610,8 @@ scheduling_cycle(int sd, const sched_cmd *cmd)
 
 	log_event(PBSEVENT_DEBUG, PBS_EVENTCLASS_REQUEST, LOG_DEBUG,
 		  "", "Starting Scheduling Cycle");
+	prof_cycle_start();
+	capture_start(sd);
 
 	/* Decide whether we need to send "can't run" type updates this cycle */
 	if (time(NULL) - last_attr_updates >= sc_attrs.attr_update_period)
@@ -742,7 +762,13 @@ get_high_prio_cmd(int *is_conn_lost, sched_cmd *high_prior_cmd)
 {
 	int i;
 	sched_cmd cmd;
-	svr_conn_t **svr_conns = get_conn_svr_instances(clust_secondary_sock);
+	svr_conn_t **svr_conns;
+
+	/* a replayed cycle has no servers to hear from */
+	if (replay_active())
+		return 0;
+
+	svr_conns = get_conn_svr_instances(clust_secondary_sock);
 	if (svr_conns == NULL) {
 		log_event(PBSEVENT_SCHED, PBS_EVENTCLASS_SCHED, LOG_ERR, __func__,
 			"Unable to fetch secondary connections");
@@ -788,6 +814,124 @@ get_high_prio_cmd(int *is_conn_lost, sched_cmd *high_prior_cmd)
 	return 0;
 }
 
+/*
+ * Answers of is_ok_to_run_quick() for the jobs main_sched_loop() is
+ * about to consider.  They stay good until the universe changes.
+ */
+struct spec_batch {
+	int gen;				/* universe generation of the answers */
+	std::unordered_map<int, schd_error *> errs;	/* job rank -> error, NULL if passed */
+	resource_resv **arr;			/* job array last speculated over */
+	int pos;				/* where njob was found in arr */
+	int served;				/* jobs answered from the batch */
+};
+
+/**
+ * @brief	free the answers of a speculative batch
+ *
+ * @param[in]	sb	-	batch to clear
+ *
+ * @return	void
+ */
+static void
+clear_spec_batch(spec_batch& sb)
+{
+	for (auto& e : sb.errs)
+		free_schd_error(e.second);
+	sb.errs.clear();
+}
+
+/**
+ * @brief
+ *		speculate_next_jobs - run is_ok_to_run_quick() in parallel for njob
+ *		and the jobs after it in the order next_job() is likely to return
+ *		them.  The universe is only read while this runs.
+ *
+ * @param[in]	policy	-	policy info
+ * @param[in]	sinfo	-	server info
+ * @param[in]	njob	-	job about to be considered
+ * @param[in]	gen	-	current universe generation
+ * @param[in,out]	sb	-	batch to fill in
+ *
+ * @return	void
+ */
+static void
+speculate_next_jobs(status *policy, server_info *sinfo, resource_resv *njob, int gen, spec_batch& sb)
+{
+	resource_resv **arr;
+	std::vector<resource_resv *> cands;
+	std::vector<schd_error *> errs;
+	int max_cands;
+	int i;
+
+	clear_spec_batch(sb);
+	sb.gen = gen;
+
+	/* next_job() walks the queues for these policies */
+	if (policy->round_robin || policy->by_queue)
+		arr = njob->job->queue->jobs;
+	else
+		arr = sinfo->jobs;
+	if (arr == NULL)
+		return;
+
+	if (arr != sb.arr) {
+		sb.arr = arr;
+		sb.pos = 0;
+	}
+	for (i = sb.pos; arr[i] != NULL && arr[i] != njob; i++)
+		;
+	if (arr[i] == NULL) {
+		for (i = 0; i < sb.pos && arr[i] != njob; i++)
+			;
+		if (arr[i] != njob)
+			return;
+	}
+	sb.pos = i;
+
+	/* the allpart is read by every check, bring it up to date once */
+	if (sinfo->pset_metadata_stale)
+		update_all_nodepart(policy, sinfo, NO_FLAGS);
+
+	max_cands = num_threads * MT_SPEC_JOBS_PER_THREAD;
+	for (; arr[i] != NULL && static_cast<int>(cands.size()) < max_cands; i++) {
+		resource_resv *r = arr[i];
+
+		if (r->can_not_run || !in_runnable_state(r) || r->is_shrink_to_fit)
+			continue;
+		if (sinfo->equiv_classes != NULL && r->ec_index != UNSPECIFIED &&
+		    sinfo->equiv_classes[r->ec_index]->can_not_run)
+			continue;
+		cands.push_back(r);
+	}
+
+	errs.resize(cands.size(), NULL);
+	parallel_for(__func__, cands.size(), mt_chunk_size(cands.size(), 1),
+		[&](int sidx, int eidx) {
+			for (int j = sidx; j <= eidx; j++) {
+				schd_error *err = new_schd_error();
+
+				if (err == NULL)
+					return 1;
+				unsigned int flags = NO_FLAGS;
+
+				if (job_should_use_buckets(cands[j]))
+					flags = USE_BUCKETS;
+
+				if (is_ok_to_run_quick(policy, sinfo, cands[j]->job->queue,
+						       cands[j], flags, err) == SE_NONE) {
+					free_schd_error(err);
+					err = NULL;
+				}
+				errs[j] = err;
+			}
+			return 0;
+		});
+
+	for (i = 0; i < static_cast<int>(cands.size()); i++)
+		sb.errs[cands[i]->rank] = errs[i];
+}
+
 /**
  * @brief
  * 		the main scheduler loop
@@ -811,6 +955,7 @@ get_high_prio_cmd(int *is_conn_lost, sched_cmd *high_prior_cmd)
 int
 main_sched_loop(status *policy, int sd, server_info *sinfo, schd_error **rerr)
 {
+	prof_phase prof(__func__);
 	resource_resv *njob;		/* ptr to the next job to see if it can run */
 	int rc = 0;			/* return code to the function */
 	int num_topjobs = 0;		/* number of jobs we've added to the calendar */
@@ -825,6 +970,9 @@ main_sched_loop(status *policy, int sd, server_info *sinfo, schd_error **rerr)
 	int sort_again = DONT_SORT_JOBS;
 	schd_error *err;
 	schd_error *chk_lim_err;
+	int universe_gen = 0;		/* bumped whenever the universe may have changed */
+	spec_batch sb = {-1, {}, NULL, 0, 0};
+	bool speculate;
 
 
 	if (policy == NULL || sinfo == NULL || rerr == NULL)
@@ -843,6 +991,16 @@ main_sched_loop(status *policy, int sd, server_info *sinfo, schd_error **rerr)
 		return -1;
 	}
 
+	/* Check the next few jobs ahead of time in parallel.  A qrun only
+	 * considers one job, so there is nothing to get ahead of.
+	 */
+	speculate = num_threads > 1 && sinfo->qrun_job == NULL;
+
+	/* skip the classes which failed in an earlier cycle on a universe
+	 * which has not changed since
+	 */
+	ec_cache.apply(policy, sinfo);
+
 	/* main scheduling loop */
 #ifdef NAS
 	/* localmod 030 */
@@ -855,6 +1013,7 @@ main_sched_loop(status *policy, int sd, server_info *sinfo, schd_error **rerr)
 	for (i = 0; !end_cycle &&
 		(njob = next_job(policy, sinfo, sort_again)) != NULL; i++) {
 		int should_use_buckets;		/* Should use node buckets for a job */
+		int eval_gen;			/* universe_gen the job was evaluated in */
 		unsigned int flags = NO_FLAGS;	/* flags to is_ok_to_run @see is_ok_to_run() */
 		auto qinfo = njob->job->queue;
 
@@ -873,22 +1032,47 @@ main_sched_loop(status *policy, int sd, server_info *sinfo, schd_error **rerr)
 
 		log_event(PBSEVENT_DEBUG, PBS_EVENTCLASS_JOB, LOG_DEBUG,
 			njob->name, "Considering job to run");
+		prof_count(PROF_JOBS_CONSIDERED);
 
 		should_use_buckets = job_should_use_buckets(njob);
 		if(should_use_buckets)
 			flags = USE_BUCKETS;
 
+		eval_gen = universe_gen;
+
 		if (njob->is_shrink_to_fit) {
 			/* Pass the suitable heuristic for shrinking */
 			ns_arr = is_ok_to_run_STF(policy, sinfo, qinfo, njob, flags, err, shrink_job_algorithm);
-		} else
-			ns_arr = is_ok_to_run(policy, sinfo, qinfo, njob, flags, err);
+		} else {
+			schd_error *spec_err = NULL;
+
+			if (speculate) {
+				if (sb.gen != universe_gen || sb.errs.find(njob->rank) == sb.errs.end())
+					speculate_next_jobs(policy, sinfo, njob, universe_gen, sb);
+				auto it = sb.errs.find(njob->rank);
+				if (it != sb.errs.end())
+					spec_err = it->second;
+				/* a marked equivalence class answers for itself */
+				if (sinfo->equiv_classes != NULL && njob->ec_index != UNSPECIFIED &&
+				    sinfo->equiv_classes[njob->ec_index]->can_not_run)
+					spec_err = NULL;
+			}
+
+			if (spec_err != NULL) {
+				copy_schd_error(err, spec_err);
+				ns_arr = NULL;
+				sb.served++;
+			} else
+				ns_arr = is_ok_to_run(policy, sinfo, qinfo, njob, flags, err);
+		}
 
 		if (err->status_code == NEVER_RUN)
 			njob->can_never_run = 1;
 
 		if (ns_arr != NULL) { /* success! */
 			resource_resv *tj;
+
+			universe_gen++;
 			if (njob->job->is_array) {
 				tj = queue_subjob(njob, sinfo, qinfo);
 				if (tj == NULL) {
@@ -901,6 +1085,7 @@ main_sched_loop(status *policy, int sd, server_info *sinfo, schd_error **rerr)
 			if (rc != SCHD_ERROR) {
 				if(run_update_resresv(policy, sd, sinfo, qinfo, tj, ns_arr, RURR_ADD_END_EVENT, err) > 0 ) {
 					rc = SUCCESS;
+					prof_count(PROF_JOBS_RUN);
 					if (sinfo->has_soft_limit || qinfo->has_soft_limit)
 						sort_again = MUST_RESORT_JOBS;
 					else
@@ -916,8 +1101,11 @@ main_sched_loop(status *policy, int sd, server_info *sinfo, schd_error **rerr)
 				free_nspecs(ns_arr);
 		}
 		else if (policy->preempting && in_runnable_state(njob) && (!njob -> can_never_run)) {
+			universe_gen++;
+			prof_count(PROF_PREEMPT_ATTEMPTS);
 			if (find_and_preempt_jobs(policy, sd, njob, sinfo, err) > 0) {
 				rc = SUCCESS;
+				prof_count(PROF_JOBS_RUN);
 				sort_again = MUST_RESORT_JOBS;
 			}
 			else
@@ -949,6 +1137,9 @@ main_sched_loop(status *policy, int sd, server_info *sinfo, schd_error **rerr)
 #endif
 				auto cal_rc = add_job_to_calendar(sd, policy, sinfo, njob, should_use_buckets);
 
+				/* the calendar is read by the limit checks */
+				universe_gen++;
+
 				if (cal_rc > 0) { /* Success! */
 #ifdef NAS /* localmod 034 */
 					switch(bf_rc)
@@ -1033,6 +1224,9 @@ main_sched_loop(status *policy, int sd, server_info *sinfo, schd_error **rerr)
 				if (rc != RUN_FAILURE &&  !ec->can_not_run) {
 					ec->can_not_run = 1;
 					ec->err = dup_schd_error(err);
+					/* nothing had changed yet, so the failure holds in later cycles too */
+					if (eval_gen == 0 && !njob->is_shrink_to_fit)
+						ec_cache.remember(ec, njob->ec_index, err);
 				}
 			}
 		}
@@ -1103,6 +1297,11 @@ main_sched_loop(status *policy, int sd, server_info *sinfo, schd_error **rerr)
 
 	*rerr = err;
 
+	if (sb.served > 0)
+		log_eventf(PBSEVENT_DEBUG2, PBS_EVENTCLASS_SCHED, LOG_DEBUG, __func__,
+			"%d jobs were found unable to run by the parallel pre-checks", sb.served);
+	clear_spec_batch(sb);
+
 	free_schd_error(chk_lim_err);
 	return rc;
 }
@@ -1119,6 +1318,14 @@ main_sched_loop(status *policy, int sd, server_info *sinfo, schd_error **rerr)
 void
 end_cycle_tasks(server_info *sinfo)
 {
+	prof_phase prof(__func__);
+
+	/* send any run requests still waiting for a full run job list */
+	flush_run_jobs();
+
+	/* send the attribute updates collected during the cycle */
+	flush_attr_updates();
+
 	/* keep track of update used resources for fairshare */
 	if (sinfo != NULL && sinfo->policy->fair_share)
 		create_prev_job_info(sinfo->running_jobs);
@@ -1147,6 +1354,12 @@ end_cycle_tasks(server_info *sinfo)
 		cmp_aoename = NULL;
 	}
 
+	log_thread_stats();
+	log_pool_stats();
+	age_parse_caches();
+	prof_cycle_end();
+	capture_end();
+
 	log_event(PBSEVENT_DEBUG, PBS_EVENTCLASS_REQUEST, LOG_DEBUG,
 		"", "Leaving Scheduling Cycle");
 }
@@ -1196,7 +1409,7 @@ update_job_can_not_run(int pbs_sd, resource_resv *job, schd_error *err)
 				job->name, log_buf);
 
 		/* We won't be looking at this job in main_sched_loop()
-		 * and we just updated some attributes just above.  Send Now.
+		 * and we just updated some attributes just above.  Queue them now.
 		 */
 		send_job_updates(pbs_sd, job);
 	}
@@ -1365,6 +1578,7 @@ run_update_resresv(status *policy, int pbs_sd, server_info *sinfo,
 	queue_info *qinfo, resource_resv *resresv, nspec **ns_arr,
 	unsigned int flags, schd_error *err)
 {
+	prof_phase prof(__func__);
 	int ret = 0;				/* return code */
 	int pbsrc;				/* return codes from pbs IFL calls */
 
@@ -1649,6 +1863,7 @@ run_update_resresv(status *policy, int pbs_sd, server_info *sinfo,
 			/* update the job preempt status */
 			set_preempt_prio(resresv, qinfo, sinfo);
 		}
+		add_preempt_candidate(sinfo, rr);
 
 		/* update_preemption_priority() must be called post queue/server update */
 		update_preemption_priority(sinfo, rr);
@@ -1849,11 +2064,13 @@ int
 add_job_to_calendar(int pbs_sd, status *policy, server_info *sinfo,
 	resource_resv *topjob, int use_buckets)
 {
+	prof_phase prof(__func__);
 	server_info *nsinfo;		/* dup'd universe to simulate in */
 	resource_resv *njob;		/* the topjob in the dup'd universe */
 	resource_resv *bjob;		/* job pointer which becomes the topjob*/
 	resource_resv *tjob;		/* temporary job pointer for job arrays */
 	time_t start_time;		/* calculated start time of topjob */
+	bool est_unchanged;		/* server already has the estimates */
 
 	if (policy == NULL || sinfo == NULL ||
 		topjob == NULL || topjob->job == NULL)
@@ -1863,11 +2080,10 @@ add_job_to_calendar(int pbs_sd, status *policy, server_info *sinfo,
 		/* if the job is in the calendar, then there is nothing to do
 		 * Note: We only ever look from now into the future
 		 */
-		auto nexte = get_next_event(sinfo->calendar);
-		if (find_timed_event(nexte, topjob->name, IGNORE_DISABLED_EVENTS, TIMED_NOEVENT, 0) != NULL)
+		if (exists_resresv_event(sinfo->calendar, topjob))
 			return 1;
 	}
-	if ((nsinfo = dup_server_info(sinfo)) == NULL)
+	if ((nsinfo = snapshot_server_info(sinfo, topjob)) == NULL)
 		return 0;
 
 	if ((njob = find_resource_resv_by_indrank(nsinfo->jobs, topjob->resresv_ind, topjob->rank)) == NULL) {
@@ -1955,6 +2171,12 @@ add_job_to_calendar(int pbs_sd, status *policy, server_info *sinfo,
 		}
 
 
+		/* the server already has these estimates, don't send them again.
+		 * Subjobs are estimated on their parent array, so always update those.
+		 */
+		est_unchanged = !bjob->job->is_subjob && bjob->job->est_start_time == start_time &&
+			bjob->job->est_execvnode != NULL && strcmp(bjob->job->est_execvnode, exec) == 0;
+
 		if (bjob->job->est_execvnode != NULL)
 			free(bjob->job->est_execvnode);
 		bjob->job->est_execvnode = string_dup(exec);
@@ -1976,7 +2198,7 @@ add_job_to_calendar(int pbs_sd, status *policy, server_info *sinfo,
 		}
 		add_event(sinfo->calendar, te_end);
 
-		if (update_estimated_attrs(pbs_sd, bjob, bjob->job->est_start_time,
+		if (!est_unchanged && update_estimated_attrs(pbs_sd, bjob, bjob->job->est_start_time,
 			bjob->job->est_execvnode, 0) <0) {
 			log_event(PBSEVENT_SCHED, PBS_EVENTCLASS_SCHED, LOG_WARNING,
 				bjob->name, "Failed to update estimated attrs.");
@@ -2206,11 +2428,14 @@ next_job(status *policy, server_info *sinfo, int flag)
 			skip |= SKIP_RESERVATIONS;
 	}
 
-	if ((sort_status != SORTED) || ((flag == MAY_RESORT_JOBS) && policy->fair_share)
-		|| (flag == MUST_RESORT_JOBS)) {
+	if ((sort_status != SORTED) || (flag == MUST_RESORT_JOBS)) {
 		sort_jobs(policy, sinfo);
 		sort_status = SORTED;
 		last_job_index = 0;
+	} else if ((flag == MAY_RESORT_JOBS) && policy->fair_share) {
+		/* only the jobs whose fairshare usage changed need to move */
+		resort_jobs(policy, sinfo);
+		last_job_index = 0;
 	}
 	if (policy->round_robin) {
 		/* Below is a pictorial representation of how queue_list
@@ -0,0 +1,816 @@
+/*
+ * Copyright (C) 1994-2021 Altair Engineering, Inc.
+ * For more information, contact Altair at www.altair.com.
+ *
+ * This file is part of both the OpenPBS software ("OpenPBS")
+ * and the PBS Professional ("PBS Pro") software.
+ *
+ * Open Source License Information:
+ *
+ * OpenPBS is free software. You can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Commercial License Information:
+ *
+ * PBS Pro is commercially licensed software that shares a common core with
+ * the OpenPBS software.  For a copy of the commercial license terms and
+ * conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+ * Altair Legal Department.
+ *
+ * Altair's dual-license business model allows companies, individuals, and
+ * organizations to create proprietary derivative works of OpenPBS and
+ * distribute them - whether embedded or bundled with other software -
+ * under a commercial license agreement.
+ *
+ * Use of Altair's trademarks, including but not limited to "PBS™",
+ * "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+ * subject to Altair's trademark licensing policies.
+ */
+
+/**
+ * @file    formula.cpp
+ *
+ * @brief
+ * 		formula.cpp - compiles math formulas (job_sort_formula and the
+ *		fairshare_entity formula) into expression trees over the job's
+ *		resources and the formula keywords, so they can be evaluated
+ *		without the python interpreter.  Python expressions the compiler
+ *		does not understand are left to formula_evaluate()'s python path.
+ *
+ * Functions included are:
+ * 	find_compiled_formula()
+ * 	compiled_formula_evaluate()
+ * 	formula_evaluate_jobs()
+ * 	clear_compiled_formulas()
+ */
+#include <pbs_config.h>
+
+#include <ctype.h>
+#include <math.h>
+#include <string.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <log.h>
+#include <pbs_share.h>
+#include "formula.h"
+#include "data_types.h"
+#include "globals.h"
+#include "job_info.h"
+#include "misc.h"
+#include "multi_threading.h"
+#include "resource.h"
+#include "resource_resv.h"
+#include "constant.h"
+
+
+/* what a node of a compiled formula does */
+enum formula_op {
+	FOP_NUM,		/* constant */
+	FOP_RES,		/* amount of a consumable resource */
+	FOP_ELIGIBLE_TIME,
+	FOP_QUEUE_PRIO,
+	FOP_JOB_PRIO,
+	FOP_FSPERC,
+	FOP_TREE_USAGE,
+	FOP_FSFACTOR,
+	FOP_ACCRUE_TYPE,
+	FOP_NEG,
+	FOP_POS,
+	FOP_NOT,
+	FOP_ADD,
+	FOP_SUB,
+	FOP_MUL,
+	FOP_DIV,
+	FOP_FLOORDIV,
+	FOP_MOD,
+	FOP_POW,
+	FOP_AND,
+	FOP_OR,
+	FOP_IFELSE,		/* kids: true value, condition, false value */
+	FOP_COMPARE,		/* kids: operands, cmps: the comparisons between them */
+	FOP_ABS,
+	FOP_MIN,
+	FOP_MAX,
+	FOP_INT,
+	FOP_FLOAT
+};
+
+enum formula_cmp {
+	FCMP_LT,
+	FCMP_LE,
+	FCMP_GT,
+	FCMP_GE,
+	FCMP_EQ,
+	FCMP_NE
+};
+
+struct formula_node
+{
+	formula_op op;
+	double num;			/* FOP_NUM */
+	resdef *def;			/* FOP_RES */
+	std::vector<int> kids;		/* indices of the operands */
+	std::vector<formula_cmp> cmps;	/* FOP_COMPARE */
+};
+
+/**
+ * @brief
+ * 		a formula compiled into an expression tree.  The nodes are kept in
+ *		one array, operands before the nodes which use them.
+ */
+struct compiled_formula
+{
+	std::vector<formula_node> nodes;
+	int root;
+};
+
+/**
+ * @brief
+ * 		compiles the subset of python expressions formulas are written in:
+ *		numbers, resource names, formula keywords, arithmetic, comparisons,
+ *		and/or/not, conditional expressions and the abs(), min(), max(),
+ *		pow(), int() and float() builtins.  The grammar follows python's
+ *		precedence rules.
+ */
+class formula_compiler
+{
+public:
+	formula_compiler(const char *formula, compiled_formula *cf) : failed(NULL), p(formula), out(cf) {}
+	bool compile();
+	const char *failed;	/* why the formula could not be compiled */
+
+private:
+	const char *p;
+	compiled_formula *out;
+
+	void skip_space() { while (isspace(*p)) p++; }
+	bool accept(const char *tok);
+	bool accept_word(const char *word);
+	int fail(const char *why) { if (failed == NULL) failed = why; return -1; }
+	int add(formula_op op, std::vector<int> kids);
+	int test();
+	int or_test();
+	int and_test();
+	int not_test();
+	int comparison();
+	int arith();
+	int term();
+	int factor();
+	int power();
+	int atom();
+	int name(const std::string &nm);
+	int call(const std::string &nm);
+};
+
+/**
+ * @brief	consume an operator token if it is next
+ *
+ * @param[in]	tok	-	the operator
+ *
+ * @return	bool
+ */
+bool
+formula_compiler::accept(const char *tok)
+{
+	size_t len = strlen(tok);
+
+	skip_space();
+	if (strncmp(p, tok, len) != 0)
+		return false;
+	/* don't take the start of a longer operator (e.g., '*' of '**') */
+	if (len == 1 && (*tok == '*' || *tok == '/') && p[1] == *tok)
+		return false;
+	if (len == 1 && (*tok == '<' || *tok == '>') && p[1] == '=')
+		return false;
+	p += len;
+	return true;
+}
+
+/**
+ * @brief	consume a python keyword if it is next
+ *
+ * @param[in]	word	-	the keyword
+ *
+ * @return	bool
+ */
+bool
+formula_compiler::accept_word(const char *word)
+{
+	size_t len = strlen(word);
+
+	skip_space();
+	if (strncmp(p, word, len) != 0 || isalnum(p[len]) || p[len] == '_')
+		return false;
+	p += len;
+	return true;
+}
+
+/**
+ * @brief	add a node to the compiled formula
+ *
+ * @return	index of the node or -1 if an operand failed to compile
+ */
+int
+formula_compiler::add(formula_op op, std::vector<int> kids)
+{
+	formula_node n;
+
+	for (auto k : kids)
+		if (k < 0)
+			return -1;
+	n.op = op;
+	n.num = 0;
+	n.def = NULL;
+	n.kids.swap(kids);
+	out->nodes.push_back(n);
+	return out->nodes.size() - 1;
+}
+
+/**
+ * @brief	compile the whole formula
+ *
+ * @return	bool
+ * @retval	true	: compiled
+ * @retval	false	: not compiled, failed says why
+ */
+bool
+formula_compiler::compile()
+{
+	out->nodes.clear();
+	out->root = test();
+	skip_space();
+	if (out->root >= 0 && *p != '\0')
+		fail("unexpected text after the expression");
+	return failed == NULL;
+}
+
+/* test: or_test ['if' or_test 'else' test] */
+int
+formula_compiler::test()
+{
+	int val = or_test();
+
+	if (accept_word("if")) {
+		int cond = or_test();
+		if (!accept_word("else"))
+			return fail("conditional expression without else");
+		return add(FOP_IFELSE, {val, cond, test()});
+	}
+	return val;
+}
+
+/* or_test: and_test ('or' and_test)* */
+int
+formula_compiler::or_test()
+{
+	int val = and_test();
+
+	while (accept_word("or"))
+		val = add(FOP_OR, {val, and_test()});
+	return val;
+}
+
+/* and_test: not_test ('and' not_test)* */
+int
+formula_compiler::and_test()
+{
+	int val = not_test();
+
+	while (accept_word("and"))
+		val = add(FOP_AND, {val, not_test()});
+	return val;
+}
+
+/* not_test: 'not' not_test | comparison */
+int
+formula_compiler::not_test()
+{
+	if (accept_word("not"))
+		return add(FOP_NOT, {not_test()});
+	return comparison();
+}
+
+/* comparison: arith (compop arith)*  -- chained like python: a < b < c */
+int
+formula_compiler::comparison()
+{
+	static const struct {
+		const char *tok;
+		formula_cmp cmp;
+	} ops[] = {
+		{"<=", FCMP_LE}, {">=", FCMP_GE}, {"==", FCMP_EQ}, {"!=", FCMP_NE},
+		{"<", FCMP_LT}, {">", FCMP_GT}
+	};
+	std::vector<int> kids;
+	std::vector<formula_cmp> cmps;
+
+	kids.push_back(arith());
+	for (;;) {
+		bool found = false;
+		for (const auto &o : ops) {
+			if (accept(o.tok)) {
+				cmps.push_back(o.cmp);
+				kids.push_back(arith());
+				found = true;
+				break;
+			}
+		}
+		if (!found)
+			break;
+	}
+	if (cmps.empty())
+		return kids[0];
+
+	int n = add(FOP_COMPARE, kids);
+	if (n >= 0)
+		out->nodes[n].cmps.swap(cmps);
+	return n;
+}
+
+/* arith: term (('+'|'-') term)* */
+int
+formula_compiler::arith()
+{
+	int val = term();
+
+	for (;;) {
+		if (accept("+"))
+			val = add(FOP_ADD, {val, term()});
+		else if (accept("-"))
+			val = add(FOP_SUB, {val, term()});
+		else
+			return val;
+	}
+}
+
+/* term: factor (('*'|'/'|'//'|'%') factor)* */
+int
+formula_compiler::term()
+{
+	int val = factor();
+
+	for (;;) {
+		if (accept("*"))
+			val = add(FOP_MUL, {val, factor()});
+		else if (accept("//"))
+			val = add(FOP_FLOORDIV, {val, factor()});
+		else if (accept("/"))
+			val = add(FOP_DIV, {val, factor()});
+		else if (accept("%"))
+			val = add(FOP_MOD, {val, factor()});
+		else
+			return val;
+	}
+}
+
+/* factor: ('+'|'-') factor | power */
+int
+formula_compiler::factor()
+{
+	if (accept("-"))
+		return add(FOP_NEG, {factor()});
+	if (accept("+"))
+		return add(FOP_POS, {factor()});
+	return power();
+}
+
+/* power: atom ['**' factor] */
+int
+formula_compiler::power()
+{
+	int val = atom();
+
+	if (accept("**"))
+		return add(FOP_POW, {val, factor()});
+	return val;
+}
+
+/* atom: NUMBER | NAME | NAME '(' args ')' | '(' test ')' */
+int
+formula_compiler::atom()
+{
+	skip_space();
+	if (accept("(")) {
+		int val = test();
+		if (!accept(")"))
+			return fail("missing ')'");
+		return val;
+	}
+	if (isdigit(*p) || (*p == '.' && isdigit(p[1]))) {
+		char *endp;
+		double num;
+
+		/* python forbids leading zeros and has its own hex/octal/binary syntax */
+		if (*p == '0' && (isdigit(p[1]) || isalpha(p[1])))
+			return fail("unsupported number");
+		num = strtod(p, &endp);
+		if (endp == p || isalpha(*endp) || *endp == '_' || *endp == '.')
+			return fail("unsupported number");
+		p = endp;
+		int n = add(FOP_NUM, {});
+		out->nodes[n].num = num;
+		return n;
+	}
+	if (isalpha(*p) || *p == '_') {
+		const char *start = p;
+		while (isalnum(*p) || *p == '_')
+			p++;
+		std::string nm(start, p - start);
+		if (accept("("))
+			return call(nm);
+		return name(nm);
+	}
+	return fail("unsupported syntax");
+}
+
+/**
+ * @brief	compile a name: a formula keyword or a consumable resource
+ *
+ * @param[in]	nm	-	the name
+ *
+ * @return	index of the node
+ */
+int
+formula_compiler::name(const std::string &nm)
+{
+	static const struct {
+		const char *kw;
+		formula_op op;
+	} kws[] = {
+		{FORMULA_ELIGIBLE_TIME, FOP_ELIGIBLE_TIME},
+		{FORMULA_QUEUE_PRIO, FOP_QUEUE_PRIO},
+		{FORMULA_JOB_PRIO, FOP_JOB_PRIO},
+		{FORMULA_FSPERC, FOP_FSPERC},
+		{FORMULA_FSPERC_DEP, FOP_FSPERC},
+		{FORMULA_TREE_USAGE, FOP_TREE_USAGE},
+		{FORMULA_FSFACTOR, FOP_FSFACTOR},
+		{FORMULA_ACCRUE_TYPE, FOP_ACCRUE_TYPE}
+	};
+	int n;
+
+	/* keywords win over resources of the same name, like in the python dict */
+	for (const auto &k : kws)
+		if (nm == k.kw)
+			return add(k.op, {});
+
+	if (nm == "True" || nm == "False") {
+		n = add(FOP_NUM, {});
+		out->nodes[n].num = (nm == "True");
+		return n;
+	}
+
+	auto def = find_resdef(nm);
+	if (def == NULL || !def->type.is_consumable)
+		return fail("unknown name");
+
+	n = add(FOP_RES, {});
+	out->nodes[n].def = def;
+	return n;
+}
+
+/**
+ * @brief	compile a call to a python builtin
+ *
+ * @param[in]	nm	-	the function called.  The '(' has been consumed
+ *
+ * @return	index of the node
+ */
+int
+formula_compiler::call(const std::string &nm)
+{
+	std::vector<int> args;
+	formula_op op;
+	size_t min_args = 1;
+	size_t max_args = 1;
+
+	if (find_resdef(nm) != NULL)
+		return fail("call of a resource");
+
+	if (nm == "abs")
+		op = FOP_ABS;
+	else if (nm == "int")
+		op = FOP_INT;
+	else if (nm == "float")
+		op = FOP_FLOAT;
+	else if (nm == "pow") {
+		op = FOP_POW;
+		min_args = max_args = 2;
+	} else if (nm == "min" || nm == "max") {
+		op = (nm == "min") ? FOP_MIN : FOP_MAX;
+		min_args = 2;
+		max_args = SIZE_MAX;
+	} else
+		return fail("unsupported function");
+
+	if (!accept(")")) {
+		do {
+			args.push_back(test());
+		} while (accept(","));
+		if (!accept(")"))
+			return fail("missing ')'");
+	}
+	if (args.size() < min_args || args.size() > max_args)
+		return fail("unsupported number of arguments");
+
+	return add(op, args);
+}
+
+/**
+ * @brief	floor division and modulo with python's sign rules
+ */
+static inline double
+py_mod(double a, double b)
+{
+	double m = fmod(a, b);
+
+	if (m != 0 && ((m < 0) != (b < 0)))
+		m += b;
+	return m;
+}
+
+/**
+ * @brief
+ * 		evaluate a node of a compiled formula
+ *
+ * @param[in]	cf	-	the compiled formula
+ * @param[in]	ind	-	index of the node
+ * @param[in]	resresv	-	job for the formula keywords
+ * @param[in]	resreq	-	resources to use
+ * @param[out]	errmsg	-	set on error like python's exception message
+ *
+ * @return	value of the node.  Undefined if errmsg was set
+ */
+static double
+eval_node(const compiled_formula *cf, int ind, resource_resv *resresv, resource_req *resreq, const char **errmsg)
+{
+	const formula_node &n = cf->nodes[ind];
+	const group_info *ginfo = resresv->job->ginfo;
+	double a;
+	double b;
+
+	switch (n.op) {
+		case FOP_NUM:
+			return n.num;
+		case FOP_RES: {
+			auto req = find_resource_req(resreq, n.def);
+			return (req != NULL) ? req->amount : 0;
+		}
+		case FOP_ELIGIBLE_TIME:
+			return resresv->job->eligible_time;
+		case FOP_QUEUE_PRIO:
+			return resresv->job->queue->priority;
+		case FOP_JOB_PRIO:
+			return resresv->job->priority;
+		case FOP_FSPERC:
+			return (ginfo != NULL) ? ginfo->tree_percentage : 0;
+		case FOP_TREE_USAGE:
+			return (ginfo != NULL) ? ginfo->usage_factor : 0;
+		case FOP_FSFACTOR:
+			if (ginfo == NULL || ginfo->tree_percentage == 0)
+				return 0;
+			return pow(2, -(ginfo->usage_factor / ginfo->tree_percentage));
+		case FOP_ACCRUE_TYPE:
+			return resresv->job->accrue_type;
+		case FOP_AND:
+			a = eval_node(cf, n.kids[0], resresv, resreq, errmsg);
+			return (a == 0) ? a : eval_node(cf, n.kids[1], resresv, resreq, errmsg);
+		case FOP_OR:
+			a = eval_node(cf, n.kids[0], resresv, resreq, errmsg);
+			return (a != 0) ? a : eval_node(cf, n.kids[1], resresv, resreq, errmsg);
+		case FOP_IFELSE:
+			if (eval_node(cf, n.kids[1], resresv, resreq, errmsg) != 0)
+				return eval_node(cf, n.kids[0], resresv, resreq, errmsg);
+			return eval_node(cf, n.kids[2], resresv, resreq, errmsg);
+		case FOP_COMPARE:
+			a = eval_node(cf, n.kids[0], resresv, resreq, errmsg);
+			for (size_t i = 0; i < n.cmps.size(); i++) {
+				bool res = false;
+				b = eval_node(cf, n.kids[i + 1], resresv, resreq, errmsg);
+				switch (n.cmps[i]) {
+					case FCMP_LT: res = a < b; break;
+					case FCMP_LE: res = a <= b; break;
+					case FCMP_GT: res = a > b; break;
+					case FCMP_GE: res = a >= b; break;
+					case FCMP_EQ: res = a == b; break;
+					case FCMP_NE: res = a != b; break;
+				}
+				if (!res)
+					return 0;
+				a = b;
+			}
+			return 1;
+		case FOP_MIN:
+		case FOP_MAX:
+			a = eval_node(cf, n.kids[0], resresv, resreq, errmsg);
+			for (size_t i = 1; i < n.kids.size(); i++) {
+				b = eval_node(cf, n.kids[i], resresv, resreq, errmsg);
+				if (n.op == FOP_MIN ? b < a : b > a)
+					a = b;
+			}
+			return a;
+		default:
+			break;
+	}
+
+	a = eval_node(cf, n.kids[0], resresv, resreq, errmsg);
+	switch (n.op) {
+		case FOP_NEG:
+			return -a;
+		case FOP_POS:
+		case FOP_FLOAT:
+			return a;
+		case FOP_NOT:
+			return a == 0;
+		case FOP_ABS:
+			return fabs(a);
+		case FOP_INT:
+			return trunc(a);
+		default:
+			break;
+	}
+
+	b = eval_node(cf, n.kids[1], resresv, resreq, errmsg);
+	switch (n.op) {
+		case FOP_ADD:
+			return a + b;
+		case FOP_SUB:
+			return a - b;
+		case FOP_MUL:
+			return a * b;
+		case FOP_DIV:
+		case FOP_FLOORDIV:
+		case FOP_MOD:
+			if (b == 0) {
+				*errmsg = "division by zero";
+				return 0;
+			}
+			if (n.op == FOP_DIV)
+				return a / b;
+			if (n.op == FOP_MOD)
+				return py_mod(a, b);
+			return floor(a / b);
+		case FOP_POW:
+			if (a == 0 && b < 0) {
+				*errmsg = "0.0 cannot be raised to a negative power";
+				return 0;
+			}
+			return pow(a, b);
+		default:
+			break;
+	}
+	*errmsg = "unknown formula operation";
+	return 0;
+}
+
+/**
+ * @brief
+ * 		evaluate a compiled formula for a job
+ *
+ * @param[in]	cf	-	the compiled formula
+ * @param[in]	resresv	-	job for the formula keywords
+ * @param[in]	resreq	-	resources to use when evaluating
+ * @param[out]	ans	-	the answer, 0 on error
+ * @param[out]	errmsg	-	what went wrong on error
+ *
+ * @return	bool
+ * @retval	true	: evaluated
+ * @retval	false	: error, like a python exception
+ */
+bool
+compiled_formula_evaluate(const compiled_formula *cf, resource_resv *resresv,
+	resource_req *resreq, sch_resource_t *ans, const char **errmsg)
+{
+	const char *err = NULL;
+	double val;
+
+	*ans = 0;
+	*errmsg = NULL;
+	if (cf == NULL || resresv == NULL || resresv->job == NULL)
+		return true;
+
+	val = eval_node(cf, cf->root, resresv, resreq, &err);
+	if (err == NULL && !std::isfinite(val))
+		err = "math range error";
+	if (err != NULL) {
+		*errmsg = err;
+		return false;
+	}
+	*ans = val;
+	return true;
+}
+
+/* formulas compiled so far.  NULL if the formula needs python */
+static std::unordered_map<std::string, std::unique_ptr<compiled_formula>> compiled_formulas;
+static std::mutex compiled_formulas_lock;
+
+/**
+ * @brief
+ * 		compile a formula or find it in the already compiled formulas.
+ *		A formula is compiled once and used until the resource
+ *		definitions change.
+ *
+ * @param[in]	formula	-	the formula
+ *
+ * @return	the compiled formula
+ * @retval	NULL	: the formula has to be evaluated by python
+ */
+const compiled_formula *
+find_compiled_formula(const char *formula)
+{
+	if (formula == NULL)
+		return NULL;
+
+	std::lock_guard<std::mutex> lock(compiled_formulas_lock);
+
+	auto f = compiled_formulas.find(formula);
+	if (f != compiled_formulas.end())
+		return f->second.get();
+
+	std::unique_ptr<compiled_formula> cf(new compiled_formula);
+	formula_compiler fc(formula, cf.get());
+	if (!fc.compile()) {
+		log_eventf(PBSEVENT_DEBUG2, PBS_EVENTCLASS_SCHED, LOG_DEBUG, __func__,
+			"Formula will be evaluated by python (%s): %s", fc.failed, formula);
+		cf.reset();
+	}
+
+	auto ret = cf.get();
+	compiled_formulas[formula] = std::move(cf);
+	return ret;
+}
+
+/**
+ * @brief
+ * 		evaluate a formula for all the jobs of an array and set their
+ *		formula_value.  Compiled formulas are evaluated on the worker
+ *		threads.
+ *
+ * @param[in]	formula	-	the formula
+ * @param[in,out]	jobs	-	the jobs
+ *
+ * @return	void
+ */
+void
+formula_evaluate_jobs(const char *formula, resource_resv **jobs)
+{
+	const compiled_formula *cf;
+	int num_jobs;
+
+	if (formula == NULL || jobs == NULL)
+		return;
+
+	num_jobs = count_array(jobs);
+	cf = find_compiled_formula(formula);
+	if (cf == NULL) {
+		for (int i = 0; i < num_jobs; i++)
+			if (jobs[i]->job != NULL)
+				jobs[i]->job->formula_value = formula_evaluate(formula, jobs[i], jobs[i]->resreq);
+		return;
+	}
+
+	std::vector<const char *> errs(num_jobs, NULL);
+	parallel_for(__func__, num_jobs, MT_CHUNK_SIZE_MIN, [&](int sidx, int eidx) {
+		for (int i = sidx; i <= eidx; i++) {
+			auto r = jobs[i];
+			sch_resource_t ans;
+
+			if (r->job == NULL)
+				continue;
+			compiled_formula_evaluate(cf, r, r->resreq, &ans, &errs[i]);
+			r->job->formula_value = ans;
+		}
+		return 0;
+	});
+
+	for (int i = 0; i < num_jobs; i++)
+		if (errs[i] != NULL)
+			log_eventf(PBSEVENT_DEBUG2, PBS_EVENTCLASS_JOB, LOG_DEBUG, jobs[i]->name,
+				"Formula evaluation for job had an error.  Zero value will be used: %s", errs[i]);
+}
+
+/**
+ * @brief
+ * 		forget the compiled formulas.  They point at resource definitions.
+ *
+ * @return	void
+ */
+void
+clear_compiled_formulas(void)
+{
+	std::lock_guard<std::mutex> lock(compiled_formulas_lock);
+
+	compiled_formulas.clear();
+}
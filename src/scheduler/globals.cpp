@@ -154,7 +154,6 @@ pthread_mutex_t work_lock;
 pthread_mutex_t result_lock;
 pthread_cond_t work_cond;
 pthread_cond_t result_cond;
-ds_queue *work_queue = NULL;
 ds_queue *result_queue = NULL;
 pthread_t *threads = NULL;
 int threads_die = 0;
@@ -50,6 +50,7 @@
  * 	free_job_info()
  * 	set_job_state()
  * 	update_job_attr()
+ * 	merge_attr_updates()
  * 	send_job_updates()
  * 	send_attr_updates()
  * 	unset_job_attr()
@@ -106,6 +107,7 @@
 #include <pbs_error.h>
 #include "queue_info.h"
 #include "job_info.h"
+#include "formula.h"
 #include "resv_info.h"
 #include "constant.h"
 #include "misc.h"
@@ -124,6 +126,9 @@
 #include "server_info.h"
 #include "attribute.h"
 #include "multi_threading.h"
+#include "job_status_cache.h"
+#include "cycle_profile.h"
+#include "preempt_index.h"
 #include "libpbs.h"
 
 #ifdef NAS
@@ -596,6 +601,12 @@ query_jobs_chunk(th_data_query_jinfo *data)
 		}
 
 		resresv->job->queue = qinfo;
+
+		/* eligible_time is computed by the server when the job is queried.
+		 * Status out of the job status cache is older than this cycle.
+		 */
+		if (sinfo->eligible_time_enable && resresv->job->accrue_type == JOB_ELIGIBLE)
+			resresv->job->eligible_time += jstat_cache.status_age(qinfo->name, resresv->name, server_time);
 #ifdef NAS /* localmod 040 */
 		/* we modify nodect to be the same value for all jobs in queues that are
 		 * configured to ignore nodect key sorting, for two reasons:
@@ -896,6 +907,7 @@ alloc_tdata_jquery(status *policy, int pbs_sd, struct batch_status *jobs, queue_
 resource_resv **
 query_jobs(status *policy, int pbs_sd, queue_info *qinfo, resource_resv **pjobs, const std::string& queue_name)
 {
+	prof_phase prof(__func__);
 	/* pbs_selstat() takes a linked list of attropl structs which tell it
 	 * what information about what jobs to return.  We want all jobs which are
 	 * in a specified queue
@@ -920,6 +932,9 @@ query_jobs(status *policy, int pbs_sd, queue_info *qinfo, resource_resv **pjobs,
 	int num_prev_jobs;
 	int num_new_jobs;
 
+	/* true if jobs is owned by the job status cache */
+	bool cached = false;
+
 	/* for multi-threading */
 	int jidx;
 	th_data_query_jinfo *tdata = NULL;
@@ -973,6 +988,7 @@ query_jobs(status *policy, int pbs_sd, queue_info *qinfo, resource_resv **pjobs,
 			ATTR_A,
 			ATTR_max_run_subjobs,
 			ATTR_server_inst_id,
+			ATTR_mtime,
 			NULL};
 
 		for (int i = 0; jobattrs[i] != NULL; i++) {
@@ -986,8 +1002,14 @@ query_jobs(status *policy, int pbs_sd, queue_info *qinfo, resource_resv **pjobs,
 		}
 	}
 
-	/* get jobs from PBS server */
-	if ((jobs = send_selstat(pbs_sd, &opl, attrib, const_cast<char *>("S"))) == NULL) {
+	/* get jobs from PBS server.  Jobs of local queues come from the job
+	 * status cache, which only queries what changed since the last cycle.
+	 */
+	if (qinfo->is_peer_queue)
+		jobs = send_selstat(pbs_sd, &opl, attrib, const_cast<char *>("S"));
+	else
+		jobs = jstat_cache.get_queue_jobs(pbs_sd, queue_name, attrib, &cached);
+	if (jobs == NULL) {
 		if (pbs_errno > 0) {
 			const char *errmsg = pbs_geterrmsg(pbs_sd);
 			if (errmsg == NULL)
@@ -1016,25 +1038,28 @@ query_jobs(status *policy, int pbs_sd, queue_info *qinfo, resource_resv **pjobs,
 
 	if (resresv_arr == NULL) {
 		log_err(errno, __func__, MEM_ERR_MSG);
-		pbs_statfree(jobs);
+		if (!cached)
+			pbs_statfree(jobs);
 		return NULL;
 	}
 	resresv_arr[num_prev_jobs] = NULL;
 
 	tid = *((int *) pthread_getspecific(th_id_key));
-	if (tid != 0 || num_threads <= 1) {
+	if (tid != 0 || num_threads <= 1 || inside_parallel_for()) {
 		/* don't use multi-threading if I am a worker thread or num_threads is 1 */
 		tdata = alloc_tdata_jquery(policy, pbs_sd, jobs, qinfo, 0, num_new_jobs - 1);
 		if (tdata == NULL) {
 			free_resource_resv_array(resresv_arr);
-			pbs_statfree(jobs);
+			if (!cached)
+				pbs_statfree(jobs);
 			return NULL;
 		}
 		query_jobs_chunk(tdata);
 
 		if (tdata->error || tdata->oarr == NULL) {
 			free_resource_resv_array(resresv_arr);
-			pbs_statfree(jobs);
+			if (!cached)
+				pbs_statfree(jobs);
 			free(tdata->oarr);
 			free(tdata);
 			return NULL;
@@ -1048,12 +1073,10 @@ query_jobs(status *policy, int pbs_sd, queue_info *qinfo, resource_resv **pjobs,
 		free(tdata);
 		resresv_arr[jidx] = NULL;
 	} else {
-		int chunk_size = num_new_jobs / num_threads;
+		int chunk_size = mt_chunk_size(num_new_jobs, MT_CHUNK_SIZE_MIN);
 		int th_err = 0;
 		int num_tasks = 0;
 
-		chunk_size = (chunk_size > MT_CHUNK_SIZE_MIN) ? chunk_size : MT_CHUNK_SIZE_MIN;
-		chunk_size = (chunk_size < MT_CHUNK_SIZE_MAX) ? chunk_size : MT_CHUNK_SIZE_MAX;
 		for (int j = 0; num_new_jobs > 0;
 				num_tasks++, j += chunk_size, num_new_jobs -= chunk_size) {
 			tdata = alloc_tdata_jquery(policy, pbs_sd, jobs, qinfo, j, j + chunk_size - 1);
@@ -1072,10 +1095,7 @@ query_jobs(status *policy, int pbs_sd, queue_info *qinfo, resource_resv **pjobs,
 			task->task_type = TS_QUERY_JOB_INFO;
 			task->thread_data = (void*) tdata;
 
-			pthread_mutex_lock(&work_lock);
-			ds_enqueue(work_queue, (void*) task);
-			pthread_cond_signal(&work_cond);
-			pthread_mutex_unlock(&work_lock);
+			queue_work_for_threads(task);
 		}
 		jinfo_arrs_tasks = static_cast<resource_resv ***>(malloc(num_tasks * sizeof(resource_resv**)));
 		if (jinfo_arrs_tasks == NULL) {
@@ -1100,7 +1120,8 @@ query_jobs(status *policy, int pbs_sd, queue_info *qinfo, resource_resv **pjobs,
 			pthread_mutex_unlock(&result_lock);
 		}
 		if (th_err) {
-			pbs_statfree(jobs);
+			if (!cached)
+				pbs_statfree(jobs);
 			free_resource_resv_array(resresv_arr);
 			free(jinfo_arrs_tasks);
 			return NULL;
@@ -1119,7 +1140,8 @@ query_jobs(status *policy, int pbs_sd, queue_info *qinfo, resource_resv **pjobs,
 		free(jinfo_arrs_tasks);
 	}
 
-	pbs_statfree(jobs);
+	if (!cached)
+		pbs_statfree(jobs);
 
 	return resresv_arr;
 }
@@ -1265,11 +1287,11 @@ query_job(struct batch_status *job, server_info *sinfo, schd_error *err)
 		else if (!strcmp(attrp->name, ATTR_released)) /* resources_released */
 			resresv->job->resreleased = parse_execvnode(attrp->value, sinfo, NULL);
 		else if (!strcmp(attrp->name, ATTR_euser))	/* account name */
-			resresv->user = string_dup(attrp->value);
+			resresv->user = intern_name(attrp->value);
 		else if (!strcmp(attrp->name, ATTR_egroup))	/* group name */
-			resresv->group = string_dup(attrp->value);
+			resresv->group = intern_name(attrp->value);
 		else if (!strcmp(attrp->name, ATTR_project))	/* project name */
-			resresv->project = string_dup(attrp->value);
+			resresv->project = intern_name(attrp->value);
 		else if (!strcmp(attrp->name, ATTR_resv_ID))	/* reserve_ID */
 			resresv->job->resv_id = string_dup(attrp->value);
 		else if (!strcmp(attrp->name, ATTR_altid))    /* vendor ID */
@@ -1383,7 +1405,7 @@ query_job(struct batch_status *job, server_info *sinfo, schd_error *err)
 				resresv->job->est_start_time =
 					(time_t) res_to_num(attrp->value, NULL);
 			}
-			else if (!strcmp(attrp->resource, "execvnode"))
+			else if (!strcmp(attrp->resource, "exec_vnode"))
 				resresv->job->est_execvnode = string_dup(attrp->value);
 		}
 		else if (!strcmp(attrp->name, ATTR_c)) { /* checkpoint allowed? */
@@ -1686,7 +1708,6 @@ update_job_attr(int pbs_sd, resource_resv *resresv, const char *attr_name,
 {
 	struct attrl *pattr = NULL;
 	struct attrl *pattr2 = NULL;
-	struct attrl *end;
 
 	if (resresv == NULL  ||
 		(attr_name == NULL && attr_value == NULL && extra == NULL))
@@ -1713,7 +1734,7 @@ update_job_attr(int pbs_sd, resource_resv *resresv, const char *attr_name,
 		return -1;
 
 	if (attr_name == NULL && attr_value == NULL) {
-		end = pattr = dup_attrl_list(extra);
+		pattr = dup_attrl_list(extra);
 		if(pattr == NULL)
 			return -1;
 	} else {
@@ -1740,7 +1761,6 @@ update_job_attr(int pbs_sd, resource_resv *resresv, const char *attr_name,
 		pattr->name = string_dup(attr_name);
 		pattr->value = string_dup(attr_value);
 		pattr->resource = string_dup(attr_resc);
-		end = pattr;
 		if (extra != NULL) {
 			pattr2 = dup_attrl_list(extra);
 			if (pattr2 == NULL) {
@@ -1748,16 +1768,12 @@ update_job_attr(int pbs_sd, resource_resv *resresv, const char *attr_name,
 				return -1;
 			}
 			pattr->next = pattr2;
-			/* extra may have been a list, let's find the end */
-			for (end = pattr2; end->next != NULL; end = end ->next)
-				;
 		}
 	}
 
-	if(flags & UPDATE_LATER) {
-		end->next = resresv->job->attr_updates;
-		resresv->job->attr_updates = pattr;
-	}
+	/* an attribute set again later in the cycle replaces its pending value */
+	if(flags & UPDATE_LATER)
+		resresv->job->attr_updates = merge_attr_updates(pattr, resresv->job->attr_updates);
 
 	if (pattr != NULL && (flags & UPDATE_NOW)) {
 		int rc;
@@ -1769,19 +1785,81 @@ update_job_attr(int pbs_sd, resource_resv *resresv, const char *attr_name,
 	return 0;
 }
 
+/**
+ * @brief	Check whether two attrl entries name the same attribute
+ *
+ * @param[in]	a	-	first attribute
+ * @param[in]	b	-	second attribute
+ *
+ * @return	int
+ * @retval	1	: same attribute and resource
+ * @retval	0	: different
+ */
+static int
+same_attrl(const struct attrl *a, const struct attrl *b)
+{
+	const char *ares = a->resource != NULL ? a->resource : "";
+	const char *bres = b->resource != NULL ? b->resource : "";
+
+	return strcmp(a->name, b->name) == 0 && strcmp(ares, bres) == 0;
+}
+
 /**
  * @brief
- * 		send delayed job attribute updates for job using send_attr_updates().
+ * 		merge two lists of pending attribute updates for the same job.
+ *		Entries of the older list which are set again by the newer list
+ *		are dropped so each attribute is only sent once, with its last value.
+ *
+ * @param[in]	newer	-	most recent updates (consumed)
+ * @param[in]	older	-	updates queued before (consumed)
+ *
+ * @return	struct attrl *
+ * @retval	the merged list
+ */
+struct attrl *
+merge_attr_updates(struct attrl *newer, struct attrl *older)
+{
+	struct attrl *end;
+	struct attrl *a;
+	struct attrl *b;
+	struct attrl *next;
+
+	if (newer == NULL)
+		return older;
+
+	for (end = newer; end->next != NULL; end = end->next)
+		;
+
+	for (a = older; a != NULL; a = next) {
+		next = a->next;
+		a->next = NULL;
+		for (b = newer; b != NULL && !same_attrl(a, b); b = b->next)
+			;
+		if (b != NULL)
+			free_attrl(a);
+		else {
+			end->next = a;
+			end = a;
+		}
+	}
+
+	return newer;
+}
+
+/**
+ * @brief
+ * 		queue delayed job attribute updates for job using queue_attr_updates().
  *
  * @par
- * 		The main reason to use this function over a direct send_attr_update()
- *      call is so that the job's attr_updates list gets free'd and NULL'd.
- *      We don't want to send the attr updates multiple times
+ * 		The main reason to use this function over a direct queue_attr_updates()
+ *      call is so that the job's attr_updates list gets handed off and NULL'd.
+ *      We don't want to send the attr updates multiple times.  The updates
+ *      are sent with the rest of the cycle's updates by flush_attr_updates().
  *
  * @param[in]	pbs_sd	-	server connection descriptor
  * @param[in]	job	-	job to send attributes to
  *
- * @return	int(ret val from send_attr_updates)
+ * @return	int(ret val from queue_attr_updates)
  * @retval	1	- success
  * @retval	0	- failure to update
  */
@@ -1805,9 +1883,7 @@ int send_job_updates(int pbs_sd, resource_resv *job)
 			return 0;
 	}
 
-	rc = send_attr_updates(pbs_sd, job, job->job->attr_updates);
-
-	free_attrl_list(job->job->attr_updates);
+	rc = queue_attr_updates(pbs_sd, job, job->job->attr_updates);
 	job->job->attr_updates = NULL;
 	return rc;
 }
@@ -2227,9 +2303,6 @@ free_resresv_set(resresv_set *rset) {
 		return;
 
 	free_schd_error(rset->err);
-	free(rset->user);
-	free(rset->group);
-	free(rset->project);
 	delete rset->select_spec;
 	free_place(rset->place_spec);
 	free_resource_req_list(rset->req);
@@ -2274,21 +2347,9 @@ dup_resresv_set(resresv_set *oset, server_info *nsinfo)
 		return NULL;
 	}
 
-	rset->user = string_dup(oset->user);
-	if (oset->user != NULL && rset->user == NULL) {
-		free_resresv_set(rset);
-		return NULL;
-	}
-	rset->group = string_dup(oset->group);
-	if (oset->group != NULL && rset->group == NULL) {
-		free_resresv_set(rset);
-		return NULL;
-	}
-	rset->project = string_dup(oset->project);
-	if (oset->project != NULL && rset->project == NULL) {
-		free_resresv_set(rset);
-		return NULL;
-	}
+	rset->user = oset->user;
+	rset->group = oset->group;
+	rset->project = oset->project;
 	rset->select_spec = new selspec(*oset->select_spec);
 	if (rset->select_spec == NULL) {
 		free_resresv_set(rset);
@@ -2516,11 +2577,11 @@ create_resresv_set_by_resresv(status *policy, server_info *sinfo, resource_resv
 	}
 
 	if (resresv_set_use_user(sinfo, rset->qinfo))
-		rset->user = string_dup(resresv->user);
+		rset->user = resresv->user;
 	if (resresv_set_use_grp(sinfo, rset->qinfo))
-		rset->group = string_dup(resresv->group);
+		rset->group = resresv->group;
 	if (resresv_set_use_proj(sinfo, rset->qinfo))
-		rset->project = string_dup(resresv->project);
+		rset->project = resresv->project;
 
 	rset->select_spec = new selspec(*resresv_set_which_selspec(resresv));
 	if (rset->select_spec == NULL) {
@@ -2556,7 +2617,7 @@ create_resresv_set_by_resresv(status *policy, server_info *sinfo, resource_resv
  * @retval -1 if not found or on error
  */
 int
-find_resresv_set(status *policy, resresv_set **rsets, char *user, char *group, char *project, selspec *sel, place *pl, resource_req *req, queue_info *qinfo)
+find_resresv_set(status *policy, resresv_set **rsets, const char *user, const char *group, const char *project, selspec *sel, place *pl, resource_req *req, queue_info *qinfo)
 {
 	int i;
 
@@ -2569,19 +2630,12 @@ find_resresv_set(status *policy, resresv_set **rsets, char *user, char *group, c
 		if ((qinfo != NULL && rsets[i]->qinfo != NULL) && qinfo->name != rsets[i]->qinfo->name)
 
 			continue;
-		if ((user != NULL && rsets[i]->user == NULL) || (user == NULL && rsets[i]->user != NULL))
-			continue;
-		if (user != NULL && cstrcmp(user, rsets[i]->user) != 0)
-			continue;
-
-		if ((group != NULL && rsets[i]->group == NULL) || (group == NULL && rsets[i]->group != NULL))
-			continue;
-		if (group != NULL && cstrcmp(group, rsets[i]->group) != 0)
+		/* names are interned, so equal names are the same pointer */
+		if (user != rsets[i]->user)
 			continue;
-
-		if ((project != NULL && rsets[i]->project == NULL) || (project == NULL && rsets[i]->project != NULL))
+		if (group != rsets[i]->group)
 			continue;
-		if (project != NULL && cstrcmp(project, rsets[i]->project) != 0)
+		if (project != rsets[i]->project)
 			continue;
 
 		if (compare_selspec(rsets[i]->select_spec, sel) == 0)
@@ -2607,9 +2661,9 @@ find_resresv_set(status *policy, resresv_set **rsets, char *user, char *group, c
 int
 find_resresv_set_by_resresv(status *policy, resresv_set **rsets, resource_resv *resresv)
 {
-	char *user = NULL;
-	char *grp = NULL;
-	char *proj = NULL;
+	const char *user = NULL;
+	const char *grp = NULL;
+	const char *proj = NULL;
 	queue_info *qinfo = NULL;
 	selspec *sspec;
 
@@ -2643,6 +2697,7 @@ find_resresv_set_by_resresv(status *policy, resresv_set **rsets, resource_resv *
 resresv_set **
 create_resresv_sets(status *policy, server_info *sinfo)
 {
+	prof_phase prof(__func__);
 	int i;
 	int j = 0;
 	int len;
@@ -2946,6 +3001,7 @@ struct preempt_ordering *schd_get_preempt_order(resource_resv *resresv)
 int
 find_and_preempt_jobs(status *policy, int pbs_sd, resource_resv *hjob, server_info *sinfo, schd_error *err)
 {
+	prof_phase prof(__func__);
 
 	int i = 0;
 	int *jobs = NULL;
@@ -3270,6 +3326,15 @@ find_jobs_to_preempt(status *policy, resource_resv *hjob, server_info *sinfo, in
 		}
 	}
 
+	/* rule out jobs no amount of preemption can make room for before we
+	 * duplicate the universe to simulate it.  This is only a filter: the
+	 * jobs to preempt are still picked and checked by the simulation below.
+	 */
+	if (!can_fit_with_preemption(sinfo, hjob)) {
+		free_schd_error_list(full_err);
+		return NULL;
+	}
+
 	if ((pjobs = static_cast<resource_resv **>(malloc(sizeof(resource_resv *) * (sinfo->sc.running + 1)))) == NULL) {
 		log_err(errno, __func__, MEM_ERR_MSG);
 		free_schd_error_list(full_err);
@@ -3295,7 +3360,7 @@ find_jobs_to_preempt(status *policy, resource_resv *hjob, server_info *sinfo, in
 	}
 
 	/* use locally dup'd copy of sinfo so we don't modify the original */
-	if ((nsinfo = dup_server_info(sinfo)) == NULL) {
+	if ((nsinfo = snapshot_server_info(sinfo, hjob)) == NULL) {
 		free_schd_error_list(full_err);
 		free(pjobs);
 		free_string_array(preempt_targets_list);
@@ -3732,12 +3797,12 @@ select_index_to_preempt(status *policy, resource_resv *hjob,
 					clear_schd_error(err);
 					if (only_check_noncons) {
 						if (!policy->resdef_to_check_noncons.empty())
-							num_chunks_returned = check_avail_resources(node->res, hjob->select->chunks[k]->req,
+							num_chunks_returned = check_avail_resources(node, hjob->select->chunks[k]->req,
 											flags, policy->resdef_to_check_noncons, INSUFFICIENT_RESOURCE, err);
 						else
 							num_chunks_returned = SCHD_INFINITY;
 					} else
-						num_chunks_returned = check_avail_resources(node->res, hjob->select->chunks[k]->req,
+						num_chunks_returned = check_avail_resources(node, hjob->select->chunks[k]->req,
 								flags, INSUFFICIENT_RESOURCE, err);
 
 					if ( (num_chunks_returned > 0) || (num_chunks_returned == SCHD_INFINITY) ) {
@@ -4175,7 +4240,7 @@ queue_subjob(resource_resv *array, server_info *sinfo,
 /**
  * @brief
  * 		evaluate a math formula for jobs based on their resources
- *		NOTE: currently done through embedded python interpreter
+ *		through the embedded python interpreter
  *
  * @param[in]	formula	-	formula to evaluate
  * @param[in]	resresv	-	job for special case key words
@@ -4186,8 +4251,8 @@ queue_subjob(resource_resv *array, server_info *sinfo,
  */
 
 #ifdef PYTHON
-sch_resource_t
-formula_evaluate(const char *formula, resource_resv *resresv, resource_req *resreq)
+static sch_resource_t
+python_formula_evaluate(const char *formula, resource_resv *resresv, resource_req *resreq)
 {
 	char buf[1024];
 	char *globals;
@@ -4301,13 +4366,48 @@ formula_evaluate(const char *formula, resource_resv *resresv, resource_req *resr
 
 	return ans;
 }
-#else
+#endif
+
+/**
+ * @brief
+ * 		evaluate a math formula for jobs based on their resources.
+ *		The formula is compiled once and evaluated without python.
+ *		Formulas the compiler does not understand are evaluated through
+ *		the embedded python interpreter.
+ *
+ * @param[in]	formula	-	formula to evaluate
+ * @param[in]	resresv	-	job for special case key words
+ * @param[in]	resreq	-	resources to use when evaluating
+ *
+ * @return	evaluated formula answer or 0 on exception
+ *
+ */
 sch_resource_t
-formula_evaluate(char *formula, resource_resv *resresv, resource_req *resreq)
+formula_evaluate(const char *formula, resource_resv *resresv, resource_req *resreq)
 {
-	return 0;
-}
+	const compiled_formula *cf;
+	sch_resource_t ans = 0;
+	const char *errmsg;
+
+	if (formula == NULL || resresv == NULL ||
+		resresv->job == NULL)
+		return 0;
+
+	cf = find_compiled_formula(formula);
+	if (cf == NULL) {
+#ifdef PYTHON
+		return python_formula_evaluate(formula, resresv, resreq);
+#else
+		return 0;
 #endif
+	}
+
+	if (!compiled_formula_evaluate(cf, resresv, resreq, &ans, &errmsg))
+		log_eventf(PBSEVENT_DEBUG2, PBS_EVENTCLASS_JOB, LOG_DEBUG, resresv->name,
+			"Formula evaluation for job had an error.  Zero value will be used: %s", errmsg);
+
+	return ans;
+}
 
 /**
  * @brief
@@ -4709,7 +4809,7 @@ preemption_similarity(resource_resv *hjob, resource_resv *pjob, schd_error *full
 			case SERVER_USER_RES_LIMIT_REACHED:
 			case SERVER_BYUSER_JOB_LIMIT_REACHED:
 			case SERVER_BYUSER_RES_LIMIT_REACHED:
-				if (strcmp(pjob->user, hjob->user) == 0)
+				if (pjob->user == hjob->user)
 					match = 1;
 				break;
 			case QUEUE_USER_LIMIT_REACHED:
@@ -4717,7 +4817,7 @@ preemption_similarity(resource_resv *hjob, resource_resv *pjob, schd_error *full
 			case QUEUE_BYUSER_JOB_LIMIT_REACHED:
 			case QUEUE_BYUSER_RES_LIMIT_REACHED:
 				if (pjob->job->queue == hjob->job->queue &&
-					strcmp(pjob->user, hjob->user) == 0)
+					pjob->user == hjob->user)
 					match = 1;
 
 				break;
@@ -4725,7 +4825,7 @@ preemption_similarity(resource_resv *hjob, resource_resv *pjob, schd_error *full
 			case SERVER_GROUP_RES_LIMIT_REACHED:
 			case SERVER_BYGROUP_JOB_LIMIT_REACHED:
 			case SERVER_BYGROUP_RES_LIMIT_REACHED:
-				if (strcmp(pjob->group, hjob->group) == 0)
+				if (pjob->group == hjob->group)
 					match = 1;
 				break;
 
@@ -4734,14 +4834,14 @@ preemption_similarity(resource_resv *hjob, resource_resv *pjob, schd_error *full
 			case QUEUE_BYGROUP_JOB_LIMIT_REACHED:
 			case QUEUE_BYGROUP_RES_LIMIT_REACHED:
 				if (pjob->job->queue == hjob->job->queue &&
-					strcmp(pjob->group, hjob->group) == 0)
+					pjob->group == hjob->group)
 					match = 1;
 				break;
 			case SERVER_PROJECT_LIMIT_REACHED:
 			case SERVER_PROJECT_RES_LIMIT_REACHED:
 			case SERVER_BYPROJECT_RES_LIMIT_REACHED:
 			case SERVER_BYPROJECT_JOB_LIMIT_REACHED:
-				if (strcmp(pjob->project, hjob->project) == 0)
+				if (pjob->project == hjob->project)
 					match = 1;
 				break;
 			case QUEUE_PROJECT_LIMIT_REACHED:
@@ -4749,7 +4849,7 @@ preemption_similarity(resource_resv *hjob, resource_resv *pjob, schd_error *full
 			case QUEUE_BYPROJECT_RES_LIMIT_REACHED:
 			case QUEUE_BYPROJECT_JOB_LIMIT_REACHED:
 				if (pjob->job->queue == hjob->job->queue &&
-					strcmp(pjob->project, hjob->project) == 0)
+					pjob->project == hjob->project)
 					match = 1;
 				break;
 			case SERVER_JOB_LIMIT_REACHED:
@@ -4996,40 +5096,40 @@ static int cull_preemptible_jobs(resource_resv *job, const void *arg)
 	switch (inp->err->error_code) {
 		case SERVER_USER_RES_LIMIT_REACHED:
 		case SERVER_BYUSER_RES_LIMIT_REACHED:
-			if ((strcmp(job->user, inp->job->user) == 0) &&
+			if ((job->user == inp->job->user) &&
 			    find_resource_req(job->resreq, inp->err->rdef) != NULL)
 				return 1;
 			break;
 		case QUEUE_USER_RES_LIMIT_REACHED:
 		case QUEUE_BYUSER_RES_LIMIT_REACHED:
 			if ((job->job->queue == inp->job->job->queue) &&
-			    (strcmp(job->user, inp->job->user) == 0) &&
+			    (job->user == inp->job->user) &&
 			    find_resource_req(job->resreq, inp->err->rdef) != NULL)
 				return 1;
 			break;
 		case SERVER_GROUP_RES_LIMIT_REACHED:
 		case SERVER_BYGROUP_RES_LIMIT_REACHED:
-			if ((strcmp(job->group, inp->job->group) == 0) &&
+			if ((job->group == inp->job->group) &&
 			    find_resource_req(job->resreq, inp->err->rdef) != NULL)
 				return 1;
 			break;
 		case QUEUE_GROUP_RES_LIMIT_REACHED:
 		case QUEUE_BYGROUP_RES_LIMIT_REACHED:
 			if ((job->job->queue == inp->job->job->queue) &&
-			    (strcmp(job->group, inp->job->group) == 0) &&
+			    (job->group == inp->job->group) &&
 			    find_resource_req(job->resreq, inp->err->rdef) != NULL)
 				return 1;
 			break;
 		case SERVER_PROJECT_RES_LIMIT_REACHED:
 		case SERVER_BYPROJECT_RES_LIMIT_REACHED:
-			if ((strcmp(job->user, inp->job->user) == 0) &&
+			if ((job->user == inp->job->user) &&
 			    find_resource_req(job->resreq, inp->err->rdef) != NULL)
 				return 1;
 			break;
 		case QUEUE_PROJECT_RES_LIMIT_REACHED:
 		case QUEUE_BYPROJECT_RES_LIMIT_REACHED:
 			if ((job->job->queue == inp->job->job->queue) &&
-			    (strcmp(job->project, inp->job->project) == 0) &&
+			    (job->project == inp->job->project) &&
 			    find_resource_req(job->resreq, inp->err->rdef) != NULL)
 				return 1;
 			break;
@@ -5039,35 +5139,35 @@ static int cull_preemptible_jobs(resource_resv *job, const void *arg)
 			break;
 		case SERVER_USER_LIMIT_REACHED:
 		case SERVER_BYUSER_JOB_LIMIT_REACHED:
-			if (strcmp(job->user, inp->job->user) == 0)
+			if (job->user == inp->job->user)
 				return 1;
 			break;
 		case QUEUE_USER_LIMIT_REACHED:
 		case QUEUE_BYUSER_JOB_LIMIT_REACHED:
 			if ((job->job->queue == inp->job->job->queue) &&
-			    (strcmp(job->user, inp->job->user) == 0))
+			    (job->user == inp->job->user))
 				return 1;
 			break;
 		case SERVER_GROUP_LIMIT_REACHED:
 		case SERVER_BYGROUP_JOB_LIMIT_REACHED:
-			if (strcmp(job->group, inp->job->group) == 0)
+			if (job->group == inp->job->group)
 				return 1;
 			break;
 		case QUEUE_GROUP_LIMIT_REACHED:
 		case QUEUE_BYGROUP_JOB_LIMIT_REACHED:
 			if((job->job->queue == inp->job->job->queue) &&
-			   (strcmp(job->group, inp->job->group) == 0))
+			   (job->group == inp->job->group))
 				return 1;
 			break;
 		case SERVER_PROJECT_LIMIT_REACHED:
 		case SERVER_BYPROJECT_JOB_LIMIT_REACHED:
-			if (strcmp(job->project, inp->job->project) == 0)
+			if (job->project == inp->job->project)
 				return 1;
 			break;
 		case QUEUE_PROJECT_LIMIT_REACHED:
 		case QUEUE_BYPROJECT_JOB_LIMIT_REACHED:
 			if ((job->job->queue == inp->job->job->queue) &&
-			   (strcmp(job->project, inp->job->project) == 0))
+			   (job->project == inp->job->project))
 				return 1;
 			break;
 		case SERVER_JOB_LIMIT_REACHED:
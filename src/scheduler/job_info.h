@@ -83,18 +83,29 @@ int
 update_job_attr(int pbs_sd, resource_resv *resresv, const char *attr_name,
 	const char *attr_resc, const char *attr_value, struct attrl *extra, unsigned int flags );
 
-/* send delayed job attribute updates for job using send_attr_updates() */
+/* merge two lists of pending attribute updates, newer values win */
+struct attrl *merge_attr_updates(struct attrl *newer, struct attrl *older);
+
+/* queue delayed job attribute updates for job using queue_attr_updates() */
 int send_job_updates(int pbs_sd, resource_resv *job);
 
 /* send delayed attributes to the server for a job */
 int send_attr_updates(int virtual_fd, resource_resv *resresv, struct attrl *pattr);
 
+/* queue attributes to be sent to the server at the end of the cycle */
+int queue_attr_updates(int virtual_fd, resource_resv *resresv, struct attrl *pattr);
+
+/* send all queued attribute updates to the server */
+void flush_attr_updates(void);
+
 preempt_job_info *send_preempt_jobs(int virtual_sd, char **preempt_jobs_list);
 
 int send_sigjob(int virtual_sd, resource_resv *resresv, const char *signal, char *extend);
 
 struct batch_status *send_selstat(int virtual_fd, struct attropl *attrib, struct attrl *rattrib, char *extend);
 
+char **send_selectjob(int virtual_fd, struct attropl *attrib, char *extend);
+
 
 /*
  *
@@ -350,7 +361,7 @@ resresv_set **dup_resresv_set_array(resresv_set **osets, server_info *nsinfo);
 resresv_set *create_resresv_set_by_resresv(status *policy, server_info *sinfo, resource_resv *resresv);
 
 /* find a resresv_set by its internal components */
-int find_resresv_set(status *policy, resresv_set **rsets, char *user, char *group, char *project, selspec *sel, place *pl, resource_req *req, queue_info *qinfo);
+int find_resresv_set(status *policy, resresv_set **rsets, const char *user, const char *group, const char *project, selspec *sel, place *pl, resource_req *req, queue_info *qinfo);
 
 /* find a resresv_set with a resresv as a template */
 int find_resresv_set_by_resresv(status *policy, resresv_set **rsets, resource_resv *resresv);
@@ -0,0 +1,451 @@
+/*
+ * Copyright (C) 1994-2021 Altair Engineering, Inc.
+ * For more information, contact Altair at www.altair.com.
+ *
+ * This file is part of both the OpenPBS software ("OpenPBS")
+ * and the PBS Professional ("PBS Pro") software.
+ *
+ * Open Source License Information:
+ *
+ * OpenPBS is free software. You can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Commercial License Information:
+ *
+ * PBS Pro is commercially licensed software that shares a common core with
+ * the OpenPBS software.  For a copy of the commercial license terms and
+ * conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+ * Altair Legal Department.
+ *
+ * Altair's dual-license business model allows companies, individuals, and
+ * organizations to create proprietary derivative works of OpenPBS and
+ * distribute them - whether embedded or bundled with other software -
+ * under a commercial license agreement.
+ *
+ * Use of Altair's trademarks, including but not limited to "PBS™",
+ * "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+ * subject to Altair's trademark licensing policies.
+ */
+
+
+/**
+ * @file    job_status_cache.cpp
+ *
+ * @brief
+ * 		job_status_cache.cpp - keeps the server's job status between scheduling
+ * 		cycles and refreshes it with deltas instead of re-querying every job.
+ *
+ * Functions included are:
+ * 	job_status_cache::get_queue_jobs()
+ * 	job_status_cache::status_age()
+ * 	job_status_cache::prune_queues()
+ * 	job_status_cache::invalidate()
+ */
+#include <pbs_config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pbs_ifl.h>
+#include <pbs_error.h>
+#include <libpbs.h>
+#include <log.h>
+#include "job_status_cache.h"
+#include "job_info.h"
+#include "misc.h"
+#include "constant.h"
+
+
+job_status_cache jstat_cache;
+
+/**
+ * @brief	get the mtime of a job out of its batch_status
+ *
+ * @param[in]	bs	-	batch_status of the job
+ *
+ * @return	long
+ * @retval	the job's mtime
+ * @retval	0 if the job has no mtime
+ */
+static long
+get_status_mtime(struct batch_status *bs)
+{
+	for (struct attrl *attrp = bs->attribs; attrp != NULL; attrp = attrp->next) {
+		if (!strcmp(attrp->name, ATTR_mtime))
+			return strtol(attrp->value, NULL, 10);
+	}
+
+	return 0;
+}
+
+/**
+ * @brief	return the id of the array parent of a subjob id
+ *
+ * @param[in]	jobid	-	job id, e.g. 123[4].server
+ *
+ * @return	std::string
+ * @retval	the id of the parent, e.g. 123[].server
+ * @retval	empty string if jobid is not a subjob id
+ */
+static std::string
+get_parent_id(const char *jobid)
+{
+	const char *open = strchr(jobid, '[');
+	const char *close;
+
+	if (open == NULL || open[1] == ']')
+		return std::string();
+	close = strchr(open, ']');
+	if (close == NULL)
+		return std::string();
+
+	return std::string(jobid, open - jobid + 1) + close;
+}
+
+/**
+ * @brief	free the batch_status of one cached job without touching
+ *		the rest of the list it may still be linked into
+ *
+ * @param[in]	bs	-	batch_status to free
+ *
+ * @return	void
+ */
+static void
+free_single_status(struct batch_status *bs)
+{
+	if (bs == NULL)
+		return;
+
+	bs->next = NULL;
+	pbs_statfree(bs);
+}
+
+/**
+ * @brief	free all the cached job status of a queue and mark it out of sync
+ *
+ * @param[in,out]	q	-	the cached queue
+ *
+ * @return	void
+ */
+void
+job_status_cache::clear_queue(jsc_queue& q)
+{
+	for (auto& j : q.jobs)
+		free_single_status(j.second.bs);
+	q.jobs.clear();
+	q.synced = false;
+	q.mtime_hw = 0;
+}
+
+/**
+ * @brief	merge a list of job status returned by the server into a cached queue.
+ *		The list is consumed: every element is either stored in the cache
+ *		or freed.
+ *
+ * @param[in,out]	q	-	the cached queue
+ * @param[in]	bs	-	list of job status from the server
+ * @param[in]	now	-	time the list was fetched
+ * @param[in]	cur_gen	-	generation the list was fetched in
+ *
+ * @return	void
+ */
+void
+job_status_cache::merge_status(jsc_queue& q, struct batch_status *bs, time_t now, unsigned long cur_gen)
+{
+	struct batch_status *next;
+
+	for (; bs != NULL; bs = next) {
+		next = bs->next;
+		bs->next = NULL;
+
+		auto mtime = get_status_mtime(bs);
+		if (mtime > q.mtime_hw)
+			q.mtime_hw = mtime;
+
+		auto& ent = q.jobs[bs->name];
+		free_single_status(ent.bs);
+		ent.bs = bs;
+		ent.fetched = now;
+		ent.gen = cur_gen;
+	}
+}
+
+/**
+ * @brief	query every job of a queue from the server and replace the
+ *		cached state of the queue with it
+ *
+ * @param[in]	pbs_sd	-	connection to the server
+ * @param[in]	qname	-	name of the queue
+ * @param[in,out]	q	-	the cached queue
+ * @param[in]	attrib	-	attributes to query
+ *
+ * @return	struct batch_status *
+ * @retval	the jobs in the queue, linked in server order
+ * @retval	NULL if there are no jobs or on error (pbs_errno is set)
+ */
+struct batch_status *
+job_status_cache::full_sync(int pbs_sd, const std::string& qname, jsc_queue& q, struct attrl *attrib)
+{
+	struct attropl opl = { NULL, const_cast<char *>(ATTR_q), NULL, const_cast<char *>(qname.c_str()), EQ };
+	struct batch_status *jobs;
+	struct batch_status *prev = NULL;
+
+	clear_queue(q);
+	gen++;
+
+	jobs = send_selstat(pbs_sd, &opl, attrib, const_cast<char *>("S"));
+	if (jobs == NULL) {
+		/* an empty queue is in sync too */
+		if (pbs_errno == PBSE_NONE)
+			q.synced = true;
+		return NULL;
+	}
+
+	/* keep the list linked as the server returned it, the cache just
+	 * remembers where each element is
+	 */
+	auto now = time(NULL);
+	for (auto bs = jobs; bs != NULL; bs = bs->next) {
+		auto mtime = get_status_mtime(bs);
+		if (mtime > q.mtime_hw)
+			q.mtime_hw = mtime;
+		auto& ent = q.jobs[bs->name];
+		if (ent.bs != NULL) {
+			/* a job can't be listed twice, but don't leak if it is */
+			prev->next = bs->next;
+			free_single_status(bs);
+			bs = prev;
+			continue;
+		}
+		ent.bs = bs;
+		ent.fetched = now;
+		ent.gen = gen;
+		prev = bs;
+	}
+	q.synced = true;
+
+	log_eventf(PBSEVENT_DEBUG3, PBS_EVENTCLASS_QUEUE, LOG_DEBUG, qname,
+		"Job status cache synced with %d jobs", static_cast<int>(q.jobs.size()));
+
+	return jobs;
+}
+
+/**
+ * @brief	return the status of all jobs of a queue.  If the queue is
+ *		in sync, only the jobs which changed since the last cycle are
+ *		queried from the server.
+ *
+ * @param[in]	pbs_sd	-	connection to the server
+ * @param[in]	qname	-	name of the queue
+ * @param[in]	attrib	-	attributes to query.  Must include ATTR_mtime.
+ * @param[out]	cached	-	true if the returned list is owned by the cache
+ *
+ * @return	struct batch_status *
+ * @retval	the jobs in the queue
+ * @retval	NULL if there are no jobs or on error (pbs_errno is set)
+ *
+ * @par MT-safe: No
+ */
+struct batch_status *
+job_status_cache::get_queue_jobs(int pbs_sd, const std::string& qname, struct attrl *attrib, bool *cached)
+{
+	struct attropl opl = { NULL, const_cast<char *>(ATTR_q), NULL, const_cast<char *>(qname.c_str()), EQ };
+	struct attropl opl_mtime = { NULL, const_cast<char *>(ATTR_mtime), NULL, NULL, GE };
+	struct attropl opl_active = { NULL, const_cast<char *>(ATTR_state), NULL, const_cast<char *>("RESUE"), EQ };
+	char mtime_buf[32];
+	char **ids;
+	struct batch_status *delta;
+	struct batch_status *head = NULL;
+	struct batch_status *tail = NULL;
+	int num_changed = 0;
+
+	*cached = false;
+
+	/* Each server has its own clock, so one mtime high-water mark can't
+	 * cover jobs from several servers.  Fall back to a full query.
+	 */
+	if (get_num_servers() > 1) {
+		struct batch_status *jobs = send_selstat(pbs_sd, &opl, attrib, const_cast<char *>("S"));
+		return jobs;
+	}
+
+	auto& q = queues[qname];
+
+	if (!q.synced) {
+		*cached = true;
+		return full_sync(pbs_sd, qname, q, attrib);
+	}
+
+	/* no ids without an error is an empty queue */
+	ids = send_selectjob(pbs_sd, &opl, const_cast<char *>("S"));
+	if (ids == NULL && pbs_errno != PBSE_NONE) {
+		clear_queue(q);
+		return NULL;
+	}
+
+	/* jobs saved since the last cycle: new, altered, or changed state */
+	auto now = time(NULL);
+	auto cur_gen = ++gen;
+	snprintf(mtime_buf, sizeof(mtime_buf), "%ld", q.mtime_hw);
+	opl_mtime.value = mtime_buf;
+	opl.next = &opl_mtime;
+	delta = send_selstat(pbs_sd, &opl, attrib, const_cast<char *>("S"));
+	if (delta == NULL && pbs_errno != PBSE_NONE) {
+		free(ids);
+		clear_queue(q);
+		return NULL;
+	}
+	for (auto bs = delta; bs != NULL; bs = bs->next)
+		num_changed++;
+	merge_status(q, delta, now, cur_gen);
+
+	/* active jobs have their resources_used updated by the moms without
+	 * a job save, so their mtime can't be trusted
+	 */
+	opl.next = &opl_active;
+	delta = send_selstat(pbs_sd, &opl, attrib, const_cast<char *>("S"));
+	if (delta == NULL && pbs_errno != PBSE_NONE) {
+		free(ids);
+		clear_queue(q);
+		return NULL;
+	}
+	merge_status(q, delta, now, cur_gen);
+
+	/* Relink the cached status in the order the server reported the ids.
+	 * Every id must be known to us.  If one isn't, we've missed a change
+	 * and we start over.
+	 *
+	 * The ids list every subjob of an array, while the status we cache
+	 * is the array parent plus its running subjobs.  A subjob is linked
+	 * by its own status only if that was refreshed this cycle, otherwise
+	 * it is covered by its parent.  A subjob which has since finished is
+	 * still listed, so an older status of its own is stale.
+	 */
+	std::unordered_set<std::string> seen;
+	for (int i = 0; ids != NULL && ids[i] != NULL; i++) {
+		std::string parent = get_parent_id(ids[i]);
+		auto it = q.jobs.find(ids[i]);
+		if (!parent.empty() && (it == q.jobs.end() || it->second.gen != cur_gen))
+			it = q.jobs.find(parent);
+		if (it == q.jobs.end()) {
+			log_eventf(PBSEVENT_DEBUG2, PBS_EVENTCLASS_QUEUE, LOG_DEBUG, qname,
+				"Job status cache out of sync on job %s, re-syncing queue", ids[i]);
+			free(ids);
+			*cached = true;
+			return full_sync(pbs_sd, qname, q, attrib);
+		}
+		if (!seen.insert(it->first).second)
+			continue;
+		if (tail == NULL)
+			head = it->second.bs;
+		else
+			tail->next = it->second.bs;
+		tail = it->second.bs;
+	}
+	if (tail != NULL)
+		tail->next = NULL;
+	free(ids);
+
+	/* jobs no longer in the queue have been deleted, finished or moved */
+	for (auto it = q.jobs.begin(); it != q.jobs.end();) {
+		if (seen.find(it->first) == seen.end()) {
+			free_single_status(it->second.bs);
+			it = q.jobs.erase(it);
+		} else
+			++it;
+	}
+
+	log_eventf(PBSEVENT_DEBUG3, PBS_EVENTCLASS_QUEUE, LOG_DEBUG, qname,
+		"Job status cache: %d jobs, %d changed since last cycle",
+		static_cast<int>(q.jobs.size()), num_changed);
+
+	*cached = true;
+	return head;
+}
+
+/**
+ * @brief	seconds since the status of a job was fetched from the server.
+ *		Values the server computes when it is queried (e.g., eligible_time)
+ *		are this much older than the cycle.
+ *
+ * @param[in]	qname	-	name of the queue the job is in
+ * @param[in]	jobid	-	job id
+ * @param[in]	now	-	current time
+ *
+ * @return	time_t
+ * @retval	age of the job's status
+ * @retval	0 if the job is not cached
+ *
+ * @par MT-safe: Yes, as long as the cache isn't being refreshed
+ */
+time_t
+job_status_cache::status_age(const std::string& qname, const std::string& jobid, time_t now) const
+{
+	auto qit = queues.find(qname);
+	if (qit == queues.end())
+		return 0;
+
+	auto jit = qit->second.jobs.find(jobid);
+	if (jit == qit->second.jobs.end() || jit->second.fetched > now)
+		return 0;
+
+	return now - jit->second.fetched;
+}
+
+/**
+ * @brief	forget the cached jobs of queues which no longer exist
+ *
+ * @param[in]	qnames	-	names of all queues on the server
+ *
+ * @return	void
+ */
+void
+job_status_cache::prune_queues(const std::unordered_set<std::string>& qnames)
+{
+	for (auto it = queues.begin(); it != queues.end();) {
+		if (qnames.find(it->first) == qnames.end()) {
+			clear_queue(it->second);
+			it = queues.erase(it);
+		} else
+			++it;
+	}
+}
+
+/**
+ * @brief	throw away the whole cache.  The next cycle will query every
+ *		job from the server again.
+ *
+ * @param[in]	reason	-	why the cache is invalidated (for logging)
+ *
+ * @return	void
+ */
+void
+job_status_cache::invalidate(const char *reason)
+{
+	if (queues.empty())
+		return;
+
+	for (auto& q : queues)
+		clear_queue(q.second);
+	queues.clear();
+
+	log_eventf(PBSEVENT_DEBUG2, PBS_EVENTCLASS_SCHED, LOG_DEBUG, __func__,
+		"Job status cache invalidated: %s", reason);
+}
+
+job_status_cache::~job_status_cache()
+{
+	for (auto& q : queues)
+		clear_queue(q.second);
+}
@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 1994-2021 Altair Engineering, Inc.
+ * For more information, contact Altair at www.altair.com.
+ *
+ * This file is part of both the OpenPBS software ("OpenPBS")
+ * and the PBS Professional ("PBS Pro") software.
+ *
+ * Open Source License Information:
+ *
+ * OpenPBS is free software. You can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Commercial License Information:
+ *
+ * PBS Pro is commercially licensed software that shares a common core with
+ * the OpenPBS software.  For a copy of the commercial license terms and
+ * conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+ * Altair Legal Department.
+ *
+ * Altair's dual-license business model allows companies, individuals, and
+ * organizations to create proprietary derivative works of OpenPBS and
+ * distribute them - whether embedded or bundled with other software -
+ * under a commercial license agreement.
+ *
+ * Use of Altair's trademarks, including but not limited to "PBS™",
+ * "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+ * subject to Altair's trademark licensing policies.
+ */
+
+#ifndef	_JOB_STATUS_CACHE_H
+#define	_JOB_STATUS_CACHE_H
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <time.h>
+#include <pbs_ifl.h>
+
+/*
+ * The job status cache keeps the server's batch_status of every job between
+ * scheduling cycles.  Once a queue has been fully synced, later cycles only
+ * ask the server for the job ids in the queue, the jobs whose mtime moved
+ * since the last cycle, and the active jobs (whose resources_used is updated
+ * without a job save).  The id list doubles as the consistency check: a job
+ * the cache has never seen causes a full re-sync of its queue.
+ *
+ * The cache owns every batch_status it hands out.  Callers must not call
+ * pbs_statfree() on a list returned with *cached set to true.
+ */
+class job_status_cache
+{
+	public:
+	/* return the jobs of a queue, refreshing the cached status from the server */
+	struct batch_status *get_queue_jobs(int pbs_sd, const std::string& qname, struct attrl *attrib, bool *cached);
+
+	/* seconds since the cached status of a job was last fetched from the server */
+	time_t status_age(const std::string& qname, const std::string& jobid, time_t now) const;
+
+	/* drop queues which are no longer on the server */
+	void prune_queues(const std::unordered_set<std::string>& qnames);
+
+	/* throw everything away and do a full re-sync on the next cycle */
+	void invalidate(const char *reason);
+
+	~job_status_cache();
+
+	private:
+	struct jsc_entry
+	{
+		struct batch_status *bs;	/* status of the job as last returned by the server */
+		time_t fetched;			/* when bs was fetched */
+		unsigned long gen;		/* generation bs was fetched in */
+	};
+
+	struct jsc_queue
+	{
+		bool synced = false;		/* the queue has been fully queried at least once */
+		long mtime_hw = 0;		/* highest job mtime seen, in server time */
+		std::unordered_map<std::string, jsc_entry> jobs;
+	};
+
+	std::unordered_map<std::string, jsc_queue> queues;
+	unsigned long gen = 0;			/* bumped for every refresh of a queue */
+
+	struct batch_status *full_sync(int pbs_sd, const std::string& qname, jsc_queue& q, struct attrl *attrib);
+	void merge_status(jsc_queue& q, struct batch_status *bs, time_t now, unsigned long cur_gen);
+	void clear_queue(jsc_queue& q);
+};
+
+extern job_status_cache jstat_cache;
+
+#endif	/* _JOB_STATUS_CACHE_H */
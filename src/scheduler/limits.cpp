@@ -53,6 +53,7 @@
  * 	lim_setlimits()
  * 	has_hardlimits()
  * 	has_softlimits()
+ * 	lim_hash_hardlimits()
  * 	new_limcounts()
  * 	free_limcounts()
  * 	make_limcounts()
@@ -119,6 +120,9 @@
 #include	<stdio.h>
 #include	<string.h>
 #include	<assert.h>
+#include	<functional>
+#include	<string>
+#include	<unordered_map>
 #include	"pbs_config.h"
 #include	"pbs_ifl.h"
 #include	"data_types.h"
@@ -366,7 +370,10 @@ static int		is_hardlimit(const struct attrl *);
 static int
 lim_callback(void *, enum lim_keytypes, char *, char *,
 	char *, char *);
-static void		*lim_dup_ctx(void *);
+struct lim_value;
+typedef std::unordered_map<std::string, lim_value> lim_table;
+
+static lim_table	*lim_dup_ctx(const lim_table *);
 static char		*lim_gengroupreskey(const char *);
 static char		*lim_genprojectreskey(const char *);
 static char		*lim_genuserreskey(const char *);
@@ -379,17 +386,34 @@ static int		lim_setoldlimits(const struct attrl *, void *);
 static int		lim_setreslimits(const struct attrl *, void *);
 static int		lim_setrunlimits(const struct attrl *, void *);
 
+/**
+ * @struct	lim_value
+ * @brief
+ * 		a limit as it was set, along with its numeric value.  The value is
+ * 		converted once when the limit is set rather than on every check.
+ *
+ * @param[in]	lv_str	-	the limit value as set on the server or queue
+ * @param[in]	lv_num	-	lv_str converted by res_to_num()
+ */
+struct lim_value {
+	std::string	lv_str;
+	sch_resource_t	lv_num;
+};
+
 /**
  * @struct	limit_info
  * @brief
- * 		internal structure of stored limit information
+ * 		internal structure of stored limit information.  A limit context
+ * 		is a lim_table, which maps a limit key (see entlim_mk_runkey() and
+ * 		entlim_mk_reskey()) to its value, so fetching a limit is a single
+ * 		hash lookup.
  *
  * @param[in]	li_ctxh	-	limit context for storing (hard) resource and run limits
  * @param[in]	li_ctxs	-	limit context for storing (soft) resource and run limits
  */
 struct limit_info {
-	void	*li_ctxh;
-	void	*li_ctxs;
+	lim_table	*li_ctxh;
+	lim_table	*li_ctxs;
 };
 #define	LI2RESCTX(li)		(((struct limit_info *) li)->li_ctxh)
 #define	LI2RESCTXSOFT(li)	(((struct limit_info *) li)->li_ctxs)
@@ -437,19 +461,8 @@ lim_alloc_liminfo(void)
 	if ((lip = static_cast<limit_info *>(calloc(1, sizeof(struct limit_info)))) == NULL)
 		return NULL;
 	else {
-		void	*ctx;
-
-		if ((ctx = entlim_initialize_ctx()) == NULL) {
-			lim_free_liminfo(lip);
-			return NULL;
-		} else
-			LI2RESCTX(lip) = ctx;
-		if ((ctx = entlim_initialize_ctx()) == NULL) {
-			lim_free_liminfo(lip);
-			return NULL;
-		} else
-			LI2RESCTXSOFT(lip) = ctx;
-
+		LI2RESCTX(lip) = new lim_table();
+		LI2RESCTXSOFT(lip) = new lim_table();
 
 		assert(LI2RUNCTX(lip) != NULL);
 		assert(LI2RUNCTXSOFT(lip) != NULL);
@@ -480,7 +493,7 @@ lim_dup_liminfo(void *p)
 	if ((newlip = static_cast<limit_info *>(calloc(1, sizeof(struct limit_info)))) == NULL)
 		return NULL;
 	else {
-		void	*ctx;
+		lim_table	*ctx;
 
 		if ((ctx = lim_dup_ctx(LI2RESCTX(oldlip))) == NULL) {
 			lim_free_liminfo(newlip);
@@ -522,22 +535,11 @@ lim_free_liminfo(void *p)
 	if (lip == NULL)
 		return;
 
-	if (LI2RESCTX(lip) != NULL) {
-		(void) entlim_free_ctx(LI2RESCTX(lip), free);
-		LI2RESCTX(lip) = NULL;
-	}
-	if (LI2RESCTXSOFT(lip) != NULL) {
-		(void) entlim_free_ctx(LI2RESCTXSOFT(lip), free);
-		LI2RESCTXSOFT(lip) = NULL;
-	}
-	if (LI2RUNCTX(lip) != NULL) {
-		(void) entlim_free_ctx(LI2RUNCTX(lip), free);
-		LI2RUNCTX(lip) = NULL;
-	}
-	if (LI2RUNCTXSOFT(lip) != NULL) {
-		(void) entlim_free_ctx(LI2RUNCTXSOFT(lip), free);
-		LI2RUNCTXSOFT(lip) = NULL;
-	}
+	delete LI2RESCTX(lip);
+	LI2RESCTX(lip) = NULL;
+	delete LI2RESCTXSOFT(lip);
+	LI2RESCTXSOFT(lip) = NULL;
+	/* the run limit contexts are the resource limit contexts, see above */
 	free(lip);
 }
 /**
@@ -672,16 +674,14 @@ int
 has_hardlimits(void *p)
 {
 	struct limit_info	*lip = static_cast<limit_info *>(p);
-	char *k = NULL;
 
-	if (entlim_get_next(LI2RESCTX(lip), (void **)&k) != NULL) /* at least one hard resource limit present */
+	if (!LI2RESCTX(lip)->empty()) /* at least one hard resource limit present */
 		return (1);
 
 	/* run limit already checked? */
 	if (LI2RUNCTX(lip) == LI2RESCTX(lip))
 		return (0);
-	k = NULL;
-	if (entlim_get_next(LI2RUNCTX(lip), (void **)&k) != NULL) /* at least one hard run limit present */
+	if (!LI2RUNCTX(lip)->empty()) /* at least one hard run limit present */
 		return (1);
 
 	return (0);
@@ -701,20 +701,46 @@ int
 has_softlimits(void *p)
 {
 	struct limit_info	*lip = static_cast<limit_info *>(p);
-	char *k = NULL;
 
-	if (entlim_get_next(LI2RESCTXSOFT(lip), (void **)&k) != NULL) /* at least one soft resource limit present */
+	if (!LI2RESCTXSOFT(lip)->empty()) /* at least one soft resource limit present */
 		return (1);
 
 	/* run limit already checked? */
 	if (LI2RUNCTXSOFT(lip) == LI2RESCTXSOFT(lip))
 		return (0);
-	k = NULL;
-	if (entlim_get_next(LI2RUNCTXSOFT(lip), (void **)&k) != NULL) /* at least one soft run limit present */
+	if (!LI2RUNCTXSOFT(lip)->empty()) /* at least one soft run limit present */
 		return (1);
 
 	return (0);
 }
+/**
+ * @brief
+ * 		hash the hard limits of a limit info structure.  The hash does not
+ * 		depend on the order the limits are stored in, so two structures
+ * 		with the same limits hash the same.
+ *
+ * @param[in]	p	-	limit info structure to hash
+ *
+ * @return	unsigned long
+ * @retval	hash of every hard limit key and value
+ * @retval	0	: no hard limits are set
+ */
+unsigned long
+lim_hash_hardlimits(void *p)
+{
+	struct limit_info	*lip = static_cast<limit_info *>(p);
+	std::hash<std::string> hstr;
+	unsigned long h = 0;
+
+	if (lip == NULL)
+		return 0;
+
+	/* the run and resource limits share one context */
+	for (const auto& lim : *LI2RESCTX(lip))
+		h += hstr(lim.first + '=' + lim.second.lv_str);
+
+	return h;
+}
 /**
  * @brief
  *		create a new limit count structure and initialize it.
@@ -1249,7 +1275,7 @@ check_server_max_user_run(server_info *si, queue_info *qi, resource_resv *rr,
 	limcounts *sc, limcounts *qc, schd_error *err)
 {
 	char		*key;
-	char		*user = rr->user;
+	const char	*user = rr->user;
 	int		used;
 	int		max_user_run, max_genuser_run;
 	counts		*cts = NULL;
@@ -1319,7 +1345,7 @@ check_server_max_group_run(server_info *si, queue_info *qi, resource_resv *rr,
 	limcounts *sc, limcounts *qc, schd_error *err)
 {
 	char		*key;
-	char		*group = rr->group;
+	const char	*group = rr->group;
 	int		used;
 	int		max_group_run, max_gengroup_run;
 	counts		*cts = NULL;
@@ -1501,7 +1527,7 @@ check_queue_max_user_run(server_info *si, queue_info *qi, resource_resv *rr,
 	limcounts *sc, limcounts *qc, schd_error *err)
 {
 	char		*key;
-	char		*user = rr->user;
+	const char	*user = rr->user;
 	int		used;
 	int		max_user_run, max_genuser_run;
 	counts		*cts = NULL;
@@ -1571,7 +1597,7 @@ check_queue_max_group_run(server_info *si, queue_info *qi, resource_resv *rr,
 	limcounts *sc, limcounts *qc, schd_error *err)
 {
 	char		*key;
-	char		*group = rr->group;
+	const char	*group = rr->group;
 	int		used;
 	int		max_group_run, max_gengroup_run;
 	counts		*cts = NULL;
@@ -2058,7 +2084,7 @@ static int
 check_queue_max_user_run_soft(server_info *si, queue_info *qi, resource_resv *rr)
 {
 	char		*key;
-	char		*user = rr->user;
+	const char	*user = rr->user;
 	int		used;
 	int		max_user_run_soft, max_genuser_run_soft;
 	counts		*cnt = NULL;
@@ -2132,7 +2158,7 @@ check_queue_max_group_run_soft(server_info *si, queue_info *qi,
 	resource_resv *rr)
 {
 	char		*key;
-	char		*group = rr->group;
+	const char	*group = rr->group;
 	int		used;
 	int		max_group_run_soft, max_gengroup_run_soft;
 	counts		*cnt = NULL;
@@ -2312,7 +2338,7 @@ check_server_max_user_run_soft(server_info *si, queue_info *qi,
 	resource_resv *rr)
 {
 	char		*key;
-	char		*user = rr->user;
+	const char	*user = rr->user;
 	int		used;
 	int		max_user_run_soft, max_genuser_run_soft;
 	counts		*cnt = NULL;
@@ -2385,7 +2411,7 @@ check_server_max_group_run_soft(server_info *si, queue_info *qi,
 	resource_resv *rr)
 {
 	char		*key;
-	char		*group = rr->group;
+	const char	*group = rr->group;
 	int		used;
 	int		max_group_run_soft, max_gengroup_run_soft;
 	counts		*cnt = NULL;
@@ -2657,7 +2683,7 @@ check_max_group_res(resource_resv *rr, counts *cts_list, resdef **rdef, void *li
 {
 	char		*groupreskey;
 	char		*gengroupreskey;
-	char		*group;
+	const char	*group;
 	schd_resource	*res;
 	sch_resource_t	max_group_res;
 	sch_resource_t	max_gengroup_res;
@@ -2735,7 +2761,7 @@ check_max_group_res_soft(resource_resv *rr, counts *cts_list, void *limitctx, in
 {
 	char		*groupreskey;
 	char		*gengroupreskey;
-	char		*group;
+	const char	*group;
 	schd_resource	*res;
 	sch_resource_t	max_group_res_soft;
 	sch_resource_t	max_gengroup_res_soft;
@@ -2825,7 +2851,7 @@ check_max_user_res(resource_resv *rr, counts *cts_list, resdef **rdef,
 {
 	char		*userreskey;
 	char		*genuserreskey;
-	char		*user;
+	const char	*user;
 	schd_resource	*res;
 	sch_resource_t	max_user_res;
 	sch_resource_t	max_genuser_res;
@@ -2906,7 +2932,7 @@ check_max_user_res_soft(resource_resv **rr_arr, resource_resv *rr,
 {
 	char		*userreskey;
 	char		*genuserreskey;
-	char		*user;
+	const char	*user;
 	schd_resource	*res;
 	sch_resource_t	max_user_res_soft;
 	sch_resource_t	max_genuser_res_soft;
@@ -3176,47 +3202,17 @@ lim_setoldlimits(const struct attrl *a, void *ctx)
  *
  * @param[in]	ctx	-	the limit storage context
  *
- * @return	void *
+ * @return	lim_table *
  * @retval	the newly-allocated storage context	: on success
  * @retval	NULL	: on error
  */
-static void *
-lim_dup_ctx(void *ctx)
+static lim_table *
+lim_dup_ctx(const lim_table *ctx)
 {
-	void *newctx;
-	char *key = NULL;
-	char *value = NULL;
-
-	if ((newctx = entlim_initialize_ctx()) == NULL) {
-		log_err(errno, __func__, "malloc failed");
-		return(NULL);
-	}
+	if (ctx == NULL)
+		return NULL;
 
-	while ((value = static_cast<char *>(entlim_get_next(ctx, (void **)&key))) != NULL) {
-		const char *newval;
-		if ((newval = strdup(value)) == NULL) {
-			log_event(PBSEVENT_DEBUG, PBS_EVENTCLASS_SCHED, LOG_ERR, __func__, "strdup value failed");
-			(void) entlim_free_ctx(newctx, free);
-			return NULL;
-		} else if (entlim_add(key, newval, newctx) != 0) {
-			log_eventf(PBSEVENT_DEBUG, PBS_EVENTCLASS_SCHED, LOG_ERR, __func__, "entlim_add(%s) failed", key);
-			/*
-			 *	One might think that we should free newval
-			 *	on error as well.  We don't only because we
-			 *	are uncertain whether the underneath entlim code
-			 *	might have remembered the location of the key's
-			 *	value in spite of having returned failure indication.
-			 *	We choose to leak a small amount of memory (in
-			 *	what we hope to be rare circumstances) rather
-			 *	than have the scheduler crash when the system
-			 *	memory allocation code detects and aborts due
-			 *	to twice-freed memory.
-			 */
-			(void) entlim_free_ctx(newctx, free);
-			return NULL;
-		}
-	}
-	return newctx;
+	return new lim_table(*ctx);
 }
 
 /**
@@ -3306,8 +3302,8 @@ static int
 lim_callback(void *ctx, enum lim_keytypes kt, char *param, char *namestring,
 	char *res, char *val)
 {
+	lim_table	*lt = static_cast<lim_table *>(ctx);
 	char		*key = NULL;
-	char		*v = NULL;
 
 	if (res != NULL)
 		key = entlim_mk_reskey(kt, namestring, res);
@@ -3319,17 +3315,9 @@ lim_callback(void *ctx, enum lim_keytypes kt, char *param, char *namestring,
 		return (-1);
 	}
 
-	if ((v = strdup(val)) == NULL) {
-		log_eventf(PBSEVENT_SCHED, PBS_EVENTCLASS_SCHED, LOG_ERR, __func__,
-			"strdup %s %s %s failed", key, res, val);
-		free(key);
-		return (-1);
-	}
-
-	if (entlim_add(key, v, ctx) != 0) {
+	if (!lt->emplace(key, lim_value{val, res_to_num(val, NULL)}).second) {
 		log_eventf(PBSEVENT_SCHED, PBS_EVENTCLASS_SCHED, LOG_ERR, __func__,
 			"limit set %s %s %s failed", key, res, val);
-		free(v);
 		free(key);
 		return (-1);
 	} else {
@@ -3358,17 +3346,16 @@ lim_callback(void *ctx, enum lim_keytypes kt, char *param, char *namestring,
 static sch_resource_t
 lim_get(const char *param, void *ctx)
 {
-	char		*retptr;
+	lim_table	*lt = static_cast<lim_table *>(ctx);
 
-	retptr = static_cast<char *>(entlim_get(param, ctx));
-	if (retptr != NULL) {
-		sch_resource_t	v;
+	if (param == NULL || lt == NULL)
+		return (SCHD_INFINITY);
 
-		v = res_to_num(retptr, NULL);
-		return (v);
-	} else {
+	auto it = lt->find(param);
+	if (it != lt->end())
+		return (it->second.lv_num);
+	else
 		return (SCHD_INFINITY);
-	}
 }
 
 /**
@@ -3462,7 +3449,7 @@ check_max_project_res(resource_resv *rr, counts *cts_list,
 	char		*projectreskey;
 	char		*genprojectreskey;
 	schd_resource	*res;
-	char		*project;
+	const char	*project;
 	sch_resource_t	max_project_res;
 	sch_resource_t	max_genproject_res;
 	sch_resource_t	used = 0;
@@ -3538,7 +3525,7 @@ check_max_project_res_soft(resource_resv *rr, counts *cts_list, void *limitctx,
 {
 	char		*projectreskey;
 	char		*genprojectreskey;
-	char		*project;
+	const char	*project;
 	schd_resource	*res;
 	sch_resource_t	max_project_res_soft;
 	sch_resource_t	max_genproject_res_soft;
@@ -3688,7 +3675,7 @@ check_server_max_project_run_soft(server_info *si, queue_info *qi,
 	resource_resv *rr)
 {
 	char		*key;
-	char		*project;
+	const char	*project;
 	int		used;
 	int		max_project_run_soft, max_genproject_run_soft;
 	counts		*cnt = NULL;
@@ -3855,7 +3842,7 @@ check_queue_max_project_run_soft(server_info *si, queue_info *qi,
 	resource_resv *rr)
 {
 	char		*key;
-	char		*project;
+	const char	*project;
 	int		used;
 	int		max_project_run_soft, max_genproject_run_soft;
 	counts		*cnt = NULL;
@@ -3968,7 +3955,7 @@ check_server_max_project_run(server_info *si, queue_info *qi, resource_resv *rr,
 	limcounts *sc, limcounts *qc, schd_error *err)
 {
 	char		*key;
-	char		*project;
+	const char	*project;
 	int		used;
 	int		max_project_run, max_genproject_run;
 	counts		*cts = NULL;
@@ -4045,7 +4032,7 @@ check_queue_max_project_run(server_info *si, queue_info *qi, resource_resv *rr,
 	limcounts *sc, limcounts *qc, schd_error *err)
 {
 	char		*key;
-	char		*project;
+	const char	*project;
 	int		used;
 	int		max_project_run, max_genproject_run;
 	counts		*cts = NULL;
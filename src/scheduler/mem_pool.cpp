@@ -0,0 +1,228 @@
+/*
+ * Copyright (C) 1994-2021 Altair Engineering, Inc.
+ * For more information, contact Altair at www.altair.com.
+ *
+ * This file is part of both the OpenPBS software ("OpenPBS")
+ * and the PBS Professional ("PBS Pro") software.
+ *
+ * Open Source License Information:
+ *
+ * OpenPBS is free software. You can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Commercial License Information:
+ *
+ * PBS Pro is commercially licensed software that shares a common core with
+ * the OpenPBS software.  For a copy of the commercial license terms and
+ * conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+ * Altair Legal Department.
+ *
+ * Altair's dual-license business model allows companies, individuals, and
+ * organizations to create proprietary derivative works of OpenPBS and
+ * distribute them - whether embedded or bundled with other software -
+ * under a commercial license agreement.
+ *
+ * Use of Altair's trademarks, including but not limited to "PBS™",
+ * "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+ * subject to Altair's trademark licensing policies.
+ */
+
+
+/**
+ * @file    mem_pool.cpp
+ *
+ * @brief
+ * 		mem_pool.cpp - per-thread free lists for the small objects the
+ * 		scheduler allocates and frees every cycle.
+ *
+ * Functions included are:
+ * 	pool_alloc()
+ * 	pool_free()
+ * 	log_pool_stats()
+ */
+#include <pbs_config.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <log.h>
+#include "mem_pool.h"
+
+/* allocation counters of a kind of object.  Only the owning thread
+ * writes them; they are atomic so log_pool_stats() can read them.
+ */
+struct pool_stats
+{
+	std::atomic<long> allocs{0};	/* objects handed out */
+	std::atomic<long> reused{0};	/* of those, taken from a free list */
+	std::atomic<long> released{0};	/* objects freed with the free list full */
+};
+
+/* totals of a kind of object */
+struct pool_totals
+{
+	long allocs;
+	long reused;
+	long released;
+};
+
+struct pool_cache;
+
+/* the caches of the live threads, and the counts of the threads which exited */
+static std::mutex caches_lock;
+static std::vector<pool_cache *> caches;
+static pool_totals retired[POOL_NUM];
+static pool_totals reported[POOL_NUM];
+
+/* the free lists and counters of one thread, emptied when the thread exits */
+struct pool_cache
+{
+	std::vector<void *> objs[POOL_NUM];
+	pool_stats stats[POOL_NUM];
+	pool_cache()
+	{
+		std::lock_guard<std::mutex> lk(caches_lock);
+		caches.push_back(this);
+	}
+	~pool_cache()
+	{
+		std::lock_guard<std::mutex> lk(caches_lock);
+		for (int i = 0; i < POOL_NUM; i++) {
+			retired[i].allocs += stats[i].allocs.load(std::memory_order_relaxed);
+			retired[i].reused += stats[i].reused.load(std::memory_order_relaxed);
+			retired[i].released += stats[i].released.load(std::memory_order_relaxed);
+		}
+		caches.erase(std::remove(caches.begin(), caches.end(), this), caches.end());
+		for (auto& v : objs)
+			for (auto obj : v)
+				free(obj);
+	}
+};
+
+static thread_local pool_cache cache;
+
+/**
+ * @brief	bump a counter of the calling thread.  No other thread writes
+ *		it, so a plain load and store does without a locked instruction.
+ */
+static inline void
+bump(std::atomic<long>& counter)
+{
+	counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+static const char *pool_names[POOL_NUM] = {
+	"resource_req",
+	"resource_count",
+	"counts",
+	"nspec",
+	"schd_error"
+};
+
+/**
+ * @brief
+ *		pool_alloc - allocate an object of a pooled kind.  The object is
+ *		taken from the calling thread's free list if it has one.
+ *
+ * @param[in]	id	-	kind of object
+ * @param[in]	size	-	size of the object, the same for every call with id
+ *
+ * @return	void *
+ * @retval	zeroed object
+ * @retval	NULL	: calloc failed
+ *
+ * @par MT-Safe:	yes
+ */
+void *
+pool_alloc(enum sched_pool_id id, size_t size)
+{
+	std::vector<void *>& objs = cache.objs[id];
+
+	bump(cache.stats[id].allocs);
+	if (!objs.empty()) {
+		void *obj = objs.back();
+
+		objs.pop_back();
+		bump(cache.stats[id].reused);
+		memset(obj, 0, size);
+		return obj;
+	}
+
+	return calloc(1, size);
+}
+
+/**
+ * @brief
+ *		pool_free - put an object on the calling thread's free list, or
+ *		free it if the list is full.  The object may have been allocated
+ *		by another thread.
+ *
+ * @param[in]	id	-	kind of object
+ * @param[in]	obj	-	object allocated by pool_alloc() with the same id
+ *
+ * @return	void
+ *
+ * @par MT-Safe:	yes
+ */
+void
+pool_free(enum sched_pool_id id, void *obj)
+{
+	std::vector<void *>& objs = cache.objs[id];
+
+	if (obj == NULL)
+		return;
+
+	if (objs.size() < POOL_CACHE_MAX) {
+		objs.push_back(obj);
+		return;
+	}
+
+	bump(cache.stats[id].released);
+	free(obj);
+}
+
+/**
+ * @brief
+ *		log_pool_stats - log the allocation counters of each kind of object
+ *		since the last call.  The counters of all threads are summed.
+ *
+ * @return void
+ */
+void
+log_pool_stats(void)
+{
+	std::lock_guard<std::mutex> lk(caches_lock);
+
+	for (int i = 0; i < POOL_NUM; i++) {
+		pool_totals sum = retired[i];
+
+		for (auto c : caches) {
+			sum.allocs += c->stats[i].allocs.load(std::memory_order_relaxed);
+			sum.reused += c->stats[i].reused.load(std::memory_order_relaxed);
+			sum.released += c->stats[i].released.load(std::memory_order_relaxed);
+		}
+		long allocs = sum.allocs - reported[i].allocs;
+		long reused = sum.reused - reported[i].reused;
+		long released = sum.released - reported[i].released;
+		reported[i] = sum;
+
+		if (allocs == 0 && released == 0)
+			continue;
+		log_eventf(PBSEVENT_DEBUG2, PBS_EVENTCLASS_SCHED, LOG_DEBUG, __func__,
+			"%s: %ld allocated, %ld reused, %ld released", pool_names[i],
+			allocs, reused, released);
+	}
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 1994-2021 Altair Engineering, Inc.
+ * For more information, contact Altair at www.altair.com.
+ *
+ * This file is part of both the OpenPBS software ("OpenPBS")
+ * and the PBS Professional ("PBS Pro") software.
+ *
+ * Open Source License Information:
+ *
+ * OpenPBS is free software. You can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Commercial License Information:
+ *
+ * PBS Pro is commercially licensed software that shares a common core with
+ * the OpenPBS software.  For a copy of the commercial license terms and
+ * conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+ * Altair Legal Department.
+ *
+ * Altair's dual-license business model allows companies, individuals, and
+ * organizations to create proprietary derivative works of OpenPBS and
+ * distribute them - whether embedded or bundled with other software -
+ * under a commercial license agreement.
+ *
+ * Use of Altair's trademarks, including but not limited to "PBS™",
+ * "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+ * subject to Altair's trademark licensing policies.
+ */
+
+#ifndef	_MEM_POOL_H
+#define	_MEM_POOL_H
+
+#include <stddef.h>
+
+/*
+ * Object pools for the small structures the scheduler creates and throws
+ * away by the million every cycle.  Freed objects go on a per-thread free
+ * list and are handed out again by the next allocation of the same kind,
+ * so the query, dup and free paths mostly skip malloc() and free().  Each
+ * thread keeps at most POOL_CACHE_MAX objects of a kind and releases the
+ * rest to the system.
+ */
+
+/* objects of one kind a thread keeps on its free list */
+#define POOL_CACHE_MAX 65536
+
+enum sched_pool_id {
+	POOL_RESOURCE_REQ,
+	POOL_RESOURCE_COUNT,
+	POOL_COUNTS,
+	POOL_NSPEC,
+	POOL_SCHD_ERROR,
+	POOL_NUM
+};
+
+/* allocate a zeroed object of a pooled kind */
+void *pool_alloc(enum sched_pool_id id, size_t size);
+
+/* give an object back to its pool */
+void pool_free(enum sched_pool_id id, void *obj);
+
+/* log the allocation counters since the last call, and reset them */
+void log_pool_stats(void);
+
+#endif	/* _MEM_POOL_H */
@@ -58,6 +58,9 @@
 #include <pbs_share.h>
 #include <libutil.h>
 #include <libpbs.h>
+#include <mutex>
+#include <string>
+#include <unordered_set>
 #include "config.h"
 #include "constant.h"
 #include "misc.h"
@@ -65,6 +68,7 @@
 #include "fairshare.h"
 #include "resource_resv.h"
 #include "resource.h"
+#include "mem_pool.h"
 
 
 /**
@@ -97,6 +101,34 @@ string_dup(const char *str)
 	return newstr;
 }
 
+/**
+ * @brief
+ *		intern_name - return the scheduler's one copy of an entity name
+ *		(user, group or project).  Interned names are kept for the life of
+ *		the scheduler and are never freed.  Two interned names are equal
+ *		exactly when their pointers are equal.
+ *
+ * @param[in]	name	-	name to intern
+ *
+ * @return	const char *
+ * @retval	the interned copy of name
+ * @retval	NULL	: name is NULL
+ *
+ * @par MT-Safe:	yes
+ */
+const char *
+intern_name(const char *name)
+{
+	static std::unordered_set<std::string> names;
+	static std::mutex names_lock;
+
+	if (name == NULL)
+		return NULL;
+
+	std::lock_guard<std::mutex> lock(names_lock);
+	return names.insert(name).first->c_str();
+}
+
 /**
  * @brief
  * 		add a string to a string to a string array only if it is unique
@@ -926,7 +958,7 @@ clear_schd_error(schd_error *err)
 schd_error *
 new_schd_error() {
 	schd_error *err;
-	if ((err = static_cast<schd_error *>(calloc(1, sizeof(schd_error)))) == NULL) {
+	if ((err = static_cast<schd_error *>(pool_alloc(POOL_SCHD_ERROR, sizeof(schd_error)))) == NULL) {
 		log_err(errno, __func__, MEM_ERR_MSG);
 		return NULL;
 	}
@@ -1112,7 +1144,7 @@ free_schd_error(schd_error *err)
 
 	err->next = NULL; /* just incase people try and access freed memory */
 
-	free(err);
+	pool_free(POOL_SCHD_ERROR, err);
 }
 
 /**
@@ -1259,8 +1291,8 @@ void add_err(schd_error **prev_err, schd_error *err)
 char *
 res_to_str(void *p, enum resource_fields fld)
 {
-	static char *resbuf = NULL;
-	static int resbuf_size = 1024;
+	static thread_local char *resbuf = NULL;
+	static thread_local int resbuf_size = 1024;
 
 	if (resbuf == NULL) {
 		if ((resbuf = static_cast<char *>(malloc(resbuf_size))) == NULL)
@@ -53,6 +53,11 @@
  */
 char *string_dup(const char *str);
 
+/*
+ *	intern_name - return the scheduler's one copy of an entity name
+ */
+const char *intern_name(const char *name);
+
 /*
  *      res_to_num - convert a resource string to an integer in the lowest
  *                      form of resource on the machine (btye/word)
@@ -46,6 +46,12 @@
 #include <pthread.h>
 #include <errno.h>
 #include <signal.h>
+#include <time.h>
+
+#include <atomic>
+#include <deque>
+#include <map>
+#include <string>
 
 #include "log.h"
 #include "pbs_idx.h"
@@ -60,6 +66,33 @@
 #include "resource_resv.h"
 #include "multi_threading.h"
 
+/* Each worker owns a deque of tasks.  A worker takes tasks from the front of
+ * its own deque and steals from the back of the others' when it runs dry.
+ */
+struct th_deque
+{
+	pthread_mutex_t lock;
+	std::deque<th_task_info *> tasks;
+};
+
+/* timing counters for a kind of task */
+struct th_task_stats
+{
+	int tasks;
+	int stolen;
+	double secs;
+};
+
+static th_deque *deques = NULL;
+static int next_deque = 0;
+/* tasks queued and not yet picked up, workers sleep on work_cond when 0 */
+static std::atomic<int> tasks_pending(0);
+/* set while the main thread runs a parallel_for() */
+static int in_parallel_for = 0;
+
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static std::map<std::string, th_task_stats> task_stats;
+
 /**
  * @brief	create the thread id key & set it for the main thread
  *
@@ -112,12 +145,16 @@ kill_threads(void)
 	pthread_mutex_destroy(&result_lock);
 	pthread_cond_destroy(&result_cond);
 	pthread_mutex_destroy(&general_lock);
+	for (i = 0; i < num_threads; i++)
+		pthread_mutex_destroy(&deques[i].lock);
+	delete[] deques;
 	free(threads);
-	free_ds_queue(work_queue);
 	free_ds_queue(result_queue);
 	threads = NULL;
+	deques = NULL;
 	num_threads = 0;
-	work_queue = NULL;
+	next_deque = 0;
+	tasks_pending = 0;
 	result_queue = NULL;
 }
 
@@ -184,17 +221,17 @@ init_multi_threading(int nthreads)
 		return 0;
 	}
 
-	/* Create task and result queues */
-	work_queue = new_ds_queue();
-	if (work_queue == NULL) {
-		free(threads);
-		return 0;
-	}
+	/* Create the per-worker task deques and the result queue */
+	deques = new th_deque[num_threads];
+	for (i = 0; i < num_threads; i++)
+		pthread_mutex_init(&deques[i].lock, NULL);
 	result_queue = new_ds_queue();
 	if (result_queue == NULL) {
 		free(threads);
-		free_ds_queue(work_queue);
-		work_queue = NULL;
+		for (i = 0; i < num_threads; i++)
+			pthread_mutex_destroy(&deques[i].lock);
+		delete[] deques;
+		deques = NULL;
 		return 0;
 	}
 
@@ -205,9 +242,11 @@ init_multi_threading(int nthreads)
 		thid = static_cast<int *>(malloc(sizeof(int)));
 		if (thid == NULL) {
 			free(threads);
-			free_ds_queue(work_queue);
+			for (int j = 0; j < num_threads; j++)
+				pthread_mutex_destroy(&deques[j].lock);
+			delete[] deques;
+			deques = NULL;
 			free_ds_queue(result_queue);
-			work_queue = NULL;
 			result_queue = NULL;
 			log_err(errno, __func__, MEM_ERR_MSG);
 			return 0;
@@ -219,6 +258,134 @@ init_multi_threading(int nthreads)
 	return 1;
 }
 
+/**
+ * @brief	name of a task in the timing counters
+ *
+ * @param[in]	task - the task
+ *
+ * @return	const char *
+ */
+static const char *
+task_name(th_task_info *task)
+{
+	switch (task->task_type) {
+		case TS_IS_ND_ELIGIBLE:
+			return "check_node_eligibility_chunk";
+		case TS_QUERY_ND_INFO:
+			return "query_node_info_chunk";
+		case TS_DUP_RESRESV:
+			return "dup_resource_resv_array_chunk";
+		case TS_QUERY_JOB_INFO:
+			return "query_jobs_chunk";
+		case TS_PARALLEL_FOR:
+			return static_cast<th_data_parallel_for *>(task->thread_data)->name;
+	}
+	return "unknown";
+}
+
+/**
+ * @brief	take the next task to run.  Workers take from the front of their
+ *		own deque first, then steal from the back of the others' deques.
+ *
+ * @param[in]	self - index of the caller's deque, or -1 for the main thread
+ * @param[out]	stolen - set to 1 if the task came from another deque
+ *
+ * @return	th_task_info *
+ * @retval	NULL	: no task is queued
+ */
+static th_task_info *
+take_task(int self, int *stolen)
+{
+	th_task_info *task = NULL;
+	int i;
+
+	*stolen = 0;
+	if (self >= 0) {
+		pthread_mutex_lock(&deques[self].lock);
+		if (!deques[self].tasks.empty()) {
+			task = deques[self].tasks.front();
+			deques[self].tasks.pop_front();
+			tasks_pending--;
+		}
+		pthread_mutex_unlock(&deques[self].lock);
+		if (task != NULL)
+			return task;
+	}
+
+	for (i = 1; i <= num_threads; i++) {
+		int victim = (self + i) % num_threads;
+
+		if (victim < 0 || victim == self)
+			continue;
+		pthread_mutex_lock(&deques[victim].lock);
+		if (!deques[victim].tasks.empty()) {
+			task = deques[victim].tasks.back();
+			deques[victim].tasks.pop_back();
+			tasks_pending--;
+		}
+		pthread_mutex_unlock(&deques[victim].lock);
+		if (task != NULL) {
+			*stolen = 1;
+			return task;
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * @brief	run a task and account its time in the timing counters
+ *
+ * @param[in,out]	task - the task to run
+ * @param[in]	ntid - thread id of the caller
+ * @param[in]	stolen - the task was stolen from another deque
+ *
+ * @return void
+ */
+static void
+run_task(th_task_info *task, int ntid, int stolen)
+{
+	struct timespec start;
+	struct timespec end;
+	const char *name;
+
+	name = task_name(task);
+	log_eventf(PBSEVENT_DEBUG3, PBS_EVENTCLASS_SCHED, LOG_DEBUG, __func__,
+		"Thread %d calling %s()", ntid, name);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	switch (task->task_type) {
+		case TS_IS_ND_ELIGIBLE:
+			check_node_eligibility_chunk(static_cast<th_data_nd_eligible *>(task->thread_data));
+			break;
+		case TS_QUERY_ND_INFO:
+			query_node_info_chunk(static_cast<th_data_query_ninfo *>(task->thread_data));
+			break;
+		case TS_DUP_RESRESV:
+			dup_resource_resv_array_chunk(static_cast<th_data_dup_resresv *>(task->thread_data));
+			break;
+		case TS_QUERY_JOB_INFO:
+			query_jobs_chunk(static_cast<th_data_query_jinfo *>(task->thread_data));
+			break;
+		case TS_PARALLEL_FOR: {
+			auto data = static_cast<th_data_parallel_for *>(task->thread_data);
+			data->ret = (*data->func)(data->sidx, data->eidx);
+			break;
+		}
+		default:
+			log_event(PBSEVENT_ERROR, PBS_EVENTCLASS_SCHED, LOG_ERR, __func__,
+					"Invalid task type passed to worker thread");
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	pthread_mutex_lock(&stats_lock);
+	th_task_stats& st = task_stats[name];
+	st.tasks++;
+	st.stolen += stolen;
+	st.secs += (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+	pthread_mutex_unlock(&stats_lock);
+}
+
 /**
  * @brief	Main pthread routine for worker threads
  *
@@ -232,7 +399,7 @@ worker(void *tid)
 	th_task_info *work = NULL;
 	sigset_t set;
 	int ntid;
-	char buf[1024];
+	int stolen;
 
 	pthread_setspecific(th_id_key, tid);
 	ntid = *(int *)tid;
@@ -248,70 +415,31 @@ worker(void *tid)
 	}
 
 	while (!threads_die) {
-		/* Get the next work task from work queue */
-		pthread_mutex_lock(&work_lock);
-		while (ds_queue_is_empty(work_queue) && !threads_die) {
-			pthread_cond_wait(&work_cond, &work_lock);
-		}
-		work = static_cast<th_task_info *>(ds_dequeue(work_queue));
-		pthread_mutex_unlock(&work_lock);
-
-		/* find out what task we need to do */
-		if (work != NULL) {
-			switch (work->task_type) {
-			case TS_IS_ND_ELIGIBLE:
-				snprintf(buf, sizeof(buf), "Thread %d calling check_node_eligibility_chunk()", ntid);
-				log_event(PBSEVENT_DEBUG3, PBS_EVENTCLASS_SCHED, LOG_DEBUG, __func__, buf);
-				check_node_eligibility_chunk(static_cast<th_data_nd_eligible *>(work->thread_data));
-				break;
-			case TS_DUP_ND_INFO:
-				snprintf(buf, sizeof(buf), "Thread %d calling dup_node_info_chunk()", ntid);
-				log_event(PBSEVENT_DEBUG3, PBS_EVENTCLASS_SCHED, LOG_DEBUG, __func__, buf);
-				dup_node_info_chunk(static_cast<th_data_dup_nd_info *>(work->thread_data));
-				break;
-			case TS_QUERY_ND_INFO:
-				snprintf(buf, sizeof(buf), "Thread %d calling query_node_info_chunk()", ntid);
-				log_event(PBSEVENT_DEBUG3, PBS_EVENTCLASS_SCHED, LOG_DEBUG, __func__, buf);
-				query_node_info_chunk(static_cast<th_data_query_ninfo *>(work->thread_data));
-				break;
-			case TS_FREE_ND_INFO:
-				snprintf(buf, sizeof(buf), "Thread %d calling free_node_info_chunk()", ntid);
-				log_event(PBSEVENT_DEBUG3, PBS_EVENTCLASS_SCHED, LOG_DEBUG, __func__, buf);
-				free_node_info_chunk(static_cast<th_data_free_ninfo *>(work->thread_data));
-				break;
-			case TS_DUP_RESRESV:
-				snprintf(buf, sizeof(buf), "Thread %d calling dup_resource_resv_array_chunk()", ntid);
-				log_event(PBSEVENT_DEBUG3, PBS_EVENTCLASS_SCHED, LOG_DEBUG, __func__, buf);
-				dup_resource_resv_array_chunk(static_cast<th_data_dup_resresv *>(work->thread_data));
-				break;
-			case TS_QUERY_JOB_INFO:
-				snprintf(buf, sizeof(buf), "Thread %d calling query_jobs_chunk()", ntid);
-				log_event(PBSEVENT_DEBUG3, PBS_EVENTCLASS_SCHED, LOG_DEBUG, __func__, buf);
-				query_jobs_chunk(static_cast<th_data_query_jinfo *>(work->thread_data));
-				break;
-			case TS_FREE_RESRESV:
-				snprintf(buf, sizeof(buf), "Thread %d calling free_resource_resv_array_chunk()", ntid);
-				log_event(PBSEVENT_DEBUG3, PBS_EVENTCLASS_SCHED, LOG_DEBUG, __func__, buf);
-				free_resource_resv_array_chunk(static_cast<th_data_free_resresv *>(work->thread_data));
-				break;
-			default:
-				log_event(PBSEVENT_ERROR, PBS_EVENTCLASS_SCHED, LOG_ERR, __func__,
-						"Invalid task type passed to worker thread");
-			}
-
-			/* Post results */
-			pthread_mutex_lock(&result_lock);
-			ds_enqueue(result_queue, (void *) work);
-			pthread_cond_signal(&result_cond);
-			pthread_mutex_unlock(&result_lock);
+		/* thread ids start at 1, deques at 0 */
+		work = take_task(ntid - 1, &stolen);
+		if (work == NULL) {
+			pthread_mutex_lock(&work_lock);
+			while (tasks_pending <= 0 && !threads_die)
+				pthread_cond_wait(&work_cond, &work_lock);
+			pthread_mutex_unlock(&work_lock);
+			continue;
 		}
+
+		run_task(work, ntid, stolen);
+
+		/* Post results */
+		pthread_mutex_lock(&result_lock);
+		ds_enqueue(result_queue, (void *) work);
+		pthread_cond_signal(&result_cond);
+		pthread_mutex_unlock(&result_lock);
 	}
 
 	pthread_exit(NULL);
 }
 
 /**
- * @brief	Convenience function to queue up work for worker threads
+ * @brief	Convenience function to queue up work for worker threads.
+ *		Tasks are dealt out to the worker deques round robin.
  *
  * @param[in]	task - the task to queue up
  *
@@ -320,8 +448,169 @@ worker(void *tid)
 void
 queue_work_for_threads(th_task_info *task)
 {
+	th_deque *dq;
+
+	dq = &deques[next_deque];
+	next_deque = (next_deque + 1) % num_threads;
+
+	pthread_mutex_lock(&dq->lock);
+	dq->tasks.push_back(task);
+	pthread_mutex_unlock(&dq->lock);
+
 	pthread_mutex_lock(&work_lock);
-	ds_enqueue(work_queue, (void *) task);
+	tasks_pending++;
 	pthread_cond_signal(&work_cond);
 	pthread_mutex_unlock(&work_lock);
 }
+
+/**
+ * @brief	size of the chunks a parallel stage is cut into.  The items are
+ *		cut into MT_TASKS_PER_THREAD chunks per thread so threads which
+ *		finish early can steal from threads which got the expensive items.
+ *
+ * @param[in]	num_items - number of items in the stage
+ * @param[in]	min_chunk - smallest chunk worth handing to a thread
+ *
+ * @return	int
+ */
+int
+mt_chunk_size(int num_items, int min_chunk)
+{
+	int nthreads = (num_threads > 1) ? num_threads : 1;
+	int chunk_size;
+
+	chunk_size = (num_items + nthreads * MT_TASKS_PER_THREAD - 1) / (nthreads * MT_TASKS_PER_THREAD);
+	chunk_size = (chunk_size > min_chunk) ? chunk_size : min_chunk;
+	chunk_size = (chunk_size < MT_CHUNK_SIZE_MAX) ? chunk_size : MT_CHUNK_SIZE_MAX;
+
+	return chunk_size;
+}
+
+/**
+ * @brief	is the main thread running chunks of a parallel_for().  Stages
+ *		which queue their own tasks and wait on the result queue must run
+ *		inline then, or they would take the parallel_for()'s results.
+ *
+ * @return	int
+ * @retval	1	: inside a parallel_for()
+ * @retval	0	: not
+ */
+int
+inside_parallel_for(void)
+{
+	return in_parallel_for;
+}
+
+/**
+ * @brief	run func over the chunks of [0, num_items) on the worker threads.
+ *		The main thread runs chunks too while it waits.  If called from a
+ *		worker thread, from inside another parallel_for(), or with only
+ *		one thread, func is called once over all the items.
+ *
+ * @param[in]	name - name of the stage in the timing counters
+ * @param[in]	num_items - number of items
+ * @param[in]	min_chunk - smallest chunk to cut the items into
+ * @param[in]	func - called with the first and last index of each chunk
+ *
+ * @return	int
+ * @retval	0	: every call to func returned 0
+ * @retval	!0	: the first non-zero value func returned
+ */
+int
+parallel_for(const char *name, int num_items, int min_chunk,
+	const std::function<int(int, int)>& func)
+{
+	th_task_info *task;
+	int chunk_size;
+	int num_tasks = 0;
+	int done = 0;
+	int ret = 0;
+	int stolen;
+	int tid;
+	int i;
+
+	if (num_items <= 0)
+		return 0;
+
+	tid = *((int *) pthread_getspecific(th_id_key));
+	if (tid != 0 || num_threads <= 1 || in_parallel_for)
+		return func(0, num_items - 1);
+
+	chunk_size = mt_chunk_size(num_items, min_chunk);
+	in_parallel_for = 1;
+	for (i = 0; i < num_items; i += chunk_size) {
+		th_data_parallel_for *tdata;
+
+		tdata = static_cast<th_data_parallel_for *>(malloc(sizeof(th_data_parallel_for)));
+		task = static_cast<th_task_info *>(malloc(sizeof(th_task_info)));
+		if (tdata == NULL || task == NULL) {
+			free(tdata);
+			free(task);
+			log_err(errno, __func__, MEM_ERR_MSG);
+			/* run what is left of the stage ourselves */
+			ret = func(i, num_items - 1);
+			break;
+		}
+		tdata->func = &func;
+		tdata->name = name;
+		tdata->sidx = i;
+		tdata->eidx = (i + chunk_size < num_items) ? i + chunk_size - 1 : num_items - 1;
+		tdata->ret = 0;
+		task->task_id = num_tasks++;
+		task->task_type = TS_PARALLEL_FOR;
+		task->thread_data = (void *) tdata;
+
+		queue_work_for_threads(task);
+	}
+
+	while (done < num_tasks) {
+		/* help the workers out before waiting on them */
+		task = take_task(-1, &stolen);
+		if (task != NULL) {
+			run_task(task, 0, stolen);
+			auto tdata = static_cast<th_data_parallel_for *>(task->thread_data);
+			if (ret == 0)
+				ret = tdata->ret;
+			free(tdata);
+			free(task);
+			done++;
+			continue;
+		}
+
+		pthread_mutex_lock(&result_lock);
+		while (ds_queue_is_empty(result_queue))
+			pthread_cond_wait(&result_cond, &result_lock);
+		while (!ds_queue_is_empty(result_queue)) {
+			task = static_cast<th_task_info *>(ds_dequeue(result_queue));
+			auto tdata = static_cast<th_data_parallel_for *>(task->thread_data);
+			if (ret == 0)
+				ret = tdata->ret;
+			free(tdata);
+			free(task);
+			done++;
+		}
+		pthread_mutex_unlock(&result_lock);
+	}
+	in_parallel_for = 0;
+
+	return ret;
+}
+
+/**
+ * @brief	log the timing counters of the tasks run by the thread pool
+ *		since the last call, and reset them
+ *
+ * @return void
+ */
+void
+log_thread_stats(void)
+{
+	pthread_mutex_lock(&stats_lock);
+	for (const auto& st : task_stats) {
+		log_eventf(PBSEVENT_DEBUG2, PBS_EVENTCLASS_SCHED, LOG_DEBUG, __func__,
+			"%s: %d tasks, %d stolen, %.3f seconds",
+			st.first.c_str(), st.second.tasks, st.second.stolen, st.second.secs);
+	}
+	task_stats.clear();
+	pthread_mutex_unlock(&stats_lock);
+}
@@ -41,14 +41,77 @@
 #ifndef SRC_SCHEDULER_MULTI_THREADING_H_
 #define SRC_SCHEDULER_MULTI_THREADING_H_
 
+#include <functional>
+#include <vector>
+
 #include "data_types.h"
 
 #define MT_CHUNK_SIZE_MIN 1024
 #define MT_CHUNK_SIZE_MAX 8192
+/* smallest chunk for work whose cost varies a lot between items */
+#define MT_CHUNK_SIZE_MIN_UNEVEN 64
+/* chunks handed out per thread so idle threads have something to steal */
+#define MT_TASKS_PER_THREAD 4
+/* jobs main_sched_loop() checks ahead of time per thread */
+#define MT_SPEC_JOBS_PER_THREAD 8
 
 int init_multi_threading(int nthreads);
 void kill_threads(void);
 void *worker(void *);
 void queue_work_for_threads(th_task_info *task);
 
+/* size of the chunks a parallel stage over num_items is cut into */
+int mt_chunk_size(int num_items, int min_chunk);
+
+/*
+ * run func(sidx, eidx) over the chunks of [0, num_items) on the worker
+ * threads.  Returns 0 if every chunk returned 0.
+ */
+int parallel_for(const char *name, int num_items, int min_chunk,
+	const std::function<int(int, int)>& func);
+
+int inside_parallel_for(void);
+
+/* log and reset the per-task timing counters */
+void log_thread_stats(void);
+
+/**
+ * @brief	map each chunk of [0, num_items) to a partial result on the
+ *		worker threads and combine the partial results in chunk order
+ *
+ * @param[in]	name - name of the stage in the timing counters
+ * @param[in]	num_items - number of items
+ * @param[in]	min_chunk - smallest chunk to cut the items into
+ * @param[in]	identity - result of an empty chunk
+ * @param[in]	map_func - compute the partial result of items [sidx, eidx]
+ * @param[in]	reduce_func - combine two partial results
+ *
+ * @return	the combined result
+ */
+template <typename T>
+T
+parallel_reduce(const char *name, int num_items, int min_chunk, T identity,
+	const std::function<T(int, int)>& map_func,
+	const std::function<T(const T&, const T&)>& reduce_func)
+{
+	T result = identity;
+
+	if (num_items <= 0)
+		return result;
+
+	/* parallel_for() cuts the items into chunks of exactly this size */
+	int chunk_size = mt_chunk_size(num_items, min_chunk);
+	std::vector<T> partial((num_items + chunk_size - 1) / chunk_size, identity);
+
+	parallel_for(name, num_items, chunk_size, [&](int sidx, int eidx) {
+		partial[sidx / chunk_size] = map_func(sidx, eidx);
+		return 0;
+	});
+
+	for (const auto& p : partial)
+		result = reduce_func(result, p);
+
+	return result;
+}
+
 #endif /* SRC_SCHEDULER_MULTI_THREADING_H_ */
@@ -53,6 +53,8 @@
  * 	add_node_state()
  * 	node_filter()
  * 	find_node_info()
+ * 	index_node_resources()
+ * 	find_node_resource()
  * 	find_node_by_host()
  * 	dup_nodes()
  * 	dup_node_info()
@@ -78,6 +80,8 @@
  * 	is_vnode_eligible_chunk()
  * 	resources_avail_on_vnode()
  * 	check_resources_for_node()
+ * 	clear_parse_caches()
+ * 	age_parse_caches()
  * 	parse_placespec()
  * 	parse_selspec()
  * 	create_execvnode()
@@ -109,6 +113,8 @@
  *
  */
 
+#include <memory>
+#include <mutex>
 #include <unordered_map>
 
 #include <pbs_config.h>
@@ -148,13 +154,15 @@
 #include "pbs_bitmap.h"
 #include "pbs_license.h"
 #include "multi_threading.h"
+#include "mem_pool.h"
+#include "cycle_profile.h"
 #ifdef NAS
 #include "site_code.h"
 #endif
 
 
 /* name of the last node a job ran on - used in smp_dist = round robin */
-static char last_node_name[PBS_MAXSVRJOBID];
+static thread_local char last_node_name[PBS_MAXSVRJOBID];
 
 void
 query_node_info_chunk(th_data_query_ninfo *data)
@@ -250,6 +258,7 @@ alloc_tdata_nd_query(struct batch_status *nodes, server_info *sinfo, int sidx, i
 node_info **
 query_nodes(int pbs_sd, server_info *sinfo)
 {
+	prof_phase prof(__func__);
 	struct batch_status *nodes;		/* nodes returned from the server */
 	struct batch_status *cur_node;	/* used to cycle through nodes */
 	node_info **ninfo_arr;		/* array of nodes for scheduler's use */
@@ -316,7 +325,7 @@ query_nodes(int pbs_sd, server_info *sinfo)
 	}
 
 	tid = *((int *) pthread_getspecific(th_id_key));
-	if (tid != 0 || num_threads <= 1) {
+	if (tid != 0 || num_threads <= 1 || inside_parallel_for()) {
 		/* don't use multi-threading if I am a worker thread or num_threads is 1 */
 		tdata = alloc_tdata_nd_query(nodes, sinfo, 0, num_nodes - 1);
 		if (tdata == NULL) {
@@ -332,7 +341,7 @@ query_nodes(int pbs_sd, server_info *sinfo)
 
 		ninfo_arr[nidx] = NULL;
 	} else {
-		int chunk_size = num_nodes / num_threads;
+		int chunk_size = mt_chunk_size(num_nodes, MT_CHUNK_SIZE_MIN);
 		int th_err = 0;
 		int j;
 		int num_tasks;
@@ -342,7 +351,6 @@ query_nodes(int pbs_sd, server_info *sinfo)
 			return NULL;
 		}
 		ninfo_arr[0] = NULL;
-		chunk_size = (chunk_size > MT_CHUNK_SIZE_MIN) ? chunk_size : MT_CHUNK_SIZE_MIN;
 		for (j = 0, num_tasks = 0; num_nodes > 0;
 				j += chunk_size, num_tasks++, num_nodes -= chunk_size) {
 			tdata = alloc_tdata_nd_query(nodes, sinfo, j, j + chunk_size - 1);
@@ -616,6 +624,8 @@ query_node_info(struct batch_status *node, server_info *sinfo)
 	if (ninfo->lic_lock != 1)
 		ninfo->nscr |= NSCR_CYCLE_INELIGIBLE;
 
+	index_node_resources(ninfo);
+
 	return ninfo;
 }
 
@@ -725,35 +735,6 @@ free_node_info_chunk(th_data_free_ninfo *data)
 	}
 }
 
-/**
- * @brief	Allocates th_data_free_ninfo for multi-threading of free_nodes
- *
- * @param[in,out]	ninfo_arr	-	the node array to free
- * @param[in]	sidx	-	start index for the nodes array for the thread
- * @param[in]	eidx	-	end index for the nodes array for the thread
- *
- * @return th_data_free_ninfo *
- * @retval a newly allocated th_data_free_ninfo object
- * @retval NULL for malloc error
- */
-static inline th_data_free_ninfo *
-alloc_tdata_free_nodes(node_info **ninfo_arr, int sidx, int eidx)
-{
-	th_data_free_ninfo *tdata;
-
-	tdata = static_cast<th_data_free_ninfo *>(malloc(sizeof(th_data_free_ninfo)));
-	if (tdata == NULL) {
-		log_err(errno, __func__, MEM_ERR_MSG);
-		return NULL;
-	}
-
-	tdata->ninfo_arr = ninfo_arr;
-	tdata->sidx = sidx;
-	tdata->eidx = eidx;
-
-	return tdata;
-}
-
 /**
  * @brief
  *		free_nodes - free all the nodes in a node_info array
@@ -766,65 +747,15 @@ alloc_tdata_free_nodes(node_info **ninfo_arr, int sidx, int eidx)
 void
 free_nodes(node_info **ninfo_arr)
 {
-	int i;
-	int chunk_size;
-	th_data_free_ninfo *tdata = NULL;
-	th_task_info *task = NULL;
-	int num_tasks;
-	int num_nodes;
-	int tid;
-
 	if (ninfo_arr == NULL)
 		return;
 
-	num_nodes = count_array(ninfo_arr);
-
-	tid = *((int *) pthread_getspecific(th_id_key));
-	if (tid != 0 || num_threads <= 1) {
-		/* don't use multi-threading if I am a worker thread or num_threads is 1 */
-		tdata = alloc_tdata_free_nodes(ninfo_arr, 0, num_nodes - 1);
-		if (tdata == NULL)
-			return;
-
-		free_node_info_chunk(tdata);
-		free(tdata);
-		free(ninfo_arr);
-		return;
-	}
-	chunk_size = num_nodes / num_threads;
-	chunk_size = (chunk_size > MT_CHUNK_SIZE_MIN) ? chunk_size : MT_CHUNK_SIZE_MIN;
-	for (i = 0, num_tasks = 0; num_nodes > 0;
-			num_tasks++, i += chunk_size, num_nodes -= chunk_size) {
-		tdata = alloc_tdata_free_nodes(ninfo_arr, i, i + chunk_size - 1);
-		if (tdata == NULL)
-			break;
-
-		task = static_cast<th_task_info *>(malloc(sizeof(th_task_info)));
-		if (task == NULL) {
-			free(tdata);
-			log_err(errno, __func__, MEM_ERR_MSG);
-			break;
-		}
-		task->task_type = TS_FREE_ND_INFO;
-		task->thread_data = (void *) tdata;
-
-		queue_work_for_threads(task);
-	}
-
-	/* Get results from worker threads */
-	for (i = 0; i < num_tasks;) {
-		pthread_mutex_lock(&result_lock);
-		while (ds_queue_is_empty(result_queue))
-			pthread_cond_wait(&result_cond, &result_lock);
-		while (!ds_queue_is_empty(result_queue)) {
-			task = static_cast<th_task_info *>(ds_dequeue(result_queue));
-			tdata = static_cast<th_data_free_ninfo *>(task->thread_data);
-			free(tdata);
-			free(task);
-			i++;
-		}
-		pthread_mutex_unlock(&result_lock);
-	}
+	parallel_for("free_nodes", count_array(ninfo_arr), MT_CHUNK_SIZE_MIN,
+		[ninfo_arr](int sidx, int eidx) {
+			th_data_free_ninfo tdata = {ninfo_arr, sidx, eidx};
+			free_node_info_chunk(&tdata);
+			return 0;
+		});
 	free(ninfo_arr);
 }
 
@@ -1118,6 +1049,55 @@ find_node_info(node_info **ninfo_arr, const std::string& nodename)
 	return ninfo_arr[i];
 }
 
+/**
+ * @brief
+ *		index_node_resources - build the index of a node's consumable
+ *		resources by resdef ordinal.  It needs to be rebuilt whenever a
+ *		resource is added to the node's resource list.
+ *
+ * @param[in]	ninfo	-	node to index
+ *
+ * @return	void
+ */
+void
+index_node_resources(node_info *ninfo)
+{
+	if (ninfo == NULL)
+		return;
+
+	ninfo->res_ind.assign(consres.size(), NULL);
+	for (auto res = ninfo->res; res != NULL; res = res->next) {
+		if (res->def != NULL && res->def->ordinal >= 0 &&
+		    static_cast<size_t>(res->def->ordinal) < ninfo->res_ind.size())
+			ninfo->res_ind[res->def->ordinal] = res;
+	}
+}
+
+/**
+ * @brief
+ *		find_node_resource - find a resource on a node.  Consumable
+ *		resources are looked up through the node's ordinal index rather
+ *		than by walking the resource list.
+ *
+ * @param[in]	ninfo	-	node to search
+ * @param[in]	def	-	resource definition to search for
+ *
+ * @return	schd_resource *
+ * @retval	the found resource
+ * @retval	NULL	: if not found
+ */
+schd_resource *
+find_node_resource(node_info *ninfo, resdef *def)
+{
+	if (ninfo == NULL || def == NULL)
+		return NULL;
+
+	if (def->ordinal >= 0 && static_cast<size_t>(def->ordinal) < ninfo->res_ind.size())
+		return ninfo->res_ind[def->ordinal];
+
+	return find_resource(ninfo->res, def);
+}
+
 /**
  * @brief
  *		find_node_by_host - find a node by its host resource rather then
@@ -1184,41 +1164,6 @@ dup_node_info_chunk(th_data_dup_nd_info *data)
 
 }
 
-/**
- * @brief	Allocates th_data_dup_nd_info for multi-threading of dup_nodes
- *
- * @param[in]	flags	-	flags passed to dup_nodes
- * @param[in]	nsinfo	-	the new server
- * @param[in]	onodes	-	the array to duplicate
- * @param[out]	nnodes	-	the duplicated array
- * @param[in]	sidx	-	start index for the nodes list for the thread
- * @param[in]	eidx	-	end index for the nodes list for the thread
- *
- * @return th_data_dup_nd_info *
- * @retval a newly allocated th_data_dup_nd_info object
- * @retval NULL for malloc error
- */
-static inline th_data_dup_nd_info *
-alloc_tdata_dup_nodes(unsigned int flags, server_info *nsinfo, node_info **onodes, node_info **nnodes,
-		int sidx, int eidx)
-{
-	th_data_dup_nd_info *tdata;
-
-	tdata = static_cast<th_data_dup_nd_info *>(malloc(sizeof(th_data_dup_nd_info)));
-	if (tdata == NULL) {
-		log_err(errno, __func__, MEM_ERR_MSG);
-		return NULL;
-	}
-	tdata->flags = flags;
-	tdata->nsinfo = nsinfo;
-	tdata->onodes = onodes;
-	tdata->nnodes = nnodes;
-	tdata->sidx = sidx;
-	tdata->eidx = eidx;
-
-	return tdata;
-}
-
 /**
  * @brief
  *		dup_nodes - duplicate an array of nodes
@@ -1237,82 +1182,35 @@ dup_nodes(node_info **onodes, server_info *nsinfo, unsigned int flags)
 {
 	node_info **nnodes;
 	int num_nodes;
-	int thread_node_ct_left;
 	schd_resource *nres = NULL;
 	schd_resource *ores = NULL;
 	schd_resource *tres = NULL;
 	node_info *ninfo = NULL;
-	th_data_dup_nd_info *tdata = NULL;
-	th_task_info *task = NULL;
 	int th_err = 0;
-	int tid;
 
 	if (onodes == NULL || nsinfo == NULL)
 		return NULL;
 
-	num_nodes = thread_node_ct_left = count_array(onodes);
+	num_nodes = count_array(onodes);
 
 	if ((nnodes = static_cast<node_info **>(malloc((num_nodes + 1) * sizeof(node_info *)))) == NULL) {
 		log_err(errno, __func__, MEM_ERR_MSG);
 		return NULL;
 	}
 
-	tid = *((int *) pthread_getspecific(th_id_key));
-	if (tid != 0 || num_threads <= 1) {
-		/* don't use multi-threading if I am a worker thread or num_threads is 1 */
-		tdata = alloc_tdata_dup_nodes(flags, nsinfo, onodes, nnodes, 0, num_nodes - 1);
-		if (tdata == NULL) {
-			free_nodes(nnodes);
-			log_err(errno, __func__, MEM_ERR_MSG);
-			return NULL;
-		}
+	th_err = parallel_for("dup_nodes", num_nodes, MT_CHUNK_SIZE_MIN,
+		[=](int sidx, int eidx) {
+			th_data_dup_nd_info tdata;
 
-		dup_node_info_chunk(tdata);
-		th_err = tdata->error;
-		free(tdata);
-	} else { /* We are multithreading */
-		int j;
-		int num_tasks;
-		int chunk_size = num_nodes / num_threads;
-		chunk_size = (chunk_size > MT_CHUNK_SIZE_MIN) ? chunk_size : MT_CHUNK_SIZE_MIN;
-		for (j = 0, num_tasks = 0; thread_node_ct_left > 0;
-				num_tasks++, j+= chunk_size, thread_node_ct_left -= chunk_size) {
-			tdata = alloc_tdata_dup_nodes(flags, nsinfo, onodes, nnodes, j, j + chunk_size - 1);
-			if (tdata == NULL) {
-				th_err = 1;
-				break;
-			}
-			task = static_cast<th_task_info *>(malloc(sizeof(th_task_info)));
-			if (task == NULL) {
-				free(tdata);
-				th_err = 1;
-				log_err(errno, __func__, MEM_ERR_MSG);
-				break;
-
-			}
-			task->task_type = TS_DUP_ND_INFO;
-			task->thread_data = (void *) tdata;
-
-			queue_work_for_threads(task);
-		}
-
-		/* Get results from worker threads */
-		for (int i = 0; i < num_tasks;) {
-			pthread_mutex_lock(&result_lock);
-			while (ds_queue_is_empty(result_queue))
-				pthread_cond_wait(&result_cond, &result_lock);
-			while (!ds_queue_is_empty(result_queue)) {
-				task = static_cast<th_task_info *>(ds_dequeue(result_queue));
-				tdata = static_cast<th_data_dup_nd_info *>(task->thread_data);
-				if (tdata->error)
-					th_err = 1;
-				free(tdata);
-				free(task);
-				i++;
-			}
-			pthread_mutex_unlock(&result_lock);
-		}
-	}
+			tdata.flags = flags;
+			tdata.nsinfo = nsinfo;
+			tdata.onodes = onodes;
+			tdata.nnodes = nnodes;
+			tdata.sidx = sidx;
+			tdata.eidx = eidx;
+			dup_node_info_chunk(&tdata);
+			return tdata.error ? 1 : 0;
+		});
 
 	if (th_err) {
 		free_nodes(nnodes);
@@ -1443,6 +1341,7 @@ dup_node_info(node_info *onode, server_info *nsinfo, unsigned int flags)
 		nnode->res = dup_ind_resource_list(onode->res);
 	else
 		nnode->res = dup_resource_list(onode->res);
+	index_node_resources(nnode);
 
 	nnode->max_running = onode->max_running;
 	nnode->max_user_run = onode->max_user_run;
@@ -1585,6 +1484,7 @@ collect_resvs_on_nodes(node_info **ninfo_arr, resource_resv **resresv_arr, int s
 int
 collect_jobs_on_nodes(node_info **ninfo_arr, resource_resv **resresv_arr, int size, int flags)
 {
+	prof_phase prof(__func__);
 	char *ptr;		/* used to find the '/' in the jobs array */
 	resource_resv *job;	/* find the job from the jobs array */
 	resource_resv **susp_jobs = NULL; 	/* list of suspended jobs */
@@ -1773,7 +1673,7 @@ update_node_on_run(nspec *ns, resource_resv *resresv, const char *job_state)
 		if (resreq->type.is_consumable) {
 			schd_resource *res;
 
-			res = find_resource(ninfo->res, resreq->def);
+			res = find_node_resource(ninfo, resreq->def);
 
 			if (res != NULL) {
 				if (res->indirect_res != NULL)
@@ -1892,6 +1792,8 @@ update_node_on_end(node_info *ninfo, resource_resv *resresv, const char *job_sta
 	if (ninfo->is_offline || ninfo->is_down)
 		return;
 
+	set_nodepart_stale(ninfo->server, ninfo);
+
 	if (resresv->is_job) {
 		ninfo->num_jobs--;
 		if (ninfo->num_jobs < 0)
@@ -1933,7 +1835,7 @@ update_node_on_end(node_info *ninfo, resource_resv *resresv, const char *job_sta
 			}
 			while (resreq != NULL) {
 				if (resreq->type.is_consumable) {
-					res = find_resource(ninfo->res, resreq->def);
+					res = find_node_resource(ninfo, resreq->def);
 					if (res != NULL) {
 						if (res->indirect_res != NULL)
 							res = res->indirect_res;
@@ -1992,7 +1894,7 @@ new_nspec()
 {
 	nspec *ns;
 
-	if ((ns = static_cast<nspec *>(malloc(sizeof(nspec)))) == NULL) {
+	if ((ns = static_cast<nspec *>(pool_alloc(POOL_NSPEC, sizeof(nspec)))) == NULL) {
 		log_err(errno, __func__, MEM_ERR_MSG);
 		return NULL;
 	}
@@ -2026,7 +1928,7 @@ free_nspec(nspec *ns)
 	if (ns->resreq != NULL)
 		free_resource_req_list(ns->resreq);
 
-	free(ns);
+	pool_free(POOL_NSPEC, ns);
 }
 
 /**
@@ -2230,7 +2132,7 @@ eval_selspec(status *policy, selspec *spec, place *placespec,
 	int pass_flags = NO_FLAGS;
 	char reason[MAX_LOG_SIZE] = {0};
 	int i = 0;
-	static struct schd_error *failerr = NULL;
+	static thread_local struct schd_error *failerr = NULL;
 	nspec **tmp;
 
 	if (spec == NULL || ninfo_arr == NULL || resresv == NULL || placespec == NULL || nspec_arr == NULL)
@@ -2432,7 +2334,7 @@ eval_placement(status *policy, selspec *spec, node_info **ninfo_arr, place *pl,
 	schd_resource		*res = NULL;
 	selspec			*dselspec = NULL;
 	node_info		**nptr = NULL;
-	static schd_error	*failerr = NULL;
+	static thread_local schd_error	*failerr = NULL;
 
 	if (spec == NULL || ninfo_arr == NULL || pl == NULL || resresv == NULL || nspec_arr == NULL)
 		return 0;
@@ -2907,7 +2809,7 @@ eval_complex_selspec(status *policy, selspec *spec, node_info **ninfo_arr, place
 				else {
 					req = (*nsa)->resreq;
 					while (req != NULL) {
-						res = find_resource((*nsa)->ninfo->res, req->def);
+						res = find_node_resource((*nsa)->ninfo, req->def);
 						if (res != NULL)
 							res->assigned += req->amount;
 
@@ -2995,7 +2897,7 @@ eval_simple_selspec(status *policy, chunk *chk, node_info **pninfo_arr,
 
 	node_info	**ninfo_arr = NULL;
 
-	static schd_error *failerr = NULL;
+	static thread_local schd_error *failerr = NULL;
 
 	resource_req	*aoereq = NULL;
 
@@ -3184,7 +3086,7 @@ eval_simple_selspec(status *policy, chunk *chk, node_info **pninfo_arr,
 			 * because the chunk is pretty much equivalent to ncpus=1 at that point
 			 */
 			if (ninfo_arr[i]->nodesig_ind >= 0 && !(flags & EVAL_OKBREAK)) {
-				if (check_avail_resources(ninfo_arr[i]->res, chk->req,
+				if (check_avail_resources(ninfo_arr[i], chk->req,
 					COMPARE_TOTAL | UNSET_RES_ZERO | CHECK_ALL_BOOLS,
 					policy->resdef_to_check_no_hostvnode,
 					INSUFFICIENT_RESOURCE, err) == 0) {
@@ -3276,6 +3178,8 @@ is_vnode_eligible(node_info *node, resource_resv *resresv,
 	if (node == NULL || resresv == NULL || pl == NULL || err == NULL)
 		return 0;
 
+	prof_count(PROF_NODES_PROBED);
+
 	/* A node is invalid for an exclusive job if jobs/resvs are running on it
 	 * NOTE: this check must be the first check or exclhost may break
 	 */
@@ -3384,7 +3288,7 @@ is_vnode_eligible_chunk(resource_req *specreq, node_info *node,
 	}
 
 	if (specreq != NULL) {
-		if (check_avail_resources(node->res, specreq,
+		if (check_avail_resources(node, specreq,
 				CHECK_ALL_BOOLS | ONLY_COMP_NONCONS | UNSET_RES_ZERO,
 				INSUFFICIENT_RESOURCE, err) == 0) {
 			return 0;
@@ -3578,7 +3482,7 @@ resources_avail_on_vnode(resource_req *specreq_cons, node_info *node,
 					 */
 					req->amount -= num_chunks;
 
-					auto res = find_resource(node->res, req->def);
+					auto res = find_node_resource(node, req->def);
 					if (res != NULL) {
 						if (res->indirect_res != NULL)
 							res->indirect_res->assigned += num_chunks;
@@ -3691,14 +3595,10 @@ check_resources_for_node(resource_req *resreq, node_info *ninfo,
 
 	time_t end_time;
 
-	timed_event *event;
-
 	if (resreq == NULL || ninfo == NULL || err == NULL || resresv == NULL)
 		return -1;
 
-	auto noderes = ninfo->res;
-
-	min_chunks = check_avail_resources(noderes, resreq,
+	min_chunks = check_avail_resources(ninfo, resreq,
 		CHECK_ALL_BOOLS|UNSET_RES_ZERO, INSUFFICIENT_RESOURCE, err);
 
 	if (chunks != UNSPECIFIED && (min_chunks == SCHD_INFINITY || chunks < min_chunks))
@@ -3727,71 +3627,72 @@ check_resources_for_node(resource_req *resreq, node_info *ninfo,
 		 * from t1 to t2, then the resources should be taken out at t1 and returned
 		 * at t2.
 		 */
-		auto nres = dup_ind_resource_list(noderes);
+		auto nres = dup_ind_resource_list(ninfo->res);
 		auto resresv_excl = is_excl(resresv->place_spec, ninfo->sharing);
 
 		if (nres != NULL) {
-			/* Walk the event list by time such that the start of an event always
+			/* Walk the node's events by time such that the start of an event always
 			 * precedes the end of it. The event type (start or end event) is
 			 * determined, and the resources are consumed if a start event, and
 			 * released if an end event.
 			 */
-			event = get_next_event(calendar);
-			const auto event_mask = TIMED_RUN_EVENT | TIMED_END_EVENT;
+			std::vector<timed_event *> events;
+
+			calendar_node_events(calendar, ninfo, end_time, events);
 
-			for (event = find_init_timed_event(event, IGNORE_DISABLED_EVENTS, event_mask);
-				event != NULL && min_chunks > 0;
-				event = find_next_timed_event(event, IGNORE_DISABLED_EVENTS, event_mask)) {
-				auto event_time = event->event_time;
+			for (auto event : events) {
 				auto resc_resv = static_cast<resource_resv *>(event->event_ptr);
 				nspec *ns;
+				int i;
 
-				if (event_time < cur_time)
+				if (min_chunks <= 0)
+					break;
+				if (event->event_time < cur_time)
 					continue;
 				if (resc_resv->job != NULL && resc_resv->job->resv != NULL)
 					continue;
+				if (resresv == resc_resv)
+					continue;
 
-				if (resc_resv->nspec_arr != NULL) {
-					int i;
-					for (i = 0; resc_resv->nspec_arr[i] != NULL &&
-							resc_resv->nspec_arr[i]->ninfo->rank != ninfo->rank; i++)
-						;
-					ns = resc_resv->nspec_arr[i];
-				} else {
-					ns = NULL;
+				if (resc_resv->nspec_arr == NULL) {
 					log_eventf(PBSEVENT_SCHED, PBS_EVENTCLASS_SCHED, LOG_WARNING, resresv->name,
 						"Event %s is a run/end event w/o nspec array, ignoring event", event->name.c_str());
+					continue;
 				}
+				for (i = 0; resc_resv->nspec_arr[i] != NULL &&
+						resc_resv->nspec_arr[i]->ninfo->rank != ninfo->rank; i++)
+					;
+				ns = resc_resv->nspec_arr[i];
+				if (ns == NULL)
+					continue;
 
 				auto is_run_event = (event->event_type == TIMED_RUN_EVENT);
 
-				if ((event_time < end_time) && resresv != resc_resv && ns != NULL) {
-					/* One event will need provisioning while the other will not,
-					 * they cannot co exist at same time.
-					 */
-					if (resresv->aoename != NULL && resc_resv->aoename == NULL) {
-						set_schd_error_codes(err, NOT_RUN, PROV_RESRESV_CONFLICT);
-						min_chunks = 0;
-						break;
-					}
+				/* One event will need provisioning while the other will not,
+				 * they cannot co exist at same time.
+				 */
+				if (resresv->aoename != NULL && resc_resv->aoename == NULL) {
+					set_schd_error_codes(err, NOT_RUN, PROV_RESRESV_CONFLICT);
+					min_chunks = 0;
+					break;
+				}
 
-					if (is_excl(resc_resv->place_spec, ninfo->sharing) || resresv_excl) {
-						min_chunks = 0;
-					} else {
-						for (auto cur_res = nres; cur_res  != NULL; cur_res = cur_res->next) {
-							if (cur_res->type.is_consumable) {
-								auto req = find_resource_req(ns->resreq, cur_res->def);
-								if (req != NULL) {
-									cur_res->assigned += is_run_event ? req->amount : -req->amount;
-								}
+				if (is_excl(resc_resv->place_spec, ninfo->sharing) || resresv_excl) {
+					min_chunks = 0;
+				} else {
+					for (auto cur_res = nres; cur_res  != NULL; cur_res = cur_res->next) {
+						if (cur_res->type.is_consumable) {
+							auto req = find_resource_req(ns->resreq, cur_res->def);
+							if (req != NULL) {
+								cur_res->assigned += is_run_event ? req->amount : -req->amount;
 							}
 						}
-						if (is_run_event) {
-							chunks = check_avail_resources(nres, resreq,
-								CHECK_ALL_BOOLS|UNSET_RES_ZERO, INSUFFICIENT_RESOURCE, err);
-							if (chunks < min_chunks)
-								min_chunks = chunks;
-						}
+					}
+					if (is_run_event) {
+						chunks = check_avail_resources(nres, resreq,
+							CHECK_ALL_BOOLS|UNSET_RES_ZERO, INSUFFICIENT_RESOURCE, err);
+						if (chunks < min_chunks)
+							min_chunks = chunks;
 					}
 				}
 			}
@@ -3855,6 +3756,131 @@ compare_place(place *pl1, place *pl2)
 	return 1;
 }
 
+/*
+ * Parsed select, place and exec_vnode specs, keyed by the spec string.
+ * Most jobs share a handful of select and place specs and a running job's
+ * exec_vnode does not change between cycles, so each distinct string is
+ * parsed once.  The parsed templates are never modified after they are
+ * cached.  They point at resource definitions, so they are thrown away
+ * whenever the definitions are updated.
+ */
+template<typename T>
+class parse_cache
+{
+	public:
+	explicit parse_cache(const char *n) : name(n) {}
+
+	/* find the template for a spec and mark it used this cycle */
+	std::shared_ptr<T> find(const std::string& key)
+	{
+		std::lock_guard<std::mutex> lk(lock);
+		auto e = ents.find(key);
+		if (e == ents.end()) {
+			misses++;
+			return NULL;
+		}
+		hits++;
+		e->second.last_used = gen;
+		return e->second.tmpl;
+	}
+
+	void insert(const std::string& key, const std::shared_ptr<T>& tmpl)
+	{
+		std::lock_guard<std::mutex> lk(lock);
+		ents.emplace(key, entry{tmpl, gen});
+	}
+
+	void clear()
+	{
+		std::lock_guard<std::mutex> lk(lock);
+		ents.clear();
+	}
+
+	/* log this cycle's counters and drop the templates that were not used */
+	void age()
+	{
+		std::lock_guard<std::mutex> lk(lock);
+		if (hits != 0 || misses != 0)
+			log_eventf(PBSEVENT_DEBUG2, PBS_EVENTCLASS_SCHED, LOG_DEBUG, "age_parse_caches",
+				"%s: %ld hits, %ld misses, %zu cached", name, hits, misses, ents.size());
+		for (auto e = ents.begin(); e != ents.end();) {
+			if (e->second.last_used != gen)
+				e = ents.erase(e);
+			else
+				++e;
+		}
+		hits = 0;
+		misses = 0;
+		gen++;
+	}
+
+	private:
+	struct entry {
+		std::shared_ptr<T> tmpl;
+		unsigned long last_used;
+	};
+	const char *name;
+	std::unordered_map<std::string, entry> ents;
+	std::mutex lock;
+	unsigned long gen = 0;
+	long hits = 0;
+	long misses = 0;
+};
+
+/* one vnode of a parsed exec_vnode, before it is bound to a node_info */
+struct exec_vnode_el
+{
+	std::string node_name;
+	resource_req *req;
+	bool end_of_chunk;
+};
+
+struct exec_vnode_tmpl
+{
+	int num_paren = 0;
+	std::vector<exec_vnode_el> els;
+	~exec_vnode_tmpl()
+	{
+		for (auto& el : els)
+			free_resource_req_list(el.req);
+	}
+};
+
+/* never destroyed: the templates can't be freed after the memory pools are gone */
+static parse_cache<selspec>& selspec_cache = *new parse_cache<selspec>("select");
+static parse_cache<place>& place_cache = *new parse_cache<place>("place");
+static parse_cache<exec_vnode_tmpl>& exec_vnode_cache = *new parse_cache<exec_vnode_tmpl>("exec_vnode");
+
+/**
+ * @brief
+ *		clear_parse_caches - forget all parsed select, place and
+ *		exec_vnode specs.  Called when the resource definitions change.
+ *
+ * @return	void
+ */
+void
+clear_parse_caches(void)
+{
+	selspec_cache.clear();
+	place_cache.clear();
+	exec_vnode_cache.clear();
+}
+
+/**
+ * @brief
+ *		age_parse_caches - called at the end of a cycle.  Log how well the
+ *		parse caches did and drop the specs nothing used this cycle.
+ *
+ * @return	void
+ */
+void
+age_parse_caches(void)
+{
+	selspec_cache.age();
+	place_cache.age();
+	exec_vnode_cache.age();
+}
+
 /**
  * @brief
  *		parse_placespec - allocate a new place structure and parse
@@ -3879,6 +3905,10 @@ parse_placespec(char *place_str)
 	if (place_str == NULL)
 		return NULL;
 
+	auto tmpl = place_cache.find(place_str);
+	if (tmpl != NULL)
+		return dup_place(tmpl.get());
+
 	pl = new_place();
 
 	if (pl == NULL)
@@ -3935,6 +3965,10 @@ parse_placespec(char *place_str)
 		return NULL;
 	}
 
+	place *cpl = dup_place(pl);
+	if (cpl != NULL)
+		place_cache.insert(place_str, std::shared_ptr<place>(cpl, free_place));
+
 	return pl;
 }
 
@@ -3987,6 +4021,18 @@ parse_selspec(const std::string& sspec)
 
 	const char *select_spec = sspec.c_str();
 
+	/* chunks of different jobs need their own sequence numbers */
+	auto tmpl = selspec_cache.find(sspec);
+	if (tmpl != NULL) {
+		spec = new selspec(*tmpl);
+		if (spec->chunks != NULL) {
+			for (i = 0; spec->chunks[i] != NULL; i++)
+				spec->chunks[i]->seq_num = get_sched_rank();
+			return spec;
+		}
+		delete spec;
+	}
+
 	if ((spec = new selspec()) == NULL)
 		return NULL;
 
@@ -4086,6 +4132,13 @@ parse_selspec(const std::string& sspec)
 
 	free(specbuf);
 
+	/* a chunk left with no resources after res_to_check can't be copied */
+	auto cspec = new selspec(*spec);
+	if (cspec->chunks != NULL)
+		selspec_cache.insert(sspec, std::shared_ptr<selspec>(cspec));
+	else
+		delete cspec;
+
 	return spec;
 }
 
@@ -4156,10 +4209,10 @@ int compare_selspec(selspec *s1, selspec *s2) {
 char *
 create_execvnode(nspec **ns)
 {
-	static char *execvnode = NULL;
-	static int execvnode_size = 0;
-	static char *buf = NULL;
-	static int bufsize = 0;
+	static thread_local char *execvnode = NULL;
+	static thread_local int execvnode_size = 0;
+	static thread_local char *buf = NULL;
+	static thread_local int bufsize = 0;
 	char buf2[128];
 	resource_req *req;
 	int end_of_chunk = 1;
@@ -4239,10 +4292,96 @@ create_execvnode(nspec **ns)
 	return execvnode;
 }
 
+/**
+ * @brief
+ *		parse_exec_vnode_tmpl - parse the node independent parts of an
+ *		execvnode: the vnode names, their resources and where the chunks end
+ *
+ * @param[in]	execvnode	-	the execvnode to parse
+ *
+ * @return	exec_vnode_tmpl *
+ * @retval	NULL	: invalid execvnode
+ */
+static exec_vnode_tmpl *
+parse_exec_vnode_tmpl(const char *execvnode)
+{
+	char *simplespec;
+	char *excvndup;
+	char *node_name;
+	char *tailptr = NULL;
+	int num_el;
+	int nlkv = 0;
+	int hp;
+	int in_superchunk = 0;
+	int invalid = 0;
+	struct key_value_pair *kv = NULL;
+	exec_vnode_tmpl *tmpl;
+	const char *p;
+
+	if ((tmpl = new exec_vnode_tmpl()) == NULL)
+		return NULL;
+
+	for (p = execvnode; *p != '\0'; p++)
+		if (*p == '(')
+			tmpl->num_paren++;
+
+	if ((excvndup = string_dup(execvnode)) == NULL) {
+		delete tmpl;
+		return NULL;
+	}
+
+	simplespec = parse_plus_spec_r(excvndup, &tailptr, &hp);
+	if (simplespec == NULL)
+		invalid = 1;
+
+	while (simplespec != NULL && !invalid) {
+		exec_vnode_el el = {"", NULL, false};
+
+		if (hp > 0) /* simplespec starts with '(' but doesn't end with ')' */
+			in_superchunk = 1;
+		else if (hp < 0) /* simplespec ends with ')' but does not start with '(' */
+			in_superchunk = 0;
+		/* hp == 0 simplespec either starts and ends with '(' ')' or has neither */
+
+		if (parse_node_resc_r(simplespec, &node_name, &num_el, &nlkv, &kv) != 0) {
+			invalid = 1;
+			break;
+		}
+
+		el.node_name = node_name;
+		el.end_of_chunk = !in_superchunk || hp < 0;
+		tmpl->els.push_back(el);
+		for (int j = 0; j < num_el; j++) {
+			resource_req *req = create_resource_req(kv[j].kv_keyw, kv[j].kv_val);
+			if (req == NULL) {
+				invalid = 1;
+				break;
+			}
+			req->next = tmpl->els.back().req;
+			tmpl->els.back().req = req;
+		}
+
+		simplespec = parse_plus_spec_r(tailptr, &tailptr, &hp);
+	}
+
+	free(kv);
+	free(excvndup);
+
+	if (invalid) {
+		delete tmpl;
+		return NULL;
+	}
+
+	return tmpl;
+}
+
 /**
  * @brief
  *		parse_execvnode - parse an execvnode into an nspec array
  *
+ * @par	The node independent parse of an execvnode is cached across cycles.
+ *		Only the vnodes and select chunks are looked up on each call.
+ *
  * @param[in]	execvnode	-	the execvnode to parse
  * @param[in]	sinfo		-	server to get the nodes from
  * @param[in]	sel			- select to map
@@ -4253,148 +4392,86 @@ create_execvnode(nspec **ns)
 nspec **
 parse_execvnode(char *execvnode, server_info *sinfo, selspec *sel)
 {
-	char *simplespec;
-	char *excvndup;
-	char *node_name;
-	int num_el;
-	struct key_value_pair *kv = NULL;
-
 	nspec **nspec_arr;
 	node_info *ninfo;
-	resource_req *req;
-	int i, j;
-
+	int i;
 	int invalid = 0;
-
-	int num_chunk;
-	int nlkv = 0;
-	char *p;
-	char *tailptr = NULL;
-	int hp;
+	int num_el;
 	int cur_chunk_num = 0;
 	int cur_tot_chunks = 0;
-	int chunks_ind;
-	int num_paren = 0;
-	int in_superchunk = 0;
+	int chunks_ind = 0;
 
 	if (execvnode == NULL || sinfo == NULL)
 		return NULL;
 
-	p = execvnode;
-
-	/* number of chunks is number of pluses + 1 */
-	num_chunk = 1;
-
-	while (p != NULL && *p != '\0') {
-		if (*p == '+')
-			num_chunk++;
-		if (*p == '(')
-			num_paren++;
-
-		p++;
+	auto tmpl = exec_vnode_cache.find(execvnode);
+	if (tmpl == NULL) {
+		tmpl.reset(parse_exec_vnode_tmpl(execvnode));
+		if (tmpl == NULL) {
+			log_eventf(PBSEVENT_SCHED, PBS_EVENTCLASS_NODE, LOG_WARNING, __func__,
+				"Failed to parse execvnode: %s", execvnode);
+			return NULL;
+		}
+		exec_vnode_cache.insert(execvnode, tmpl);
 	}
 
 	/* Number of chunks in exec_vnode don't match selspec, don't map chunks */
-	if (sel != NULL && num_paren != sel->total_chunks)
+	if (sel != NULL && tmpl->num_paren != sel->total_chunks)
 		sel = NULL;
 
-	if ((nspec_arr = static_cast<nspec **>(calloc(num_chunk + 1, sizeof(nspec *)))) == NULL) {
+	num_el = tmpl->els.size();
+	if ((nspec_arr = static_cast<nspec **>(calloc(num_el + 1, sizeof(nspec *)))) == NULL) {
 		log_err(errno, __func__, MEM_ERR_MSG);
 		return NULL;
 	}
 
-	if ((excvndup = string_dup(execvnode)) == NULL) {
-		free(nspec_arr);
-		return NULL;
-	}
-
-	simplespec = parse_plus_spec_r(excvndup, &tailptr, &hp);
-	if (hp > 0) /* simplespec starts with '(' but doesn't close */
-		in_superchunk = 1;
+	if (sel != NULL)
+		cur_tot_chunks = sel->chunks[0]->num_chunks;
 
-	if (simplespec == NULL)
-		invalid = 1;
-	else if (parse_node_resc_r(simplespec, &node_name, &num_el, &nlkv, &kv) != 0)
-		invalid = 1;
+	for (i = 0; i < num_el && !invalid; i++) {
+		const exec_vnode_el& el = tmpl->els[i];
 
-	if (sel != NULL) {
-		cur_tot_chunks = sel->chunks[0]->num_chunks;
-		chunks_ind = 0;
-	}
-	for (i = 0; i < num_chunk && !invalid && simplespec != NULL; i++) {
-		nspec_arr[i] = new_nspec();
-		if (nspec_arr[i] != NULL) {
-			ninfo = find_node_info(sinfo->nodes, node_name);
-			if (ninfo != NULL) {
-				nspec_arr[i]->ninfo = ninfo;
-				for (j = 0; j < num_el; j++) {
-					req = create_resource_req(kv[j].kv_keyw, kv[j].kv_val);
-					if (req != NULL) {
-						if (nspec_arr[i]->resreq == NULL)
-							nspec_arr[i]->resreq = req;
-						else {
-							req->next = nspec_arr[i]->resreq;
-							nspec_arr[i]->resreq = req;
-						}
-					}
-					else
-						invalid = 1;
-				}
-			}
-			else {
-				log_event(PBSEVENT_DEBUG, PBS_EVENTCLASS_JOB, LOG_DEBUG, node_name,
-					"Exechost contains a node that does not exist.");
-				invalid = 1;
+		if ((nspec_arr[i] = new_nspec()) == NULL) {
+			invalid = 1;
+			break;
+		}
+		ninfo = find_node_info(sinfo->nodes, el.node_name);
+		if (ninfo == NULL) {
+			log_event(PBSEVENT_DEBUG, PBS_EVENTCLASS_JOB, LOG_DEBUG, el.node_name.c_str(),
+				"Exechost contains a node that does not exist.");
+			invalid = 1;
+			break;
+		}
+		nspec_arr[i]->ninfo = ninfo;
+		if (el.req != NULL && (nspec_arr[i]->resreq = dup_resource_req_list(el.req)) == NULL) {
+			invalid = 1;
+			break;
+		}
+		if (sel != NULL) {
+			/* This shouldn't happen since we checked above to make sure we could map properly */
+			if (sel->chunks[chunks_ind] == NULL) {
+				log_event(PBS_EVENTCLASS_NODE, PBS_EVENTCLASS_NODE, LOG_WARNING, __func__, "Select spec and exec_vnode/resv_nodes can not be mapped");
+				free_nspecs(nspec_arr);
+				return NULL;
 			}
+			nspec_arr[i]->chk = sel->chunks[chunks_ind];
+			nspec_arr[i]->seq_num = nspec_arr[i]->chk->seq_num;
+		}
+		if (el.end_of_chunk) {
+			nspec_arr[i]->end_of_chunk = 1;
 			if (sel != NULL) {
-				/* This shouldn't happen since we checked above to make sure we could map properly */
-				if (sel->chunks[chunks_ind] == NULL) {
-					log_event(PBS_EVENTCLASS_NODE, PBS_EVENTCLASS_NODE, LOG_WARNING, __func__, "Select spec and exec_vnode/resv_nodes can not be mapped");
-					free_nspecs(nspec_arr);
-					return NULL;
-				}
-				nspec_arr[i]->chk = sel->chunks[chunks_ind];
-				nspec_arr[i]->seq_num = nspec_arr[i]->chk->seq_num;
-			}
-			if (!in_superchunk || hp < 0) {
-				nspec_arr[i]->end_of_chunk = 1;
-				if (sel != NULL) {
-					cur_chunk_num++;
-					if (cur_chunk_num == cur_tot_chunks) {
-						chunks_ind++;
-						if (sel->chunks[chunks_ind] != NULL) {
-							cur_tot_chunks = sel->chunks[chunks_ind]->num_chunks;
-							cur_chunk_num = 0;
-						}
+				cur_chunk_num++;
+				if (cur_chunk_num == cur_tot_chunks) {
+					chunks_ind++;
+					if (sel->chunks[chunks_ind] != NULL) {
+						cur_tot_chunks = sel->chunks[chunks_ind]->num_chunks;
+						cur_chunk_num = 0;
 					}
 				}
 			}
 		}
-		else
-			invalid = 1;
-
-		if (!invalid) {
-			simplespec = parse_plus_spec_r(tailptr, &tailptr, &hp);
-			if (simplespec != NULL) {
-				int ret;
-
-				if (hp > 0) /* simplespec starts with '(' but doesn't end with ')' */
-					in_superchunk = 1;
-				else if (hp < 0) /* simplespec ends with ')' but does not start with '(' */
-					in_superchunk = 0;
-				/* hp == 0 simplespec either starts and ends with '(' ')' or has neither */
-
-				ret = parse_node_resc_r(simplespec, &node_name, &num_el, &nlkv, &kv);
-				if (ret < 0)
-					invalid = 1;
-			}
-		}
 	}
 
-	nspec_arr[i] = NULL;
-	free(kv);
-	free(excvndup);
-
 	if (invalid) {
 		log_eventf(PBSEVENT_SCHED, PBS_EVENTCLASS_NODE, LOG_WARNING, __func__,
 				"Failed to parse execvnode: %s", execvnode);
@@ -4595,8 +4672,8 @@ create_node_array_from_nspec(nspec **nspec_arr)
 node_info **
 reorder_nodes(node_info **nodes, resource_resv *resresv)
 {
-	static node_info	**node_array = NULL;
-	static int		node_array_size = 0;
+	static thread_local node_info	**node_array = NULL;
+	static thread_local int		node_array_size = 0;
 	node_info		**nptr = NULL;
 	node_info		**tmparr = NULL;
 	schd_resource		*hostres = NULL;
@@ -4849,6 +4926,67 @@ alloc_rest_nodepart(nspec **nsa, node_info **ninfo_arr)
 	return 1;
 }
 
+/**
+ * @brief
+ * 		mark the nodes which have enough of every consumable resource in
+ *		req to fit one chunk.  The amounts available on the nodes are
+ *		gathered into one column per resource, so the comparisons run
+ *		over contiguous memory and can be vectorized.  A node is only
+ *		unmarked when it certainly can't fit, the full check still needs
+ *		to be done on the nodes left marked.
+ *
+ * @param[in]	req	-	requested resources (compared as with UNSET_RES_ZERO)
+ * @param[in]	ninfo_arr	-	node array
+ * @param[in]	num_nodes	-	number of nodes in ninfo_arr
+ * @param[out]	fit	-	fit[i] is nonzero if ninfo_arr[i] may fit the chunk
+ *
+ * @return	void
+ */
+static void
+cons_fit_mask(resource_req *req, node_info **ninfo_arr, int num_nodes, std::vector<unsigned char>& fit)
+{
+	std::vector<sch_resource_t> avail(num_nodes);
+
+	fit.assign(num_nodes, 1);
+
+	for (auto r = req; r != NULL; r = r->next) {
+		if (!r->type.is_consumable || r->def == NULL || r->def->ordinal < 0 || r->amount == 0)
+			continue;
+
+		auto amount = r->amount;
+		bool ignore_unset = conf.ignore_res.find(r->name) != conf.ignore_res.end();
+
+		/* gather the column, filling in amount where the check passes regardless */
+		for (int i = 0; i < num_nodes; i++) {
+			auto res = find_node_resource(ninfo_arr[i], r->def);
+
+			if (res == NULL || res->orig_str_avail == NULL) {
+				if (ignore_unset) {
+					avail[i] = amount;
+					continue;
+				}
+			}
+			if (res == NULL) {
+				avail[i] = 0;
+				continue;
+			}
+			if (res->indirect_res != NULL)
+				res = res->indirect_res;
+			if (!res->type.is_consumable)
+				avail[i] = amount;
+			else if (res->avail == SCHD_INFINITY_RES)
+				avail[i] = 0;
+			else
+				avail[i] = res->avail - res->assigned;
+		}
+
+		const sch_resource_t *col = avail.data();
+		unsigned char *f = fit.data();
+		for (int i = 0; i < num_nodes; i++)
+			f[i] &= (col[i] >= amount);
+	}
+}
+
 /**
  * @brief
  * 		determine if a chunk can fit on one vnode in node list
@@ -4870,7 +5008,9 @@ int
 can_fit_on_vnode(resource_req *req, node_info **ninfo_arr)
 {
 	int i;
-	static schd_error *dumperr = NULL;
+	int num_nodes;
+	static thread_local schd_error *dumperr = NULL;
+	std::vector<unsigned char> fit;
 
 	if (req == NULL || ninfo_arr == NULL)
 		return 0;
@@ -4883,13 +5023,17 @@ can_fit_on_vnode(resource_req *req, node_info **ninfo_arr)
 		}
 	}
 
+	num_nodes = count_array(ninfo_arr);
+	cons_fit_mask(req, ninfo_arr, num_nodes, fit);
 
+	for (i = 0; i < num_nodes; i++) {
+		if (!fit[i])
+			continue;
 
-	for (i = 0; ninfo_arr[i] != NULL; i++) {
 		clear_schd_error(dumperr);
 
 		if (is_vnode_eligible_chunk(req, ninfo_arr[i], NULL, dumperr)) {
-			if (check_avail_resources(ninfo_arr[i]->res, req,
+			if (check_avail_resources(ninfo_arr[i], req,
 				UNSET_RES_ZERO, INSUFFICIENT_RESOURCE, NULL))
 				return 1;
 		}
@@ -5086,11 +5230,7 @@ node_up_event(node_info *node, void *arg)
 		set_node_info_state(node, ND_free);
 
 	sinfo = node->server;
-	if (sinfo->node_group_enable && sinfo->node_group_key != NULL) {
-		node_partition_update_array(sinfo->policy, sinfo->nodepart);
-		qsort(sinfo->nodepart, sinfo->num_parts,
-			sizeof(node_partition *), cmp_placement_sets);
-	}
+	set_nodepart_stale(sinfo, node);
 	update_all_nodepart(sinfo->policy, sinfo, NO_ALLPART);
 
 	return 1;
@@ -5134,11 +5274,7 @@ node_down_event(node_info *node, void *arg)
 
 	set_node_info_state(node, ND_down);
 
-	if (sinfo->node_group_enable && sinfo->node_group_key != NULL) {
-		node_partition_update_array(sinfo->policy, sinfo->nodepart);
-		qsort(sinfo->nodepart, sinfo->num_parts,
-			sizeof(node_partition *), cmp_placement_sets);
-	}
+	set_nodepart_stale(sinfo, node);
 	update_all_nodepart(sinfo->policy, sinfo, NO_ALLPART);
 
 	return 1;
@@ -5545,7 +5681,7 @@ check_node_array_eligibility(node_info **ninfo_arr, resource_resv *resresv, plac
 		num_nodes = count_array(ninfo_arr);
 
 	tid = *((int *) pthread_getspecific(th_id_key));
-	if (tid != 0 || num_threads <= 1) {
+	if (tid != 0 || num_threads <= 1 || inside_parallel_for()) {
 		/* don't use multi-threading if I am a worker thread or num_threads is 1 */
 		tdata = alloc_tdata_nd_eligible(pl, resresv, ninfo_arr, 0, num_nodes - 1);
 		if (tdata == NULL)
@@ -5557,8 +5693,10 @@ check_node_array_eligibility(node_info **ninfo_arr, resource_resv *resresv, plac
 	} else {	 /* We are multithreading */
 		int j;
 		int num_tasks;
-		int chunk_size = num_nodes / num_threads;
-		chunk_size = (chunk_size > MT_CHUNK_SIZE_MIN) ? chunk_size : MT_CHUNK_SIZE_MIN;
+		/* the cost of checking a node varies a lot between nodes, so cut
+		 * the nodes finely and let idle threads steal
+		 */
+		int chunk_size = mt_chunk_size(num_nodes, MT_CHUNK_SIZE_MIN_UNEVEN);
 		for (j = 0, num_tasks = 0; num_nodes > 0;
 				num_tasks++, j += chunk_size, num_nodes -= chunk_size) {
 			tdata = alloc_tdata_nd_eligible(pl, resresv, ninfo_arr, j, j + chunk_size - 1);
@@ -100,6 +100,16 @@ int is_node_timeshared(node_info *node, void *arg);
  */
 node_info *find_node_info(node_info **ninfo_arr, const std::string& nodename);
 
+/*
+ *      index_node_resources - index a node's consumable resources by ordinal
+ */
+void index_node_resources(node_info *ninfo);
+
+/*
+ *      find_node_resource - find a resource on a node through its index
+ */
+schd_resource *find_node_resource(node_info *ninfo, resdef *def);
+
 /*
  *      dup_node_info - duplicate a node by creating a new one and coping all
  *                      the data into the new
@@ -275,6 +285,16 @@ const char *node_state_to_str(node_info *ninfo);
  */
 place *parse_placespec(char *place_str);
 
+/*
+ *	clear_parse_caches - forget the parsed select, place and exec_vnode specs
+ */
+void clear_parse_caches(void);
+
+/*
+ *	age_parse_caches - drop the parsed specs not used this cycle
+ */
+void age_parse_caches(void);
+
 /* compare two place specs to see if they are equal */
 int compare_place(place *pl1, place *pl2);
 
@@ -63,6 +63,10 @@
  * 	resresv_can_fit_nodepart()
  * 	create_specific_nodepart()
  * 	create_placement_sets()
+ * 	sort_all_nodepart()
+ * 	set_nodepart_stale()
+ * 	update_stale_nodepart()
+ * 	update_all_nodepart()
  *
  */
 #include <pbs_config.h>
@@ -92,7 +96,11 @@
 #include "globals.h"
 #include "sort.h"
 #include "buckets.h"
+#include "cycle_profile.h"
 
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 /**
@@ -390,7 +398,7 @@ create_node_partitions(status *policy, node_info **nodes, const char * const *re
 	char *str;
 	bool free_str = false;
 	int np_arr_size = 0;
-	static schd_resource *res;
+	schd_resource *res;
 
 	int num_nodes;
 
@@ -401,10 +409,13 @@ create_node_partitions(status *policy, node_info **nodes, const char * const *re
 	int node_i;		/* index into nodes array */
 	int np_i;		/* index into node partition array we are creating */
 
-	static schd_resource *unset_res = NULL;
+	static thread_local schd_resource *unset_res = NULL;
 
 	queue_info **queues = NULL;
 
+	std::unordered_map<std::string, int> part_ind;	/* partition name to index in np_arr */
+	std::vector<std::vector<node_info *>> members;	/* nodes of each partition, in node order */
+
 	if (nodes == NULL || resnames == NULL)
 		return NULL;
 
@@ -460,7 +471,8 @@ create_node_partitions(status *policy, node_info **nodes, const char * const *re
 					/* If we find the partition, we've already created it - add the node
 					 * to the existing partition.  If we don't find it, we create it.
 					 */
-					np = find_node_partition(np_arr, str);
+					auto pi = part_ind.find(str);
+					np = (pi == part_ind.end()) ? NULL : np_arr[pi->second];
 					if (np == NULL) {
 						if (np_i >= np_arr_size) {
 							tmp_arr = static_cast<node_partition **>(realloc(np_arr,
@@ -498,6 +510,8 @@ create_node_partitions(status *policy, node_info **nodes, const char * const *re
 								return NULL;
 							}
 
+							part_ind[np_arr[np_i]->name] = np_i;
+							members.push_back(std::vector<node_info *>(1, nodes[node_i]));
 							np_i++;
 							np_arr[np_i] = NULL;
 						}
@@ -510,6 +524,8 @@ create_node_partitions(status *policy, node_info **nodes, const char * const *re
 						np->tot_nodes++;
 						if (nodes[node_i]->is_free)
 							np->free_nodes++;
+						if (members[pi->second].back() != nodes[node_i])
+							members[pi->second].push_back(nodes[node_i]);
 					}
 					if (free_str) {
 						free(str);
@@ -525,7 +541,7 @@ create_node_partitions(status *policy, node_info **nodes, const char * const *re
 	}
 
 
-	/* now that we have a list of node partitions and number of nodes in each
+	/* now that we have a list of node partitions and the nodes in each
 	 * lets allocate a node array and fill it
 	 */
 
@@ -533,9 +549,10 @@ create_node_partitions(status *policy, node_info **nodes, const char * const *re
 		int i = 0;
 		np_arr[np_i]->ok_break = 1;
 		schd_resource *hostres = NULL;
+		const auto &np_nodes = members[np_i];
 
 		np_arr[np_i]->ninfo_arr =
-			static_cast<node_info **>(malloc((np_arr[np_i]->tot_nodes + 1) * sizeof(node_info *)));
+			static_cast<node_info **>(malloc((np_nodes.size() + 1) * sizeof(node_info *)));
 
 		if (np_arr[np_i]->ninfo_arr == NULL) {
 			free_node_partition_array(np_arr);
@@ -544,46 +561,30 @@ create_node_partitions(status *policy, node_info **nodes, const char * const *re
 
 		np_arr[np_i]->ninfo_arr[0] = NULL;
 
-		for (node_i = 0; nodes[node_i] != NULL &&
-			i < np_arr[np_i]->tot_nodes; node_i++) {
-			if (nodes[node_i]->is_stale)
-				continue;
-
-			res = find_resource(nodes[node_i]->res, np_arr[np_i]->def);
-			if (res == NULL && (flags & NP_CREATE_REST)) {
-				set_resource(unset_res, "\"\"", RF_AVAIL);
-				res = unset_res;
-			}
-			if (res != NULL) {
-				/* Incase of indirect resource, point it to the right place */
-				if (res->indirect_res != NULL)
-					res = res->indirect_res;
-				if (compare_res_to_str(res, np_arr[np_i]->res_val, CMP_CASE)) {
-					if (np_arr[np_i]->ok_break) {
-						tmpres = find_resource(nodes[node_i]->res, allres["host"]);
-						if (tmpres != NULL) {
-							if (hostres == NULL)
-								hostres = tmpres;
-							else {
-								if (!compare_res_to_str(hostres, tmpres->str_avail[0], CMP_CASELESS))
-									np_arr[np_i]->ok_break = 0;
-							}
-						}
-					}
-					if (!(NP_NO_ADD_NP_ARR & flags)) {
-						tmp_arr = static_cast<node_partition **>(add_ptr_to_array(nodes[node_i]->np_arr, np_arr[np_i]));
-						if (tmp_arr == NULL) {
-							free_node_partition_array(np_arr);
-							return NULL;
-						}
-						nodes[node_i]->np_arr = tmp_arr;
+		for (auto ninfo : np_nodes) {
+			if (np_arr[np_i]->ok_break) {
+				tmpres = find_resource(ninfo->res, allres["host"]);
+				if (tmpres != NULL) {
+					if (hostres == NULL)
+						hostres = tmpres;
+					else {
+						if (!compare_res_to_str(hostres, tmpres->str_avail[0], CMP_CASELESS))
+							np_arr[np_i]->ok_break = 0;
 					}
-
-					np_arr[np_i]->ninfo_arr[i] = nodes[node_i];
-					i++;
-					np_arr[np_i]->ninfo_arr[i] = NULL;
 				}
 			}
+			if (!(NP_NO_ADD_NP_ARR & flags)) {
+				tmp_arr = static_cast<node_partition **>(add_ptr_to_array(ninfo->np_arr, np_arr[np_i]));
+				if (tmp_arr == NULL) {
+					free_node_partition_array(np_arr);
+					return NULL;
+				}
+				ninfo->np_arr = tmp_arr;
+			}
+
+			np_arr[np_i]->ninfo_arr[i] = ninfo;
+			i++;
+			np_arr[np_i]->ninfo_arr[i] = NULL;
 		}
 		/* if multiple resource values are present, tot_nodes may be incorrect.
 		 * recalculating tot_nodes for each node partition.
@@ -1127,7 +1128,7 @@ resresv_can_fit_nodepart(status *policy, node_partition *np, resource_resv *resr
 	if ((flags & RETURN_ALL_ERR)) {
 		if(prev_err != NULL) {
 			prev_err->next = NULL;
-			free(err);
+			free_schd_error(err);
 		}
 		return can_fit;
 	}
@@ -1223,6 +1224,7 @@ create_specific_nodepart(status *policy, const char *name, node_info **nodes, in
 bool
 create_placement_sets(status *policy, server_info *sinfo)
 {
+	prof_phase prof(__func__);
 	bool is_success = true;
 
 	sinfo->allpart = create_specific_nodepart(policy, "all", sinfo->unassoc_nodes, NO_FLAGS);
@@ -1342,6 +1344,84 @@ sort_all_nodepart(status *policy, server_info *sinfo)
 	}
 }
 
+/**
+ * @brief mark the placement set meta data of a node stale.  The node's
+ *	  placement sets are brought up to date in the next call to
+ *	  update_all_nodepart()
+ * @param[in] sinfo - server universe
+ * @param[in] ninfo - the node which changed or NULL if it is unknown which
+ *		      nodes changed
+ * @return void
+ */
+void
+set_nodepart_stale(server_info *sinfo, node_info *ninfo)
+{
+	if (sinfo == NULL)
+		return;
+
+	sinfo->pset_metadata_stale = 1;
+
+	/* nodes outside of the server's node array (e.g., reservation nodes)
+	 * can't be tracked individually
+	 */
+	if (ninfo != NULL && ninfo->node_ind >= 0 && ninfo->node_ind < sinfo->num_nodes &&
+	    sinfo->unordered_nodes != NULL && sinfo->unordered_nodes[ninfo->node_ind] == ninfo)
+		sinfo->pset_stale_nodes.push_back(ninfo->node_ind);
+	else
+		sinfo->pset_stale_all = 1;
+}
+
+/**
+ * @brief update only the placement sets of the nodes marked stale with
+ *	  set_nodepart_stale().  The other placement sets are kept up to date
+ *	  as jobs run, so only these need their meta data regenerated.
+ * @param[in] policy - policy info
+ * @param[in] sinfo - server info
+ * @param[in] flags - NO_ALLPART - do not update the metadata in the allparts
+ * @return void
+ */
+static void
+update_stale_nodepart(status *policy, server_info *sinfo, unsigned int flags)
+{
+	std::unordered_set<node_partition *> qallparts;
+	std::unordered_set<node_partition *> updated;
+	std::unordered_set<int> seen;
+
+	for (int i = 0; sinfo->queues[i] != NULL; i++) {
+		auto qinfo = sinfo->queues[i];
+
+		if (qinfo->allpart == NULL)
+			continue;
+		qallparts.insert(qinfo->allpart);
+		if ((flags & NO_ALLPART) == 0 && qinfo->allpart->res == NULL)
+			node_partition_update(policy, qinfo->allpart);
+	}
+
+	for (auto ind : sinfo->pset_stale_nodes) {
+		node_info *ninfo;
+
+		if (!seen.insert(ind).second)
+			continue;
+		ninfo = sinfo->unordered_nodes[ind];
+		if (ninfo->np_arr == NULL)
+			continue;
+
+		for (int j = 0; ninfo->np_arr[j] != NULL; j++) {
+			auto np = ninfo->np_arr[j];
+
+			/* the allparts are handled on their own */
+			if (np == sinfo->allpart || qallparts.find(np) != qallparts.end())
+				continue;
+			if (updated.insert(np).second)
+				node_partition_update(policy, np);
+			update_buckets_for_node(np->bkts, ninfo);
+		}
+	}
+
+	if ((flags & NO_ALLPART) == 0)
+		node_partition_update(policy, sinfo->allpart);
+}
+
 /**
  *
  *	@brief update all node partitions of all queues on the server
@@ -1368,11 +1448,19 @@ update_all_nodepart(status *policy, server_info *sinfo, unsigned int flags)
 	if(sinfo->allpart == NULL)
 		return;
 
+	if (sinfo->pset_metadata_stale && !sinfo->pset_stale_all && !sinfo->pset_stale_nodes.empty()) {
+		update_stale_nodepart(policy, sinfo, flags);
+		sort_all_nodepart(policy, sinfo);
+		sinfo->pset_metadata_stale = 0;
+		sinfo->pset_stale_nodes.clear();
+		return;
+	}
+
 	if (sinfo->node_group_enable && sinfo->node_group_key != NULL)
 		node_partition_update_array(policy, sinfo->nodepart);
 
 	if (pbs_conf.pbs_num_servers > 1) {	/* Update svr_to_psets for multi-server */
-		static node_partition **svrtopsetarr = NULL;
+		static thread_local node_partition **svrtopsetarr = NULL;
 		int i = 0;
 
 		if (svrtopsetarr == NULL) {
@@ -1413,4 +1501,6 @@ update_all_nodepart(status *policy, server_info *sinfo, unsigned int flags)
 	sort_all_nodepart(policy, sinfo);
 
 	sinfo->pset_metadata_stale = 0;
+	sinfo->pset_stale_all = 0;
+	sinfo->pset_stale_nodes.clear();
 }
@@ -218,6 +218,9 @@ node_partition *create_specific_nodepart(status *policy, const char *name, node_
 /* create the placement sets for the server and queues */
 bool create_placement_sets(status *policy, server_info *sinfo);
 
+/* Mark the placement sets of a node stale */
+void set_nodepart_stale(server_info *sinfo, node_info *ninfo);
+
 /* Update placement sets and allparts */
 void update_all_nodepart(status *policy, server_info *sinfo, unsigned int flags);
 
@@ -118,6 +118,7 @@ config::config() : fairshare_res("cput"), fairshare_ent("euser")
 	unknown_shares = 0;			/* unknown group shares */
 	max_preempt_attempts = SCHD_INFINITY;					/* max num of preempt attempts per cyc*/
 	max_jobs_to_check = SCHD_INFINITY;			/* max number of jobs to check in cyc*/
+	runjob_batch_size = 0;			/* max num of jobs sent in one run job list */
 	fairshare_decay_factor = .5;		/* decay factor used when decaying fairshare tree */
 #ifdef NAS
 	/* localmod 034 */
@@ -379,6 +380,28 @@ parse_config(const char *fname)
 							PARSE_RESV_CONFIRM_IGNORE);
 					}
 				}
+				else if (!strcmp(config_name, PARSE_CYCLE_PROFILE)) {
+					if (!strcmp(config_value, "none"))
+						tmpconf.cycle_profile.clear();
+					else if (!strcmp(config_value, "log") || config_value[0] == '/')
+						tmpconf.cycle_profile = config_value;
+					else {
+						error = true;
+						sprintf(errbuf, "%s valid values: none, log or an absolute file name",
+							PARSE_CYCLE_PROFILE);
+					}
+				}
+				else if (!strcmp(config_name, PARSE_CYCLE_CAPTURE)) {
+					if (!strcmp(config_value, "none"))
+						tmpconf.cycle_capture.clear();
+					else if (config_value[0] == '/')
+						tmpconf.cycle_capture = config_value;
+					else {
+						error = true;
+						sprintf(errbuf, "%s valid values: none or an absolute directory name",
+							PARSE_CYCLE_CAPTURE);
+					}
+				}
 				else if (!strcmp(config_name, PARSE_RESOURCES)) {
 					bool need_host = false;
 					bool need_vnode = false;
@@ -602,6 +625,8 @@ parse_config(const char *fname)
 
 				} else if (!strcmp(config_name, PARSE_PREEMPT_ATTEMPTS))
 					tmpconf.max_preempt_attempts = num;
+				else if (!strcmp(config_name, PARSE_RUNJOB_BATCH_SIZE))
+					tmpconf.runjob_batch_size = num;
 				else if (!strcmp(config_name, PARSE_MAX_JOB_CHECK)) {
 					if (!strcmp(config_value, "ALL_JOBS"))
 						tmpconf.max_jobs_to_check = SCHD_INFINITY;
@@ -41,9 +41,76 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "pbs_bitmap.h"
 
 #define BYTES_TO_BITS(x) ((x) * 8)
+#define BITS_PER_LONG BYTES_TO_BITS(sizeof(unsigned long))
+
+/*
+ * Word kernels for the set operations below.  They work on whole vectors
+ * when the compiler is targeting AVX2 or SSE2 and fall back to one
+ * unsigned long at a time otherwise.
+ */
+enum bits_op { BITS_ANDNOT, BITS_OR };
+
+static void
+bits_apply(enum bits_op op, unsigned long *dst, const unsigned long *src, unsigned long n)
+{
+	unsigned long i = 0;
+
+#if defined(__AVX2__)
+	const unsigned long step = sizeof(__m256i) / sizeof(unsigned long);
+
+	for (; i + step <= n; i += step) {
+		__m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(dst + i));
+		__m256i r = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+
+		switch (op) {
+			case BITS_ANDNOT:
+				d = _mm256_andnot_si256(r, d);
+				break;
+			case BITS_OR:
+				d = _mm256_or_si256(d, r);
+				break;
+		}
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), d);
+	}
+#elif defined(__SSE2__)
+	const unsigned long step = sizeof(__m128i) / sizeof(unsigned long);
+
+	for (; i + step <= n; i += step) {
+		__m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dst + i));
+		__m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+
+		switch (op) {
+			case BITS_ANDNOT:
+				d = _mm_andnot_si128(r, d);
+				break;
+			case BITS_OR:
+				d = _mm_or_si128(d, r);
+				break;
+		}
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), d);
+	}
+#endif
+
+	for (; i < n; i++) {
+		switch (op) {
+			case BITS_ANDNOT:
+				dst[i] &= ~src[i];
+				break;
+			case BITS_OR:
+				dst[i] |= src[i];
+				break;
+		}
+	}
+}
 
 
 /**
@@ -216,45 +283,29 @@ int
 pbs_bitmap_next_on_bit(pbs_bitmap *pbm, unsigned long start_bit)
 {
 	unsigned long long_ind;
-	long bit;
-	size_t i;
+	unsigned long bit;
+	unsigned long word;
 
 	if (pbm == NULL)
 		return -1;
 
-	if (start_bit >= pbm->num_bits)
+	if (start_bit + 1 >= pbm->num_bits)
 		return -1;
 
-	long_ind = start_bit / BYTES_TO_BITS(sizeof(unsigned long));
-	bit = start_bit % BYTES_TO_BITS(sizeof(unsigned long));
-
-	/* special case - look at first long that contains start_bit */
-	if (pbm->bits[long_ind] != 0) {
-		for (i = bit + 1; i < BYTES_TO_BITS(sizeof(unsigned long)); i++) {
-			if (pbm->bits[long_ind] & (1UL << i)) {
-				return (long_ind * BYTES_TO_BITS(sizeof(unsigned long)) + i);
-			}
-		}
-
-		/* didn't find an on bit after start_bit_index in the long that contained start_bit */
-		if (long_ind < pbm->num_longs) {
-			long_ind++;
-		}
-	}
-
-	for( ; long_ind < pbm->num_longs && pbm->bits[long_ind] == 0; long_ind++)
-		;
+	start_bit++;
+	long_ind = start_bit / BITS_PER_LONG;
+	bit = start_bit % BITS_PER_LONG;
 
-	if (long_ind == pbm->num_longs)
-		return -1;
+	/* special case - mask off the bits up to start_bit in its long */
+	word = pbm->bits[long_ind] & (~0UL << bit);
 
-	for (i = 0 ; i < BYTES_TO_BITS(sizeof(unsigned long)) ; i++) {
-		if (pbm->bits[long_ind] & (1UL << i)) {
-			return (long_ind * BYTES_TO_BITS(sizeof(unsigned long)) + i);
-		}
+	while (word == 0) {
+		if (++long_ind >= pbm->num_longs)
+			return -1;
+		word = pbm->bits[long_ind];
 	}
 
-	return -1;
+	return (long_ind * BITS_PER_LONG + __builtin_ctzl(word));
 }
 
 /**
@@ -334,3 +385,95 @@ pbs_bitmap_is_equal(pbs_bitmap *L, pbs_bitmap *R)
 
 	return 1;
 }
+
+/**
+ * @brief pbs_bitmap version of L &= ~R
+ * @param L - bitmap lvalue
+ * @param R - bitmap rvalue
+ * @return int
+ * @retval 1 success
+ * @retval 0 failure
+ */
+int
+pbs_bitmap_andnot(pbs_bitmap *L, pbs_bitmap *R)
+{
+	unsigned long n;
+
+	if (L == NULL || R == NULL)
+		return 0;
+
+	n = L->num_longs < R->num_longs ? L->num_longs : R->num_longs;
+	bits_apply(BITS_ANDNOT, L->bits, R->bits, n);
+
+	return 1;
+}
+
+/**
+ * @brief pbs_bitmap version of L |= R
+ * @param L - bitmap lvalue
+ * @param R - bitmap rvalue
+ * @return int
+ * @retval 1 success
+ * @retval 0 failure
+ */
+int
+pbs_bitmap_or(pbs_bitmap *L, pbs_bitmap *R)
+{
+	if (L == NULL || R == NULL)
+		return 0;
+
+	if (R->num_bits > L->num_bits)
+		if (pbs_bitmap_alloc(L, R->num_bits) == NULL)
+			return 0;
+
+	bits_apply(BITS_OR, L->bits, R->bits, R->num_longs < L->num_longs ? R->num_longs : L->num_longs);
+
+	return 1;
+}
+
+/**
+ * @brief set L to the first n on bits of R
+ * @param L - bitmap lvalue
+ * @param R - bitmap rvalue
+ * @param n - number of on bits to take
+ * @return unsigned long
+ * @retval number of bits taken, less than n if R does not have n on bits
+ */
+unsigned long
+pbs_bitmap_first_n_on_bits(pbs_bitmap *L, pbs_bitmap *R, unsigned long n)
+{
+	unsigned long i;
+	unsigned long taken = 0;
+
+	if (L == NULL || R == NULL)
+		return 0;
+
+	if (R->num_longs > L->num_longs)
+		if (pbs_bitmap_alloc(L, BYTES_TO_BITS(R->num_longs * sizeof(unsigned long))) == NULL)
+			return 0;
+
+	for (i = 0; i < L->num_longs; i++)
+		L->bits[i] = 0;
+	L->num_bits = R->num_bits;
+
+	for (i = 0; i < R->num_longs && taken < n; i++) {
+		unsigned long word = R->bits[i];
+		unsigned long ct = __builtin_popcountl(word);
+
+		if (taken + ct > n) {
+			/* only part of this long is needed: keep its lowest on bits */
+			unsigned long part = 0;
+
+			for (; taken < n; taken++) {
+				part |= word & (~word + 1);
+				word &= word - 1;
+			}
+			L->bits[i] = part;
+			break;
+		}
+		L->bits[i] = word;
+		taken += ct;
+	}
+
+	return taken;
+}
@@ -77,4 +77,13 @@ int pbs_bitmap_assign(pbs_bitmap *L, pbs_bitmap *R);
 /* pbs_bitmap's version of L == R */
 int pbs_bitmap_is_equal(pbs_bitmap *L, pbs_bitmap *R);
 
+/* pbs_bitmap's version of L &= ~R */
+int pbs_bitmap_andnot(pbs_bitmap *L, pbs_bitmap *R);
+
+/* pbs_bitmap's version of L |= R */
+int pbs_bitmap_or(pbs_bitmap *L, pbs_bitmap *R);
+
+/* Set L to the first n on bits of R */
+unsigned long pbs_bitmap_first_n_on_bits(pbs_bitmap *L, pbs_bitmap *R, unsigned long n);
+
 #endif	/* _PBS_BITMASK_H */
@@ -0,0 +1,281 @@
+/*
+ * Copyright (C) 1994-2021 Altair Engineering, Inc.
+ * For more information, contact Altair at www.altair.com.
+ *
+ * This file is part of both the OpenPBS software ("OpenPBS")
+ * and the PBS Professional ("PBS Pro") software.
+ *
+ * Open Source License Information:
+ *
+ * OpenPBS is free software. You can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Commercial License Information:
+ *
+ * PBS Pro is commercially licensed software that shares a common core with
+ * the OpenPBS software.  For a copy of the commercial license terms and
+ * conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+ * Altair Legal Department.
+ *
+ * Altair's dual-license business model allows companies, individuals, and
+ * organizations to create proprietary derivative works of OpenPBS and
+ * distribute them - whether embedded or bundled with other software -
+ * under a commercial license agreement.
+ *
+ * Use of Altair's trademarks, including but not limited to "PBS™",
+ * "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+ * subject to Altair's trademark licensing policies.
+ */
+
+
+/**
+ * @file    pbs_sched_replay.cpp
+ *
+ * @brief
+ * 		pbs_sched_replay.cpp - run scheduling cycles against a cycle
+ * 		captured by pbs_sched's cycle_capture option, without a
+ * 		server.  Prints what each cycle decided and how long it took.
+ *
+ * Every cycle sees the universe as it was captured: the decisions of one
+ * cycle are not fed back into the next.  Each cycle runs at the current
+ * time, not the capture time.
+ *
+ * Functions included are:
+ * 	main()
+ * 	replay_now()
+ * 	remove_scratch()
+ *
+ */
+#include <pbs_config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <time.h>
+#include <string>
+#include <vector>
+#include <libpbs.h>
+#include <pbs_ifl.h>
+#include "data_types.h"
+#include "constant.h"
+#include "fifo.h"
+#include "globals.h"
+#include "log.h"
+#include "multi_threading.h"
+#include "pbs_version.h"
+#include "resource.h"
+#include "sched_cmds.h"
+#include "capture.h"
+
+/* descriptor passed around as the server connection.  Every request is
+ * answered from the capture, it only has to look like an open connection.
+ */
+#define REPLAY_SD 0
+
+static const char usage[] = "[-c cycles] [-t threads] [-L logfile] [-g max_mean_seconds] capture_dir";
+
+/**
+ * @brief	seconds on the monotonic clock
+ */
+static double
+replay_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief	remove the scratch directory the cycles ran in
+ *
+ * @param[in]	dir	-	the scratch directory
+ *
+ * @return	void
+ */
+static void
+remove_scratch(const char *dir)
+{
+	DIR *dp;
+	struct dirent *ent;
+
+	if ((dp = opendir(dir)) != NULL) {
+		while ((ent = readdir(dp)) != NULL) {
+			if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0)
+				continue;
+			unlink((std::string(dir) + "/" + ent->d_name).c_str());
+		}
+		closedir(dp);
+	}
+	rmdir(dir);
+}
+
+/**
+ * @brief
+ * 		The entry point of pbs_sched_replay
+ *
+ * @return	int
+ * @retval	0	: success
+ * @retval	1	: error
+ * @retval	2	: the mean cycle time exceeded the -g limit
+ */
+int
+main(int argc, char *argv[])
+{
+	char scratch[] = "/tmp/pbs_sched_replay.XXXXXX";
+	char logpath[] = "/dev/null";
+	char *logfile = logpath;
+	const char *capdir;
+	sched_cmd cmd = {SCH_SCHEDULE_NEW, NULL};
+	std::vector<double> secs;
+	double gate = 0;
+	double total = 0;
+	double min;
+	double max;
+	int cycles = 1;
+	int nthreads = 1;
+	int errflg = 0;
+	int ret = 0;
+	time_t captured;
+	char *endp;
+	int c;
+
+	/* the real deal or output version and exit? */
+	PRINT_VERSION_AND_EXIT(argc, argv);
+	set_msgdaemonname(const_cast<char *>("pbs_sched_replay"));
+
+	while ((c = getopt(argc, argv, "c:t:L:g:")) != -1) {
+		switch (c) {
+			case 'c':
+				cycles = strtol(optarg, &endp, 10);
+				if (*endp != '\0' || cycles < 1)
+					errflg = 1;
+				break;
+			case 't':
+				nthreads = strtol(optarg, &endp, 10);
+				if (*endp != '\0' || nthreads < 1)
+					errflg = 1;
+				break;
+			case 'L':
+				logfile = optarg;
+				break;
+			case 'g':
+				gate = strtod(optarg, &endp);
+				if (*endp != '\0' || gate <= 0)
+					errflg = 1;
+				break;
+			default:
+				errflg = 1;
+		}
+	}
+	if (errflg || optind != argc - 1) {
+		fprintf(stderr, "usage: %s %s\n", argv[0], usage);
+		fprintf(stderr, "       %s --version\n", argv[0]);
+		exit(1);
+	}
+	capdir = argv[optind];
+
+	/* pbs.conf is only used for PBS_EXEC, a laptop may not have one.
+	 * The capture is one universe, however many servers it came from.
+	 */
+	pbs_loadconf(0);
+	pbs_conf.pbs_num_servers = 1;
+
+	if (pbs_client_thread_init_thread_context() != 0) {
+		fprintf(stderr, "%s: Unable to initialize thread context\n", argv[0]);
+		exit(1);
+	}
+
+	if (mkdtemp(scratch) == NULL) {
+		perror("mkdtemp");
+		exit(1);
+	}
+	if (log_open(logfile, scratch) == -1) {
+		fprintf(stderr, "%s: logfile could not be opened\n", argv[0]);
+		remove_scratch(scratch);
+		exit(1);
+	}
+
+	/* the cycles update the fairshare usage, keep the capture as it is */
+	if (capture_copy_priv(capdir, scratch) != 0) {
+		fprintf(stderr, "%s: can't copy the sched_priv files of %s\n", argv[0], capdir);
+		remove_scratch(scratch);
+		exit(1);
+	}
+	if (replay_load(capdir) != 0) {
+		remove_scratch(scratch);
+		exit(1);
+	}
+	if (chdir(scratch) == -1) {
+		perror("chdir");
+		remove_scratch(scratch);
+		exit(1);
+	}
+
+	/* find the sched object of the scheduler the capture was taken of,
+	 * but leave its log and priv directories alone
+	 */
+	sc_name = replay_sched_name();
+	dflt_sched = 1;
+
+	if (schedinit(nthreads) != 0) {
+		fprintf(stderr, "%s: local initialization failed\n", argv[0]);
+		remove_scratch(scratch);
+		exit(1);
+	}
+	update_resource_defs(REPLAY_SD);
+	if (!set_validate_sched_attrs(REPLAY_SD)) {
+		fprintf(stderr, "%s: no valid scheduler %s in capture\n", argv[0], sc_name);
+		remove_scratch(scratch);
+		exit(1);
+	}
+
+	captured = replay_time();
+	printf("scheduler %s captured %s", sc_name, ctime(&captured));
+
+	for (int i = 0; i < cycles; i++) {
+		unsigned long decisions = replay_decision_count();
+		double start;
+
+		printf("cycle %d\n", i + 1);
+		start = replay_now();
+		scheduling_cycle(REPLAY_SD, &cmd);
+		secs.push_back(replay_now() - start);
+		printf("cycle %d: %.6f seconds, %lu decisions\n", i + 1, secs.back(),
+			replay_decision_count() - decisions);
+	}
+
+	min = max = secs[0];
+	for (auto s : secs) {
+		total += s;
+		if (s < min)
+			min = s;
+		if (s > max)
+			max = s;
+	}
+	printf("%d cycles: min %.6f mean %.6f max %.6f seconds\n", cycles, min, total / cycles, max);
+
+	if (gate > 0 && total / cycles > gate) {
+		fprintf(stderr, "%s: mean cycle time %.6f exceeds %.6f seconds\n", argv[0], total / cycles, gate);
+		ret = 2;
+	}
+
+	if (num_threads > 1)
+		kill_threads();
+	log_close(1);
+	remove_scratch(scratch);
+
+	return ret;
+}
@@ -76,6 +76,8 @@
 #include "config.h"
 #include "fifo.h"
 #include "globals.h"
+#include "job_status_cache.h"
+#include "equiv_class_cache.h"
 #include "libpbs.h"
 #include "libsec.h"
 #include "list_link.h"
@@ -668,6 +670,10 @@ unmask_continue:
 	log_eventf(PBSEVENT_ADMIN | PBSEVENT_FORCE, PBS_EVENTCLASS_SCHED,
 		   LOG_INFO, msg_daemonname, "Connected to all the up servers");
 
+	/* we may have missed job changes while we were disconnected */
+	jstat_cache.invalidate("reconnected to server");
+	ec_cache.invalidate("reconnected to server");
+
 	sched_svr_init();
 
 	for (i = 0; svr_conns_secondary[i] != NULL; i++) {
@@ -0,0 +1,291 @@
+/*
+ * Copyright (C) 1994-2021 Altair Engineering, Inc.
+ * For more information, contact Altair at www.altair.com.
+ *
+ * This file is part of both the OpenPBS software ("OpenPBS")
+ * and the PBS Professional ("PBS Pro") software.
+ *
+ * Open Source License Information:
+ *
+ * OpenPBS is free software. You can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Commercial License Information:
+ *
+ * PBS Pro is commercially licensed software that shares a common core with
+ * the OpenPBS software.  For a copy of the commercial license terms and
+ * conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+ * Altair Legal Department.
+ *
+ * Altair's dual-license business model allows companies, individuals, and
+ * organizations to create proprietary derivative works of OpenPBS and
+ * distribute them - whether embedded or bundled with other software -
+ * under a commercial license agreement.
+ *
+ * Use of Altair's trademarks, including but not limited to "PBS™",
+ * "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+ * subject to Altair's trademark licensing policies.
+ */
+
+
+/**
+ * @file    preempt_index.cpp
+ *
+ * @brief
+ * 		preempt_index.cpp - index of the resources held by preemptable
+ * 		running jobs, used to rule out preemption without a simulation.
+ *
+ * Functions included are:
+ * 	add_preempt_candidate()
+ * 	remove_preempt_candidate()
+ * 	free_preempt_candidates()
+ * 	can_fit_with_preemption()
+ */
+#include <pbs_config.h>
+
+#include <unordered_set>
+#include <log.h>
+#include "data_types.h"
+#include "preempt_index.h"
+#include "node_info.h"
+#include "misc.h"
+#include "constant.h"
+
+/**
+ * @brief
+ *		is_preempt_candidate - should a job be in the index.  Jobs in
+ *		reservations are left out: preempting them frees nothing for jobs
+ *		outside the reservation.
+ *
+ * @param[in]	resresv	-	the job
+ *
+ * @return	bool
+ */
+static bool
+is_preempt_candidate(resource_resv *resresv)
+{
+	if (resresv == NULL || !resresv->is_job || resresv->job == NULL)
+		return false;
+
+	return !resresv->job->can_not_preempt && resresv->job->resv == NULL;
+}
+
+/**
+ * @brief
+ *		index_job - add what a running job holds on its vnodes to the index
+ *
+ * @param[in,out]	pci	-	the index
+ * @param[in]	resresv	-	the job
+ *
+ * @return	void
+ */
+static void
+index_job(preempt_cand_index *pci, resource_resv *resresv)
+{
+	pcand_job pj;
+
+	if (pci->jobs.find(resresv->rank) != pci->jobs.end())
+		return;
+
+	pj.preempt = resresv->job->preempt;
+	pj.indexed = resresv->nspec_arr != NULL;
+	for (int i = 0; pj.indexed && resresv->nspec_arr[i] != NULL; i++) {
+		nspec *ns = resresv->nspec_arr[i];
+
+		if (ns->ninfo == NULL) {
+			pj.indexed = false;
+			break;
+		}
+		for (resource_req *req = ns->resreq; req != NULL; req = req->next)
+			if (req->type.is_consumable)
+				pj.holds.push_back({ns->ninfo->node_ind, req->def, req->amount});
+	}
+
+	if (!pj.indexed) {
+		pj.holds.clear();
+		pci->unindexed++;
+	}
+	for (const auto& h : pj.holds)
+		pci->held[pj.preempt][h.node_ind][h.def] += h.amount;
+
+	pci->jobs.emplace(resresv->rank, std::move(pj));
+}
+
+/**
+ * @brief
+ *		add_preempt_candidate - index a job which has started running.
+ *		Nothing is done if the server has no index yet.
+ *
+ * @param[in]	sinfo	-	the server the job runs on
+ * @param[in]	resresv	-	the job
+ *
+ * @return	void
+ *
+ * @par MT-Safe:	no
+ */
+void
+add_preempt_candidate(server_info *sinfo, resource_resv *resresv)
+{
+	if (sinfo == NULL || sinfo->pcands == NULL || !is_preempt_candidate(resresv))
+		return;
+
+	index_job(sinfo->pcands, resresv);
+}
+
+/**
+ * @brief
+ *		remove_preempt_candidate - remove a job which is ending from the index
+ *
+ * @param[in]	sinfo	-	the server the job ran on
+ * @param[in]	resresv	-	the job
+ *
+ * @return	void
+ *
+ * @par MT-Safe:	no
+ */
+void
+remove_preempt_candidate(server_info *sinfo, resource_resv *resresv)
+{
+	preempt_cand_index *pci;
+
+	if (sinfo == NULL || sinfo->pcands == NULL || resresv == NULL)
+		return;
+
+	pci = sinfo->pcands;
+	auto j = pci->jobs.find(resresv->rank);
+	if (j == pci->jobs.end())
+		return;
+
+	if (!j->second.indexed)
+		pci->unindexed--;
+	for (const auto& h : j->second.holds)
+		pci->held[j->second.preempt][h.node_ind][h.def] -= h.amount;
+
+	pci->jobs.erase(j);
+}
+
+/**
+ * @brief
+ *		free_preempt_candidates - drop a server's index.  It is rebuilt the
+ *		next time it is needed.
+ *
+ * @param[in]	sinfo	-	the server
+ *
+ * @return	void
+ */
+void
+free_preempt_candidates(server_info *sinfo)
+{
+	if (sinfo == NULL)
+		return;
+
+	delete sinfo->pcands;
+	sinfo->pcands = NULL;
+}
+
+/**
+ * @brief
+ *		can_fit_with_preemption - check whether preempting every running
+ *		job of a lower preempt priority could free enough of the consumable
+ *		resources hjob's select asks for.  The check adds up the free amounts
+ *		on the vnodes hjob may use and what the lower priority jobs hold on
+ *		them.  It ignores placement, so it can only tell that preemption
+ *		can't work, never that it will.
+ *
+ * @param[in]	sinfo	-	the server
+ * @param[in]	hjob	-	the high priority job
+ *
+ * @return	bool
+ * @retval	false	: preemption can't make room for hjob
+ * @retval	true	: preemption might make room for hjob
+ *
+ * @par MT-Safe:	no
+ */
+bool
+can_fit_with_preemption(server_info *sinfo, resource_resv *hjob)
+{
+	std::unordered_map<resdef *, sch_resource_t> need;
+	std::unordered_map<resdef *, sch_resource_t> have;
+	std::unordered_set<int> usable;
+	node_info **nodes;
+	preempt_cand_index *pci;
+
+	if (sinfo == NULL || hjob == NULL || hjob->job == NULL)
+		return true;
+	if (hjob->select == NULL || hjob->select->chunks == NULL || hjob->job->resv != NULL)
+		return true;
+
+	if (sinfo->pcands == NULL) {
+		sinfo->pcands = new preempt_cand_index();
+		for (int i = 0; sinfo->running_jobs != NULL && sinfo->running_jobs[i] != NULL; i++)
+			if (is_preempt_candidate(sinfo->running_jobs[i]))
+				index_job(sinfo->pcands, sinfo->running_jobs[i]);
+	}
+	pci = sinfo->pcands;
+	if (pci->unindexed > 0)
+		return true;
+
+	for (int i = 0; hjob->select->chunks[i] != NULL; i++) {
+		chunk *chk = hjob->select->chunks[i];
+
+		for (resource_req *req = chk->req; req != NULL; req = req->next)
+			if (req->type.is_consumable)
+				need[req->def] += chk->num_chunks * req->amount;
+	}
+	if (need.empty())
+		return true;
+
+	if (hjob->job->queue != NULL && hjob->job->queue->has_nodes)
+		nodes = hjob->job->queue->nodes;
+	else
+		nodes = sinfo->nodes;
+	if (nodes == NULL)
+		return true;
+
+	for (int i = 0; nodes[i] != NULL; i++) {
+		if (nodes != sinfo->nodes)
+			usable.insert(nodes[i]->node_ind);
+		for (const auto& n : need) {
+			schd_resource *res = find_node_resource(nodes[i], n.first);
+
+			if (res == NULL)
+				continue;
+			/* shared or unlimited resources can't be added up */
+			if (res->indirect_res != NULL || res->avail == SCHD_INFINITY_RES)
+				return true;
+			if (res->avail > res->assigned)
+				have[n.first] += res->avail - res->assigned;
+		}
+	}
+
+	for (auto p = pci->held.begin(); p != pci->held.end() && p->first < hjob->job->preempt; ++p) {
+		for (const auto& nd : p->second) {
+			if (nodes != sinfo->nodes && usable.find(nd.first) == usable.end())
+				continue;
+			for (const auto& r : nd.second)
+				if (need.find(r.first) != need.end())
+					have[r.first] += r.second;
+		}
+	}
+
+	for (const auto& n : need) {
+		if (have[n.first] < n.second) {
+			log_eventf(PBSEVENT_DEBUG2, PBS_EVENTCLASS_JOB, LOG_DEBUG, hjob->name,
+				"Preempt: Not enough %s on the job's vnodes even with all lower priority work preempted",
+				n.first->name.c_str());
+			return false;
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 1994-2021 Altair Engineering, Inc.
+ * For more information, contact Altair at www.altair.com.
+ *
+ * This file is part of both the OpenPBS software ("OpenPBS")
+ * and the PBS Professional ("PBS Pro") software.
+ *
+ * Open Source License Information:
+ *
+ * OpenPBS is free software. You can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Commercial License Information:
+ *
+ * PBS Pro is commercially licensed software that shares a common core with
+ * the OpenPBS software.  For a copy of the commercial license terms and
+ * conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+ * Altair Legal Department.
+ *
+ * Altair's dual-license business model allows companies, individuals, and
+ * organizations to create proprietary derivative works of OpenPBS and
+ * distribute them - whether embedded or bundled with other software -
+ * under a commercial license agreement.
+ *
+ * Use of Altair's trademarks, including but not limited to "PBS™",
+ * "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+ * subject to Altair's trademark licensing policies.
+ */
+
+#ifndef	_PREEMPT_INDEX_H
+#define	_PREEMPT_INDEX_H
+
+#include <map>
+#include <unordered_map>
+#include <vector>
+#include "data_types.h"
+
+/*
+ * Index of the resources held on each vnode by the preemptable running
+ * jobs, by preempt priority.  It lets find_jobs_to_preempt() see without
+ * duplicating the universe that no amount of preemption will make room for
+ * a job.  It only rules preemption out: it does not pick the jobs to
+ * preempt, which is still done by simulating on a copy of the universe.
+ * The index is built the first time it is needed in a cycle and
+ * kept up to date as jobs are run and ended.  It is dropped when preempt
+ * priorities are recalculated.  Duplicated servers do not carry one.
+ */
+
+/* an amount of a resource a job holds on a vnode */
+struct pcand_hold
+{
+	int node_ind;
+	resdef *def;
+	sch_resource_t amount;
+};
+
+/* a job in the index */
+struct pcand_job
+{
+	unsigned int preempt;		/* preempt priority the job was indexed with */
+	bool indexed;			/* false if the job's vnodes were not known */
+	std::vector<pcand_hold> holds;
+};
+
+struct preempt_cand_index
+{
+	/* job rank to what the job was indexed with */
+	std::unordered_map<int, pcand_job> jobs;
+	/* preempt priority to node_ind to the amounts of resources held */
+	std::map<unsigned int, std::unordered_map<int, std::unordered_map<resdef *, sch_resource_t>>> held;
+	/* preemptable running jobs whose exec_vnode could not be indexed */
+	int unindexed = 0;
+};
+
+/* index a job which has started running */
+void add_preempt_candidate(server_info *sinfo, resource_resv *resresv);
+
+/* remove a job which is ending from the index */
+void remove_preempt_candidate(server_info *sinfo, resource_resv *resresv);
+
+/* drop the index, it is rebuilt when next needed */
+void free_preempt_candidates(server_info *sinfo);
+
+/* can preempting lower priority work possibly make room for hjob */
+bool can_fit_with_preemption(server_info *sinfo, resource_resv *hjob);
+
+#endif	/* _PREEMPT_INDEX_H */
@@ -67,6 +67,8 @@
 #include <log.h>
 #include "queue_info.h"
 #include "job_info.h"
+#include "server_info.h"
+#include "job_status_cache.h"
 #include "resv_info.h"
 #include "constant.h"
 #include "misc.h"
@@ -85,6 +87,8 @@
 #include "limits_if.h"
 #include "pbs_internal.h"
 #include "fifo.h"
+#include "cycle_profile.h"
+#include "capture.h"
 
 /**
  * @brief
@@ -101,6 +105,7 @@
 queue_info **
 query_queues(status *policy, int pbs_sd, server_info *sinfo)
 {
+	prof_phase prof(__func__);
 	/* the linked list of queues returned from the server */
 	struct batch_status *queues;
 
@@ -135,6 +140,9 @@ query_queues(status *policy, int pbs_sd, server_info *sinfo)
 
 	schd_error *sch_err;
 
+	/* queues whose jobs we queried - the rest are dropped from the job status cache */
+	std::unordered_set<std::string> job_queues;
+
 	if (policy == NULL || sinfo == NULL)
 		return NULL;
 
@@ -220,6 +228,7 @@ query_queues(status *policy, int pbs_sd, server_info *sinfo)
 			if (ret != QUEUE_NOT_EXEC) {
 				/* get all the jobs which reside in the queue */
 				qinfo->jobs = query_jobs(policy, pbs_sd, qinfo, NULL, qinfo->name);
+				job_queues.insert(qinfo->name);
 
 				for (auto& pq : conf.peer_queues) {
 					if (qinfo->name == pq.local_queue) {
@@ -228,6 +237,9 @@ query_queues(status *policy, int pbs_sd, server_info *sinfo)
 						if (pq.remote_server.empty()) {
 							peer_sd = pbs_sd;
 						}
+						/* a capture only holds our own server's jobs */
+						else if (replay_active())
+							peer_on = 0;
 						else if ((peer_sd = pbs_connect_noblk(const_cast<char *>(pq.remote_server.c_str()), 2)) < 0) {
 							/* Message was PBSEVENT_SCHED - moved to PBSEVENT_DEBUG2 for
 							 * failover reasons (see bz3002)
@@ -311,6 +323,8 @@ query_queues(status *policy, int pbs_sd, server_info *sinfo)
 	}
 	qinfo_arr[qidx] = NULL;
 
+	if (!err)
+		jstat_cache.prune_queues(job_queues);
 
 	pbs_statfree(queues);
 	free_schd_error(sch_err);
@@ -896,7 +910,17 @@ queue_info::queue_info(queue_info& oqinfo, server_info *nsinfo): name(oqinfo.nam
 	} else
 		resv = NULL;
 	
-	jobs = dup_resource_resv_array(oqinfo.jobs, server, this);
+	if (nsinfo->is_snapshot && oqinfo.jobs != NULL) {
+		resource_resv **touched;
+
+		touched = resource_resv_filter(oqinfo.jobs, count_array(oqinfo.jobs),
+			snapshot_keep_job, nsinfo, 0);
+		jobs = dup_resource_resv_array(touched, server, this);
+		free(touched);
+		/* sc.total is used as the length of the job arrays */
+		sc.total = count_array(jobs);
+	} else
+		jobs = dup_resource_resv_array(oqinfo.jobs, server, this);
 
 	running_jobs = resource_resv_filter(jobs, sc.total, check_run_job, NULL, 0);
 
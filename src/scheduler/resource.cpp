@@ -83,6 +83,8 @@
 #include "parse.h"
 #include "limits_if.h"
 #include "fifo.h"
+#include "formula.h"
+#include "node_info.h"
 
 
 
@@ -386,8 +388,10 @@ update_resource_defs(int pbs_sd)
 
 	consres.clear();
 	for (const auto& def : allres) {
-		if (def.second->type.is_consumable)
+		if (def.second->type.is_consumable) {
+			def.second->ordinal = consres.size();
 			consres.insert(def.second);
+		}
 	}
 
 	boolres.clear();
@@ -403,6 +407,8 @@ update_resource_defs(int pbs_sd)
 	update_sorting_defs();
 
 	clear_limres();
+	clear_compiled_formulas();
+	clear_parse_caches();
 
 	return true;
 }
@@ -112,6 +112,7 @@
 #include "range.h"
 #include "simulate.h"
 #include "multi_threading.h"
+#include "mem_pool.h"
 
 
 /**
@@ -201,35 +202,6 @@ free_resource_resv_array_chunk(th_data_free_resresv *data)
 	}
 }
 
-/**
- * @brief	Allocates th_data_free_resresv for multi-threading of free_resource_resv_array
- *
- * @param[in,out]	resresv_arr	-	the resresv array to free
- * @param[in]	sidx	-	start index for the resresv array for the thread
- * @param[in]	eidx	-	end index for the resresv array for the thread
- *
- * @return th_data_free_resresv *
- * @retval a newly allocated th_data_free_resresv object
- * @retval NULL for malloc error
- */
-static inline th_data_free_resresv *
-alloc_tdata_free_rr_arr(resource_resv **resresv_arr, int sidx, int eidx)
-{
-	th_data_free_resresv *tdata;
-
-	tdata = static_cast<th_data_free_resresv *>(malloc(sizeof(th_data_free_resresv)));
-	if (tdata == NULL) {
-		log_err(errno, __func__, MEM_ERR_MSG);
-		return NULL;
-	}
-
-	tdata->resresv_arr = resresv_arr;
-	tdata->sidx = sidx;
-	tdata->eidx = eidx;
-
-	return tdata;
-}
-
 /**
  * @brief
  *		free_resource_resv_array - free an array of resource resvs
@@ -242,63 +214,15 @@ alloc_tdata_free_rr_arr(resource_resv **resresv_arr, int sidx, int eidx)
 void
 free_resource_resv_array(resource_resv **resresv_arr)
 {
-	int i;
-	int chunk_size;
-	th_data_free_resresv *tdata = NULL;
-	th_task_info *task = NULL;
-	int num_tasks;
-	int num_jobs;
-	int tid;
-
 	if (resresv_arr == NULL)
 		return;
 
-	num_jobs = count_array(resresv_arr);
-
-	tid = *((int *) pthread_getspecific(th_id_key));
-	if (tid != 0 || num_threads <= 1) {
-		/* don't use multi-threading if I am a worker thread or num_threads is 1 */
-		tdata = alloc_tdata_free_rr_arr(resresv_arr, 0, num_jobs - 1);
-		if (tdata == NULL)
-			return;
-
-		free_resource_resv_array_chunk(tdata);
-		free(tdata);
-		free(resresv_arr);
-		return;
-	}
-
-	chunk_size = num_jobs / num_threads;
-	chunk_size = (chunk_size > MT_CHUNK_SIZE_MIN) ? chunk_size : MT_CHUNK_SIZE_MIN;
-	chunk_size = (chunk_size < MT_CHUNK_SIZE_MAX) ? chunk_size : MT_CHUNK_SIZE_MAX;
-	for (i = 0, num_tasks = 0; num_jobs > 0;
-			num_tasks++, i += chunk_size, num_jobs -= chunk_size) {
-		tdata = alloc_tdata_free_rr_arr(resresv_arr, i, i + chunk_size - 1);
-		if (tdata == NULL)
-			break;
-
-		task = static_cast<th_task_info *>(malloc(sizeof(th_task_info)));
-		task->task_type = TS_FREE_RESRESV;
-		task->thread_data = (void *) tdata;
-
-		queue_work_for_threads(task);
-	}
-
-	/* Get results from worker threads */
-	for (i = 0; i < num_tasks;) {
-		pthread_mutex_lock(&result_lock);
-		while (ds_queue_is_empty(result_queue))
-			pthread_cond_wait(&result_cond, &result_lock);
-		while (!ds_queue_is_empty(result_queue)) {
-			task = static_cast<th_task_info *>(ds_dequeue(result_queue));
-			tdata = static_cast<th_data_free_resresv *>(task->thread_data);
-			free(tdata);
-			free(task);
-			i++;
-		}
-		pthread_mutex_unlock(&result_lock);
-	}
-
+	parallel_for("free_resource_resv_array", count_array(resresv_arr), MT_CHUNK_SIZE_MIN,
+		[resresv_arr](int sidx, int eidx) {
+			th_data_free_resresv tdata = {resresv_arr, sidx, eidx};
+			free_resource_resv_array_chunk(&tdata);
+			return 0;
+		});
 	free(resresv_arr);
 }
 
@@ -309,9 +233,6 @@ free_resource_resv_array(resource_resv **resresv_arr)
  */
 resource_resv::~resource_resv()
 {
-	free(user);
-	free(group);
-	free(project);
 	free(nodepart_name);
 	delete select;
 	delete execselect;
@@ -450,7 +371,7 @@ dup_resource_resv_array(resource_resv **oresresv_arr,
 	nresresv_arr[0] = NULL;
 
 	tid = *((int *) pthread_getspecific(th_id_key));
-	if (tid != 0 || num_threads <= 1) {
+	if (tid != 0 || num_threads <= 1 || inside_parallel_for()) {
 		/* don't use multi-threading if I am a worker thread or num_threads is 1 */
 		tdata = alloc_tdata_dup_nodes(oresresv_arr, nresresv_arr, nsinfo, nqinfo, 0, num_resresv - 1);
 		if (tdata == NULL)
@@ -462,9 +383,7 @@ dup_resource_resv_array(resource_resv **oresresv_arr,
 		}
 	} else { /* We are multithreading */
 		int num_tasks = 0;
-		int chunk_size = num_resresv / num_threads;
-		chunk_size = (chunk_size > MT_CHUNK_SIZE_MIN)? chunk_size: MT_CHUNK_SIZE_MIN;
-		chunk_size = (chunk_size < MT_CHUNK_SIZE_MAX)? chunk_size: MT_CHUNK_SIZE_MAX;
+		int chunk_size = mt_chunk_size(num_resresv, MT_CHUNK_SIZE_MIN);
 		for (int j = 0; thread_job_ct_left > 0;
 				num_tasks++, j += chunk_size, thread_job_ct_left -= chunk_size) {
 			tdata = alloc_tdata_dup_nodes(oresresv_arr, nresresv_arr, nsinfo, nqinfo, j, j + chunk_size - 1);
@@ -551,9 +470,9 @@ dup_resource_resv(resource_resv *oresresv, server_info *nsinfo, queue_info *nqin
 	nresresv->server = nsinfo;
 
 	nresresv->svr_inst_id = string_dup(oresresv->svr_inst_id);
-	nresresv->user = string_dup(oresresv->user);
-	nresresv->group = string_dup(oresresv->group);
-	nresresv->project = string_dup(oresresv->project);
+	nresresv->user = oresresv->user;
+	nresresv->group = oresresv->group;
+	nresresv->project = oresresv->project;
 
 	nresresv->nodepart_name = string_dup(oresresv->nodepart_name);
 	if (oresresv->select != NULL)
@@ -683,9 +602,17 @@ find_resource_resv_by_indrank(resource_resv **resresv_arr, int index, int rank)
 	if (resresv_arr == NULL)
 		return NULL;
 
-	if (index != -1 && resresv_arr[0] != NULL && resresv_arr[0]->server != NULL &&
-	    resresv_arr[0]->server->all_resresv != NULL)
-		return resresv_arr[0]->server->all_resresv[index];
+	if (index != -1 && resresv_arr[0] != NULL && resresv_arr[0]->server != NULL) {
+		server_info *sinfo = resresv_arr[0]->server;
+
+		if (sinfo->is_snapshot) {
+			/* resresvs created during the simulation are not in the map */
+			auto it = sinfo->snapshot_ind.find(index);
+			if (it != sinfo->snapshot_ind.end() && it->second != NULL && it->second->rank == rank)
+				return it->second;
+		} else if (sinfo->all_resresv != NULL)
+			return sinfo->all_resresv[index];
+	}
 
 	for (i = 0; resresv_arr[i] != NULL && resresv_arr[i]->rank != rank; i++)
 		;
@@ -1009,12 +936,12 @@ new_resource_req()
 {
 	resource_req *resreq;
 
-	if ((resreq = static_cast<resource_req *>(calloc(1, sizeof(resource_req)))) == NULL) {
+	if ((resreq = static_cast<resource_req *>(pool_alloc(POOL_RESOURCE_REQ, sizeof(resource_req)))) == NULL) {
 		log_err(errno, __func__, MEM_ERR_MSG);
 		return NULL;
 	}
 
-	/* member type zero'd by calloc() */
+	/* member type zero'd by pool_alloc() */
 
 	resreq->name = NULL;
 	resreq->res_str = NULL;
@@ -1036,7 +963,7 @@ resource_count *new_resource_count()
 {
 	resource_count *rcount;
 
-	if ((rcount = static_cast<resource_count *>(malloc(sizeof(resource_count)))) == NULL) {
+	if ((rcount = static_cast<resource_count *>(pool_alloc(POOL_RESOURCE_COUNT, sizeof(resource_count)))) == NULL) {
 		log_err(errno, __func__, MEM_ERR_MSG);
 		return NULL;
 	}
@@ -1380,7 +1307,7 @@ free_resource_req(resource_req *req)
 	if (req->res_str != NULL)
 		free(req->res_str);
 
-	free(req);
+	pool_free(POOL_RESOURCE_REQ, req);
 }
 
 /**
@@ -1395,7 +1322,7 @@ free_resource_req(resource_req *req)
 void
 free_resource_count(resource_count *rcount)
 {
-	free(rcount);
+	pool_free(POOL_RESOURCE_COUNT, rcount);
 }
 
 /**
@@ -54,6 +54,7 @@
  *	dup_resv_info()
  *	check_new_reservations()
  *	disable_reservation_occurrence()
+ *	confirm_occurrences_parallel()
  *	confirm_reservation()
  *	check_vnodes_unavailable()
  *	release_nodes()
@@ -62,6 +63,10 @@
  */
 #include <pbs_config.h>
 
+#include <atomic>
+#include <string>
+#include <vector>
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -88,6 +93,8 @@
 #include "node_partition.h"
 #include "pbs_internal.h"
 #include "libpbs.h"
+#include "cycle_profile.h"
+#include "multi_threading.h"
 
 /**
  * @brief
@@ -141,6 +148,7 @@ stat_resvs(int pbs_sd)
 resource_resv **
 query_reservations(int pbs_sd, server_info *sinfo, struct batch_status *resvs)
 {
+	prof_phase prof(__func__);
 	/* the current reservation in the list */
 	struct batch_status *cur_resv;
 
@@ -630,9 +638,9 @@ query_resv(struct batch_status *resv, server_info *sinfo)
 
 	while (attrp != NULL) {
 		if (!strcmp(attrp->name, ATTR_resv_owner))
-			advresv->user = string_dup(attrp->value);
+			advresv->user = intern_name(attrp->value);
 		else if (!strcmp(attrp->name, ATTR_egroup))
-			advresv->group = string_dup(attrp->value);
+			advresv->group = intern_name(attrp->value);
 		else if (!strcmp(attrp->name, ATTR_queue))
 			advresv->resv->queuename = string_dup(attrp->value);
 		else if (!strcmp(attrp->name, ATTR_SchedSelect)) {
@@ -1014,6 +1022,7 @@ dup_resv_info(resv_info *rinfo, server_info *sinfo)
 int
 check_new_reservations(status *policy, int pbs_sd, resource_resv **resvs, server_info *sinfo)
 {
+	prof_phase prof(__func__);
 	int count = 0;	/* new reservation count */
 	int pbsrc = 0;	/* return code from pbs_confirmresv() */
 
@@ -1321,6 +1330,151 @@ disable_reservation_occurrence(timed_event *events,
 	return 1;
 }
 
+/**
+ * @brief
+ * 		try to fit the occurrences of a new standing reservation on the
+ *		worker threads.  Each thread takes a run of consecutive occurrences
+ *		and simulates its own copy of the universe forward through them, so
+ *		every occurrence is checked against the universe it would see if
+ *		the occurrences were checked one after another.
+ *
+ * @param[in]	policy	-	policy info
+ * @param[in]	nsinfo	-	the simulated universe.  It is only copied.
+ * @param[in]	resv	-	the parent reservation in nsinfo
+ * @param[in]	occr_start_arr	-	the start times of the occurrences
+ * @param[in]	occr_count	-	the number of occurrences
+ * @param[out]	execvnodes	-	the execvnodes of the occurrences which fit
+ * @param[out]	logmsg	-	why the first occurrence which didn't fit failed
+ *
+ * @return	int
+ * @retval	the number of occurrences which fit before the first which didn't
+ */
+static int
+confirm_occurrences_parallel(status *policy, server_info *nsinfo, resource_resv *resv,
+	const time_t *occr_start_arr, int occr_count, std::string& execvnodes, char *logmsg)
+{
+	std::vector<char *> occr_xc(occr_count, NULL);
+	std::vector<std::string> occr_msg(occr_count);
+	std::atomic<int> first_fail(occr_count);
+	int fit;
+
+	/* occurrences past a failure are not needed */
+	auto fail_at = [&](int j) {
+		int f = first_fail.load();
+		while (j < f && !first_fail.compare_exchange_weak(f, j))
+			;
+	};
+
+	parallel_for(__func__, occr_count, (occr_count + num_threads - 1) / num_threads,
+		[&](int sidx, int eidx) {
+			server_info *wsinfo;
+			resource_resv *wresv = NULL;
+			resource_resv *occr = NULL;
+			resource_resv **tmp_resresv;
+			schd_error *err;
+			unsigned int simrc;
+			time_t sim_time;
+			nspec **ns;
+			char *tmp;
+
+			if ((err = new_schd_error()) == NULL) {
+				fail_at(sidx);
+				return 0;
+			}
+			wsinfo = dup_server_info(nsinfo);
+			if (wsinfo != NULL)
+				wresv = find_resource_resv_by_indrank(wsinfo->resvs, resv->resresv_ind, resv->rank);
+			if (wresv == NULL) {
+				occr_msg[sidx] = "Error determining if reservation can be confirmed: "
+					"Resource not found.";
+				fail_at(sidx);
+				free_server(wsinfo);
+				free_schd_error(err);
+				return 0;
+			}
+
+			for (int j = sidx; j <= eidx && j < first_fail.load(); j++) {
+				time_t next = occr_start_arr[j];
+
+				if (j == 0)
+					occr = wresv;
+				else {
+					occr = dup_resource_resv(occr != NULL ? occr : wresv, wsinfo, NULL);
+					if (occr == NULL) {
+						fail_at(j);
+						break;
+					}
+					tmp_resresv = add_resresv_to_array(wsinfo->resvs, occr, NO_FLAGS);
+					if (tmp_resresv == NULL) {
+						delete occr;
+						fail_at(j);
+						break;
+					}
+					wsinfo->resvs = tmp_resresv;
+					tmp_resresv = add_resresv_to_array(wsinfo->all_resresv, occr, SET_RESRESV_INDEX);
+					if (tmp_resresv == NULL) {
+						fail_at(j);
+						break;
+					}
+					wsinfo->all_resresv = tmp_resresv;
+					wsinfo->num_resvs++;
+				}
+
+				occr->resv->req_start = next;
+				occr->start = next;
+				occr->end = next + occr->resv->req_duration;
+
+				simrc = simulate_events(policy, wsinfo, SIM_TIME, (void *) &next, &sim_time);
+				if (simrc & TIMED_ERROR) {
+					log_event(PBSEVENT_RESV, PBS_EVENTCLASS_RESV, LOG_INFO, occr->name,
+						"Error determining if reservation can be confirmed: "
+						"Simulation failed.");
+					fail_at(j);
+					break;
+				}
+
+				clear_schd_error(err);
+				if ((ns = is_ok_to_run(wsinfo->policy, wsinfo, NULL, occr, NO_ALLPART, err)) == NULL) {
+					char buf[MAX_LOG_SIZE];
+
+					(void) translate_fail_code(err, NULL, buf);
+					occr_msg[j] = buf;
+					fail_at(j);
+					break;
+				}
+				qsort(ns, count_array(ns), sizeof(nspec *), cmp_nspec);
+				tmp = create_execvnode(ns);
+				free_nspecs(ns);
+				if (tmp == NULL || (occr_xc[j] = string_dup(tmp)) == NULL) {
+					log_event(PBSEVENT_RESV, PBS_EVENTCLASS_RESV, LOG_INFO, occr->name,
+						"Error determining if reservation can be confirmed: "
+						"Creation of execvnode failed.");
+					fail_at(j);
+					break;
+				}
+			}
+
+			free_server(wsinfo);
+			free_schd_error(err);
+			return 0;
+		});
+
+	/* put the results together in occurrence order */
+	fit = first_fail.load();
+	for (int j = 0; j < fit; j++) {
+		if (j > 0)
+			execvnodes += TOKEN_SEPARATOR;
+		execvnodes += occr_xc[j];
+	}
+	if (fit < occr_count)
+		pbs_strncpy(logmsg, occr_msg[fit].c_str(), MAX_LOG_SIZE);
+
+	for (auto xc : occr_xc)
+		free(xc);
+
+	return fit;
+}
+
 /**
  * @brief
  * 		determines if a resource reservation can be satisfied
@@ -1368,6 +1522,8 @@ confirm_reservation(status *policy, int pbs_sd, resource_resv *unconf_resv, serv
 	 */
 	time_t resv_start_time = 0;		/* estimated start time for resv */
 	time_t *occr_start_arr = NULL;		/* an array of occurrence start times */
+	time_t *occr_times = NULL;		/* start times of the rule's occurrences from dtstart */
+	int num_occr_times;
 
 	std::string execvnodes;
 	char *short_xc = NULL;
@@ -1409,6 +1565,12 @@ confirm_reservation(status *policy, int pbs_sd, resource_resv *unconf_resv, serv
 		return RESV_CONFIRM_FAIL;
 	}
 
+	/* Look the occurrences up once rather than one index at a time */
+	num_occr_times = get_occurrence_times(rrule, dtstart, tz, &occr_times);
+	auto occr_time = [&](int j) {
+		return j < num_occr_times ? occr_times[j] : get_occurrence(rrule, dtstart, tz, j + 1);
+	};
+
 
 	/* Each reservation attempts to confirm a set of nodes on which to run for
 	 * a given start and end time. When handling an advance reservation,
@@ -1428,13 +1590,37 @@ confirm_reservation(status *policy, int pbs_sd, resource_resv *unconf_resv, serv
 	 * date information.
 	 */
 	cur_count = 0;
-	for (int j = 0; j < occr_count && rconf == RESV_CONFIRM_SUCCESS;
+
+	/* The occurrences of a new standing reservation only depend on the
+	 * simulated universe at their start times, so they can be checked on the
+	 * worker threads.  Reconfirmations, alters and ASAP reservations are done
+	 * one occurrence at a time below.
+	 */
+	if (nresv->resv->is_standing && occr_count > 1 && num_threads > 1 &&
+	    nresv->resv->resv_substate != RESV_DEGRADED && nresv->resv->resv_substate != RESV_IN_CONFLICT &&
+	    nresv->resv->resv_state != RESV_BEING_ALTERED && nresv->resv->req_start != PBS_RESV_FUTURE_SCH) {
+		for (int j = 0; j < occr_count; j++)
+			occr_start_arr[j] = occr_time(j);
+
+		confirmd_occr = confirm_occurrences_parallel(policy, nsinfo, nresv,
+			occr_start_arr, occr_count, execvnodes, logmsg);
+		nresv->resv->req_start = occr_start_arr[0];
+		nresv->start = nresv->resv->req_start;
+		nresv->end = nresv->start + nresv->resv->req_duration;
+		if (confirmd_occr == occr_count)
+			resv_start_time = occr_start_arr[0];
+		else
+			rconf = RESV_CONFIRM_FAIL;
+		cur_count = occr_count;
+	}
+
+	for (int j = cur_count; j < occr_count && rconf == RESV_CONFIRM_SUCCESS;
 	     j++, cur_count = j) {
 		/* Get the start time of the next occurrence.
 		 * See call to same function in query_reservations for a more in-depth
 		 * description.
 		 */
-		next = get_occurrence(rrule, dtstart, tz, j + 1);
+		next = occr_time(j);
 		/* keep track of each occurrence's start time */
 		occr_start_arr[j] = next;
 
@@ -1700,7 +1886,7 @@ confirm_reservation(status *policy, int pbs_sd, resource_resv *unconf_resv, serv
 			 * so we only care about the remaining ones
 			 */
 			for (; cur_count < occr_count; cur_count++) {
-				next = get_occurrence(rrule, dtstart, tz, cur_count + 1);
+				next = occr_time(cur_count);
 				occr_start_arr[cur_count] = next;
 			}
 		}
@@ -1731,6 +1917,8 @@ confirm_reservation(status *policy, int pbs_sd, resource_resv *unconf_resv, serv
 	/* clean up */
 	free_schd_error(err);
 
+	free(occr_times);
+
 	/* the return value is initialized to RESV_CONFIRM_SUCCESS */
 	return rconf;
 }
@@ -2117,6 +2305,8 @@ create_resv_nodes(nspec **nspec_arr, server_info *sinfo)
 					}
 					req = req->next;
 				}
+				/* find_alloc_resource() may have added resources */
+				index_node_resources(nodes[i]);
 			}
 			nodes[i] = NULL;
 		}
@@ -40,8 +40,14 @@
 #include <pbs_config.h>
 
 #include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
 #include <pbs_ifl.h>
 #include <libpbs.h>
+#include "pbs_version.h"
+#include "attribute.h"
 #include "data_types.h"
 #include "fifo.h"
 #include "globals.h"
@@ -49,7 +55,26 @@
 #include "misc.h"
 #include "log.h"
 #include "server_info.h"
-
+#include "capture.h"
+
+/* jobs waiting to be sent in one run job list, per server instance fd */
+struct runjob_batch {
+	std::vector<std::string> jobids;
+	std::vector<std::string> execvnodes;
+};
+static std::unordered_map<int, runjob_batch> runjob_batches;
+
+/* every server instance is known to take run job lists */
+static bool runjob_batch_supported = false;
+
+/* attribute updates of one job waiting for the end of the cycle */
+struct job_attr_update {
+	int job_owner_sd;
+	std::string job_name;
+	struct attrl *attrs;
+};
+static std::vector<job_attr_update> pending_attr_updates;
+static std::unordered_map<std::string, size_t> pending_attr_index;
 
 /**
  * @brief	Handle partition tolerance related issues
@@ -75,6 +100,108 @@ handle_part_tolerance(void *ret)
 	return ret;
 }
 
+/**
+ * @brief	Send one batch of queued run requests to a server instance
+ *
+ * @param[in]	job_owner_sd	-	fd of the server instance
+ * @param[in,out]	batch	-	the queued jobs, emptied on return
+ *
+ * @return	void
+ */
+static void
+send_run_job_batch(int job_owner_sd, runjob_batch& batch)
+{
+	std::vector<char *> jobids;
+	std::vector<char *> execvnodes;
+	struct batch_deljob_status *failed = NULL;
+	struct batch_deljob_status *p;
+	int rc;
+
+	if (batch.jobids.empty())
+		return;
+
+	for (size_t i = 0; i < batch.jobids.size(); i++) {
+		jobids.push_back(const_cast<char *>(batch.jobids[i].c_str()));
+		execvnodes.push_back(const_cast<char *>(batch.execvnodes[i].c_str()));
+	}
+
+	rc = PBSD_runjoblist(job_owner_sd, jobids.data(), execvnodes.data(), jobids.size(), NULL, &failed);
+	if (rc == PBSE_UNKREQ) {
+		/* The server closes the connection after rejecting a request, so
+		 * the jobs can't be resent here.  They are picked up next cycle.
+		 */
+		log_event(PBSEVENT_SCHED, PBS_EVENTCLASS_SCHED, LOG_NOTICE, __func__,
+			"Server does not support run job lists, sending run requests one at a time");
+		runjob_batch_supported = false;
+	}
+	if (rc == PBSE_NONE)
+		log_eventf(PBSEVENT_DEBUG2, PBS_EVENTCLASS_SCHED, LOG_DEBUG, __func__,
+			"Run job list of %d jobs sent", (int) jobids.size());
+	else {
+		log_eventf(PBSEVENT_SCHED, PBS_EVENTCLASS_SCHED, LOG_WARNING, __func__,
+			"Run job list of %d jobs failed (%d)", (int) jobids.size(), rc);
+		for (auto jid : jobids)
+			log_eventf(PBSEVENT_SCHED, PBS_EVENTCLASS_JOB, LOG_WARNING, jid,
+				"Server could not run job: %s (%d)", pbse_to_txt(rc) != NULL ? pbse_to_txt(rc) : "", rc);
+	}
+
+	for (p = failed; p != NULL; p = p->next) {
+		const char *errtxt = pbse_to_txt(p->code);
+
+		log_eventf(PBSEVENT_SCHED, PBS_EVENTCLASS_JOB, LOG_WARNING, p->name,
+			"Server could not run job: %s (%d)", errtxt != NULL ? errtxt : "", p->code);
+	}
+	pbs_delstatfree(failed);
+
+	batch.jobids.clear();
+	batch.execvnodes.clear();
+}
+
+/**
+ * @brief	Decide whether run requests can be sent in run job lists this
+ *		cycle.  Only a server of the same version as the scheduler is known
+ *		to take them.  An older server rejects the request and drops the
+ *		connection, so this must be known before the first list is sent.
+ *
+ * @param[in]	server	-	the status of every server instance
+ *
+ * @return	void
+ */
+void
+check_runjob_list_support(struct batch_status *server)
+{
+	runjob_batch_supported = (server != NULL);
+
+	for (auto bs = server; bs != NULL; bs = bs->next) {
+		struct attrl *attrp;
+
+		for (attrp = bs->attribs; attrp != NULL; attrp = attrp->next) {
+			if (strcmp(attrp->name, ATTR_version) == 0)
+				break;
+		}
+		if (attrp == NULL || strcmp(attrp->value, PBS_VERSION) != 0) {
+			runjob_batch_supported = false;
+			break;
+		}
+	}
+}
+
+/**
+ * @brief	Send all run requests queued by send_run_job()
+ *
+ * @note	Must be called before anything that depends on the queued jobs
+ *		having been started on the server, and at the end of the cycle.
+ *
+ * @return	void
+ */
+void
+flush_run_jobs(void)
+{
+	for (auto& b : runjob_batches)
+		send_run_job_batch(b.first, b.second);
+	runjob_batches.clear();
+}
+
 /**
  * @brief	Send the relevant runjob request to server
  *
@@ -95,41 +222,46 @@ send_run_job(int virtual_sd, int has_runjob_hook, const std::string& jobid, char
 	if (jobid.empty() || execvnode == NULL)
 		return 1;
 
+	if (replay_active()) {
+		replay_decision("run", jobid, execvnode);
+		return 0;
+	}
+
 	job_owner_sd = get_svr_inst_fd(virtual_sd, svr_id_job);
 
 	if (sc_attrs.runjob_mode == RJ_EXECJOB_HOOK)
 		return pbs_runjob(job_owner_sd, const_cast<char *>(jobid.c_str()), execvnode, NULL);
 	else if (((sc_attrs.runjob_mode == RJ_RUNJOB_HOOK) && has_runjob_hook))
 		return pbs_asyrunjob_ack(job_owner_sd, const_cast<char *>(jobid.c_str()), execvnode, NULL);
-	else
+	else if (conf.runjob_batch_size > 1 && runjob_batch_supported && job_owner_sd != SIMULATE_SD) {
+		/* like pbs_asyrunjob(), failures are only logged once the batch is sent */
+		runjob_batch& batch = runjob_batches[job_owner_sd];
+
+		batch.jobids.push_back(jobid);
+		batch.execvnodes.push_back(execvnode);
+		if (static_cast<int>(batch.jobids.size()) >= conf.runjob_batch_size)
+			send_run_job_batch(job_owner_sd, batch);
+		return 0;
+	} else
 		return pbs_asyrunjob(job_owner_sd, const_cast<char *>(jobid.c_str()), execvnode, NULL);
 }
 
 /**
- * @brief
- * 		send delayed attributes to the server for a job
+ * @brief	Send an alter request for a job to its server instance
  *
- * @param[in]	virtual_sd	-	virtual sd for the cluster
- * @param[in]	resresv	-	resource_resv object for job
+ * @param[in]	job_owner_sd	-	fd of the server instance owning the job
+ * @param[in]	job_name	-	id of the job
  * @param[in]	pattr	-	attrl list to update on the server
  *
  * @return	int
  * @retval	1	success
  * @retval	0	failure to update
  */
-int
-send_attr_updates(int virtual_sd, resource_resv *resresv, struct attrl *pattr)
+static int
+send_job_attr_list(int job_owner_sd, const std::string& job_name, struct attrl *pattr)
 {
 	const char *errbuf;
 	int one_attr = 0;
-	int job_owner_sd = get_svr_inst_fd(virtual_sd, resresv->svr_inst_id);
-	const std::string& job_name = resresv->name;
-
-	if (job_name.empty() || pattr == NULL)
-		return 0;
-
-	if (job_owner_sd == SIMULATE_SD)
-		return 1; /* simulation always successful */
 
 	if (pattr->next == NULL)
 		one_attr = 1;
@@ -165,6 +297,103 @@ send_attr_updates(int virtual_sd, resource_resv *resresv, struct attrl *pattr)
 	return 0;
 }
 
+/**
+ * @brief
+ * 		send delayed attributes to the server for a job
+ *
+ * @param[in]	virtual_sd	-	virtual sd for the cluster
+ * @param[in]	resresv	-	resource_resv object for job
+ * @param[in]	pattr	-	attrl list to update on the server
+ *
+ * @return	int
+ * @retval	1	success
+ * @retval	0	failure to update
+ */
+int
+send_attr_updates(int virtual_sd, resource_resv *resresv, struct attrl *pattr)
+{
+	int job_owner_sd;
+
+	if (resresv->name.empty() || pattr == NULL)
+		return 0;
+
+	if (replay_active())
+		return 1;
+
+	job_owner_sd = get_svr_inst_fd(virtual_sd, resresv->svr_inst_id);
+	if (job_owner_sd == SIMULATE_SD)
+		return 1; /* simulation always successful */
+
+	return send_job_attr_list(job_owner_sd, resresv->name, pattr);
+}
+
+/**
+ * @brief
+ * 		queue attributes to be sent to the server for a job at the end
+ *		of the cycle.  If the job already has queued updates, the lists are
+ *		merged so the job gets one alter request with the last value of
+ *		each attribute.
+ *
+ * @param[in]	virtual_sd	-	virtual sd for the cluster
+ * @param[in]	resresv	-	resource_resv object for job
+ * @param[in]	pattr	-	attrl list to update on the server (consumed)
+ *
+ * @return	int
+ * @retval	1	success
+ * @retval	0	nothing to queue
+ */
+int
+queue_attr_updates(int virtual_sd, resource_resv *resresv, struct attrl *pattr)
+{
+	int job_owner_sd;
+
+	if (resresv->name.empty() || pattr == NULL) {
+		free_attrl_list(pattr);
+		return 0;
+	}
+
+	job_owner_sd = replay_active() ? SIMULATE_SD : get_svr_inst_fd(virtual_sd, resresv->svr_inst_id);
+	if (job_owner_sd == SIMULATE_SD) {
+		free_attrl_list(pattr);
+		return 1; /* simulation always successful */
+	}
+
+	auto it = pending_attr_index.find(resresv->name);
+	if (it == pending_attr_index.end()) {
+		pending_attr_index[resresv->name] = pending_attr_updates.size();
+		pending_attr_updates.push_back({job_owner_sd, resresv->name, pattr});
+	} else {
+		job_attr_update& upd = pending_attr_updates[it->second];
+		upd.attrs = merge_attr_updates(pattr, upd.attrs);
+	}
+
+	return 1;
+}
+
+/**
+ * @brief	Send all attribute updates queued by queue_attr_updates()
+ *
+ * @return	void
+ */
+void
+flush_attr_updates(void)
+{
+	int sent = 0;
+
+	for (auto& upd : pending_attr_updates) {
+		/* our connection to the server went away, don't try to send */
+		if (!got_sigpipe && send_job_attr_list(upd.job_owner_sd, upd.job_name, upd.attrs))
+			sent++;
+		free_attrl_list(upd.attrs);
+	}
+	if (!pending_attr_updates.empty())
+		log_eventf(PBSEVENT_DEBUG2, PBS_EVENTCLASS_SCHED, LOG_DEBUG, __func__,
+			"Sent attribute updates for %d of %d jobs", sent, (int) pending_attr_updates.size());
+
+	pending_attr_updates.clear();
+	pending_attr_index.clear();
+}
+
 /**
  * @brief	Wrapper for pbs_preempt_jobs
  *
@@ -179,6 +408,27 @@ send_preempt_jobs(int virtual_sd, char **preempt_jobs_list)
 {
 	preempt_job_info *ret;
 
+	if (replay_active()) {
+		int n;
+
+		for (n = 0; preempt_jobs_list[n] != NULL; n++)
+			;
+		if ((ret = static_cast<preempt_job_info *>(calloc(n, sizeof(preempt_job_info)))) == NULL) {
+			log_err(errno, __func__, MEM_ERR_MSG);
+			return NULL;
+		}
+		/* report every job as requeued */
+		for (int i = 0; i < n; i++) {
+			replay_decision("preempt", preempt_jobs_list[i], NULL);
+			pbs_strncpy(ret[i].job_id, preempt_jobs_list[i], sizeof(ret[i].job_id));
+			ret[i].order[0] = 'Q';
+		}
+		return ret;
+	}
+
+	/* the server must see the jobs we already started before it preempts */
+	flush_run_jobs();
+
     ret = pbs_preempt_jobs(virtual_sd, preempt_jobs_list);
 
 	if (handle_part_tolerance(ret) == NULL) {
@@ -205,6 +455,11 @@ send_sigjob(int virtual_sd, resource_resv *resresv, const char *signal, char *ex
 {
 	int ret = 0;
 
+	if (replay_active()) {
+		replay_decision("signal", resresv->name, signal);
+		return 0;
+	}
+
 	ret = pbs_sigjob(get_svr_inst_fd(virtual_sd, resresv->svr_inst_id),
 			  const_cast<char *>(resresv->name.c_str()), const_cast<char *>(signal), extend);
 
@@ -232,6 +487,12 @@ send_confirmresv(int virtual_sd, resource_resv *resv, const char *location, unsi
 {
 	int ret = 0;
 
+	if (replay_active()) {
+		replay_decision(extend != NULL && strcmp(extend, PBS_RESV_CONFIRM_FAIL) == 0 ? "deny" : "confirm",
+			resv->name, location);
+		return 0;
+	}
+
 	ret = pbs_confirmresv(get_svr_inst_fd(virtual_sd, resv->svr_inst_id),
 		const_cast<char *>(resv->name.c_str()), const_cast<char *>(location), start, const_cast<char *>(extend));	
 
@@ -256,11 +517,41 @@ send_confirmresv(int virtual_sd, resource_resv *resv, const char *location, unsi
 struct batch_status *
 send_selstat(int virtual_fd, struct attropl *attrib, struct attrl *rattrib, char *extend)
 {
+	if (replay_active())
+		return replay_stat(CAP_JOB, attrib);
+
 	auto ret = pbs_selstat(virtual_fd, attrib, rattrib, extend);
 	if (handle_part_tolerance(ret) == NULL) {
 		pbs_statfree(ret);
 		return NULL;
 	}
+	capture_record(virtual_fd, CAP_JOB, ret, attrib);
+
+	return ret;
+}
+
+/**
+ * @brief	Wrapper for pbs_selectjob
+ *
+ * @param[in] c - communication handle
+ * @param[in] attrib - pointer to attropl structure(selection criteria)
+ * @param[in] extend - extend string to encode req
+ *
+ * @return	char **
+ * @retval	list of selected job ids (free with free())
+ * @retval	NULL for no jobs or error
+ */
+char **
+send_selectjob(int virtual_fd, struct attropl *attrib, char *extend)
+{
+	if (replay_active())
+		return replay_select(attrib);
+
+	auto ret = pbs_selectjob(virtual_fd, attrib, extend);
+	if (handle_part_tolerance(ret) == NULL) {
+		free(ret);
+		return NULL;
+	}
 
 	return ret;
 }
@@ -280,11 +571,15 @@ send_selstat(int virtual_fd, struct attropl *attrib, struct attrl *rattrib, char
 struct batch_status *
 send_statvnode(int virtual_fd, char *id, struct attrl *attrib, char *extend)
 {
+	if (replay_active())
+		return replay_stat(CAP_NODE, NULL);
+
 	auto ret = pbs_statvnode(virtual_fd, id, attrib, extend);
 	if (handle_part_tolerance(ret) == NULL) {
 		pbs_statfree(ret);
 		return NULL;
 	}
+	capture_record(virtual_fd, CAP_NODE, ret, NULL);
 
 	return ret;
 }
@@ -303,11 +598,15 @@ send_statvnode(int virtual_fd, char *id, struct attrl *attrib, char *extend)
 struct batch_status *
 send_statsched(int virtual_fd, struct attrl *attrib, char *extend)
 {
+	if (replay_active())
+		return replay_stat(CAP_SCHED, NULL);
+
 	auto ret = pbs_statsched(virtual_fd, attrib, extend);
 	if (handle_part_tolerance(ret) == NULL) {
 		pbs_statfree(ret);
 		return NULL;
 	}
+	capture_record(virtual_fd, CAP_SCHED, ret, NULL);
 
 	return ret;
 }
@@ -327,11 +626,15 @@ send_statsched(int virtual_fd, struct attrl *attrib, char *extend)
 struct batch_status *
 send_statqueue(int virtual_fd, char *id, struct attrl *attrib, char *extend)
 {
+	if (replay_active())
+		return replay_stat(CAP_QUEUE, NULL);
+
 	auto ret = pbs_statque(virtual_fd, id, attrib, extend);
 	if (handle_part_tolerance(ret) == NULL) {
 		pbs_statfree(ret);
 		return NULL;
 	}
+	capture_record(virtual_fd, CAP_QUEUE, ret, NULL);
 
 	return ret;
 }
@@ -350,11 +653,15 @@ send_statqueue(int virtual_fd, char *id, struct attrl *attrib, char *extend)
 struct batch_status *
 send_statserver(int virtual_fd, struct attrl *attrib, char *extend)
 {
+	if (replay_active())
+		return replay_stat(CAP_SERVER, NULL);
+
 	auto ret = pbs_statserver(virtual_fd, attrib, extend);
 	if (handle_part_tolerance(ret) == NULL) {
 		pbs_statfree(ret);
 		return NULL;
 	}
+	capture_record(virtual_fd, CAP_SERVER, ret, NULL);
 
 	return ret;
 }
@@ -374,11 +681,15 @@ send_statserver(int virtual_fd, struct attrl *attrib, char *extend)
 struct batch_status *
 send_statrsc(int virtual_fd, char *id, struct attrl *attrib, char *extend)
 {
+	if (replay_active())
+		return replay_stat(CAP_RESOURCE, NULL);
+
 	auto ret = pbs_statrsc(virtual_fd, id, attrib, extend);
 	if (handle_part_tolerance(ret) == NULL) {
 		pbs_statfree(ret);
 		return NULL;
 	}
+	capture_record(virtual_fd, CAP_RESOURCE, ret, NULL);
 
 	return ret;
 }
@@ -398,11 +709,15 @@ send_statrsc(int virtual_fd, char *id, struct attrl *attrib, char *extend)
 struct batch_status *
 send_statresv(int virtual_fd, char *id, struct attrl *attrib, char *extend)
 {
+	if (replay_active())
+		return replay_stat(CAP_RESV, NULL);
+
 	auto ret = pbs_statresv(virtual_fd, id, attrib, extend);
 	if (handle_part_tolerance(ret) == NULL) {
 		pbs_statfree(ret);
 		return NULL;
 	}
+	capture_record(virtual_fd, CAP_RESV, ret, NULL);
 
 	return ret;
 }
@@ -73,7 +73,9 @@
  * 	check_running_job_not_in_reservation()
  * 	check_running_job_in_reservation()
  * 	check_resv_running_on_node()
+ * 	snapshot_keep_job()
  * 	dup_server_info()
+ * 	snapshot_server_info()
  * 	dup_resource_list()
  * 	dup_selective_resource_list()
  * 	dup_ind_resource_list()
@@ -82,6 +84,7 @@
  * 	new_counts()
  * 	free_counts()
  * 	free_counts_list()
+ * 	index_counts_list()
  * 	dup_counts()
  * 	dup_counts_list()
  * 	find_counts()
@@ -148,6 +151,9 @@
 #include "buckets.h"
 #include "parse.h"
 #include "hook.h"
+#include "mem_pool.h"
+#include "cycle_profile.h"
+#include "preempt_index.h"
 #include "libpbs.h"
 #ifdef NAS
 #include "site_code.h"
@@ -179,6 +185,7 @@ extern char **environ;
 server_info *
 query_server(status *pol, int pbs_sd)
 {
+	prof_phase prof(__func__);
 	struct batch_status *server;	/* info about the server */
 	struct batch_status *bs_resvs;	/* batch status of the reservations */
 	server_info *sinfo;		/* scheduler internal form of server info */
@@ -208,6 +215,8 @@ query_server(status *pol, int pbs_sd)
 		return NULL;
 	}
 
+	check_runjob_list_support(server);
+
 	/* convert batch_status structure into server_info structure */
 	if ((sinfo = query_server_info(pol, server)) == NULL) {
 		pbs_statfree(server);
@@ -498,6 +507,7 @@ query_server(status *pol, int pbs_sd)
 server_info *
 query_server_info(status *pol, struct batch_status *server)
 {
+	prof_phase prof(__func__);
 	struct attrl *attrp;	/* linked list of attributes */
 	server_info *sinfo;	/* internal scheduler structure for server info */
 	schd_resource *resp;	/* a resource to help create the resource list */
@@ -1016,6 +1026,68 @@ dup_server_psets(std::unordered_map<std::string, node_partition *>& spsets, serv
 	return newpset;
 }
 
+/**
+ * @brief	point each node's np_arr at the placement sets of a duplicated
+ *		universe.  A node can be in the server's node partitions, the
+ *		allpart, a host set, a queue's node partitions or allpart and a
+ *		server pset, so every one of those arrays is searched by rank.
+ *		update_stale_nodepart() relies on np_arr reaching all of them.
+ *
+ * @param[in]	osinfo - the original universe
+ * @param[in]	nsinfo - the duplicated universe
+ *
+ * @return	int
+ * @retval	1	: success
+ * @retval	0	: failure
+ */
+static int
+dup_node_np_arrs(server_info *osinfo, server_info *nsinfo)
+{
+	std::unordered_map<int, node_partition *> by_rank;
+	auto add_nps = [&by_rank](node_partition **nps) {
+		if (nps == NULL)
+			return;
+		for (int i = 0; nps[i] != NULL; i++)
+			by_rank[nps[i]->rank] = nps[i];
+	};
+
+	add_nps(nsinfo->nodepart);
+	add_nps(nsinfo->hostsets);
+	if (nsinfo->allpart != NULL)
+		by_rank[nsinfo->allpart->rank] = nsinfo->allpart;
+	for (int i = 0; i < nsinfo->num_queues; i++) {
+		add_nps(nsinfo->queues[i]->nodepart);
+		if (nsinfo->queues[i]->allpart != NULL)
+			by_rank[nsinfo->queues[i]->allpart->rank] = nsinfo->queues[i]->allpart;
+	}
+	for (const auto& spset : nsinfo->svr_to_psets)
+		by_rank[spset.second->rank] = spset.second;
+
+	for (int i = 0; osinfo->nodes[i] != NULL; i++) {
+		node_partition **onp_arr = osinfo->nodes[i]->np_arr;
+		node_partition **nnp_arr;
+		int j, k;
+
+		if (onp_arr == NULL)
+			continue;
+
+		nnp_arr = static_cast<node_partition **>(malloc((count_array(onp_arr) + 1) * sizeof(node_partition *)));
+		if (nnp_arr == NULL) {
+			log_err(errno, __func__, MEM_ERR_MSG);
+			return 0;
+		}
+		for (j = 0, k = 0; onp_arr[j] != NULL; j++) {
+			auto it = by_rank.find(onp_arr[j]->rank);
+			if (it != by_rank.end())
+				nnp_arr[k++] = it->second;
+		}
+		nnp_arr[k] = NULL;
+		nsinfo->nodes[i]->np_arr = nnp_arr;
+	}
+
+	return 1;
+}
+
 /**
  * @brief
  * 		free_server_info - free the space used by a server_info
@@ -1073,6 +1145,7 @@ free_server_info(server_info *sinfo)
 		free_string_array(sinfo->nodesigs);
 	if (sinfo->npc_arr != NULL)
 		free_np_cache_array(sinfo->npc_arr);
+	free_preempt_candidates(sinfo);
 	if (sinfo->node_group_key != NULL)
 		free_string_array(sinfo->node_group_key);
 	if (sinfo->calendar != NULL)
@@ -1205,6 +1278,8 @@ new_server_info(int limallocflag)
 	sinfo->power_provisioning = 0;
 	sinfo->use_hard_duration = 0;
 	sinfo->pset_metadata_stale = 0;
+	sinfo->pset_stale_all = 0;
+	sinfo->is_snapshot = 0;
 	sinfo->num_parts = 0;
 	sinfo->name = NULL;
 	sinfo->res = NULL;
@@ -1232,6 +1307,7 @@ new_server_info(int limallocflag)
 	sinfo->nodesigs = NULL;
 	sinfo->node_group_key = NULL;
 	sinfo->npc_arr = NULL;
+	sinfo->pcands = NULL;
 	sinfo->qrun_job = NULL;
 	sinfo->policy = NULL;
 	sinfo->fstree = NULL;
@@ -1812,6 +1888,7 @@ update_server_on_end(status *policy, server_info *sinfo, queue_info *qinfo,
 		if (resresv->job->is_running) {
 			sinfo->sc.running--;
 			remove_resresv_from_array(sinfo->running_jobs, resresv);
+			remove_preempt_candidate(sinfo, resresv);
 		} else if (resresv->job->is_exiting) {
 			sinfo->sc.exiting--;
 			remove_resresv_from_array(sinfo->exiting_jobs, resresv);
@@ -1926,14 +2003,24 @@ copy_server_arrays(server_info *nsinfo, server_info *osinfo)
 		resresv_arr = nsinfo->queues[index]->jobs;
 
 		if (resresv_arr != NULL) {
-			for (i = 0; resresv_arr[i] != NULL; i++, j++)
-				job_arr[j] = all_arr[resresv_arr[i]->resresv_ind] = resresv_arr[i];
+			for (i = 0; resresv_arr[i] != NULL; i++, j++) {
+				job_arr[j] = resresv_arr[i];
+				/* a snapshot's all_resresv has no holes for the jobs left out */
+				if (nsinfo->is_snapshot)
+					all_arr[j] = resresv_arr[i];
+				else
+					all_arr[resresv_arr[i]->resresv_ind] = resresv_arr[i];
+			}
 		}
 	}
 
 	if (nsinfo->resvs != NULL) {
-		for (i = 0; nsinfo->resvs[i] != NULL; i++)
-			all_arr[nsinfo->resvs[i]->resresv_ind] = nsinfo->resvs[i];
+		for (i = 0; nsinfo->resvs[i] != NULL; i++) {
+			if (nsinfo->is_snapshot)
+				all_arr[j++] = nsinfo->resvs[i];
+			else
+				all_arr[nsinfo->resvs[i]->resresv_ind] = nsinfo->resvs[i];
+		}
 	}
 	nsinfo->jobs = job_arr;
 	nsinfo->all_resresv = all_arr;
@@ -2174,17 +2261,95 @@ check_resv_running_on_node(resource_resv *resv, const void *arg)
 
 /**
  * @brief
- * 		dup_server_info - duplicate a server_info struct
+ *		snapshot_keep_job - function used by resource_resv_filter to
+ *		filter the jobs which are cloned into a snapshot.  Only jobs which
+ *		are not queued take part in a simulation, along with the queued
+ *		jobs the snapshot was seeded with.
+ *
+ * @param[in]	resresv	-	the job
+ * @param[in]	arg	-	the snapshot being duplicated
+ *
+ * @return	int
+ * @retval	1	: clone the job
+ * @retval	0	: leave the job out of the snapshot
+ */
+int
+snapshot_keep_job(resource_resv *resresv, const void *arg)
+{
+	const server_info *nsinfo = static_cast<const server_info *>(arg);
+
+	if (!resresv->is_job || resresv->job == NULL)
+		return 1;
+
+	if (!resresv->job->is_queued && !resresv->job->is_held && !resresv->job->is_waiting)
+		return 1;
+
+	if (nsinfo->snapshot_ind.find(resresv->resresv_ind) != nsinfo->snapshot_ind.end())
+		return 1;
+
+	return 0;
+}
+
+/**
+ * @brief
+ *		seed_snapshot_ind - seed a snapshot with the queued jobs a simulation
+ *		can touch: the job being simulated, the qrun job, the top jobs in the
+ *		calendar and the parent arrays of subjobs which are cloned.
+ *
+ * @param[in]	osinfo	-	the server being snapshotted
+ * @param[in]	resresv	-	the job the simulation is run for
+ * @param[out]	nsinfo	-	the snapshot
+ *
+ * @return	void
+ */
+static void
+seed_snapshot_ind(server_info *osinfo, resource_resv *resresv, server_info *nsinfo)
+{
+	int i;
+
+	if (resresv != NULL)
+		nsinfo->snapshot_ind[resresv->resresv_ind] = NULL;
+	if (osinfo->qrun_job != NULL)
+		nsinfo->snapshot_ind[osinfo->qrun_job->resresv_ind] = NULL;
+
+	if (osinfo->calendar != NULL) {
+		timed_event *te;
+
+		for (te = osinfo->calendar->events; te != NULL; te = te->next) {
+			if (te->event_type == TIMED_RUN_EVENT || te->event_type == TIMED_END_EVENT) {
+				auto rr = static_cast<resource_resv *>(te->event_ptr);
+				if (rr->is_job)
+					nsinfo->snapshot_ind[rr->resresv_ind] = NULL;
+			}
+		}
+	}
+
+	if (osinfo->jobs == NULL)
+		return;
+
+	for (i = 0; osinfo->jobs[i] != NULL; i++) {
+		resource_resv *job = osinfo->jobs[i];
+
+		if (job->job->parent_job != NULL && snapshot_keep_job(job, nsinfo))
+			nsinfo->snapshot_ind[job->job->parent_job->resresv_ind] = NULL;
+	}
+}
+
+/**
+ * @brief
+ * 		dup_server_info_common - duplicate a server_info struct
  *
  * @param[in]	osinfo	-	the struct to copy
+ * @param[in]	resresv	-	if snapshot, the job the simulation is run for
+ * @param[in]	snapshot	-	only clone the jobs a simulation can touch
  *
  * @return	duplicated server_info
  * @retval	NULL	: something wrong!
  *
  * @par MT-Safe:	no
  */
-server_info *
-dup_server_info(server_info *osinfo)
+static server_info *
+dup_server_info_common(server_info *osinfo, resource_resv *resresv, int snapshot)
 {
 	server_info *nsinfo;		/* scheduler internal form of server info */
 	int i;
@@ -2192,10 +2357,17 @@ dup_server_info(server_info *osinfo)
 	if (osinfo == NULL)
 		return NULL;
 
+	prof_count(PROF_DUP_SERVER_INFO);
+
 	/* duplicate the server information */
 	if ((nsinfo = new_server_info(0)) == NULL)
 		return NULL;
 
+	if (snapshot) {
+		nsinfo->is_snapshot = 1;
+		seed_snapshot_ind(osinfo, resresv, nsinfo);
+	}
+
 	if (osinfo->fstree != NULL) {
 		nsinfo->fstree = new fairshare_head(*osinfo->fstree);
 		if (nsinfo->fstree == NULL) {
@@ -2221,6 +2393,8 @@ dup_server_info(server_info *osinfo)
 	nsinfo->power_provisioning = osinfo->power_provisioning;
 	nsinfo->use_hard_duration = osinfo->use_hard_duration;
 	nsinfo->pset_metadata_stale = osinfo->pset_metadata_stale;
+	nsinfo->pset_stale_all = osinfo->pset_stale_all;
+	nsinfo->pset_stale_nodes = osinfo->pset_stale_nodes;
 	nsinfo->name = string_dup(osinfo->name);
 	nsinfo->liminfo = lim_dup_liminfo(osinfo->liminfo);
 	nsinfo->server_time = osinfo->server_time;
@@ -2290,6 +2464,14 @@ dup_server_info(server_info *osinfo)
 	copy_server_arrays(nsinfo, osinfo);
 #endif /* localmod 054 */
 
+	if (nsinfo->is_snapshot) {
+		/* sc.total is used as the length of the job arrays */
+		nsinfo->sc.total = count_array(nsinfo->jobs);
+		nsinfo->snapshot_ind.clear();
+		for (i = 0; nsinfo->all_resresv[i] != NULL; i++)
+			nsinfo->snapshot_ind[nsinfo->all_resresv[i]->resresv_ind] = nsinfo->all_resresv[i];
+	}
+
 	nsinfo->equiv_classes = dup_resresv_set_array(osinfo->equiv_classes, nsinfo);
 
 	/* the event list is created dynamically during the evaluation of resource
@@ -2365,8 +2547,6 @@ dup_server_info(server_info *osinfo)
 	for (i = 0; osinfo->nodes[i] != NULL; i++) {
 		nsinfo->nodes[i]->run_resvs_arr =
 			copy_resresv_array(osinfo->nodes[i]->run_resvs_arr, nsinfo->resvs);
-		nsinfo->nodes[i]->np_arr =
-			copy_node_partition_ptr_array(osinfo->nodes[i]->np_arr, nsinfo->nodepart);
 		if (nsinfo->calendar != NULL)
 			nsinfo->nodes[i]->node_events = dup_te_lists(osinfo->nodes[i]->node_events, nsinfo->calendar->next_event);
 	}
@@ -2395,6 +2575,57 @@ dup_server_info(server_info *osinfo)
 	/* Copy the map of server psets */
 	nsinfo->svr_to_psets = dup_server_psets(osinfo->svr_to_psets, nsinfo);
 
+	/* np_arr can point into any of the pset arrays dupped above */
+	if (dup_node_np_arrs(osinfo, nsinfo) == 0) {
+		free_server_info(nsinfo);
+		return NULL;
+	}
+
+	return nsinfo;
+}
+
+/**
+ * @brief
+ * 		dup_server_info - duplicate a server_info struct
+ *
+ * @param[in]	osinfo	-	the struct to copy
+ *
+ * @return	duplicated server_info
+ * @retval	NULL	: something wrong!
+ *
+ * @par MT-Safe:	no
+ */
+server_info *
+dup_server_info(server_info *osinfo)
+{
+	return dup_server_info_common(osinfo, NULL, 0);
+}
+
+/**
+ * @brief
+ * 		snapshot_server_info - duplicate a server_info struct to simulate in.
+ *		Queued jobs are left out of the snapshot unless the simulation can
+ *		touch them, so the cost of the copy follows the running workload
+ *		instead of the size of the queues.
+ *
+ * @param[in]	osinfo	-	the struct to copy
+ * @param[in]	resresv	-	the job the simulation is run for
+ *
+ * @return	the snapshot
+ * @retval	NULL	: something wrong!
+ *
+ * @par MT-Safe:	no
+ */
+server_info *
+snapshot_server_info(server_info *osinfo, resource_resv *resresv)
+{
+	server_info *nsinfo;
+
+	nsinfo = dup_server_info_common(osinfo, resresv, 1);
+	if (nsinfo != NULL)
+		log_eventf(PBSEVENT_DEBUG3, PBS_EVENTCLASS_SCHED, LOG_DEBUG, __func__,
+			"Snapshot cloned %d of %d jobs", nsinfo->sc.total, osinfo->sc.total);
+
 	return nsinfo;
 }
 
@@ -2615,7 +2846,7 @@ new_counts(void)
 
 	counts *cts;
 
-	if ((cts = static_cast<struct counts *>(malloc(sizeof(struct counts)))) == NULL) {
+	if ((cts = static_cast<struct counts *>(pool_alloc(POOL_COUNTS, sizeof(struct counts)))) == NULL) {
 		log_err(errno, __func__, MEM_ERR_MSG);
 		return NULL;
 	}
@@ -2624,6 +2855,7 @@ new_counts(void)
 	cts->running = 0;
 	cts->rescts = NULL;
 	cts->soft_limit_preempt_bit = 0;
+	cts->index = NULL;
 	cts->next = NULL;
 
 	return cts;
@@ -2645,15 +2877,13 @@ free_counts(counts *cts)
 	if (cts == NULL)
 		return;
 
-	if (cts->name != NULL)
-		free(cts->name);
-
 	if (cts->rescts != NULL)
 		free_resource_count_list(cts->rescts);
 
+	delete cts->index;
 	cts->next = NULL;
 
-	free(cts);
+	pool_free(POOL_COUNTS, cts);
 }
 
 /**
@@ -2683,6 +2913,38 @@ free_counts_list(counts *ctslist)
 	}
 }
 
+/**
+ * @brief
+ * 		index_counts_list - build the name index of a counts list and
+ *		keep it on the head of the list.  Lists are only indexed once
+ *		they reach COUNTS_INDEX_MIN elements, so the per-node and
+ *		per-queue lists of a handful of entities stay cheap.
+ *
+ * @param[in,out]	ctslist - the counts list to index
+ *
+ * @return	void
+ *
+ * @par MT-Safe:	no
+ */
+static void
+index_counts_list(counts *ctslist)
+{
+	counts *cur;
+	counts_index *cidx;
+
+	if (ctslist == NULL || ctslist->index != NULL)
+		return;
+
+	cidx = new counts_index();
+	for (cur = ctslist; cur != NULL; cur = cur->next) {
+		/* like the linear search, the first of two same-named elements wins */
+		if (cur->name != NULL)
+			cidx->by_name.emplace(cur->name, cur);
+		cidx->tail = cur;
+	}
+	ctslist->index = cidx;
+}
+
 /**
  * @brief
  * 		dup_counts - duplicate a counts structure
@@ -2702,8 +2964,7 @@ dup_counts(counts *octs)
 	ncts = new_counts();
 
 	if (ncts != NULL) {
-		if (octs->name != NULL)
-			ncts->name = string_dup(octs->name);
+		ncts->name = octs->name;
 
 		ncts->running = octs->running;
 		ncts->soft_limit_preempt_bit = octs->soft_limit_preempt_bit;
@@ -2749,6 +3010,9 @@ dup_counts_list(counts *ctslist)
 		cur = cur->next;
 	}
 
+	if (ctslist != NULL && ctslist->index != NULL)
+		index_counts_list(nhead);
+
 	return nhead;
 }
 
@@ -2772,9 +3036,16 @@ find_counts(counts *ctslist, const char *name)
 	if (ctslist == NULL || name == NULL)
 		return NULL;
 
+	if (ctslist->index != NULL) {
+		auto it = ctslist->index->by_name.find(name);
+		if (it == ctslist->index->by_name.end())
+			return NULL;
+		return it->second;
+	}
+
 	cur = ctslist;
 
-	while (cur != NULL && strcmp(cur->name, name))
+	while (cur != NULL && cur->name != name && strcmp(cur->name, name))
 		cur = cur->next;
 
 	return cur;
@@ -2798,25 +3069,40 @@ find_alloc_counts(counts *ctslist, const char *name)
 {
 	counts *cur, *prev;
 	counts *ncounts;
+	int len = 0;
 
 	if (name == NULL)
 		return NULL;
 
-	prev = cur = ctslist;
+	if (ctslist != NULL && ctslist->index != NULL) {
+		cur = find_counts(ctslist, name);
+		prev = ctslist->index->tail;
+	} else {
+		prev = cur = ctslist;
 
-	while (cur != NULL && strcmp(cur->name, name)) {
-		prev = cur;
-		cur = cur->next;
+		while (cur != NULL && cur->name != name && strcmp(cur->name, name)) {
+			prev = cur;
+			cur = cur->next;
+			len++;
+		}
 	}
 
 	if (cur == NULL) {
 		ncounts = new_counts();
 
-		if (ncounts != NULL)
-			ncounts->name = string_dup(name);
+		if (ncounts == NULL)
+			return NULL;
 
-		if (prev != NULL)
+		ncounts->name = intern_name(name);
+
+		if (prev != NULL) {
 			prev->next = ncounts;
+			if (ctslist->index != NULL) {
+				ctslist->index->by_name.emplace(ncounts->name, ncounts);
+				ctslist->index->tail = ncounts;
+			} else if (len + 1 >= COUNTS_INDEX_MIN)
+				index_counts_list(ctslist);
+		}
 
 		return ncounts;
 	} else
@@ -2924,7 +3210,7 @@ counts_max(counts *cmax, counts *ncounts)
 	cmax_head = cmax;
 
 	for (cur = ncounts; cur != NULL; cur = cur->next) {
-		cur_fmax = find_counts(cmax, cur->name);
+		cur_fmax = find_counts(cmax_head, cur->name);
 		if (cur_fmax == NULL) {
 			cur_fmax = dup_counts(cur);
 			if (cur_fmax == NULL) {
@@ -2932,6 +3218,12 @@ counts_max(counts *cmax, counts *ncounts)
 				return NULL;
 			}
 
+			/* the name index moves along with the head of the list */
+			cur_fmax->index = cmax_head->index;
+			cmax_head->index = NULL;
+			if (cur_fmax->index != NULL)
+				cur_fmax->index->by_name.emplace(cur_fmax->name, cur_fmax);
+
 			cur_fmax->next = cmax_head;
 			cmax_head = cur_fmax;
 		} else {
@@ -3292,6 +3584,7 @@ update_preemption_priority(server_info *sinfo, resource_resv *resresv)
 			}
 
 			/* now that we've set all the preempt levels, we need to count them */
+			free_preempt_candidates(sinfo);
 			memset(sinfo->preempt_count, 0, NUM_PPRIO * sizeof(int));
 			for (int i = 0; sinfo->running_jobs[i] != NULL; i++)
 				if (!sinfo->running_jobs[i]->job->can_not_preempt)
@@ -3588,12 +3881,13 @@ update_total_counts_on_end(server_info *si, queue_info* qi,
  *
  * @return	int
  * @retval	unique number for this scheduling cycle
+ *
+ * @par MT-safe: Yes
  */
 int
 get_sched_rank()
 {
-	cstat.order++;
-	return cstat.order;
+	return __atomic_add_fetch(&cstat.order, 1, __ATOMIC_RELAXED);
 }
 
 
@@ -191,6 +191,18 @@ int check_resv_running_on_node(resource_resv *resv, const void *arg);
  */
 server_info *dup_server_info(server_info *osinfo);
 
+/*
+ *      snapshot_server_info - duplicate a server_info struct for a simulation
+ *				which only touches the running jobs and resresv
+ */
+server_info *snapshot_server_info(server_info *osinfo, resource_resv *resresv);
+
+/*
+ *      snapshot_keep_job - function used by resource_resv_filter to filter
+ *				the jobs which are cloned into a snapshot
+ */
+int snapshot_keep_job(resource_resv *resresv, const void *arg);
+
 /*
  *      dup_resource_list - dup a resource list
  */
@@ -57,6 +57,10 @@
  * 	find_timed_event()
  * 	perform_event()
  * 	exists_run_event()
+ * 	exists_resv_event()
+ * 	exists_resresv_event()
+ * 	calendar_node_events()
+ * 	find_earliest_fit()
  * 	calc_run_time()
  * 	create_event_list()
  * 	create_events()
@@ -70,7 +74,6 @@
  * 	free_timed_event()
  * 	free_timed_event_list()
  * 	add_event()
- * 	add_timed_event()
  * 	delete_event()
  * 	create_event()
  * 	determine_event_name()
@@ -90,8 +93,19 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <pbs_internal.h>
 #include <log.h>
 
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <map>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
 #include "simulate.h"
 #include "data_types.h"
 #include "resource_resv.h"
@@ -109,6 +123,7 @@
 #include "globals.h"
 #include "check.h"
 #include "buckets.h"
+#include "cycle_profile.h"
 #ifdef NAS /* localmod 030 */
 #include "site_code.h"
 #endif /* localmod 030 */
@@ -132,6 +147,397 @@ static const struct policy_change_func_name policy_change_func_name[] =
 	{NULL, NULL}
 };
 
+/* bumped whenever an event already in a calendar is enabled or disabled */
+static std::atomic<unsigned long> disabled_epoch(0);
+
+/**
+ * @brief
+ * 		strict weak ordering of timed events in a calendar.  Events are
+ *		ordered by time.  At the same time, end events come first, the
+ *		most recently added end event first, and then all other events
+ *		in the order they were added.
+ */
+struct te_order
+{
+	bool operator()(const timed_event *a, const timed_event *b) const
+	{
+		int a_end;
+		int b_end;
+
+		if (a->event_time != b->event_time)
+			return a->event_time < b->event_time;
+
+		a_end = (a->event_type == TIMED_END_EVENT);
+		b_end = (b->event_type == TIMED_END_EVENT);
+		if (a_end != b_end)
+			return a_end;
+		if (a_end)
+			return a->seq > b->seq;
+		return a->seq < b->seq;
+	}
+};
+
+typedef std::set<timed_event *, te_order> te_set;
+
+/**
+ * @brief
+ * 		change in the free amount of a consumable resource on a node
+ *		when an event is performed
+ */
+struct avail_step
+{
+	resdef *def;
+	sch_resource_t delta;	/* negative for a run event, positive for an end event */
+};
+
+/* availability profile of a node: the steps its free consumable resources
+ * take over time, one entry per enabled run or end event on the node
+ */
+typedef std::map<timed_event *, std::vector<avail_step>, te_order> avail_profile;
+
+/**
+ * @brief
+ * 		running total of the amount of a resource assigned over a span
+ *		of run and end events
+ */
+struct resmin_sum
+{
+	sch_resource_t sum;	/* net change over the span */
+	sch_resource_t maxpre;	/* highest running total within the span */
+	int count;		/* number of events in the span */
+};
+
+/**
+ * @brief
+ * 		treap of the run and end events of one consumable resource.
+ *		Each subtree carries the resmin_sum of its events so the peak
+ *		amount assigned between two points in time is a log(n) query.
+ */
+class resmin_tree
+{
+	struct node {
+		timed_event *te;
+		sch_resource_t delta;
+		unsigned int prio;
+		resmin_sum span;
+		node *left;
+		node *right;
+	};
+
+	node *root;
+	unsigned int seed;
+
+	static resmin_sum join(const resmin_sum &a, const resmin_sum &b)
+	{
+		if (a.count == 0)
+			return b;
+		if (b.count == 0)
+			return a;
+		return {a.sum + b.sum, std::max(a.maxpre, a.sum + b.maxpre), a.count + b.count};
+	}
+	static resmin_sum span_of(const node *n)
+	{
+		if (n == NULL)
+			return {0, 0, 0};
+		return n->span;
+	}
+	static void update(node *n)
+	{
+		resmin_sum self = {n->delta, n->delta, 1};
+		n->span = join(join(span_of(n->left), self), span_of(n->right));
+	}
+	static void split(node *t, timed_event *key, node *&l, node *&r)
+	{
+		if (t == NULL) {
+			l = r = NULL;
+		} else if (te_order()(t->te, key)) {
+			split(t->right, key, t->right, r);
+			l = t;
+			update(l);
+		} else {
+			split(t->left, key, l, t->left);
+			r = t;
+			update(r);
+		}
+	}
+	static node *merge(node *l, node *r)
+	{
+		if (l == NULL)
+			return r;
+		if (r == NULL)
+			return l;
+		if (l->prio > r->prio) {
+			l->right = merge(l->right, r);
+			update(l);
+			return l;
+		}
+		r->left = merge(l, r->left);
+		update(r);
+		return r;
+	}
+	static void insert(node *&t, node *n)
+	{
+		if (t == NULL)
+			t = n;
+		else if (n->prio > t->prio) {
+			split(t, n->te, n->left, n->right);
+			t = n;
+		} else
+			insert(te_order()(n->te, t->te) ? t->left : t->right, n);
+		update(t);
+	}
+	static void erase(node *&t, timed_event *te)
+	{
+		if (t == NULL)
+			return;
+		if (t->te == te) {
+			node *old = t;
+			t = merge(t->left, t->right);
+			delete old;
+			return;
+		}
+		erase(te_order()(te, t->te) ? t->left : t->right, te);
+		update(t);
+	}
+	static void destroy(node *t)
+	{
+		if (t == NULL)
+			return;
+		destroy(t->left);
+		destroy(t->right);
+		delete t;
+	}
+	/* sum of the events not ordered before 'from' (NULL for no bound)
+	 * and before time 'end' (0 for no bound)
+	 */
+	static resmin_sum range(const node *t, timed_event *from, time_t end)
+	{
+		if (t == NULL)
+			return {0, 0, 0};
+		if (from == NULL && end == 0)
+			return t->span;
+		if (from != NULL && te_order()(t->te, from))
+			return range(t->right, from, end);
+		if (end != 0 && t->te->event_time >= end)
+			return range(t->left, from, end);
+
+		resmin_sum self = {t->delta, t->delta, 1};
+		return join(join(range(t->left, from, 0), self), range(t->right, NULL, end));
+	}
+
+    public:
+	resmin_tree() : root(NULL), seed(2463534242U) {}
+	resmin_tree(const resmin_tree &) = delete;
+	resmin_tree &operator=(const resmin_tree &) = delete;
+	~resmin_tree() { destroy(root); }
+
+	void add(timed_event *te, sch_resource_t delta)
+	{
+		node *n = new node();
+
+		seed ^= seed << 13;
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
+		n->te = te;
+		n->delta = delta;
+		n->prio = seed;
+		n->left = n->right = NULL;
+		update(n);
+		insert(root, n);
+	}
+	void remove(timed_event *te) { erase(root, te); }
+	resmin_sum query(timed_event *from, time_t end) const { return range(root, from, end); }
+};
+
+/**
+ * @brief
+ * 		search indexes over the events of an event_list.  The order set
+ *		holds every event and is kept up to date by add_event() and
+ *		delete_event().  The other indexes are only built the first time
+ *		they are needed, and are kept up to date from then on.
+ */
+struct calendar_index
+{
+	te_set order;		/* all events in calendar order */
+
+	std::mutex build_lock;	/* serializes building the indexes below */
+	bool built;		/* the indexes below have been built */
+	unsigned long epoch;	/* disabled_epoch the resource trees match */
+	te_set resv_runs;	/* run events of reservations */
+	std::unordered_map<int, te_set> node_events;	/* run/end events by node rank */
+	std::unordered_map<timed_event *, std::vector<int>> event_nodes;	/* nodes each event is indexed under */
+	std::unordered_map<resdef *, resmin_tree> consumed;	/* enabled run/end events by resource */
+	std::unordered_map<int, avail_profile> node_avail;	/* availability profiles by node rank */
+
+	calendar_index() : built(false), epoch(0) {}
+};
+
+/**
+ * @brief
+ * 		add an enabled run or end event to the per resource trees and
+ *		to the availability profiles of the nodes it runs on
+ *
+ * @param[in]	idx	-	calendar index
+ * @param[in]	te	-	the event
+ *
+ * @return	void
+ */
+static void
+index_add_consumed(calendar_index *idx, timed_event *te)
+{
+	auto resresv = static_cast<resource_resv *>(te->event_ptr);
+	int sign = te->event_type == TIMED_RUN_EVENT ? 1 : -1;
+
+	for (auto req = resresv->resreq; req != NULL; req = req->next) {
+		if (req->type.is_consumable)
+			idx->consumed[req->def].add(te, sign * req->amount);
+	}
+
+	if (resresv->nspec_arr == NULL)
+		return;
+
+	for (int i = 0; resresv->nspec_arr[i] != NULL; i++) {
+		nspec *ns = resresv->nspec_arr[i];
+
+		for (auto req = ns->resreq; req != NULL; req = req->next) {
+			if (req->type.is_consumable)
+				idx->node_avail[ns->ninfo->rank][te].push_back({req->def, -sign * req->amount});
+		}
+	}
+}
+
+/**
+ * @brief
+ * 		add an event to the secondary indexes of a calendar
+ *
+ * @param[in]	idx	-	calendar index (already built)
+ * @param[in]	te	-	the event
+ *
+ * @return	void
+ */
+static void
+index_add_secondary(calendar_index *idx, timed_event *te)
+{
+	resource_resv *resresv;
+
+	if ((te->event_type & (TIMED_RUN_EVENT | TIMED_END_EVENT)) == 0)
+		return;
+
+	resresv = static_cast<resource_resv *>(te->event_ptr);
+	if (te->event_type == TIMED_RUN_EVENT && resresv->is_resv)
+		idx->resv_runs.insert(te);
+
+	if (resresv->nspec_arr != NULL) {
+		auto &nodes = idx->event_nodes[te];
+		for (int i = 0; resresv->nspec_arr[i] != NULL; i++) {
+			int rank = resresv->nspec_arr[i]->ninfo->rank;
+			if (idx->node_events[rank].insert(te).second)
+				nodes.push_back(rank);
+		}
+	} else
+		log_eventf(PBSEVENT_SCHED, PBS_EVENTCLASS_SCHED, LOG_WARNING, resresv->name,
+			"Event %s is a run/end event w/o nspec array, ignoring event", te->name.c_str());
+
+	if (!te->disabled)
+		index_add_consumed(idx, te);
+}
+
+/**
+ * @brief
+ * 		remove an event from the secondary indexes of a calendar
+ *
+ * @param[in]	idx	-	calendar index (already built)
+ * @param[in]	te	-	the event
+ *
+ * @return	void
+ */
+static void
+index_remove_secondary(calendar_index *idx, timed_event *te)
+{
+	if ((te->event_type & (TIMED_RUN_EVENT | TIMED_END_EVENT)) == 0)
+		return;
+
+	idx->resv_runs.erase(te);
+
+	auto en = idx->event_nodes.find(te);
+	if (en != idx->event_nodes.end()) {
+		for (int rank : en->second) {
+			idx->node_events[rank].erase(te);
+
+			auto na = idx->node_avail.find(rank);
+			if (na != idx->node_avail.end())
+				na->second.erase(te);
+		}
+		idx->event_nodes.erase(en);
+	}
+
+	for (auto &c : idx->consumed)
+		c.second.remove(te);
+}
+
+/**
+ * @brief
+ * 		return the index of a calendar with its secondary indexes built
+ *		and current
+ *
+ * @param[in]	calendar	-	the calendar
+ *
+ * @return	calendar_index *
+ * @retval	NULL	: calendar has no index
+ *
+ * @par MT-safe: Yes
+ */
+static calendar_index *
+calendar_index_ready(event_list *calendar)
+{
+	calendar_index *idx = calendar->index;
+
+	if (idx == NULL)
+		return NULL;
+
+	std::lock_guard<std::mutex> lock(idx->build_lock);
+	if (!idx->built) {
+		idx->built = true;
+		idx->epoch = disabled_epoch;
+		for (auto te : idx->order)
+			index_add_secondary(idx, te);
+	} else if (idx->epoch != disabled_epoch) {
+		/* an event was enabled or disabled somewhere, rebuild the trees */
+		idx->epoch = disabled_epoch;
+		idx->consumed.clear();
+		idx->node_avail.clear();
+		for (auto te : idx->order) {
+			if ((te->event_type & (TIMED_RUN_EVENT | TIMED_END_EVENT)) && !te->disabled)
+				index_add_consumed(idx, te);
+		}
+	}
+
+	return idx;
+}
+
+/**
+ * @brief
+ * 		(re)build the order index of a calendar from its event list.
+ *		The event list must already be in calendar order.
+ *
+ * @param[in]	calendar	-	the calendar
+ *
+ * @return	void
+ */
+static void
+index_events(event_list *calendar)
+{
+	delete calendar->index;
+	calendar->index = new calendar_index();
+	calendar->next_seq = 0;
+
+	for (auto te = calendar->events; te != NULL; te = te->next) {
+		calendar->index->order.insert(calendar->index->order.end(), te);
+		if (te->seq >= calendar->next_seq)
+			calendar->next_seq = te->seq + 1;
+	}
+}
+
 
 /**
  * @brief
@@ -482,6 +888,8 @@ set_timed_event_disabled(timed_event *te, int disabled)
 	if (te == NULL)
 		return;
 
+	if (te->disabled != (disabled ? 1 : 0))
+		disabled_epoch++;
 	te->disabled = disabled ? 1 : 0;
 }
 
@@ -581,7 +989,7 @@ perform_event(status *policy, timed_event *event)
 	if (event == NULL || event->event_ptr == NULL)
 		return 0;
 
-	sprintf(timebuf, "%s", ctime(&event->event_time));
+	ctime_r(&event->event_time, timebuf);
 	/* ctime() puts a \n at the end of the line, nuke it*/
 	timebuf[strlen(timebuf) - 1] = '\0';
 
@@ -670,27 +1078,235 @@ exists_run_event(event_list *calendar, time_t end)
 int
 exists_resv_event(event_list *calendar, time_t end)
 {
-	timed_event *te;
-	timed_event *te_list;
+	calendar_index *idx;
 
 	if (calendar == NULL)
 		return 0;
 
-	te_list = calendar->first_run_event;
-	if (te_list == NULL) /* no run events in our calendar */
+	if (calendar->first_run_event == NULL) /* no run events in our calendar */
 		return 0;
 
-	for (te = te_list; te != NULL && te->event_time <= end;
-		te = find_next_timed_event(te, 0, TIMED_RUN_EVENT)) {
-		if (te->event_type == TIMED_RUN_EVENT) {
-			resource_resv *resresv = static_cast<resource_resv *>(te->event_ptr);
-			if(resresv->is_resv)
-				return 1;
-		}
+	if ((idx = calendar_index_ready(calendar)) == NULL)
+		return 0;
+
+	auto it = idx->resv_runs.lower_bound(calendar->first_run_event);
+	if (it != idx->resv_runs.end() && (*it)->event_time <= end)
+		return 1;
+
+	return 0;
+}
+
+/**
+ * @brief finds if a job or reservation has an enabled run or end event
+ *	  between now and the end of the calendar
+ * @param[in] calendar - the calendar to search
+ * @param[in] resresv - the job or reservation
+ *
+ * @returns int
+ * @retval 1 found an event
+ * @retval 0 did not find an event
+ */
+int
+exists_resresv_event(event_list *calendar, resource_resv *resresv)
+{
+	timed_event *nexte;
+	timed_event *events[2];
+
+	if (calendar == NULL || resresv == NULL)
+		return 0;
+
+	if ((nexte = calendar->next_event) == NULL)
+		return 0;
+
+	events[0] = resresv->run_event;
+	events[1] = resresv->end_event;
+	for (auto te : events) {
+		if (te != NULL && !te->disabled && !te_order()(te, nexte))
+			return 1;
 	}
+
 	return 0;
 }
 
+/**
+ * @brief
+ * 		find the enabled run and end events of the jobs and reservations
+ *		on a node from the calendar's next event up to a time
+ *
+ * @param[in]	calendar	-	the calendar to search
+ * @param[in]	ninfo		-	the node
+ * @param[in]	end		-	only return events before this time
+ * @param[out]	events		-	the events in calendar order
+ *
+ * @return	void
+ *
+ * @par MT-safe: Yes
+ */
+void
+calendar_node_events(event_list *calendar, node_info *ninfo, time_t end,
+	std::vector<timed_event *> &events)
+{
+	calendar_index *idx;
+	timed_event *nexte;
+
+	events.clear();
+	if (calendar == NULL || ninfo == NULL)
+		return;
+
+	if ((nexte = get_next_event(calendar)) == NULL)
+		return;
+
+	if ((idx = calendar_index_ready(calendar)) == NULL)
+		return;
+
+	auto ne = idx->node_events.find(ninfo->rank);
+	if (ne == idx->node_events.end())
+		return;
+
+	for (auto it = ne->second.lower_bound(nexte);
+		it != ne->second.end() && (*it)->event_time < end; ++it) {
+		if (!(*it)->disabled)
+			events.push_back(*it);
+	}
+}
+
+/**
+ * @brief
+ * 		find the first pending event after which the nodes a job can run
+ *		on have enough of each consumable resource the job asks for, summed
+ *		over the nodes.  The availability profiles of the nodes are merged
+ *		from the next event on.  Until that event is simulated, the job
+ *		can not fit, so there is no need to check it at earlier events.
+ *
+ * @param[in]	sinfo	-	the universe being simulated
+ * @param[in]	resresv	-	the job
+ * @param[out]	fit_te	-	the event, NULL if the resources never add up
+ *
+ * @return	int
+ * @retval	1	: the job does not fit now, fit_te is set
+ * @retval	0	: the job might fit now, or its nodes can't be bounded
+ */
+static int
+find_earliest_fit(server_info *sinfo, resource_resv *resresv, timed_event **fit_te)
+{
+	struct step {
+		timed_event *te;
+		int slot;
+		sch_resource_t delta;
+	};
+	calendar_index *idx;
+	event_list *calendar = sinfo->calendar;
+	node_info **nodes;
+	std::vector<resdef *> defs;
+	std::vector<sch_resource_t> need;
+	std::vector<sch_resource_t> total;
+	std::vector<sch_resource_t> node_free;
+	std::vector<step> steps;
+	int num_nodes;
+	int nd;
+
+	*fit_te = NULL;
+
+	/* jobs in reservations, jobs with nodes already assigned and jobs which
+	 * may run on another server's nodes don't use the nodes below
+	 */
+	if (!resresv->is_job || resresv->job == NULL || resresv->job->resv != NULL ||
+	    resresv->ninfo_arr != NULL || resresv->select == NULL ||
+	    resresv->select->chunks == NULL || pbs_conf.pbs_num_servers > 1 || calendar == NULL)
+		return 0;
+
+	if (resresv->job->queue != NULL && resresv->job->queue->has_nodes)
+		nodes = resresv->job->queue->nodes;
+	else
+		nodes = sinfo->unassoc_nodes;
+	if (nodes == NULL)
+		return 0;
+
+	for (int i = 0; resresv->select->chunks[i] != NULL; i++) {
+		chunk *chk = resresv->select->chunks[i];
+
+		for (auto req = chk->req; req != NULL; req = req->next) {
+			if (!req->type.is_consumable || req->amount <= 0 ||
+			    sinfo->policy->resdef_to_check.find(req->def) == sinfo->policy->resdef_to_check.end())
+				continue;
+			auto d = std::find(defs.begin(), defs.end(), req->def) - defs.begin();
+			if (d == static_cast<long>(defs.size())) {
+				defs.push_back(req->def);
+				need.push_back(0);
+			}
+			need[d] += chk->num_chunks * req->amount;
+		}
+	}
+	nd = defs.size();
+	if (nd == 0)
+		return 0;
+
+	/* A resource which is unset, infinite or indirect on any of the nodes
+	 * does not bound where the job can run.  It is left out.
+	 */
+	num_nodes = count_array(nodes);
+	node_free.resize(num_nodes * nd);
+	total.assign(nd, 0);
+	for (int i = 0; i < num_nodes; i++) {
+		for (int d = 0; d < nd; d++) {
+			schd_resource *res;
+
+			if (need[d] < 0)
+				continue;
+			res = find_resource(nodes[i]->res, defs[d]);
+			if (res == NULL || res->indirect_res != NULL || res->avail == SCHD_INFINITY_RES) {
+				need[d] = -1;
+				continue;
+			}
+			node_free[i * nd + d] = res->avail - res->assigned;
+			total[d] += std::max(node_free[i * nd + d], static_cast<sch_resource_t>(0));
+		}
+	}
+
+	auto fits = [&]() {
+		for (int d = 0; d < nd; d++) {
+			if (need[d] >= 0 && total[d] < need[d])
+				return false;
+		}
+		return true;
+	};
+
+	if (fits())
+		return 0;
+	if (calendar->next_event == NULL || (idx = calendar_index_ready(calendar)) == NULL)
+		return 1;
+
+	for (int i = 0; i < num_nodes; i++) {
+		auto na = idx->node_avail.find(nodes[i]->rank);
+		if (na == idx->node_avail.end())
+			continue;
+		for (auto it = na->second.lower_bound(calendar->next_event); it != na->second.end(); ++it) {
+			for (const auto &st : it->second) {
+				auto d = std::find(defs.begin(), defs.end(), st.def) - defs.begin();
+				if (d < nd && need[d] >= 0)
+					steps.push_back({it->first, static_cast<int>(i * nd + d), st.delta});
+			}
+		}
+	}
+	std::stable_sort(steps.begin(), steps.end(),
+		[](const step &a, const step &b) { return te_order()(a.te, b.te); });
+
+	for (size_t i = 0; i < steps.size(); i++) {
+		sch_resource_t &nf = node_free[steps[i].slot];
+		sch_resource_t before = std::max(nf, static_cast<sch_resource_t>(0));
+
+		nf += steps[i].delta;
+		total[steps[i].slot % nd] += std::max(nf, static_cast<sch_resource_t>(0)) - before;
+
+		if ((i + 1 == steps.size() || steps[i + 1].te != steps[i].te) && fits()) {
+			*fit_te = steps[i].te;
+			break;
+		}
+	}
+
+	return 1;
+}
+
 /**
  * @brief
  * 		calculate the run time of a resresv through simulation of
@@ -724,6 +1340,8 @@ calc_run_time(const std::string& name, server_info *sinfo, int flags)
 	nspec **ns = NULL;
 	unsigned int ok_flags = NO_ALLPART;
 	queue_info *qinfo = NULL;
+	timed_event *fit_te = NULL;	/* the job can't fit before this event */
+	int short_res;			/* the job's nodes are short of resources */
 
 	if (name.empty() || sinfo == NULL)
 		return (time_t) -1;
@@ -747,13 +1365,22 @@ calc_run_time(const std::string& name, server_info *sinfo, int flags)
 	if(err == NULL)
 		return (time_t) 0;
 
+	short_res = find_earliest_fit(sinfo, resresv, &fit_te);
+
 	do {
 		/* policy is used from sinfo instead of being passed into calc_run_time()
 		 * because it's being simulated/updated in simulate_events()
 		 */
 
+		/* Don't check the job until its nodes could have enough resources.
+		 * The last check happens once the calendar runs out so the reason
+		 * the job can't run is still reported.
+		 */
+		bool wait_for_fit = short_res && calendar->next_event != NULL &&
+			(fit_te == NULL || !te_order()(fit_te, calendar->next_event));
+
 		auto desc = describe_simret(ret);
-		if (desc > 0 || (desc == 0 && policy_change_info(sinfo, resresv))) {
+		if (!wait_for_fit && (desc > 0 || (desc == 0 && policy_change_info(sinfo, resresv)))) {
 			clear_schd_error(err);
 			ns = is_ok_to_run(sinfo->policy, sinfo, qinfo, resresv, ok_flags, err);
 		}
@@ -836,6 +1463,7 @@ calc_run_time(const std::string& name, server_info *sinfo, int flags)
 event_list *
 create_event_list(server_info *sinfo)
 {
+	prof_phase prof(__func__);
 	event_list *elist;
 
 	elist = new_event_list();
@@ -844,6 +1472,7 @@ create_event_list(server_info *sinfo)
 		return NULL;
 
 	elist->events = create_events(sinfo);
+	index_events(elist);
 
 	elist->next_event = elist->events;
 	elist->first_run_event = find_timed_event(elist->events, TIMED_RUN_EVENT);
@@ -866,7 +1495,7 @@ create_event_list(server_info *sinfo)
 timed_event *
 create_events(server_info *sinfo)
 {
-	timed_event	*events = NULL;
+	std::vector<timed_event *> events;
 	timed_event	*te = NULL;
 	resource_resv	**all = NULL;
 	int		errflag = 0;
@@ -901,7 +1530,8 @@ create_events(server_info *sinfo)
 				errflag++;
 				break;
 			}
-			events = add_timed_event(events, te);
+			te->seq = events.size();
+			events.push_back(te);
 		}
 
 		if (sinfo->use_hard_duration)
@@ -913,7 +1543,8 @@ create_events(server_info *sinfo)
 			errflag++;
 			break;
 		}
-		events = add_timed_event(events, te);
+		te->seq = events.size();
+		events.push_back(te);
 	}
 
 	/* for nodes that are in state=sleep add a timed event */
@@ -926,19 +1557,32 @@ create_events(server_info *sinfo)
 				errflag++;
 				break;
 			}
-			events = add_timed_event(events, te);
+			te->seq = events.size();
+			events.push_back(te);
 		}
 	}
 
 	/* A malloc error was encountered, free all allocated memory and return */
 	if (errflag > 0) {
-		free_timed_event_list(events);
+		for (auto e : events)
+			free_timed_event(e);
 		free(all_resresv_copy);
 		return 0;
 	}
 
 	free(all_resresv_copy);
-	return events;
+
+	if (events.empty())
+		return NULL;
+
+	/* sort once and link, rather than inserting each event into a sorted list */
+	std::sort(events.begin(), events.end(), te_order());
+	for (size_t j = 0; j < events.size(); j++) {
+		events[j]->prev = j > 0 ? events[j - 1] : NULL;
+		events[j]->next = j + 1 < events.size() ? events[j + 1] : NULL;
+	}
+
+	return events[0];
 }
 
 /**
@@ -963,6 +1607,8 @@ new_event_list()
 	elist->next_event = NULL;
 	elist->first_run_event = NULL;
 	elist->current_time = NULL;
+	elist->next_seq = 0;
+	elist->index = new calendar_index();
 
 	return elist;
 }
@@ -981,6 +1627,8 @@ event_list *
 dup_event_list(event_list *oelist, server_info *nsinfo)
 {
 	event_list *nelist;
+	timed_event *oe;
+	timed_event *ne;
 
 	if (oelist == NULL || nsinfo == NULL)
 		return NULL;
@@ -1001,30 +1649,32 @@ dup_event_list(event_list *oelist, server_info *nsinfo)
 		}
 	}
 
-	if (oelist->next_event != NULL) {
-		nelist->next_event = find_timed_event(nelist->events, oelist->next_event->name,
-						      oelist->next_event->event_type,
-						      oelist->next_event->event_time);
-		if (nelist->next_event == NULL) {
-			log_event(PBSEVENT_SCHED, PBS_EVENTCLASS_SCHED, LOG_WARNING,
+	/* the duplicated list is in the same order, so walk them side by side */
+	for (oe = oelist->events, ne = nelist->events; oe != NULL && ne != NULL;
+		oe = oe->next, ne = ne->next) {
+		if (oe == oelist->next_event)
+			nelist->next_event = ne;
+		if (oe == oelist->first_run_event)
+			nelist->first_run_event = ne;
+	}
+
+	if (oelist->next_event != NULL && nelist->next_event == NULL) {
+		log_event(PBSEVENT_SCHED, PBS_EVENTCLASS_SCHED, LOG_WARNING,
 			oelist->next_event->name, "can't find next event in duplicated list");
-			free_event_list(nelist);
-			return NULL;
-		}
+		free_event_list(nelist);
+		return NULL;
 	}
 
-	if (oelist->first_run_event != NULL) {
-		nelist->first_run_event =
-			find_timed_event(nelist->events, oelist->first_run_event->name, TIMED_RUN_EVENT,
-					 oelist->first_run_event->event_time);
-		if (nelist->first_run_event == NULL) {
-			log_event(PBSEVENT_SCHED, PBS_EVENTCLASS_SCHED, LOG_WARNING, oelist->first_run_event->name,
-				"can't find first run event event in duplicated list");
-			free_event_list(nelist);
-			return NULL;
-		}
+	if (oelist->first_run_event != NULL && nelist->first_run_event == NULL) {
+		log_event(PBSEVENT_SCHED, PBS_EVENTCLASS_SCHED, LOG_WARNING, oelist->first_run_event->name,
+			"can't find first run event event in duplicated list");
+		free_event_list(nelist);
+		return NULL;
 	}
 
+	index_events(nelist);
+	nelist->next_seq = oelist->next_seq;
+
 	return nelist;
 }
 
@@ -1040,6 +1690,7 @@ free_event_list(event_list *elist)
 	if (elist == NULL)
 		return;
 
+	delete elist->index;
 	free_timed_event_list(elist->events);
 	free(elist);
 }
@@ -1068,6 +1719,7 @@ new_timed_event()
 	te->event_ptr = NULL;
 	te->event_func = NULL;
 	te->event_func_arg = NULL;
+	te->seq = 0;
 	te->next = NULL;
 	te->prev = NULL;
 
@@ -1103,7 +1755,12 @@ dup_timed_event(timed_event *ote, server_info *nsinfo)
 		return NULL;
 
 	nte = create_event(ote->event_type, ote->event_time, event_ptr, ote->event_func, ote->event_func_arg);
-	set_timed_event_disabled(nte, ote->disabled);
+	if (nte == NULL)
+		return NULL;
+
+	/* copied directly, the event is not in a calendar yet */
+	nte->disabled = ote->disabled;
+	nte->seq = ote->seq;
 
 	return nte;
 }
@@ -1430,6 +2087,8 @@ add_event(event_list *calendar, timed_event *te)
 {
 	time_t current_time;
 	int events_is_null = 0;
+	calendar_index *idx;
+	timed_event probe;
 
 	if (calendar == NULL || calendar->current_time == NULL || te == NULL)
 		return 0;
@@ -1439,7 +2098,22 @@ add_event(event_list *calendar, timed_event *te)
 	if (calendar->events == NULL)
 		events_is_null = 1;
 
-	calendar->events = add_timed_event(calendar->events, te);
+	idx = calendar->index;
+	te->seq = calendar->next_seq++;
+	auto pos = idx->order.insert(te).first;
+
+	/* link the event in between its neighbors in the order index */
+	te->prev = (pos == idx->order.begin()) ? NULL : *std::prev(pos);
+	te->next = (std::next(pos) == idx->order.end()) ? NULL : *std::next(pos);
+	if (te->prev != NULL)
+		te->prev->next = te;
+	else
+		calendar->events = te;
+	if (te->next != NULL)
+		te->next->prev = te;
+
+	if (idx->built)
+		index_add_secondary(idx, te);
 
 	/* empty event list - the new event is the only event */
 	if (events_is_null)
@@ -1452,8 +2126,13 @@ add_event(event_list *calendar, timed_event *te)
 			if (te->event_time < calendar->next_event->event_time)
 				calendar->next_event = te;
 			else if (te->event_time == calendar->next_event->event_time) {
-				calendar->next_event =
-					find_timed_event(calendar->events, te->event_time);
+				/* the first event at this time: end events sort first,
+				 * the most recently added one first
+				 */
+				probe.event_time = te->event_time;
+				probe.event_type = TIMED_END_EVENT;
+				probe.seq = ULONG_MAX;
+				calendar->next_event = *idx->order.lower_bound(&probe);
 			}
 		}
 	}
@@ -1474,58 +2153,6 @@ add_event(event_list *calendar, timed_event *te)
 	return 1;
 }
 
-/**
- * @brief
- * 		add_timed_event - add an event to a sorted list of events
- *
- * @note
- *		ASSUMPTION: if multiple events are at the same time, all
- *		    end events will come first
- *
- * @param	events - event list to add event to
- * @param 	te     - timed_event to add to list
- *
- * @return	head of timed_event list
- */
-timed_event *
-add_timed_event(timed_event *events, timed_event *te)
-{
-	timed_event *eloop;
-	timed_event *eloop_prev = NULL;
-
-	if (te == NULL)
-		return events;
-
-	if (events == NULL)
-		return te;
-
-	for (eloop = events; eloop != NULL; eloop = eloop->next) {
-		if (eloop->event_time > te->event_time)
-			break;
-		if (eloop->event_time == te->event_time &&
-			te->event_type == TIMED_END_EVENT) {
-			break;
-		}
-
-		eloop_prev = eloop;
-	}
-
-	if (eloop_prev == NULL) {
-		te->next = events;
-		events->prev = te;
-		te->prev = NULL;
-		return te;
-	}
-
-	te->next = eloop;
-	eloop_prev->next = te;
-	te->prev = eloop_prev;
-	if (eloop != NULL)
-		eloop->prev = te;
-
-	return events;
-}
-
 /**
  * @brief
  * 		delete a timed event from an event_list
@@ -1550,7 +2177,13 @@ delete_event(server_info *sinfo, timed_event *e)
 		calendar->next_event = e->next;
 
 	if (calendar->first_run_event == e)
-		calendar->first_run_event = find_timed_event(calendar->events, TIMED_RUN_EVENT);
+		calendar->first_run_event = find_init_timed_event(e->next, 0, TIMED_RUN_EVENT);
+
+	if (calendar->index != NULL) {
+		if (calendar->index->built)
+			index_remove_secondary(calendar->index, e);
+		calendar->index->order.erase(e);
+	}
 
 	if (e->prev == NULL)
 		calendar->events = e->next;
@@ -1764,7 +2397,7 @@ schd_resource *
 simulate_resmin(schd_resource *reslist, time_t end, event_list *calendar,
 	resource_resv **incl_arr, resource_resv *exclude)
 {
-	static schd_resource *retres = NULL;	/* return pointer */
+	static thread_local schd_resource *retres = NULL;	/* return pointer */
 
 	schd_resource *cur_res;
 	schd_resource *cur_resmin;
@@ -1772,6 +2405,8 @@ simulate_resmin(schd_resource *reslist, time_t end, event_list *calendar,
 	schd_resource *resmin = NULL;
 	timed_event *te;
 	unsigned int event_mask = (TIMED_RUN_EVENT | TIMED_END_EVENT);
+	calendar_index *idx;
+	std::unordered_set<int> incl_ranks;
 
 	if (reslist == NULL)
 		return NULL;
@@ -1791,6 +2426,33 @@ simulate_resmin(schd_resource *reslist, time_t end, event_list *calendar,
 		retres = NULL;
 	}
 
+	/* Without a filter, the peak of each resource comes straight from the
+	 * per resource trees of the calendar index.  The excluded job or
+	 * reservation is not in them unless it already has events.
+	 */
+	if (incl_arr == NULL &&
+		(exclude == NULL || (exclude->run_event == NULL && exclude->end_event == NULL)) &&
+		(idx = calendar_index_ready(calendar)) != NULL) {
+		if ((resmin = dup_resource_list(reslist)) == NULL)
+			return NULL;
+
+		te = get_next_event(calendar);
+		for (auto &c : idx->consumed) {
+			resmin_sum span = c.second.query(te, end);
+			if (span.count == 0)
+				continue;
+			cur_resmin = find_alloc_resource(resmin, c.first);
+			if (cur_resmin == NULL) {
+				free_resource_list(resmin);
+				return NULL;
+			}
+			if (span.maxpre > 0)
+				cur_resmin->assigned += span.maxpre;
+		}
+		retres = resmin;
+		return retres;
+	}
+
 	if ((res = dup_resource_list(reslist)) == NULL)
 		return NULL;
 	if ((resmin = dup_resource_list(reslist)) == NULL) {
@@ -1798,12 +2460,17 @@ simulate_resmin(schd_resource *reslist, time_t end, event_list *calendar,
 		return NULL;
 	}
 
+	if (incl_arr != NULL) {
+		for (int i = 0; incl_arr[i] != NULL; i++)
+			incl_ranks.insert(incl_arr[i]->rank);
+	}
+
 	te = get_next_event(calendar);
 	for (te = find_init_timed_event(te, IGNORE_DISABLED_EVENTS, event_mask);
 		te != NULL && (end == 0 || te->event_time < end);
 		te = find_next_timed_event(te, IGNORE_DISABLED_EVENTS, event_mask)) {
 		auto resresv = static_cast<resource_resv *>(te->event_ptr);
-		if (incl_arr == NULL || find_resource_resv_by_indrank(incl_arr, -1, resresv->rank) !=NULL) {
+		if (incl_arr == NULL || incl_ranks.count(resresv->rank) != 0) {
 			if (resresv != exclude) {
 				for (auto req = resresv->resreq; req != NULL; req = req->next) {
 					if (req->type.is_consumable) {
@@ -40,6 +40,8 @@
 #ifndef	_SIMULATE_H
 #define	_SIMULATE_H
 
+#include <vector>
+
 #include "data_types.h"
 #include "constant.h"
 
@@ -189,6 +191,13 @@ int exists_run_event_on_node(node_info *ninf, time_t end);
 /* Checks if a reservation run event exists between now and 'end' */
 int exists_resv_event(event_list *calendar, time_t end);
 
+/* Checks if a job or reservation has an event between now and the end of the calendar */
+int exists_resresv_event(event_list *calendar, resource_resv *resresv);
+
+/* Finds the run/end events on a node between now and 'end' */
+void calendar_node_events(event_list *calendar, node_info *ninfo, time_t end,
+	std::vector<timed_event *> &events);
+
 
 /*
  *      create_events - creates an timed_event list from running jobs
@@ -293,18 +302,6 @@ void free_event_list(event_list *el);
 timed_event *find_event_by_name(timed_event *events, char *name);
 
 
-/*
- *      add_timed_event - add an event to a sorted list of events
- *
- *      ASSUMPTION: if multiple events are at the same time, all
- *                  end events will come first
- *
- *        \param events - event list to add event to
- *        \param te     - timed_event to add to list
- *
- *      \return head of timed_event list
- */
-timed_event *add_timed_event(timed_event *events, timed_event *te);
 /*
  *
  *	add_event - add a timed_event to an event list
@@ -69,6 +69,7 @@
  * 	cmp_aoe()
  * 	cmp_job_preemption_time_asc()
  * 	sort_jobs()
+ * 	resort_jobs()
  * 	swapfunc()
  * 	med3()
  * 	qsort()
@@ -93,6 +94,10 @@
 #include "constant.h"
 #include "server_info.h"
 #include "resource.h"
+#include "cycle_profile.h"
+
+#include <algorithm>
+#include <vector>
 
 #ifdef NAS
 #include "site_code.h"
@@ -1180,6 +1185,247 @@ cmp_resv_state(const void *r1, const void *r2)
 		return 0;
 }
 
+/**
+ * @brief
+ * 		the cmp_sort() keys of a job, looked up once per job instead of
+ *		on every comparison.  The job_sort_key values live in a flat
+ *		array shared by all the keys of one sort.
+ */
+struct job_sort_key
+{
+	resource_resv *resresv;
+	bool runnable;			/* in_runnable_state() */
+	unsigned int preempt;		/* preemption priority */
+	time_t time_preempted;
+	double formula_value;
+	unsigned long fs_gen;		/* sum of usage_gen along the fairshare path */
+	size_t vals;			/* offset of the job_sort_key values */
+};
+
+/**
+ * @brief
+ * 		the keys of the last sort of the server's job array.  Used to only
+ *		reposition the jobs whose keys changed when jobs are resorted.
+ */
+struct job_sort_state
+{
+	resource_resv **jobs;		/* the array the keys are for */
+	std::vector<job_sort_key> keys;	/* keys in array order */
+	std::vector<sch_resource_t> vals;	/* job_sort_key values of all the keys */
+};
+
+static job_sort_state last_sort = {NULL, {}, {}};
+
+/**
+ * @brief
+ * 		fill in the sort keys of a job
+ *
+ * @param[in]	resresv	-	the job
+ * @param[out]	key	-	the key to fill in
+ * @param[out]	vals	-	where to append the job_sort_key values
+ *
+ * @return	void
+ */
+static void
+make_job_sort_key(resource_resv *resresv, job_sort_key &key, std::vector<sch_resource_t> &vals)
+{
+	key.resresv = resresv;
+	key.runnable = in_runnable_state(resresv);
+	key.preempt = resresv->job->preempt;
+	key.time_preempted = resresv->job->time_preempted;
+	key.formula_value = resresv->job->formula_value;
+	key.fs_gen = 0;
+	if (resresv->job->ginfo != NULL) {
+		for (auto g : resresv->job->ginfo->gpath)
+			key.fs_gen += g->usage_gen;
+	}
+	key.vals = vals.size();
+	for (const auto &si : *cstat.sort_by)
+		vals.push_back(find_resresv_amount(resresv, si.res_name, si.def));
+}
+
+/**
+ * @brief
+ * 		have a job's sort keys changed since they were made
+ *
+ * @param[in]	key	-	the job's keys
+ *
+ * @return	bool
+ */
+static bool
+job_sort_key_stale(const job_sort_key &key)
+{
+	auto resresv = key.resresv;
+	unsigned long fs_gen = 0;
+
+	if (key.runnable != in_runnable_state(resresv) ||
+	    key.preempt != resresv->job->preempt ||
+	    key.time_preempted != resresv->job->time_preempted)
+		return true;
+
+	if (resresv->job->ginfo != NULL) {
+		for (auto g : resresv->job->ginfo->gpath)
+			fs_gen += g->usage_gen;
+	}
+	return fs_gen != key.fs_gen;
+}
+
+/**
+ * @brief
+ * 		orders job_sort_keys the same way cmp_sort() orders the jobs
+ */
+struct job_sort_key_less
+{
+	const std::vector<sch_resource_t> &vals;
+	bool fair_share;
+
+	bool operator()(const job_sort_key &k1, const job_sort_key &k2) const
+	{
+		if (k1.runnable != k2.runnable)
+			return k1.runnable;
+
+		/* sort based on preemption */
+		if (k1.preempt != k2.preempt)
+			return k1.preempt > k2.preempt;
+
+		/* preempted jobs first, in the order they were preempted */
+		if (k1.time_preempted != k2.time_preempted) {
+			if (k1.time_preempted == UNSPECIFIED)
+				return false;
+			if (k2.time_preempted == UNSPECIFIED)
+				return true;
+			return k1.time_preempted < k2.time_preempted;
+		}
+
+		/* sort on the basis of job sort formula */
+		if (k1.formula_value != k2.formula_value)
+			return k1.formula_value > k2.formula_value;
+#ifndef NAS /* localmod 041 */
+		if (fair_share) {
+			int cmp = cmp_fairshare(&k1.resresv, &k2.resresv);
+			if (cmp != 0)
+				return cmp < 0;
+		}
+#endif /* localmod 041 */
+
+		/* normal resource based sort */
+		size_t i = 0;
+		for (const auto &si : *cstat.sort_by) {
+			sch_resource_t v1 = vals[k1.vals + i];
+			sch_resource_t v2 = vals[k2.vals + i];
+			i++;
+			if (v1 != v2)
+				return (si.order == ASC) ? v1 < v2 : v1 > v2;
+		}
+
+		/* stabilize the sort */
+		if (k1.resresv->qrank != k2.resresv->qrank)
+			return k1.resresv->qrank < k2.resresv->qrank;
+		return k1.resresv->rank < k2.resresv->rank;
+	}
+};
+
+/**
+ * @brief
+ * 		sort an array of jobs like qsort() with cmp_sort() would, but
+ *		compare precomputed keys
+ *
+ * @param[in]	policy	-	policy info
+ * @param[in,out]	jobs	-	the jobs to sort
+ * @param[in]	n	-	number of jobs in the array
+ * @param[out]	state	-	if not NULL, where to keep the keys for resort_jobs()
+ *
+ * @return	void
+ */
+static void
+sort_job_array(status *policy, resource_resv **jobs, int n, job_sort_state *state)
+{
+	std::vector<job_sort_key> keys(n);
+	std::vector<sch_resource_t> vals;
+
+	if (jobs == NULL || n <= 0) {
+		if (state != NULL)
+			state->jobs = NULL;
+		return;
+	}
+
+	vals.reserve(n * cstat.sort_by->size());
+	for (int i = 0; i < n; i++)
+		make_job_sort_key(jobs[i], keys[i], vals);
+
+	std::sort(keys.begin(), keys.end(), job_sort_key_less{vals, policy->fair_share != 0});
+
+	for (int i = 0; i < n; i++)
+		jobs[i] = keys[i].resresv;
+
+	if (state != NULL) {
+		state->jobs = jobs;
+		state->keys.swap(keys);
+		state->vals.swap(vals);
+	}
+}
+
+/**
+ * @brief
+ * 		resort the server's jobs after jobs have run.  Only the jobs whose
+ *		sort keys changed (e.g., their fairshare usage grew or they are
+ *		no longer runnable) are sorted and merged back into the jobs whose
+ *		order did not change.  Falls back to sort_jobs() if the job array
+ *		was not the last one sorted as a whole.
+ *
+ * @param[in]		policy	-	policy info
+ * @param[in,out]	sinfo	-	server whose jobs to resort
+ *
+ * @return	void
+ */
+void
+resort_jobs(status *policy, server_info *sinfo)
+{
+	std::vector<job_sort_key> kept;
+	std::vector<job_sort_key> moved;
+	int n;
+
+	if (policy->by_queue || policy->round_robin || !policy->fair_share ||
+	    last_sort.jobs == NULL || last_sort.jobs != sinfo->jobs) {
+		sort_jobs(policy, sinfo);
+		return;
+	}
+
+	n = count_array(sinfo->jobs);
+	if (n != static_cast<int>(last_sort.keys.size())) {
+		sort_jobs(policy, sinfo);
+		return;
+	}
+
+	for (int i = 0; i < n; i++) {
+		auto &key = last_sort.keys[i];
+		if (key.resresv != sinfo->jobs[i]) {
+			/* someone else reordered the jobs */
+			sort_jobs(policy, sinfo);
+			return;
+		}
+		if (job_sort_key_stale(key)) {
+			moved.push_back(key);
+			make_job_sort_key(key.resresv, moved.back(), last_sort.vals);
+		} else
+			kept.push_back(key);
+	}
+
+	if (moved.empty())
+		return;
+
+	job_sort_key_less less{last_sort.vals, policy->fair_share != 0};
+	std::sort(moved.begin(), moved.end(), less);
+	std::merge(kept.begin(), kept.end(), moved.begin(), moved.end(), last_sort.keys.begin(), less);
+
+	for (int i = 0; i < n; i++)
+		sinfo->jobs[i] = last_sort.keys[i].resresv;
+
+	/* the values of the old keys are garbage now, don't let them pile up */
+	if (last_sort.vals.size() > 4 * n * (cstat.sort_by->size() + 1))
+		sort_jobs(policy, sinfo);
+}
+
 /**
  * @brief
  * 		sort_jobs - This function sorts all jobs according to their preemption
@@ -1196,9 +1442,11 @@ cmp_resv_state(const void *r1, const void *r2)
 void
 sort_jobs(status *policy, server_info *sinfo)
 {
+	prof_phase prof(__func__);
 	/** sort jobs in such a way that Higher Priority jobs come on top
 	 * followed by preempted jobs and then normal jobs
 	 */
+	last_sort.jobs = NULL;
 	if (policy->fair_share) {
 		/** sort per queue basis and then use these jobs (combined from all the queues)
 		 * to select the next job.
@@ -1210,8 +1458,7 @@ sort_jobs(status *policy, server_info *sinfo)
 			 */
 			for (int i = 0; i < sinfo->num_queues; i++) {
 				if (sinfo->queues[i]->sc.total > 0) {
-					qsort(sinfo->queues[i]->jobs, sinfo->queues[i]->sc.total,
-						sizeof(resource_resv*), cmp_sort);
+					sort_job_array(policy, sinfo->queues[i]->jobs, sinfo->queues[i]->sc.total, NULL);
 				}
 			}
 			for (int count = 0; count != sinfo->num_queues; count++) {
@@ -1224,14 +1471,14 @@ sort_jobs(status *policy, server_info *sinfo)
 		}
 		/** Sort on entire complex **/
 		else if (!policy->by_queue && !policy->round_robin) {
-			qsort(sinfo->jobs, count_array(sinfo->jobs), sizeof(resource_resv *), cmp_sort);
+			sort_job_array(policy, sinfo->jobs, count_array(sinfo->jobs), &last_sort);
 		}
 	}
 	else if (policy->by_queue) {
 		for (int i = 0; i < sinfo->num_queues; i++) {
-			qsort(sinfo->queues[i]->jobs, count_array(sinfo->queues[i]->jobs), sizeof(resource_resv *), cmp_sort);
+			sort_job_array(policy, sinfo->queues[i]->jobs, count_array(sinfo->queues[i]->jobs), NULL);
 		}
-		qsort(sinfo->jobs, count_array(sinfo->jobs), sizeof(resource_resv*), cmp_sort);
+		sort_job_array(policy, sinfo->jobs, count_array(sinfo->jobs), NULL);
 	}
 	else if (policy->round_robin) {
 		if (sinfo -> queue_list != NULL) {
@@ -1241,13 +1488,13 @@ sort_jobs(status *policy, server_info *sinfo)
 				int queue_index_size = count_array(sinfo->queue_list[i]);
 				for (int j = 0; j < queue_index_size; j++)
 				{
-					qsort(sinfo->queue_list[i][j]->jobs, count_array(sinfo->queue_list[i][j]->jobs),
-						sizeof(resource_resv *), cmp_sort);
+					sort_job_array(policy, sinfo->queue_list[i][j]->jobs,
+						count_array(sinfo->queue_list[i][j]->jobs), NULL);
 				}
 			}
 
 		}
 	}
 	else
-		qsort(sinfo->jobs, count_array(sinfo->jobs), sizeof(resource_resv*), cmp_sort);
+		sort_job_array(policy, sinfo->jobs, count_array(sinfo->jobs), NULL);
 }
@@ -192,4 +192,10 @@ int cmp_resv_state(const void *r1, const void *r2);
  */
 void sort_jobs(status *policy, server_info *sinfo);
 
+/*
+ * resort_jobs - resort the jobs after jobs have run, only moving the jobs
+ *		 whose sort keys changed
+ */
+void resort_jobs(status *policy, server_info *sinfo);
+
 #endif	/* _SORT_H */
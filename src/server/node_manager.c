@@ -1660,6 +1660,8 @@ find_degraded_occurrence(resc_resv *presv, struct pbsnode *np,
 	long dtstart;
 	long occr_time;
 	long curr_degraded_time;
+	time_t *occr_times = NULL;
+	int num_occr_times = 0;
 	int ridx;
 	int ridx_adjusted;
 	int rcount;
@@ -1698,6 +1700,12 @@ find_degraded_occurrence(resc_resv *presv, struct pbsnode *np,
 	occr_found = 0;
 	curr_degraded_time = 0;
 
+	/* the start times of the occurrences from the current one, looked up
+	 * once rather than one index at a time
+	 */
+	if (degraded_op == Set_Degraded_Time)
+		num_occr_times = get_occurrence_times(rrule, dtstart, tz, &occr_times);
+
 	/* Search for a match for this node in each occurrence's execvnode */
 	for (i = ridx_adjusted - 1, j = 1; i < rcount_adjusted; i++, j++) {
 		if (find_vnode_in_execvnode(execvnodes_seq[i], np->nd_name)) {
@@ -1706,7 +1714,10 @@ find_degraded_occurrence(resc_resv *presv, struct pbsnode *np,
 				/* we keep track of the occurrence time to determine the earliest
 				 * degraded time
 				 */
-				occr_time = get_occurrence(rrule, dtstart, tz, j);
+				if (j <= num_occr_times)
+					occr_time = occr_times[j - 1];
+				else
+					occr_time = get_occurrence(rrule, dtstart, tz, j);
 
 				if (presv->ri_degraded_time == 0 &&
 					curr_degraded_time == 0) {
@@ -1716,6 +1727,8 @@ find_degraded_occurrence(resc_resv *presv, struct pbsnode *np,
 				break;
 		}
 	}
+	free(occr_times);
+
 	/* clean up unrolled execvnodes sequence helpers */
 	free(execvnodes_seq);
 	execvnodes_seq = NULL;
@@ -655,6 +655,7 @@ process_request(int sfds)
 		switch (request->rq_type) {
 			case PBS_BATCH_AsyrunJob:
 			case PBS_BATCH_AsyrunJob_ack:
+			case PBS_BATCH_RunJobList:
 			case PBS_BATCH_JobCred:
 			case PBS_BATCH_UserCred:
 			case PBS_BATCH_MoveJob:
@@ -961,6 +962,10 @@ dispatch_request(int sfds, struct batch_request *request)
 			req_runjob(request);
 			break;
 
+		case PBS_BATCH_RunJobList:
+			req_runjoblist(request);
+			break;
+
 		case PBS_BATCH_DefSchReply:
 			req_defschedreply(request);
 			break;
@@ -1660,6 +1665,12 @@ free_br(struct batch_request *preq)
 			if (preq->rq_ind.rq_deletejoblist.rq_jobslist)
 				free_string_array(preq->rq_ind.rq_deletejoblist.rq_jobslist);
 			break;
+		case PBS_BATCH_RunJobList:
+			if (preq->rq_ind.rq_runjoblist.rq_jobslist)
+				free_string_array(preq->rq_ind.rq_runjoblist.rq_jobslist);
+			if (preq->rq_ind.rq_runjoblist.rq_destins)
+				free_string_array(preq->rq_ind.rq_runjoblist.rq_destins);
+			break;
 		case PBS_BATCH_CopyFiles:
 		case PBS_BATCH_DelFiles:
 			freebr_cpyfile(&preq->rq_ind.rq_cpyfile);
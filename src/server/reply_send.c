@@ -45,6 +45,7 @@
  * 		the processing of a request.  The following routines are provided here:
  *
  *	reply_send()  - the main routine, used by all reply senders
+ *	add_runjoblist_status() - add the status of a job to a Run Job List reply
  *	reply_ack()   - send a basic no error acknowledgement
  *	req_reject()  - send a basic error return
  *	reply_text()  - send a return with a supplied text string
@@ -271,6 +272,39 @@ reply_send_status_part(struct batch_request *preq)
 	return rc;
 }
 
+/**
+ * @brief
+ * 		add the status of a job which did not run to the reply of the
+ *		Run Job List request the job was part of
+ *
+ * @param[in,out]	plist	- the Run Job List request
+ * @param[in]	jid	- the job
+ * @param[in]	code	- why the job did not run
+ *
+ * @return	int
+ * @retval	0	- success
+ * @retval	!=0	- failure
+ */
+int
+add_runjoblist_status(struct batch_request *plist, char *jid, int code)
+{
+	struct batch_deljob_status *pstat;
+
+	pstat = malloc(sizeof(struct batch_deljob_status));
+	if (pstat == NULL)
+		return PBSE_SYSTEM;
+	if ((pstat->name = strdup(jid)) == NULL) {
+		free(pstat);
+		return PBSE_SYSTEM;
+	}
+	pstat->code = code;
+	pstat->next = plist->rq_reply.brp_un.brp_deletejoblist.brp_delstatc;
+	plist->rq_reply.brp_un.brp_deletejoblist.brp_delstatc = pstat;
+	plist->rq_reply.brp_count++;
+
+	return 0;
+}
+
 /**
  * @brief
  * 		Send a reply to a batch request, reply either goes to a
@@ -320,7 +354,16 @@ reply_send(struct batch_request *request)
 
 	/* if this is a child request, just move the error to the parent */
 	if (request->rq_parentbr) {
-		if ((request->rq_parentbr->rq_reply.brp_choice == BATCH_REPLY_CHOICE_NULL) && (request->rq_parentbr->rq_reply.brp_code == 0)) {
+		if (request->rq_parentbr->rq_type == PBS_BATCH_RunJobList) {
+			/* one job of a run job list, the list replies with every job which failed */
+			if (request->rq_reply.brp_code != PBSE_NONE &&
+				add_runjoblist_status(request->rq_parentbr,
+					request->rq_type == PBS_BATCH_MoveJob ?
+					request->rq_ind.rq_move.rq_jid :	/* see move_and_runjob() */
+					request->rq_ind.rq_run.rq_jid,
+					request->rq_reply.brp_code) != 0)
+				log_err(-1, __func__, "Unable to allocate Memory!\n");
+		} else if ((request->rq_parentbr->rq_reply.brp_choice == BATCH_REPLY_CHOICE_NULL) && (request->rq_parentbr->rq_reply.brp_code == 0)) {
 			request->rq_parentbr->rq_reply.brp_code = request->rq_reply.brp_code;
 			request->rq_parentbr->rq_reply.brp_auxcode = request->rq_reply.brp_auxcode;
 			if (request->rq_reply.brp_choice == BATCH_REPLY_CHOICE_Text) {
@@ -47,6 +47,7 @@
  *	check_and_provision_job()
  *	clear_from_defr()
  *	req_runjob()
+ *	req_runjoblist()
  *	req_runjob2()
  *	clear_exec_on_run_fail()
  *	req_stagein()
@@ -695,6 +696,84 @@ req_runjob(struct batch_request *preq)
 		reply_send(preq);
 	return;
 }
+/**
+ * @brief
+ * 	req_runjoblist - service the Run Job List Request
+ *
+ * @par
+ *	Runs each job of the list on its own destination like an
+ *	Async Run Job (with ack) request.  Each job gets its own child request;
+ *	the reply is sent once every child was handled and lists the jobs
+ *	which could not be run with their error codes.
+ *
+ * @param[in] preq - pointer to batch request structure
+ *
+ * @return void
+ *
+ */
+void
+req_runjoblist(struct batch_request *preq)
+{
+	int i;
+	struct rq_runjoblist *plist = &preq->rq_ind.rq_runjoblist;
+	struct batch_request *pchild;
+
+	if ((preq->rq_perm & (ATR_DFLAG_MGWR | ATR_DFLAG_OPWR)) == 0) {
+		req_reject(PBSE_PERM, 0, preq);
+		return;
+	}
+
+	preq->rq_reply.brp_choice = BATCH_REPLY_CHOICE_Delete;
+	preq->rq_reply.brp_count = 0;
+	preq->rq_reply.brp_un.brp_deletejoblist.brp_delstatc = NULL;
+
+	/* hold the reply until the last job was handled */
+	++preq->rq_refct;
+
+	for (i = 0; i < plist->rq_count; i++) {
+		pchild = alloc_br(PBS_BATCH_AsyrunJob_ack);
+		if (pchild == NULL)
+			break;
+
+		pchild->rq_perm = preq->rq_perm;
+		pchild->rq_fromsvr = preq->rq_fromsvr;
+		pchild->rq_conn = preq->rq_conn;
+		pchild->rq_orgconn = preq->rq_orgconn;
+		pchild->rq_time = preq->rq_time;
+		strcpy(pchild->rq_user, preq->rq_user);
+		strcpy(pchild->rq_host, preq->rq_host);
+		pchild->rq_reply.brp_choice = BATCH_REPLY_CHOICE_NULL;
+		pbs_strncpy(pchild->rq_ind.rq_run.rq_jid, plist->rq_jobslist[i],
+			sizeof(pchild->rq_ind.rq_run.rq_jid));
+		pchild->rq_ind.rq_run.rq_resch = 0;
+		/* like dup_br_for_subjob(), the child shares the parent's strings,
+		 * which free_br() leaves alone for a request with a parent
+		 */
+		pchild->rq_ind.rq_run.rq_destin = plist->rq_destins[i];
+		pchild->rq_extend = preq->rq_extend;
+
+		pchild->rq_parentbr = preq;
+		++preq->rq_refct;
+
+		req_runjob(pchild);
+	}
+
+	if (i < plist->rq_count) {
+		log_eventf(PBSEVENT_ERROR, PBS_EVENTCLASS_REQUEST, LOG_ERR, __func__,
+			"Unable to run the last %d jobs of the run job list", plist->rq_count - i);
+		/* report the jobs which were never tried as failed */
+		for (; i < plist->rq_count; i++)
+			(void) add_runjoblist_status(preq, plist->rq_jobslist[i], PBSE_SYSTEM);
+	}
+
+	/*
+	 * if not waiting on any job, can reply; else it is taken
+	 * care of when the last job's request is freed
+	 */
+	if (--preq->rq_refct == 0)
+		reply_send(preq);
+}
+
 /**
  * @brief
  * 		req_runjob - service the Run Job and Asyc Run Job Requests
@@ -2792,15 +2792,16 @@ Time4occurrenceFinish(resc_resv *presv)
 	resource_def *rscdef = NULL;
 	resource *prsc = NULL;
 	attribute atemp = {0};
-	int j = 2;
+	int j;
+	int skip;
 	int occurrence_ended_early = 0;
 	int ridx = get_rattr_long(presv, RESV_ATR_resv_idx);
 	int rcount = get_rattr_long(presv, RESV_ATR_resv_count);
 	char *rrule = get_rattr_str(presv, RESV_ATR_resv_rrule);
 	char *tz = get_rattr_str(presv, RESV_ATR_resv_timezone);
 
-	/* the next occurrence returned by get_occurrence is counted from the current
-	 * one which is at index 1. */
+	/* the occurrences returned by get_occurrence and get_occurrence_index are
+	 * counted from the current one which is at index 1. */
 
 	/* If the reservation was altered,
 	 * use the stored values in RESV_ATR_standing_revert.
@@ -2839,62 +2840,67 @@ Time4occurrenceFinish(resc_resv *presv)
 	 */
 	if (presv->ri_qs.ri_substate == RESV_RUNNING && next < now)
 		occurrence_ended_early = 1;
-	while (occurrence_ended_early || dtend <= now) {
-		/* We may loop and skip several occurrences for different reasons,
-		 * if an occurrence ended early, it can only be the one we are in
+	if (occurrence_ended_early || dtend <= now) {
+		/* Find the first occurrence which ends in the future instead of
+		 * stepping through the ones we missed.  The occurrence we are in,
+		 * at index 1, is always left, so at least the one at index 2 is
+		 * taken.  If there is none, every remaining occurrence is skipped.
 		 */
-		occurrence_ended_early = 0;
-		/* get occurrence that is "j" numbers away from dtstart. */
-		next = get_occurrence(rrule, dtstart, tz, j);
-		dtend = next + presv->ri_qs.ri_duration;
-
-		/* Index of next occurrence from dtstart */
-		j++;
+		j = get_occurrence_index(rrule, dtstart, tz, now - presv->ri_qs.ri_duration + 1);
+		if (j == 0)
+			skip = rcount - ridx + 1;
+		else
+			skip = (j < 2 ? 2 : j) - 1;
 
 		/* Log information notifying of missed occurrences. An occurrence is
 		 * "missed" either if it was interrupted, in which case it never was
 		 * instructed to "give back" its allocated resources, or if the server
 		 * was down for an extended period of time extending over a number of
 		 * occurrences.
-		 * The first time around j has the value 2 and is incremented to 3 to
-		 * account for the next occurrence. Any increments after that characterize
-		 * missed occurrences that are noted in the log file. */
-		if (j > 3 || presv->ri_giveback == 0) {
-			if (strftime(start_time, sizeof(start_time),
-				     "%H:%M:%S", localtime(&dtstart))) {
-				sprintf(log_buffer,
-					"reservation occurrence %d/%d "
-					"scheduled at %s was skipped because "
-					"its end time is in the past",
-					ridx, rcount, start_time);
-			} else {
-				sprintf(log_buffer,
-					"reservation occurrence %d/%d was "
-					"skipped because its end time is in "
-					"the past",
-					ridx, rcount);
+		 * Moving on from the occurrence we are in is the normal case. Any
+		 * occurrences after that are missed and noted in the log file. */
+		for (j = 1; j <= skip; j++) {
+			if (j > 1 || presv->ri_giveback == 0) {
+				if (strftime(start_time, sizeof(start_time),
+					     "%H:%M:%S", localtime(&dtstart))) {
+					sprintf(log_buffer,
+						"reservation occurrence %d/%d "
+						"scheduled at %s was skipped because "
+						"its end time is in the past",
+						ridx, rcount, start_time);
+				} else {
+					sprintf(log_buffer,
+						"reservation occurrence %d/%d was "
+						"skipped because its end time is in "
+						"the past",
+						ridx, rcount);
+				}
+				log_event(PBSEVENT_ERROR, PBS_EVENTCLASS_RESV,
+					  LOG_NOTICE, presv->ri_qs.ri_resvID,
+					  log_buffer);
 			}
-			log_event(PBSEVENT_ERROR, PBS_EVENTCLASS_RESV,
-				  LOG_NOTICE, presv->ri_qs.ri_resvID,
-				  log_buffer);
-		}
 
-		/* The reservation index is incremented */
-		ridx++;
+			/* The reservation index is incremented */
+			ridx++;
 
-		/* If skipped past the last occurrence then return to the
-		 * caller which will handle issuing a reservation delete
-		 * message
-		 */
-		if (ridx > rcount) {
-			set_rattr_l_slim(presv, RESV_ATR_resv_idx, rcount, SET);
+			/* If skipped past the last occurrence then return to the
+			 * caller which will handle issuing a reservation delete
+			 * message
+			 */
+			if (ridx > rcount) {
+				set_rattr_l_slim(presv, RESV_ATR_resv_idx, rcount, SET);
 
-			if ((ptask = set_task(WORK_Immed, 0, Time4resvFinish, presv)) != 0)
-				append_link(&presv->ri_svrtask, &ptask->wt_linkobj, ptask);
+				if ((ptask = set_task(WORK_Immed, 0, Time4resvFinish, presv)) != 0)
+					append_link(&presv->ri_svrtask, &ptask->wt_linkobj, ptask);
 
-			return;
+				return;
+			}
 		}
 
+		/* get occurrence that is "skip" numbers away from the current one */
+		next = get_occurrence(rrule, dtstart, tz, skip + 1);
+		dtend = next + presv->ri_qs.ri_duration;
+
 		DBPRT(("stdg_resv: next occurrence start = %s", ctime(&next)))
 		DBPRT(("stdg_resv: next occurrence end   = %s", ctime(&dtend)))
 	}
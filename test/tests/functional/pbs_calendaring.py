@@ -228,3 +228,92 @@ class TestCalendaring(TestFunctional):
         est_time = job3[0]['estimated.start_time']
         est_time = time.mktime(time.strptime(est_time, '%c'))
         self.assertAlmostEqual(end_time, est_time, delta=1)
+
+    def test_topjob_start_time_multiple_ends(self):
+        """
+        In this test we test that a top job which needs the resources
+        freed by several running jobs is calendared to start when the last
+        of them ends, and not at any of the earlier end events
+        """
+
+        self.scheduler.set_sched_config({'strict_ordering': 'true all'})
+        a = {'resources_available.ncpus': 2}
+        self.mom.create_vnodes(a, 2)
+        a = {'opt_backfill_fuzzy': 'off'}
+        self.server.manager(MGR_CMD_SET, SCHED, a)
+
+        jids = []
+        for wt in [30, 45, 60, 75]:
+            res_req = {'Resource_List.select': '1:ncpus=1',
+                       'Resource_List.walltime': wt}
+            j = Job(TEST_USER, attrs=res_req)
+            j.set_sleep_time(wt)
+            jids.append(self.server.submit(j))
+
+        res_req = {'Resource_List.select': '2:ncpus=2',
+                   'Resource_List.walltime': 30}
+        j5 = Job(TEST_USER, attrs=res_req)
+        jid5 = self.server.submit(j5)
+
+        for jid in jids:
+            self.server.expect(JOB, {'job_state': 'R'}, jid)
+        self.server.expect(JOB, {'job_state': 'Q'}, jid5)
+        job4 = self.server.status(JOB, id=jids[3])
+        job5 = self.server.status(JOB, id=jid5)
+
+        end_time = time.mktime(time.strptime(job4[0]['stime'], '%c')) + 75
+        est_time = job5[0]['estimated.start_time']
+        est_time = time.mktime(time.strptime(est_time, '%c'))
+        self.assertAlmostEqual(end_time, est_time, delta=1)
+
+    def test_topjob_start_time_multi_vnode_host(self):
+        """
+        In this test we test that the host sets of multi-vnoded hosts are
+        refreshed when the calendar simulates a job ending, so a top job
+        and a reservation that need a whole host can use the host freed
+        by the first job to end
+        """
+
+        self.scheduler.set_sched_config({'strict_ordering': 'true all'})
+        a = {'resources_available.ncpus': 1}
+        self.mom.create_vnodes(a, 4, sharednode=False, vnodes_per_host=2)
+        a = {'opt_backfill_fuzzy': 'off'}
+        self.server.manager(MGR_CMD_SET, SCHED, a)
+
+        jids = []
+        for wt in [30, 120]:
+            res_req = {'Resource_List.select': '1:ncpus=1',
+                       'Resource_List.place': 'excl:host',
+                       'Resource_List.walltime': wt}
+            j = Job(TEST_USER, attrs=res_req)
+            j.set_sleep_time(wt)
+            jids.append(self.server.submit(j))
+
+        for jid in jids:
+            self.server.expect(JOB, {'job_state': 'R'}, jid)
+
+        now = int(time.time())
+        a = {'Resource_List.select': '2:ncpus=1',
+             'Resource_List.place': 'pack:excl',
+             'reserve_start': now + 60,
+             'reserve_end': now + 90}
+        r = Reservation(TEST_USER, attrs=a)
+        rid = self.server.submit(r)
+        a = {'reserve_state': (MATCH_RE, 'RESV_CONFIRMED|2')}
+        self.server.expect(RESV, a, id=rid)
+        self.server.delete(rid)
+
+        res_req = {'Resource_List.select': '2:ncpus=1',
+                   'Resource_List.place': 'pack:excl',
+                   'Resource_List.walltime': 30}
+        j3 = Job(TEST_USER, attrs=res_req)
+        jid3 = self.server.submit(j3)
+
+        self.server.expect(JOB, {'job_state': 'Q'}, jid3)
+        job1 = self.server.status(JOB, id=jids[0])
+        job3 = self.server.status(JOB, id=jid3)
+
+        end_time = time.mktime(time.strptime(job1[0]['stime'], '%c')) + 30
+        est_time = job3[0]['estimated.start_time']
+        est_time = time.mktime(time.strptime(est_time, '%c'))
+        self.assertAlmostEqual(end_time, est_time, delta=1)
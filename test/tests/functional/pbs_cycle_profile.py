@@ -0,0 +1,92 @@
+# coding: utf-8
+
+# Copyright (C) 1994-2021 Altair Engineering, Inc.
+# For more information, contact Altair at www.altair.com.
+#
+# This file is part of both the OpenPBS software ("OpenPBS")
+# and the PBS Professional ("PBS Pro") software.
+#
+# Open Source License Information:
+#
+# OpenPBS is free software. You can redistribute it and/or modify it under
+# the terms of the GNU Affero General Public License as published by the
+# Free Software Foundation, either version 3 of the License, or (at your
+# option) any later version.
+#
+# OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+# License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Commercial License Information:
+#
+# PBS Pro is commercially licensed software that shares a common core with
+# the OpenPBS software.  For a copy of the commercial license terms and
+# conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+# Altair Legal Department.
+#
+# Altair's dual-license business model allows companies, individuals, and
+# organizations to create proprietary derivative works of OpenPBS and
+# distribute them - whether embedded or bundled with other software -
+# under a commercial license agreement.
+#
+# Use of Altair's trademarks, including but not limited to "PBS™",
+# "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+# subject to Altair's trademark licensing policies.
+
+
+from tests.functional import *
+import json
+
+
+class TestCycleProfile(TestFunctional):
+    """
+    Tests for the scheduler's cycle phase profiler
+    """
+
+    def setUp(self):
+        TestFunctional.setUp(self)
+        a = {'resources_available.ncpus': 2}
+        self.mom.create_vnodes(a, 2)
+        a = {'log_events': 2047, 'scheduling': 'False'}
+        self.server.manager(MGR_CMD_SET, SCHED, a, id='default')
+
+    def test_profile_logged(self):
+        """
+        Test that with cycle_profile set to log, the scheduler logs a
+        JSON profile of the cycle with its phases and counters
+        """
+        self.scheduler.set_sched_config({'cycle_profile': 'log'})
+        jid = self.server.submit(Job())
+        t = time.time()
+        self.scheduler.run_scheduling_cycle()
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid)
+        m = self.scheduler.log_match(r'cycle_profile;\{"start":',
+                                     regexp=True, starttime=t)
+        prof = json.loads(m[1].split('cycle_profile;', 1)[1])
+        phases = prof['cycle']['phases']
+        self.assertIn('query_server', phases)
+        self.assertIn('main_sched_loop', phases)
+        self.assertIn('is_ok_to_run', phases['main_sched_loop']['phases'])
+        self.assertEqual(prof['counters']['jobs_considered'], 1)
+        self.assertEqual(prof['counters']['jobs_run'], 1)
+
+    def test_profile_file(self):
+        """
+        Test that with cycle_profile set to a file, one line of JSON is
+        appended to the file per cycle
+        """
+        fn = os.path.join(self.server.pbs_conf['PBS_HOME'], 'sched_priv',
+                          'cycle_profile.json')
+        self.du.rm(self.scheduler.hostname, fn, sudo=True, force=True)
+        self.scheduler.set_sched_config({'cycle_profile': fn})
+        self.scheduler.run_scheduling_cycle()
+        self.scheduler.run_scheduling_cycle()
+        lines = self.du.cat(self.scheduler.hostname, fn, sudo=True)['out']
+        self.assertEqual(len(lines), 2)
+        for line in lines:
+            self.assertIn('query_server', json.loads(line)['cycle']['phases'])
+        self.du.rm(self.scheduler.hostname, fn, sudo=True, force=True)
@@ -458,3 +458,28 @@ class TestFairshare(TestFunctional):
         self.server.expect(JOB, {'job_state': 'R'}, id=jid3, offset=15)
         self.server.manager(MGR_CMD_SET, SERVER, {'scheduling': True})
         self.server.expect(JOB, {'job_state': 'R'}, id=jid1, offset=15)
+
+    def test_usage_file_updated_in_place(self):
+        """
+        Test that usage the scheduler writes to its usage file is read
+        back after a restart and that no usage journal is left behind
+        """
+        self.scheduler.set_sched_config({'fair_share': 'True'})
+        self.scheduler.add_to_resource_group(TEST_USER, 10, 'root', 50)
+        self.scheduler.fairshare.set_fairshare_usage(TEST_USER, 100)
+        self.scheduler.set_sched_config({'fairshare_decay_time': '00:00:02'})
+        self.server.manager(MGR_CMD_SET, SERVER, {'scheduling': 'False'})
+
+        t = time.time()
+        time.sleep(3)
+        self.scheduler.run_scheduling_cycle()
+        self.scheduler.log_match("Usage Sync", starttime=t)
+
+        self.scheduler.restart()
+        fs = self.scheduler.fairshare.query_fairshare(name=str(TEST_USER))
+        self.assertEqual(int(fs.usage), 50)
+
+        sched_priv = os.path.dirname(self.scheduler.sched_config_file)
+        journal = os.path.join(sched_priv, 'usage.journal')
+        self.assertFalse(self.du.isfile(self.scheduler.hostname,
+                                        path=journal, sudo=True))
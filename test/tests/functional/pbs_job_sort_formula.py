@@ -72,3 +72,59 @@ class TestJobSortFormula(TestFunctional):
             self.assertEqual(job.split('.')[0], c.political_order[i])
 
         self.server.expect(JOB, {'job_state=R': 2})
+
+    def test_job_sort_formula_compiled_value(self):
+        """
+        Test that a formula the scheduler compiles evaluates like python
+        would, including keywords, builtins and division by zero
+        """
+        self.server.manager(MGR_CMD_CREATE, RSC, {'type': 'float'}, id='foo')
+        a = {'log_events': 2047}
+        self.server.manager(MGR_CMD_SET, SCHED, a, id='default')
+        formula = 'max(foo, 1) * 10 // 4 + (job_priority if foo > 0 else -1)'
+        a = {'job_sort_formula': formula, 'scheduling': 'False'}
+        self.server.manager(MGR_CMD_SET, SERVER, a, runas=ROOT_USER)
+
+        j1 = Job(TEST_USER, attrs={'Resource_List.foo': 3, 'Priority': 5})
+        jid1 = self.server.submit(j1)
+        j2 = Job(TEST_USER, attrs={'Resource_List.foo': 0})
+        jid2 = self.server.submit(j2)
+
+        t = time.time()
+        self.scheduler.run_scheduling_cycle()
+        self.scheduler.log_match(jid1 + ';Formula Evaluation = 12',
+                                 starttime=t)
+        self.scheduler.log_match(jid2 + ';Formula Evaluation = 1',
+                                 starttime=t)
+        self.scheduler.log_match('Formula will be evaluated by python',
+                                 starttime=t, existence=False,
+                                 max_attempts=2)
+
+        a = {'job_sort_formula': '1 / foo'}
+        self.server.manager(MGR_CMD_SET, SERVER, a, runas=ROOT_USER)
+        t = time.time()
+        self.scheduler.run_scheduling_cycle()
+        self.scheduler.log_match(
+            jid2 + ';Formula evaluation for job had an error.  '
+            'Zero value will be used: division by zero', starttime=t)
+
+    def test_job_sort_formula_python_fallback(self):
+        """
+        Test that a formula the scheduler can not compile is still
+        evaluated through python
+        """
+        self.server.manager(MGR_CMD_CREATE, RSC, {'type': 'float'}, id='foo')
+        a = {'log_events': 2047}
+        self.server.manager(MGR_CMD_SET, SCHED, a, id='default')
+        a = {'job_sort_formula': 'round(foo)', 'scheduling': 'False'}
+        self.server.manager(MGR_CMD_SET, SERVER, a, runas=ROOT_USER)
+
+        jid = self.server.submit(Job(TEST_USER,
+                                     attrs={'Resource_List.foo': 2.6}))
+
+        t = time.time()
+        self.scheduler.run_scheduling_cycle()
+        self.scheduler.log_match('Formula will be evaluated by python',
+                                 starttime=t)
+        self.scheduler.log_match(jid + ';Formula Evaluation = 3',
+                                 starttime=t)
@@ -821,3 +821,41 @@ exit 3
         self.server.expect(JOB, {'job_state': 'R'}, id=hjid)
         self.server.expect(JOB, {'job_state=R': 5})
         self.server.expect(JOB, {'job_state=S': 1})
+
+    def test_preempt_too_little_work(self):
+        """
+        Test that the scheduler does not simulate preemption for a high
+        priority job which fits on the vnode but would not fit even if all
+        the lower priority work were preempted, and that nothing is
+        preempted
+        """
+        a = {'resources_available.ncpus': 3}
+        self.server.manager(MGR_CMD_SET, NODE, a, id=self.mom.shortname)
+        a = {'log_events': 2047}
+        self.server.manager(MGR_CMD_SET, SCHED, a, id='default')
+
+        # same preempt priority as the high priority job, can't be preempted
+        a = {ATTR_q: 'expressq', 'Resource_List.select': '1:ncpus=2'}
+        j1 = Job(TEST_USER, attrs=a)
+        jid1 = self.server.submit(j1)
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid1)
+        j2 = Job(TEST_USER)
+        jid2 = self.server.submit(j2)
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid2)
+
+        a = {ATTR_q: 'expressq', 'Resource_List.select': '1:ncpus=3'}
+        hj = Job(TEST_USER, attrs=a)
+        t = time.time()
+        hjid = self.server.submit(hj)
+        self.scheduler.log_match(hjid + ';Preempt: Not enough ncpus on '
+                                 "the job's vnodes even with all lower "
+                                 'priority work preempted', starttime=t)
+        self.scheduler.log_match(jid2 + ';Simulation: preempting job',
+                                 starttime=t, existence=False,
+                                 max_attempts=2)
+        self.scheduler.log_match(hjid + ';Simulation: not enough work '
+                                 'preempted', starttime=t, existence=False,
+                                 max_attempts=2)
+        self.server.expect(JOB, {'job_state': 'Q'}, id=hjid)
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid1)
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid2)
@@ -0,0 +1,102 @@
+# coding: utf-8
+
+# Copyright (C) 1994-2021 Altair Engineering, Inc.
+# For more information, contact Altair at www.altair.com.
+#
+# This file is part of both the OpenPBS software ("OpenPBS")
+# and the PBS Professional ("PBS Pro") software.
+#
+# Open Source License Information:
+#
+# OpenPBS is free software. You can redistribute it and/or modify it under
+# the terms of the GNU Affero General Public License as published by the
+# Free Software Foundation, either version 3 of the License, or (at your
+# option) any later version.
+#
+# OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+# License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Commercial License Information:
+#
+# PBS Pro is commercially licensed software that shares a common core with
+# the OpenPBS software.  For a copy of the commercial license terms and
+# conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+# Altair Legal Department.
+#
+# Altair's dual-license business model allows companies, individuals, and
+# organizations to create proprietary derivative works of OpenPBS and
+# distribute them - whether embedded or bundled with other software -
+# under a commercial license agreement.
+#
+# Use of Altair's trademarks, including but not limited to "PBS™",
+# "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+# subject to Altair's trademark licensing policies.
+
+
+from tests.functional import *
+
+
+
+class TestRunJobBatch(TestFunctional):
+    """
+    Tests for sending run job requests to the server in batches
+    """
+
+    def setUp(self):
+        TestFunctional.setUp(self)
+        a = {'resources_available.ncpus': 8}
+        self.server.manager(MGR_CMD_SET, NODE, a, self.mom.shortname)
+        self.scheduler.set_sched_config({'runjob_batch_size': '3'})
+        self.server.manager(MGR_CMD_SET, SERVER, {'scheduling': 'False'})
+
+    def test_batched_jobs_run(self):
+        """
+        Test that jobs started through run job lists all run, including
+        a partial batch left at the end of the cycle
+        """
+        self.server.manager(MGR_CMD_SET, SCHED, {'log_events': 2047},
+                            id='default')
+        jids = [self.server.submit(Job()) for _ in range(7)]
+        t = time.time()
+        self.scheduler.run_scheduling_cycle()
+        for jid in jids:
+            self.server.expect(JOB, {'job_state': 'R'}, id=jid)
+        self.scheduler.log_match('Run job list of 3 jobs sent',
+                                 starttime=t)
+        self.scheduler.log_match('Run job list of 1 jobs sent',
+                                 starttime=t)
+        self.scheduler.log_match('sending run requests one at a time',
+                                 starttime=t, existence=False,
+                                 max_attempts=1)
+
+    def test_batched_job_failure_logged(self):
+        """
+        Test that a job the server refuses to run from a run job list
+        is logged by the scheduler while the rest of the batch runs
+        """
+        hook_body = """
+import pbs
+e = pbs.event()
+if e.job.Job_Name == 'reject':
+    e.reject('rejected by test')
+e.accept()
+"""
+        self.server.create_import_hook('rj', {'event': 'runjob'}, hook_body)
+        self.server.manager(MGR_CMD_SET, SCHED, {'job_run_wait': 'none'},
+                            id='default')
+        j = Job(attrs={ATTR_N: 'reject'})
+        jid1 = self.server.submit(j)
+        jid2 = self.server.submit(Job())
+        jid3 = self.server.submit(Job())
+        t = time.time()
+        self.scheduler.run_scheduling_cycle()
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid2)
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid3)
+        self.server.expect(JOB, {'job_state': 'Q'}, id=jid1)
+        self.scheduler.log_match(jid1 + ';Server could not run job',
+                                 starttime=t)
@@ -0,0 +1,104 @@
+# coding: utf-8
+
+# Copyright (C) 1994-2021 Altair Engineering, Inc.
+# For more information, contact Altair at www.altair.com.
+#
+# This file is part of both the OpenPBS software ("OpenPBS")
+# and the PBS Professional ("PBS Pro") software.
+#
+# Open Source License Information:
+#
+# OpenPBS is free software. You can redistribute it and/or modify it under
+# the terms of the GNU Affero General Public License as published by the
+# Free Software Foundation, either version 3 of the License, or (at your
+# option) any later version.
+#
+# OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+# License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Commercial License Information:
+#
+# PBS Pro is commercially licensed software that shares a common core with
+# the OpenPBS software.  For a copy of the commercial license terms and
+# conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+# Altair Legal Department.
+#
+# Altair's dual-license business model allows companies, individuals, and
+# organizations to create proprietary derivative works of OpenPBS and
+# distribute them - whether embedded or bundled with other software -
+# under a commercial license agreement.
+#
+# Use of Altair's trademarks, including but not limited to "PBS™",
+# "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+# subject to Altair's trademark licensing policies.
+
+
+from tests.functional import *
+
+
+class TestSchedCapture(TestFunctional):
+    """
+    Tests for capturing a scheduling cycle with cycle_capture
+    """
+
+    def setUp(self):
+        TestFunctional.setUp(self)
+        a = {'resources_available.ncpus': 2}
+        self.mom.create_vnodes(a, 2)
+        a = {'log_events': 2047, 'scheduling': 'False'}
+        self.server.manager(MGR_CMD_SET, SCHED, a, id='default')
+        self.capdir = os.path.join(self.server.pbs_conf['PBS_HOME'],
+                                   'sched_priv', 'capture')
+        self.du.rm(self.scheduler.hostname, self.capdir, sudo=True,
+                   recursive=True, force=True)
+
+    def tearDown(self):
+        self.du.rm(self.scheduler.hostname, self.capdir, sudo=True,
+                   recursive=True, force=True)
+        TestFunctional.tearDown(self)
+
+    def test_capture_one_cycle(self):
+        """
+        Test that only the first cycle after the config is read is
+        captured, and that the capture holds the universe and the
+        sched_priv files
+        """
+        self.scheduler.set_sched_config({'cycle_capture': self.capdir})
+        jid = self.server.submit(Job())
+        t = time.time()
+        self.scheduler.run_scheduling_cycle()
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid)
+        self.scheduler.log_match('Scheduling cycle captured in ' +
+                                 self.capdir, starttime=t)
+
+        fn = os.path.join(self.capdir, 'universe')
+        lines = self.du.cat(self.scheduler.hostname, fn, sudo=True)['out']
+        self.assertTrue(lines[0].startswith('#pbs_sched_capture\t1\t'))
+        objs = [l.split('\t')[1] for l in lines if l.startswith('O\t')]
+        for kind in ['server', 'sched', 'resource', 'queue', 'node', 'job']:
+            self.assertIn(kind, objs)
+        self.assertIn('O\tjob\t' + jid, lines)
+        self.assertTrue(self.du.isfile(self.scheduler.hostname,
+                                       os.path.join(self.capdir,
+                                                    'sched_config'),
+                                       sudo=True))
+
+        t = time.time()
+        self.scheduler.run_scheduling_cycle()
+        self.scheduler.log_match('Scheduling cycle captured in',
+                                 starttime=t, existence=False,
+                                 max_attempts=2)
+
+    def test_bad_capture_dir(self):
+        """
+        Test that cycle_capture only takes an absolute directory
+        """
+        self.scheduler.set_sched_config({'cycle_capture': 'capture'},
+                                        validate=False)
+        self.scheduler.log_match('cycle_capture valid values: none or '
+                                 'an absolute directory name')
@@ -0,0 +1,123 @@
+# coding: utf-8
+
+# Copyright (C) 1994-2021 Altair Engineering, Inc.
+# For more information, contact Altair at www.altair.com.
+#
+# This file is part of both the OpenPBS software ("OpenPBS")
+# and the PBS Professional ("PBS Pro") software.
+#
+# Open Source License Information:
+#
+# OpenPBS is free software. You can redistribute it and/or modify it under
+# the terms of the GNU Affero General Public License as published by the
+# Free Software Foundation, either version 3 of the License, or (at your
+# option) any later version.
+#
+# OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+# License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Commercial License Information:
+#
+# PBS Pro is commercially licensed software that shares a common core with
+# the OpenPBS software.  For a copy of the commercial license terms and
+# conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+# Altair Legal Department.
+#
+# Altair's dual-license business model allows companies, individuals, and
+# organizations to create proprietary derivative works of OpenPBS and
+# distribute them - whether embedded or bundled with other software -
+# under a commercial license agreement.
+#
+# Use of Altair's trademarks, including but not limited to "PBS™",
+# "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+# subject to Altair's trademark licensing policies.
+
+
+
+from tests.functional import *
+
+
+class TestSchedEquivClassCache(TestFunctional):
+    """
+    Tests for remembering equivalence classes which can not run across
+    scheduling cycles
+    """
+
+    def setUp(self):
+        TestFunctional.setUp(self)
+        a = {'log_events': 2047, 'scheduling': 'False'}
+        self.server.manager(MGR_CMD_SET, SCHED, a, id='default')
+        a = {'resources_available.ncpus': 2}
+        self.mom.create_vnodes(a, 1)
+
+    def test_blocked_class_skipped_until_change(self):
+        """
+        Test that a class which could not run for lack of resources is
+        not evaluated again until the nodes change, and that its jobs
+        run once they do
+        """
+        a = {'Resource_List.select': '1:ncpus=2'}
+        j1 = self.server.submit(Job(attrs=a))
+        self.scheduler.run_scheduling_cycle()
+        self.server.expect(JOB, {'job_state': 'R'}, id=j1)
+
+        jids = [self.server.submit(Job(attrs=a)) for _ in range(3)]
+
+        # The first cycle after submission evaluates the class
+        self.scheduler.run_scheduling_cycle()
+        for jid in jids:
+            self.server.expect(JOB, {'job_state': 'Q'}, id=jid)
+
+        # Nothing changed, so the class is known not to run
+        t = time.time()
+        self.scheduler.run_scheduling_cycle()
+        self.scheduler.log_match(
+            '1 of 1 equivalence classes still can not run since an '
+            'earlier cycle', starttime=t)
+        c = 'Not Running: Insufficient amount of resource: ncpus ' \
+            '(R: 2 A: 0 T: 2)'
+        for jid in jids:
+            self.server.expect(JOB, {'comment': c}, id=jid)
+
+        # Freeing the node invalidates the remembered failure
+        self.server.delete(j1, wait=True)
+        t = time.time()
+        self.scheduler.run_scheduling_cycle()
+        self.server.expect(JOB, {'job_state': 'R'}, id=jids[0])
+        self.scheduler.log_match(
+            'equivalence classes still can not run since an earlier cycle',
+            starttime=t, existence=False, max_attempts=2)
+
+    def test_limit_class_skipped_until_change(self):
+        """
+        Test that a class held back by a user limit is not evaluated again
+        while the user's running count is unchanged
+        """
+        a = {'max_run': '[u:PBS_GENERIC=1]'}
+        self.server.manager(MGR_CMD_SET, SERVER, a)
+        j1 = self.server.submit(Job())
+        self.scheduler.run_scheduling_cycle()
+        self.server.expect(JOB, {'job_state': 'R'}, id=j1)
+
+        jids = [self.server.submit(Job()) for _ in range(3)]
+        self.scheduler.run_scheduling_cycle()
+
+        t = time.time()
+        self.scheduler.run_scheduling_cycle()
+        self.scheduler.log_match(
+            '1 of 1 equivalence classes still can not run since an '
+            'earlier cycle', starttime=t)
+        c = 'Not Running: User has reached server running job limit.'
+        for jid in jids:
+            self.server.expect(JOB, {'comment': c}, id=jid)
+
+        # Raising the limit changes the fingerprint of the failure
+        a = {'max_run': '[u:PBS_GENERIC=2]'}
+        self.server.manager(MGR_CMD_SET, SERVER, a)
+        self.scheduler.run_scheduling_cycle()
+        self.server.expect(JOB, {'job_state': 'R'}, id=jids[0])
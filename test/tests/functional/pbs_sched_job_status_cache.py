@@ -0,0 +1,158 @@
+# coding: utf-8
+
+# Copyright (C) 1994-2021 Altair Engineering, Inc.
+# For more information, contact Altair at www.altair.com.
+#
+# This file is part of both the OpenPBS software ("OpenPBS")
+# and the PBS Professional ("PBS Pro") software.
+#
+# Open Source License Information:
+#
+# OpenPBS is free software. You can redistribute it and/or modify it under
+# the terms of the GNU Affero General Public License as published by the
+# Free Software Foundation, either version 3 of the License, or (at your
+# option) any later version.
+#
+# OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+# License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Commercial License Information:
+#
+# PBS Pro is commercially licensed software that shares a common core with
+# the OpenPBS software.  For a copy of the commercial license terms and
+# conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+# Altair Legal Department.
+#
+# Altair's dual-license business model allows companies, individuals, and
+# organizations to create proprietary derivative works of OpenPBS and
+# distribute them - whether embedded or bundled with other software -
+# under a commercial license agreement.
+#
+# Use of Altair's trademarks, including but not limited to "PBS™",
+# "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+# subject to Altair's trademark licensing policies.
+
+from tests.functional import *
+
+
+class TestSchedJobStatusCache(TestFunctional):
+    """
+    Tests for the scheduler's job status cache, which keeps job status
+    between cycles and only queries jobs which changed
+    """
+
+    def setUp(self):
+        TestFunctional.setUp(self)
+        a = {'resources_available.ncpus': 2}
+        self.server.manager(MGR_CMD_SET, NODE, a, id=self.mom.shortname)
+        a = {'log_events': 2047, 'scheduling': 'False'}
+        self.server.manager(MGR_CMD_SET, SCHED, a, id='default')
+
+    def test_altered_job_is_seen(self):
+        """
+        Test that a queued job which is altered between cycles is seen
+        with its new request by the next cycle
+        """
+        j = Job(attrs={'Resource_List.select': '1:ncpus=4'})
+        jid = self.server.submit(j)
+
+        self.scheduler.run_scheduling_cycle()
+        self.server.expect(JOB, {'job_state': 'Q'}, id=jid)
+
+        self.server.alterjob(jid, {'Resource_List.select': '1:ncpus=1'})
+        t = time.time()
+        self.scheduler.run_scheduling_cycle()
+        self.scheduler.log_match('changed since last cycle', starttime=t)
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid)
+
+    def test_deleted_job_is_dropped(self):
+        """
+        Test that a job deleted between cycles is not considered again
+        and that a new job is picked up by the next cycle
+        """
+        j = Job(attrs={'Resource_List.select': '1:ncpus=4'})
+        jid1 = self.server.submit(j)
+        self.scheduler.run_scheduling_cycle()
+        self.server.expect(JOB, {'job_state': 'Q'}, id=jid1)
+
+        self.server.delete(jid1, wait=True)
+        jid2 = self.server.submit(Job())
+
+        t = time.time()
+        self.scheduler.run_scheduling_cycle()
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid2)
+        self.scheduler.log_match(jid1 + ';Considering job to run',
+                                 starttime=t, existence=False,
+                                 max_attempts=5)
+
+    def test_resync_on_server_restart(self):
+        """
+        Test that the scheduler throws away its job status cache
+        when the server restarts
+        """
+        jid = self.server.submit(Job(attrs={'Resource_List.ncpus': 4}))
+        self.scheduler.run_scheduling_cycle()
+        self.server.expect(JOB, {'job_state': 'Q'}, id=jid)
+
+        t = time.time()
+        self.server.restart()
+        self.scheduler.log_match('Job status cache invalidated',
+                                 starttime=t)
+
+    def test_array_job_stays_in_sync(self):
+        """
+        Test that a partly running array job does not make the scheduler
+        re-sync its job status cache every cycle, and that its queued
+        subjobs still run once there is room
+        """
+        a = {'Resource_List.select': '1:ncpus=1', ATTR_J: '1-4'}
+        j = Job(attrs=a)
+        jid = self.server.submit(j)
+        subjid1 = j.create_subjob_id(jid, 1)
+        subjid3 = j.create_subjob_id(jid, 3)
+        self.scheduler.run_scheduling_cycle()
+        self.server.expect(JOB, {'job_state': 'B'}, id=jid)
+        self.server.expect(JOB, {'job_state': 'R'}, id=subjid1)
+
+        t = time.time()
+        self.scheduler.run_scheduling_cycle()
+        self.scheduler.log_match('changed since last cycle', starttime=t)
+        self.scheduler.log_match('Job status cache out of sync',
+                                 starttime=t, existence=False,
+                                 max_attempts=5)
+        self.scheduler.log_match('Job status cache synced',
+                                 starttime=t, existence=False,
+                                 max_attempts=1)
+
+        self.server.delete(subjid1, wait=True)
+        t = time.time()
+        self.scheduler.run_scheduling_cycle()
+        self.server.expect(JOB, {'job_state': 'R'}, id=subjid3)
+        self.scheduler.log_match('Job status cache out of sync',
+                                 starttime=t, existence=False,
+                                 max_attempts=5)
+
+    def test_empty_queue_stays_in_sync(self):
+        """
+        Test that an empty queue is refreshed from the cache instead of
+        being queried in full every cycle, and that a job submitted to
+        it later is seen
+        """
+        self.scheduler.run_scheduling_cycle()
+        t = time.time()
+        self.scheduler.run_scheduling_cycle()
+        self.scheduler.log_match('Job status cache: 0 jobs, 0 changed '
+                                 'since last cycle', starttime=t)
+
+        jid = self.server.submit(Job())
+        t = time.time()
+        self.scheduler.run_scheduling_cycle()
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid)
+        self.scheduler.log_match('Job status cache out of sync',
+                                 starttime=t, existence=False,
+                                 max_attempts=5)
@@ -0,0 +1,100 @@
+# coding: utf-8
+
+# Copyright (C) 1994-2021 Altair Engineering, Inc.
+# For more information, contact Altair at www.altair.com.
+#
+# This file is part of both the OpenPBS software ("OpenPBS")
+# and the PBS Professional ("PBS Pro") software.
+#
+# Open Source License Information:
+#
+# OpenPBS is free software. You can redistribute it and/or modify it under
+# the terms of the GNU Affero General Public License as published by the
+# Free Software Foundation, either version 3 of the License, or (at your
+# option) any later version.
+#
+# OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+# License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Commercial License Information:
+#
+# PBS Pro is commercially licensed software that shares a common core with
+# the OpenPBS software.  For a copy of the commercial license terms and
+# conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+# Altair Legal Department.
+#
+# Altair's dual-license business model allows companies, individuals, and
+# organizations to create proprietary derivative works of OpenPBS and
+# distribute them - whether embedded or bundled with other software -
+# under a commercial license agreement.
+#
+# Use of Altair's trademarks, including but not limited to "PBS™",
+# "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+# subject to Altair's trademark licensing policies.
+
+
+from tests.functional import *
+
+
+class TestSchedSnapshot(TestFunctional):
+    """
+    Tests for the server snapshots the scheduler simulates in when it
+    estimates the start time of top jobs and when it looks for jobs
+    to preempt
+    """
+
+    def setUp(self):
+        TestFunctional.setUp(self)
+        a = {'resources_available.ncpus': 2}
+        self.server.manager(MGR_CMD_SET, NODE, a, id=self.mom.shortname)
+        a = {'log_events': 2047}
+        self.server.manager(MGR_CMD_SET, SCHED, a, id='default')
+
+    def test_topjob_snapshot(self):
+        """
+        Test that estimating the start time of a top job only clones
+        the running jobs and the top job, and that the estimate is set
+        """
+        self.scheduler.set_sched_config({'strict_ordering': 'True ALL'})
+        self.server.manager(MGR_CMD_SET, SERVER, {'scheduling': 'False'})
+        a = {'Resource_List.select': '1:ncpus=2',
+             'Resource_List.walltime': '1:00:00'}
+        jid1 = self.server.submit(Job(attrs=a))
+        self.scheduler.run_scheduling_cycle()
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid1)
+
+        jids = [self.server.submit(Job(attrs=a)) for _ in range(4)]
+        t = time.time()
+        self.scheduler.run_scheduling_cycle()
+        self.scheduler.log_match('Snapshot cloned 2 of 5 jobs', starttime=t)
+        self.server.expect(JOB, 'estimated.start_time', op=SET, id=jids[0])
+        self.scheduler.log_match(jids[0] + ';Job is a top job',
+                                 starttime=t)
+
+    def test_preempt_snapshot(self):
+        """
+        Test that looking for jobs to preempt only clones the running
+        jobs and the high priority job, and that preemption happens
+        """
+        a = {'queue_type': 'execution',
+             'started': 'True',
+             'enabled': 'True',
+             'Priority': 200}
+        self.server.manager(MGR_CMD_CREATE, QUEUE, a, 'expressq')
+        a = {'Resource_List.select': '1:ncpus=2'}
+        jid1 = self.server.submit(Job(TEST_USER, attrs=a))
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid1)
+        for _ in range(3):
+            self.server.submit(Job(TEST_USER, attrs=a))
+
+        t = time.time()
+        a['queue'] = 'expressq'
+        jid2 = self.server.submit(Job(TEST_USER, attrs=a))
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid2)
+        self.server.expect(JOB, {'job_state': 'S'}, id=jid1)
+        self.scheduler.log_match('Snapshot cloned 2 of 5 jobs', starttime=t)
@@ -0,0 +1,103 @@
+# coding: utf-8
+
+# Copyright (C) 1994-2021 Altair Engineering, Inc.
+# For more information, contact Altair at www.altair.com.
+#
+# This file is part of both the OpenPBS software ("OpenPBS")
+# and the PBS Professional ("PBS Pro") software.
+#
+# Open Source License Information:
+#
+# OpenPBS is free software. You can redistribute it and/or modify it under
+# the terms of the GNU Affero General Public License as published by the
+# Free Software Foundation, either version 3 of the License, or (at your
+# option) any later version.
+#
+# OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+# License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Commercial License Information:
+#
+# PBS Pro is commercially licensed software that shares a common core with
+# the OpenPBS software.  For a copy of the commercial license terms and
+# conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+# Altair Legal Department.
+#
+# Altair's dual-license business model allows companies, individuals, and
+# organizations to create proprietary derivative works of OpenPBS and
+# distribute them - whether embedded or bundled with other software -
+# under a commercial license agreement.
+#
+# Use of Altair's trademarks, including but not limited to "PBS™",
+# "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+# subject to Altair's trademark licensing policies.
+
+from tests.functional import *
+
+
+class TestSchedSpecCheck(TestFunctional):
+    """
+    Tests for the scheduler's parallel pre-checks of the jobs coming up
+    in the main scheduling loop
+    """
+
+    def setUp(self):
+        TestFunctional.setUp(self)
+        self.du.set_pbs_config(self.scheduler.hostname,
+                               confs={'PBS_SCHED_THREADS': '2'})
+        self.scheduler.restart()
+        a = {'log_events': 2047, 'scheduling': 'False'}
+        self.server.manager(MGR_CMD_SET, SCHED, a, id='default')
+        a = {'resources_available.ncpus': 4}
+        self.mom.create_vnodes(a, 4)
+
+    def tearDown(self):
+        self.du.unset_pbs_config(self.scheduler.hostname,
+                                 confs=['PBS_SCHED_THREADS'])
+        self.scheduler.restart()
+        TestFunctional.tearDown(self)
+
+    def test_limit_failures_prechecked(self):
+        """
+        Test that jobs held back by a limit get the same comment when
+        they are answered by the pre-checks
+        """
+        self.server.manager(MGR_CMD_SET, SERVER,
+                            {'max_run': '[u:PBS_GENERIC=1]'})
+        jids = []
+        for n in range(1, 5):
+            a = {'Resource_List.select': '1:ncpus=%d' % n}
+            jids.append(self.server.submit(Job(TEST_USER, attrs=a)))
+
+        t = time.time()
+        self.scheduler.run_scheduling_cycle()
+        self.server.expect(JOB, {'job_state': 'R'}, id=jids[0])
+        msg = 'Not Running: User has reached server running job limit.'
+        for jid in jids[1:]:
+            self.server.expect(JOB, {'job_state': 'Q', 'comment': msg},
+                               id=jid)
+        self.scheduler.log_match(
+            '3 jobs were found unable to run by the parallel pre-checks',
+            starttime=t)
+
+    def test_never_run_prechecked(self):
+        """
+        Test that a job which can never fit the complex is still marked
+        as such when it is answered by the pre-checks
+        """
+        a = {'Resource_List.select': '1:ncpus=1'}
+        jid1 = self.server.submit(Job(attrs=a))
+        a = {'Resource_List.select': '1:ncpus=64'}
+        jid2 = self.server.submit(Job(attrs=a))
+
+        t = time.time()
+        self.scheduler.run_scheduling_cycle()
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid1)
+        self.server.expect(JOB, {'job_state': 'Q'}, id=jid2)
+        self.scheduler.log_match(jid2 + ';Job will never run',
+                                 starttime=t)
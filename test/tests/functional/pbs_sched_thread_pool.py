@@ -0,0 +1,100 @@
+# coding: utf-8
+
+# Copyright (C) 1994-2021 Altair Engineering, Inc.
+# For more information, contact Altair at www.altair.com.
+#
+# This file is part of both the OpenPBS software ("OpenPBS")
+# and the PBS Professional ("PBS Pro") software.
+#
+# Open Source License Information:
+#
+# OpenPBS is free software. You can redistribute it and/or modify it under
+# the terms of the GNU Affero General Public License as published by the
+# Free Software Foundation, either version 3 of the License, or (at your
+# option) any later version.
+#
+# OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+# License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Commercial License Information:
+#
+# PBS Pro is commercially licensed software that shares a common core with
+# the OpenPBS software.  For a copy of the commercial license terms and
+# conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+# Altair Legal Department.
+#
+# Altair's dual-license business model allows companies, individuals, and
+# organizations to create proprietary derivative works of OpenPBS and
+# distribute them - whether embedded or bundled with other software -
+# under a commercial license agreement.
+#
+# Use of Altair's trademarks, including but not limited to "PBS™",
+# "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+# subject to Altair's trademark licensing policies.
+
+
+from tests.functional import *
+
+
+class TestSchedThreadPool(TestFunctional):
+    """
+    Tests for the scheduler's work-stealing thread pool
+    """
+
+    def setUp(self):
+        TestFunctional.setUp(self)
+        self.du.set_pbs_config(self.scheduler.hostname,
+                               confs={'PBS_SCHED_THREADS': '2'})
+        self.scheduler.restart()
+        a = {'log_events': 2047, 'scheduling': 'False'}
+        self.server.manager(MGR_CMD_SET, SCHED, a, id='default')
+        a = {'resources_available.ncpus': 4}
+        self.mom.create_vnodes(a, 8)
+
+    def tearDown(self):
+        self.du.unset_pbs_config(self.scheduler.hostname,
+                                 confs=['PBS_SCHED_THREADS'])
+        self.scheduler.restart()
+        TestFunctional.tearDown(self)
+
+    def test_task_counters_logged(self):
+        """
+        Test that the thread pool logs its per-task timing counters at
+        the end of the cycle and that jobs still run
+        """
+        jids = [self.server.submit(Job()) for _ in range(4)]
+        t = time.time()
+        self.scheduler.run_scheduling_cycle()
+        for jid in jids:
+            self.server.expect(JOB, {'job_state': 'R'}, id=jid)
+        self.scheduler.log_match(
+            r'free_nodes: \d+ tasks, \d+ stolen, [0-9.]+ seconds',
+            regexp=True, starttime=t)
+        self.scheduler.log_match(
+            r'free_resource_resv_array: \d+ tasks, \d+ stolen',
+            regexp=True, starttime=t)
+
+    def test_standing_resv_occurrences(self):
+        """
+        Test that a standing reservation whose occurrences are checked on
+        the worker threads is confirmed with one execvnode per occurrence
+        """
+        tzone = self.conf.get('PBS_TZID', 'Asia/Kolkata')
+        start = int(time.time()) + 3600
+        a = {'Resource_List.select': '2:ncpus=4',
+             'reserve_start': start,
+             'reserve_end': start + 600,
+             'reserve_timezone': tzone,
+             'reserve_rrule': 'FREQ=HOURLY;COUNT=6'}
+        t = time.time()
+        rid = self.server.submit(Reservation(TEST_USER, a))
+        self.scheduler.run_scheduling_cycle()
+        a = {'reserve_state': (MATCH_RE, 'RESV_CONFIRMED|2')}
+        self.server.expect(RESV, a, id=rid)
+        self.scheduler.log_match(rid + ';Confirming 6 Occurrences',
+                                 starttime=t)